@@ -92,6 +92,57 @@ extern "C" {
 #define AUG_APPROX_THRESHOLD 0.0000001
 #endif//AUG_APPROX_THRESHOLD 
 
+// Dispatch virtual machine instructions using a table of label addresses (computed goto) instead of a switch.
+// Requires the labels as values extension (GCC, Clang). Ignored for other compilers
+#ifndef AUG_THREADED_DISPATCH
+#define AUG_THREADED_DISPATCH 0
+#endif//AUG_THREADED_DISPATCH
+
+// Optimization level of the compiled bytecode. Default value of the vm's optimize_level
+//  0 - No optimizations. Operations are written as generated
+//  1 - Remove redundant operations, i.e. discarded pushes and empty pops, fold constant expressions and remove 
+//      unreachable code
+//  2 - Fuse common operation sequences into superinstructions
+#ifndef AUG_OPTIMIZE_LEVEL
+#define AUG_OPTIMIZE_LEVEL 2
+#endif//AUG_OPTIMIZE_LEVEL
+
+// Bytecode backend of the compiled scripts. Default value of the vm's backend, see aug_backend
+//  0 - Stack. Operands are pushed onto the stack, and instructions operate on the top of the stack
+//  1 - Register. Variables and int constants are operands of three address instructions, that read and write the
+//      frame's local slots, globals or the temporaries on top of the stack directly. Executed by a separate loop
+#ifndef AUG_BACKEND
+#define AUG_BACKEND 0
+#endif//AUG_BACKEND
+
+// Rewrite arithmetic and comparison instructions at runtime to variants specialized for the operand types seen, 
+// int and int or float and float. Specialized instructions revert to the generic instruction if their operands differ
+#ifndef AUG_QUICKEN
+#define AUG_QUICKEN 1
+#endif//AUG_QUICKEN
+
+// Keep the compiled scripts by filename in the vm. Compiling an unmodified file reuses the cached compile, checked by 
+// the modification time and size of the script and its imported scripts, or by a hash of the contents if unsupported
+#ifndef AUG_SCRIPT_CACHE
+#define AUG_SCRIPT_CACHE 1
+#endif//AUG_SCRIPT_CACHE
+
+// Compile functions to native code once called AUG_JIT_THRESHOLD times, and loops once iterated as many times. Number 
+// arithmetic, comparisons, local variables and range loops are compiled inline, other instructions call their handlers. 
+// Supported on Linux x86-64 with GCC or Clang, ignored otherwise. Coroutines and profiled executions are always interpreted
+#ifndef AUG_JIT
+#define AUG_JIT 0
+#endif//AUG_JIT
+
+#ifndef AUG_JIT_THRESHOLD
+#define AUG_JIT_THRESHOLD 100
+#endif//AUG_JIT_THRESHOLD
+
+#if AUG_JIT && !(defined(__linux) && defined(__GNUC__) && defined(__x86_64__))
+#undef AUG_JIT
+#define AUG_JIT 0
+#endif//AUG_JIT
+
 #ifndef AUG_ALLOW_NO_SEMICOLON
 #define AUG_ALLOW_NO_SEMICOLON true
 #endif//AUG_ALLOW_NO_SEMICOLON
@@ -100,6 +151,60 @@ extern "C" {
 #define AUG_ALLOW_SINGLE_STMT_BLOCK true
 #endif//AUG_ALLOW_SINGLE_STMT_BLOCK
 
+// Report the values still alive when a VM or context releases its heap. Used to find reference count leaks
+#ifndef AUG_LEAK_CHECK
+#define AUG_LEAK_CHECK AUG_DEBUG
+#endif//AUG_LEAK_CHECK
+
+// Collect the arrays and maps that reference each other in a cycle, which reference counting never releases. 
+// See aug_collect
+#ifndef AUG_CYCLE_COLLECT
+#define AUG_CYCLE_COLLECT 1
+#endif//AUG_CYCLE_COLLECT
+
+// Number of possible cycle roots buffered before the VM API runs a collection step, after a call, load or evaluation
+#ifndef AUG_CYCLE_COLLECT_THRESHOLD
+#define AUG_CYCLE_COLLECT_THRESHOLD 1024
+#endif//AUG_CYCLE_COLLECT_THRESHOLD
+
+// Work of the collection steps run by the VM API. The containers visited by the cycle collector, and the elements 
+// released from deferred releases
+#ifndef AUG_COLLECT_BUDGET
+#define AUG_COLLECT_BUDGET 4096
+#endif//AUG_COLLECT_BUDGET
+
+// Arrays and maps of more elements release their elements incrementally once unreferenced, instead of all at once.
+// Each array or map allocation releases AUG_DEFER_RELEASE_STEP deferred elements, and the VM API releases 
+// AUG_COLLECT_BUDGET elements after a call, load or evaluation. 0 releases all elements immediately
+#ifndef AUG_DEFER_RELEASE_SIZE
+#define AUG_DEFER_RELEASE_SIZE 4096
+#endif//AUG_DEFER_RELEASE_SIZE
+
+#ifndef AUG_DEFER_RELEASE_STEP
+#define AUG_DEFER_RELEASE_STEP 64
+#endif//AUG_DEFER_RELEASE_STEP
+
+// Number of instructions between the source line samples taken while profiling
+#ifndef AUG_PROFILE_SAMPLE_INTERVAL
+#define AUG_PROFILE_SAMPLE_INTERVAL 64
+#endif//AUG_PROFILE_SAMPLE_INTERVAL
+
+// Use SSE2 or NEON intrinsics for the typed array bulk operations, when supported by the target
+#ifndef AUG_SIMD
+#define AUG_SIMD 1
+#endif//AUG_SIMD
+
+// Store values in 8 bytes instead of 16, by packing the type into the upper bits of the payload. Code outside of aug.h 
+// must use the aug_value accessors, aug_create_* and aug_to_* functions rather than the value fields
+#ifndef AUG_COMPACT_VALUE
+#define AUG_COMPACT_VALUE 0
+#endif//AUG_COMPACT_VALUE
+
+// Strings up to this size, including the null terminator, are stored inline within the string header
+#ifndef AUG_STRING_LOCAL_SIZE
+#define AUG_STRING_LOCAL_SIZE 16
+#endif//AUG_STRING_LOCAL_SIZE
+
 #ifndef AUG_REGISTER_LIB_FUNC
 #define AUG_REGISTER_LIB_FUNC "aug_register_lib"
 #endif//AUG_REGISTER_LIB_FUNC
@@ -137,16 +242,44 @@ typedef struct aug_vm aug_vm;
 typedef struct aug_value aug_value;
 typedef struct aug_hashtable aug_hashtable;
 typedef struct aug_container aug_container;
+typedef struct aug_heap aug_heap;
+typedef struct aug_context aug_context;
+typedef struct aug_profiler aug_profiler;
+typedef struct aug_profile_node aug_profile_node;
+typedef struct aug_snapshot aug_snapshot;
 
 // String data type value
 typedef struct aug_string
 {
-	char *buffer;
+	char *buffer; // points to local for short strings
 	int ref_count;
 	size_t capacity;
 	size_t length;
+	size_t hash; // cached by aug_string_hash, 0 if not computed. Reset by modifying functions
+	aug_heap* heap; // owning allocator, NULL if owned by a compile arena
+	bool constant; // buffer is read only. Shared with source until the first modification copies it, the literals of a 
+	               // script's constant pool and compile arena strings own theirs and are never modified
+	struct aug_string* source; // constant the buffer is shared with, see aug_string_share
+	size_t epoch; // heap epoch of the last change, see aug_heap_track
+	char local[AUG_STRING_LOCAL_SIZE];
 } aug_string;
 
+// Cycle collector colors, see aug_collect
+typedef enum aug_gc_color
+{
+    AUG_GC_BLACK = 0, // in use
+    AUG_GC_GRAY,      // references from the marked containers subtracted
+    AUG_GC_WHITE,     // referenced only by the marked containers
+    AUG_GC_GARBAGE    // white, gathered to release
+} aug_gc_color;
+
+// Cycle collector state of the container types, see aug_collect
+typedef struct aug_gc_node
+{
+    int root;      // index in the heap's buffered cycle roots, -1 if not buffered
+    uint8_t color; // aug_gc_color, black while not being collected
+} aug_gc_node;
+
 // Array data type value
 typedef struct aug_array
 {
@@ -154,17 +287,23 @@ typedef struct aug_array
 	int ref_count;
 	size_t capacity;
 	size_t length;
+	aug_heap* heap; // owning allocator
+	size_t epoch; // heap epoch of the last change, see aug_heap_track
+	aug_gc_node gc;
 } aug_array;
 
-typedef struct aug_map_bucket aug_map_bucket;
+typedef struct aug_map_slot aug_map_slot;
 
 // Associative Array data type value
 typedef struct aug_map
 {
-    aug_map_bucket* buckets;
+    aug_map_slot* slots;
     size_t capacity;
     size_t count;
     size_t ref_count;
+    aug_heap* heap; // owning allocator
+    size_t epoch; // heap epoch of the last change, see aug_heap_track
+    aug_gc_node gc;
 } aug_map;
 
 // Range is a tuple [from,to) 
@@ -172,6 +311,7 @@ typedef struct aug_range
 {
     int from, to;
     size_t ref_count;
+    aug_heap* heap; // owning allocator
 } aug_range;
 
 // TODO: Class data types value
@@ -197,17 +337,91 @@ typedef enum aug_type
     AUG_FUNCTION,
     AUG_ITERATOR,
     AUG_USERDATA,
+    AUG_TYPED_ARRAY,
+    AUG_BUFFER_VIEW,
     AUG_NONE,
 } aug_type;
 
+// Packed array data type value. Elements are ints or floats, stored without their type tags
+typedef struct aug_typed_array
+{
+    union
+    {
+        void* buffer;
+        int* ints;          // AUG_INT elements
+        float* floats;      // AUG_FLOAT elements
+    };
+    aug_type element_type;  // AUG_INT or AUG_FLOAT
+    int ref_count;
+    size_t capacity;
+    size_t length;
+    aug_heap* heap; // owning allocator
+    size_t epoch; // heap epoch of the last change, see aug_heap_track
+} aug_typed_array;
+
+// Element types of buffer views. Scripts read the integer types as ints, and the floating point types as floats
+typedef enum aug_view_type
+{
+    AUG_VIEW_INT8 = 0,
+    AUG_VIEW_UINT8,
+    AUG_VIEW_INT16,
+    AUG_VIEW_UINT16,
+    AUG_VIEW_INT32,
+    AUG_VIEW_UINT32, // values above INT_MAX read as negative ints, as ints are 32 bit signed
+    AUG_VIEW_FLOAT,
+    AUG_VIEW_DOUBLE, // read and written with float precision, as floats are 32 bit. Values do not round trip
+} aug_view_type;
+
+// Called once a buffer view is unreferenced, with the view's data and user pointer
+typedef void(aug_view_release_func)(void* /*data*/, void* /*user*/);
+
+// View of host memory, read and written in place. The memory is owned by the host, and must outlive the view
+typedef struct aug_buffer_view
+{
+    char* data;
+    aug_view_type element_type;
+    int ref_count;
+    size_t length;
+    size_t stride; // bytes between the start of consecutive elements
+    aug_view_release_func* release; // NULL if the host releases the memory separately
+    void* user;
+    aug_heap* heap; // owning allocator of the view, not the memory
+} aug_buffer_view;
+
 typedef struct aug_iterator
 {
 	aug_value* iterable;
 	aug_value* index;
     size_t ref_count;
+    aug_heap* heap; // owning allocator
 } aug_iterator;
 
 // Values instance 
+#if AUG_COMPACT_VALUE
+// The type is stored in the upper 16 bits, and the payload in the lower 48 bits. Ints, floats, chars and bools are 
+// stored as their 32 bit patterns. Pointers must fit in 48 bits, as user space addresses do on 64 bit targets
+typedef struct aug_value
+{
+    uint64_t bits;
+} aug_value;
+
+#define AUG_VALUE_TYPE_SHIFT 48
+#define AUG_VALUE_PAYLOAD_MASK ((UINT64_C(1) << AUG_VALUE_TYPE_SHIFT) - 1)
+
+static inline float aug_value_bits_float(uint64_t bits)
+{
+    union { uint32_t u; float f; } pun;
+    pun.u = (uint32_t)bits;
+    return pun.f;
+}
+
+#define aug_value_type(value)        ((aug_type)((value)->bits >> AUG_VALUE_TYPE_SHIFT))
+#define aug_value_pointer(value)     ((void*)(uintptr_t)((value)->bits & AUG_VALUE_PAYLOAD_MASK))
+#define aug_value_bool(value)        ((bool)((value)->bits & 1))
+#define aug_value_char(value)        ((char)(unsigned char)(value)->bits)
+#define aug_value_int(value)         ((int)(uint32_t)(value)->bits)
+#define aug_value_float(value)       aug_value_bits_float((value)->bits)
+#else
 typedef struct aug_value
 {
     aug_type type;
@@ -224,20 +438,78 @@ typedef struct aug_value
         aug_range* range;   // AUG_RANGE
         aug_object* obj;    // AUG_OBJECT
         void* userdata;     // AUG_USERDATA (custom data type for users)
+        aug_typed_array* typed; // AUG_TYPED_ARRAY
+        aug_buffer_view* view;  // AUG_BUFFER_VIEW
     };
 } aug_value;
 
+#define aug_value_type(value)        ((value)->type)
+#define aug_value_pointer(value)     ((value)->userdata)
+#define aug_value_bool(value)        ((value)->b)
+#define aug_value_char(value)        ((value)->c)
+#define aug_value_int(value)         ((value)->i)
+#define aug_value_float(value)       ((value)->f)
+#endif//AUG_COMPACT_VALUE
+
+// Value field accessors. Use these instead of the fields, so that code is independent of AUG_COMPACT_VALUE.
+// The accessors do not convert. The value must be of the accessed type, see aug_to_int and aug_to_float to convert
+#define aug_value_string(value)      ((aug_string*)aug_value_pointer(value))
+#define aug_value_array(value)       ((aug_array*)aug_value_pointer(value))
+#define aug_value_map(value)         ((aug_map*)aug_value_pointer(value))
+#define aug_value_iterator(value)    ((aug_iterator*)aug_value_pointer(value))
+#define aug_value_range(value)       ((aug_range*)aug_value_pointer(value))
+#define aug_value_object(value)      ((aug_object*)aug_value_pointer(value))
+#define aug_value_userdata(value)    aug_value_pointer(value)
+#define aug_value_typed_array(value) ((aug_typed_array*)aug_value_pointer(value))
+#define aug_value_buffer_view(value) ((aug_buffer_view*)aug_value_pointer(value))
+
+typedef aug_value /*return*/(aug_extension_func)(int argc, aug_value* /*args*/);
+
+// Bytecode backends. The register backend replaces stack operations on variables and int constants with three address 
+// instructions, see AUG_BACKEND. Set in the vm before compiling a script, both may be loaded by the same vm
+typedef enum aug_backend
+{
+    AUG_BACKEND_STACK = 0,
+    AUG_BACKEND_REGISTER
+} aug_backend;
+
 // Represents a "compiled" script
 typedef struct aug_script
 {
     aug_hashtable* globals;         // global defined symbols
     char* bytecode;                 // raw pointer to instruction set
+    size_t bytecode_size;           // size of the instruction set in bytes
     aug_array* stack_state;         // current state of the stack before and after execution 
     aug_hashtable* lib_extensions;  // lib loaded extensions
 
     aug_container* markers;   // aug_trace_marker info for error handling
+
+    // Extension functions called by the script. CALL_EXT indexes these by slot
+    aug_container* extension_names;        // type aug_string*
+    aug_extension_func** extension_slots;  // resolved from the extension names, NULL if not registered
+    int extension_version;                 // vm extensions version the slots were resolved against
+
+    aug_container* constants; // type aug_string*, string literals indexed by PUSH_STRING
+    int backend;              // aug_backend the bytecode was generated for
+
+    // Precompiled file contents. When loaded from a compiled file, the bytecode points into this buffer
+    char* compiled_data;
+    size_t compiled_size;
+    bool compiled_mapped; // compiled data is a read-only file mapping
+
+#if AUG_JIT
+    struct aug_jit* jit; // native code compiled from the bytecode
+#endif//AUG_JIT
 } aug_script;
 
+// Handle to a script function, resolved once by aug_get_function. Calling through the handle skips the function lookup
+typedef struct aug_function
+{
+    aug_script* script;
+    int addr; // bytecode address of the function, -1 if the handle is invalid
+    int argc; // expected argument count
+} aug_function;
+
 // Calling frames are used to access parameters and local variables from the stack within a calling context
 typedef struct aug_frame
 {
@@ -251,7 +523,6 @@ typedef struct aug_frame
 } aug_frame;
 
 typedef void(aug_error_func)(const char* /*msg*/);
-typedef aug_value /*return*/(aug_extension_func)(int argc, aug_value* /*args*/);
 
 typedef struct aug_extension
 {
@@ -261,34 +532,81 @@ typedef struct aug_extension
 // Handle to a loaded extension lib
 typedef void* aug_lib_handle;
 
+// Loaded library, with the extensions it registered. Later imports of the library reuse these without reloading it
+typedef struct aug_lib
+{
+    aug_lib_handle handle;
+    aug_hashtable* extensions; // func_name->aug_extension
+} aug_lib;
+
 // Type signature for external library entry points
 typedef void (*aug_register_lib_func)(aug_vm* /*vm*/);
 
-// Running instance of the virtual machine
-typedef struct aug_vm
+// Allocator used by a VM for script values. The user pointer is passed to each function
+typedef struct aug_allocator
 {
-    const char* exec_filepath;
-    aug_error_func* error_func;
+    void* (*alloc)(void* /*user*/, size_t /*size*/);
+    void* (*realloc)(void* /*user*/, void* /*ptr*/, size_t /*size*/);
+    void (*free)(void* /*user*/, void* /*ptr*/);
+    void* user;
+} aug_allocator;
+
+// Running instance of the virtual machine
+// Execution context. Holds the stack and the runtime state of the script being executed.
+// The VM runs its own context. Contexts created with aug_context_new share the VM and a loaded script read-only, 
+// and own private copies of the script's globals, constants and extension slots
+typedef struct aug_context
+{
+    aug_vm* vm;     // shared VM state
+    aug_heap* heap; // allocator and slab pools for values created in this context
+    aug_script* script; // script this context was created for, NULL for the VM's context
     bool valid;
     bool running;
-
-    aug_hashtable* extensions; // func_name->aug_extension. all globally registered extensions. available to all scripts
-    aug_container* libs;       // aug_lib_handle. loaded library handles for the registered extensions
-    aug_container* markers;    // weak pointer to script's aug_trace_markers
-    aug_hashtable* lib_extensions;  // Weak pointer to script loaded libs
-
-    // Script runtime context state
+    bool coroutine; // executing a coroutine, yield statements suspend execution
+    bool suspended; // execution stopped at a yield or once the budget was exhausted, and can be resumed
+    int budget;     // instructions executed before a coroutine is suspended, 0 for no limit
 
     const char* instruction;      // Index pointer to current bytecode being executed
     const char* last_instruction; // Weak pointer to bytecode last bytecode executed
     const char* bytecode;         // Weak pointer to script bytecode 
-    aug_value stack[AUG_STACK_SIZE];
+    bool registers;               // bytecode generated by the register backend, executed by aug_vm_execute_registers
+    aug_container* markers;               // weak pointer to script's aug_trace_markers
+    aug_hashtable* lib_extensions;        // Weak pointer to script loaded libs
+    aug_container* extension_names;       // Weak pointer to script extension names
+    aug_extension_func** extension_slots; // Weak pointer to script extension slots, owned if created for a script
+    int extension_version;                // Extensions version the slots were resolved against
+    aug_container* constants;             // Weak pointer to script string constants, owned if created for a script
+    aug_value* stack;
+    int stack_size;  // Number of values allocated for the stack 
+    aug_value* globals; // Global values, either the bottom of the stack or the script's resident state
+    int globals_size;
     int stack_index; // Current position on stack (ESP)
     int base_index;  // Current frame stack offset (EBP)
     int arg_count;   // Current argument count expected when entering a call frame
+    aug_profiler* profiler;         // Records the execution when attached, NULL if not profiling
+    aug_profile_node* profile_node; // Call tree node of the function being executed while profiling
+#if AUG_JIT
+    struct aug_jit* jit; // Weak pointer to the native code of the script bytecode, owned if created for a script
+#endif//AUG_JIT
+} aug_context;
+
+typedef struct aug_vm
+{
+    const char* exec_filepath;
+    aug_error_func* error_func;
+    aug_heap* heap; // allocator and slab pools for values created by this VM
+    aug_context* context; // execution context used by the VM API
+
+    aug_hashtable* extensions; // func_name->aug_extension. all globally registered extensions. available to all scripts
+    aug_hashtable* libs;       // lib_name->aug_lib. loaded library handles and their registered extensions
+    aug_hashtable* scripts;    // filename->aug_cached_script. compiled scripts reused while unmodified
+    int extensions_version;    // Incremented when extensions are registered or unregistered. Used to invalidate extension slots
+
+    int optimize_level; // Optimization level used when compiling scripts. See AUG_OPTIMIZE_LEVEL
+    int backend;        // Bytecode backend used when compiling scripts, see aug_backend. Default AUG_BACKEND
 
 #if AUG_DEBUG
-    void (*debug_post_instruction)(aug_vm* /*vm*/, int /*opcode*/);
+    void (*debug_post_instruction)(aug_context* /*context*/, int /*opcode*/);
 #endif
 
 } aug_vm;
@@ -302,12 +620,37 @@ typedef struct aug_vm_exec_state
     aug_array* stack_state;         // current state of the stack before and after execution 
     aug_hashtable* lib_extensions;  
     aug_container* markers;   
+    aug_container* extension_names;
+    aug_extension_func** extension_slots;
+    int extension_version;
+    aug_container* constants;
+    aug_value* globals;
+    int globals_size;
+    int arg_count;
+    bool coroutine;
+    bool registers;
+    int budget;
+    aug_profile_node* profile_node;
+#if AUG_JIT
+    struct aug_jit* jit;
+#endif//AUG_JIT
 } aug_vm_exec_state;
 
+// Coroutines are calls that suspend at a yield statement, or once the instruction budget is exhausted. 
+// While suspended, the execution state is saved so that the VM can be used for other calls until resumed
+typedef struct aug_coroutine
+{
+    aug_vm_exec_state state; // execution state saved while suspended
+    int budget;              // instructions executed per start or resume before suspending, 0 for no limit
+    bool suspended;          // true while the coroutine can be resumed, false once the function returned
+} aug_coroutine;
+
 // VM API ----------------------------------------- VM API ---------------------------------------------------- VM API//
 
 // VM Must call both startup before using the VM. When done, must call shutdown.
-aug_vm* aug_startup(aug_error_func* on_error);
+// Values created by the VM are allocated with the allocator, or AUG_ALLOC/AUG_REALLOC/AUG_FREE if NULL. 
+// The allocator is copied. Values must be released before shutdown, as the VM owns their memory pools
+aug_vm* aug_startup(aug_error_func* on_error, const aug_allocator* allocator);
 void aug_shutdown(aug_vm* vm);
 
 // Extensions are native functions that can be called from scripts. Use aug_register/aug_unregister to manage extensions
@@ -325,15 +668,139 @@ aug_script* aug_load(aug_vm* vm, const char* filename);
 // Unload the script globals from the VM and memory
 void aug_unload(aug_vm* vm, aug_script* script);
 
+// Compiles the script from file without executing. Script must be deleted with aug_unload
+aug_script* aug_compile(aug_vm* vm, const char* filename);
+
+// Releases the compiled scripts kept by the vm. The next compile of each file reads the source. See AUG_SCRIPT_CACHE
+void aug_clear_cache(aug_vm* vm);
+
+// Writes the script's bytecode, globals and debug markers to a precompiled file. Returns false on failure
+bool aug_save_compiled(aug_vm* vm, const aug_script* script, const char* filename);
+
+// Loads a precompiled file, then executes and loads script globals into memory. Skips compiling the script source
+// Compiled files are trusted input, only the file layout is validated. The bytecode is not verified
+aug_script* aug_load_compiled(aug_vm* vm, const char* filename);
+
 // Used to call global functions within the script
 aug_value aug_call(aug_vm* vm, aug_script* script, const char* func_name);
 aug_value aug_call_args(aug_vm* vm, aug_script* script, const char* func_name, int argc, aug_value* args);
 
+// Resolves the script function for repeated calls. The handle is valid until the script is unloaded, check addr >= 0 for success
+aug_function aug_get_function(aug_vm* vm, aug_script* script, const char* func_name);
+aug_value aug_call_handle(aug_vm* vm, aug_function function, int argc, aug_value* args);
+
+// Calls the function count times, reading argc arguments per call in order from args, count * argc values in total.
+// The VM is setup once for all of the calls. Return values are written to results, or released if results is NULL.
+// Failed calls write none. Returns the number of calls that returned
+int aug_call_batch(aug_vm* vm, aug_function function, int count, int argc, aug_value* args, aug_value* results);
+
+// Starts the function as a coroutine, with the budget set in the coroutine. Returns the function's return value, none if suspended
+// A suspended coroutine must be either resumed until it returns, or released. Release before the script is unloaded
+aug_value aug_coroutine_start(aug_vm* vm, aug_coroutine* coroutine, aug_function function, int argc, aug_value* args);
+// Continues the suspended coroutine. Returns the function's return value, none if suspended again
+aug_value aug_resume(aug_vm* vm, aug_coroutine* coroutine);
+void aug_coroutine_release(aug_coroutine* coroutine);
+
 void aug_save_state(aug_vm* vm, aug_vm_exec_state* exec_state);
 void aug_load_state(aug_vm* vm, aug_vm_exec_state* exec_state);
 
-#if AUG_DEBUG
+// Snapshots capture a script's globals. Strings, arrays, maps and typed arrays are copied on their first change since 
+// saved, through the API functions, and shared by the snapshots saved before that change. Other values are captured by 
+// reference. Saving takes time in the number of globals, restoring in the containers changed since, which are rewritten 
+// in place before the globals are reset. Containers keep their identity, so host references remain valid. Writes through 
+// the element pointers returned by the API are not tracked. Snapshots reference the captured values, delete them before 
+// the script is unloaded
+aug_snapshot* aug_snapshot_save(aug_vm* vm, aug_script* script);
+bool aug_snapshot_restore(aug_vm* vm, aug_script* script, aug_snapshot* snapshot);
+void aug_snapshot_delete(aug_snapshot* snapshot);
+
+// Writes the snapshot to the buffer if it fits, and returns the size required. Returns 0 if a captured value can not be 
+// serialized, such as userdata. Values are stored in the host byte order. Deserialized snapshots own new containers, 
+// which restoring installs in the script. Returns NULL if the data is invalid
+size_t aug_snapshot_serialize(const aug_snapshot* snapshot, char* buffer, size_t size);
+aug_snapshot* aug_snapshot_deserialize(aug_vm* vm, const char* data, size_t size);
+
+// Contexts call a loaded script's functions using their own stack, globals, value pools and bytecode copy. The script is shared read-only.
+// Stack size is the number of stack values, AUG_STACK_SIZE if 0. Globals are copied from the script when the context is created.
+// Values returned by a context are allocated from its pools, and must be released before the context is deleted.
+// Contexts must be deleted before the script is unloaded and before the VM is shutdown
+aug_context* aug_context_new(aug_vm* vm, aug_script* script, int stack_size);
+void aug_context_delete(aug_context* context);
+aug_value aug_context_call(aug_context* context, const char* func_name);
+aug_value aug_context_call_args(aug_context* context, const char* func_name, int argc, aug_value* args);
+aug_value aug_context_call_handle(aug_context* context, aug_function function, int argc, aug_value* args);
+int aug_context_call_batch(aug_context* context, aug_function function, int count, int argc, aug_value* args, aug_value* results);
+
+// Thread safety
+// A VM and its scripts may only be used by a single thread at a time. This applies to all of the VM API functions.
+// Contexts of the same script may be called concurrently, each context by a single thread at a time.
+// While any context is in use, the VM must not register or unregister extensions, or call, load or unload scripts.
+// Extension functions, the error function and the allocator may be called from multiple threads, and must be thread safe.
+// Values must not be shared between contexts. Values created outside of a VM or context use the creating thread's pools, 
+// and must be released on that thread
+
+// Profiling
+// Counts the dispatches and clock ticks of each opcode, and the calls and ticks of each script function by call stack.
+// The source line being executed is sampled every AUG_PROFILE_SAMPLE_INTERVAL instructions. Lines are resolved from the 
+// script's source markers. Ticks are read from AUG_PROFILE_CLOCK, the CPU timestamp counter where available.
+// Attach a profiler to the VM or a context to start profiling, and NULL to stop. Attaching takes effect from the next call,
+// and is not checked while no profiler is attached. A profiler may only record a single thread at a time. 
+// Detach the profiler before deleting it. Suspended coroutines must be released or completed first
+typedef enum aug_profile_format
+{
+    AUG_PROFILE_COLLAPSED = 0, // folded call stacks and self ticks, one per line. Input format of flamegraph tools
+    AUG_PROFILE_JSON,          // opcodes, functions, lines and call stacks
+} aug_profile_format;
+
+aug_profiler* aug_profiler_new();
+void aug_profiler_delete(aug_profiler* profiler);
+void aug_profiler_reset(aug_profiler* profiler);
+void aug_profile(aug_vm* vm, aug_profiler* profiler);
+void aug_context_profile(aug_context* context, aug_profiler* profiler);
+bool aug_profiler_save(const aug_profiler* profiler, const char* filename, aug_profile_format format);
+
+// Memory statistics
+// Each VM and context allocates its values from a separate heap. The statistics of a heap count the bytes requested from 
+// its allocator, including the value pools, and the values currently alive. Compiled scripts and compiler data are 
+// allocated with AUG_ALLOC, and are not included. The reference counts are the increments and decrements of the heap's
+// values, by aug_incref/aug_decref or the incref/decref function of the value type. When AUG_LEAK_CHECK is enabled, the 
+// values still alive when the heap is released are reported to the error function, by aug_shutdown for the VM and by 
+// aug_context_delete for a context
+typedef struct aug_vm_stats
+{
+    size_t live_bytes;     // bytes currently allocated
+    size_t peak_bytes;     // highest live bytes since startup
+    size_t alloc_count;    // allocator calls, excluding reallocations
+    size_t free_count;     // free calls
+    size_t live_strings;
+    size_t live_arrays;
+    size_t live_maps;
+    size_t live_iterators;
+    size_t live_ranges;
+    size_t live_typed_arrays;
+    size_t live_buffer_views;
+    size_t incref_count;
+    size_t decref_count;
+    size_t collected_count; // arrays and maps released by the cycle collector
+} aug_vm_stats;
+
+aug_vm_stats aug_get_stats(aug_vm* vm);
+aug_vm_stats aug_context_get_stats(aug_context* context);
+
+// Cycle collection
+// Arrays and maps referencing each other in a cycle keep their reference counts above zero once unreferenced. When 
+// AUG_CYCLE_COLLECT is enabled, containers decremented to a non zero count are buffered as possible cycle roots, and 
+// the collector releases the containers only referenced by the cycles of the roots. Arrays and maps larger than 
+// AUG_DEFER_RELEASE_SIZE release their elements incrementally. After each call, load and evaluation, the VM API runs 
+// a collection step of AUG_COLLECT_BUDGET when releases are deferred or AUG_CYCLE_COLLECT_THRESHOLD roots are buffered.
+// aug_collect runs a step of the budget, visiting about budget containers and releasing budget deferred elements. 
+// A budget of 0 completes all deferred releases and collects all buffered roots. Returns the number of containers 
+// collected. Values created outside of a VM or context are released immediately, and are not buffered as roots
+size_t aug_collect(aug_vm* vm, size_t budget);
+size_t aug_context_collect(aug_context* context, size_t budget);
+
 const char* aug_opcode_label(uint8_t opcode);
+#if AUG_DEBUG
 const char* aug_ast_label(uint8_t ast_type);
 #endif 
 
@@ -354,11 +821,15 @@ aug_value aug_create_float(float data);
 aug_value aug_create_string(const char* data);
 aug_value aug_create_array();
 aug_value aug_create_map();
+aug_value aug_create_typed_array(aug_type element_type, size_t length);
+aug_value aug_create_buffer_view(void* data, aug_view_type element_type, size_t length, size_t stride, 
+    aug_view_release_func* release, void* user);
 aug_value aug_create_user_data(void* data);
 
 // String API------------------------------------ String API ----------------------------------------------- String API//
 aug_string* aug_string_new(size_t size);
 aug_string* aug_string_create(const char* bytes);
+aug_string* aug_string_share(aug_string* constant); // shares the buffer until the first modification
 void aug_string_incref(aug_string* string);
 aug_string* aug_string_decref(aug_string* string);
 void aug_string_resize(aug_string* string, size_t size);
@@ -367,10 +838,11 @@ char aug_string_pop(aug_string* string);
 void aug_string_append(aug_string* a, const aug_string* b);
 void aug_string_append_bytes(aug_string* string, const char* bytes, int len);
 char aug_string_at(const aug_string* string, size_t index);
-bool aug_string_set(const aug_string* string, size_t index, char c);
+bool aug_string_set(aug_string* string, size_t index, char c);
 char aug_string_back(const aug_string* string);
 bool aug_string_compare(const aug_string* a, const aug_string* b);
 bool aug_string_compare_bytes(const aug_string* a, const char* bytes);
+size_t aug_string_hash(aug_string* string);
 
 // Array API --------------------------------------- Array API --------------------------------------------- Array API//
 aug_array* aug_array_new(size_t size);
@@ -381,17 +853,19 @@ void aug_array_resize(aug_array* array, size_t size);
 aug_value* aug_array_push(aug_array* array);
 aug_value* aug_array_pop(aug_array* array);
 aug_value* aug_array_at(const aug_array* array, size_t index);
-bool aug_array_set(const aug_array* array, size_t index, aug_value* value);
+bool aug_array_set(aug_array* array, size_t index, aug_value* value);
 aug_value* aug_array_back(const aug_array* array);
 bool aug_array_compare(const aug_array* a, const aug_array* b);
 void aug_array_append(aug_array* array, aug_value* value);
 void aug_array_remove(aug_array* array, int index);
 aug_array* aug_array_copy(aug_array* array);
+void aug_array_concat(aug_array* array, const aug_array* other);
 
 // Map API ------------------------------------------ Map API ------------------------------------------------- Map API//
 aug_map* aug_map_new(size_t size);
 void aug_map_incref(aug_map* map);
 aug_map* aug_map_decref(aug_map* map);
+void aug_map_reserve(aug_map* map, size_t size);
 bool aug_map_insert(aug_map* map, aug_value* key, aug_value* value);
 bool aug_map_insert_or_update(aug_map* map, aug_value* key, aug_value* value);
 bool aug_map_remove(aug_map* map, aug_value* key);
@@ -400,6 +874,40 @@ aug_value* aug_map_get(aug_map* map, aug_value* key);
 typedef void(aug_map_iterator)(const aug_value* /*key*/, aug_value* /*value*/, void* /*user_data*/);
 void aug_map_foreach(aug_map* /*map*/, aug_map_iterator* /*iterator*/, void* /*user_data*/);
 
+// Typed Array API ---------------------------------- Typed Array API -------------------------------------- Typed Array API//
+// Element type is AUG_INT or AUG_FLOAT. Elements are zero initialized. Values set are converted to the element type 
+aug_typed_array* aug_typed_array_new(aug_type element_type, size_t length);
+void aug_typed_array_incref(aug_typed_array* array);
+aug_typed_array* aug_typed_array_decref(aug_typed_array* array);
+void aug_typed_array_resize(aug_typed_array* array, size_t length);
+bool aug_typed_array_push(aug_typed_array* array, const aug_value* value);
+bool aug_typed_array_get(const aug_typed_array* array, size_t index, aug_value* out_element);
+bool aug_typed_array_set(aug_typed_array* array, size_t index, const aug_value* value);
+bool aug_typed_array_compare(const aug_typed_array* a, const aug_typed_array* b);
+aug_typed_array* aug_typed_array_copy(const aug_typed_array* array);
+
+// Bulk operations, vectorized when AUG_SIMD is enabled. Elementwise operations modify the first array in place, 
+// and fail unless both arrays have the same element type and length. Reductions return none for empty arrays
+bool aug_typed_array_add(aug_typed_array* array, const aug_typed_array* other);
+bool aug_typed_array_mul(aug_typed_array* array, const aug_typed_array* other);
+bool aug_typed_array_scale(aug_typed_array* array, const aug_value* factor);
+aug_value aug_typed_array_sum(const aug_typed_array* array);
+aug_value aug_typed_array_min(const aug_typed_array* array);
+aug_value aug_typed_array_max(const aug_typed_array* array);
+aug_value aug_typed_array_dot(const aug_typed_array* a, const aug_typed_array* b);
+
+// Buffer View API ---------------------------------- Buffer View API -------------------------------------- Buffer View API//
+// Views length elements of the host memory at data. A stride of 0 packs the elements by the element type's size.
+// Values set are converted to the element type, narrowing integers wrap. The release function may be NULL
+aug_buffer_view* aug_buffer_view_new(void* data, aug_view_type element_type, size_t length, size_t stride, 
+    aug_view_release_func* release, void* user);
+void aug_buffer_view_incref(aug_buffer_view* view);
+aug_buffer_view* aug_buffer_view_decref(aug_buffer_view* view);
+size_t aug_view_type_size(aug_view_type element_type);
+bool aug_buffer_view_get(const aug_buffer_view* view, size_t index, aug_value* out_element);
+bool aug_buffer_view_set(aug_buffer_view* view, size_t index, const aug_value* value);
+bool aug_buffer_view_compare(const aug_buffer_view* a, const aug_buffer_view* b);
+
 // Iterator API ------------------------------------- Iterator API ----------------------------------------- Iterator API//
 aug_iterator* aug_iterator_new(aug_value* iterable);
 aug_iterator* aug_iterator_decref(aug_iterator* iterator);
@@ -431,6 +939,28 @@ extern "C" {
 #include <math.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <time.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if AUG_SIMD && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define AUG_SIMD_SSE 1
+#elif AUG_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define AUG_SIMD_NEON 1
+#endif
+
+#if __linux
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #if defined(_WIN32) && defined(__STDC_WANT_SECURE_LIB__)
 #define AUG_SECURE
@@ -448,6 +978,369 @@ extern "C" {
 #define AUG_REALLOC(ptr, size) realloc(ptr, size)
 #endif//AUG_REALLOC
 
+// HEAP ==========================================   HEAP   ====================================================== HEAP // 
+
+// Script values are allocated from the heap of the VM they were created in. Each value header retains its heap, 
+// so it is freed by the same allocator regardless of which VM releases the last reference.
+// Small value headers are served from fixed size slab pools owned by the heap, 
+// released when the VM shuts down. Value buffers use the heap's allocator directly.
+// Callers pass the size of the released allocation, so that the heap can count its live bytes without a size header.
+
+#ifndef AUG_POOL_SLAB_COUNT
+#define AUG_POOL_SLAB_COUNT 64 // elements per slab
+#endif//AUG_POOL_SLAB_COUNT
+
+#ifndef AUG_THREAD_LOCAL
+#if defined(_MSC_VER)
+#define AUG_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define AUG_THREAD_LOCAL __thread
+#else 
+#define AUG_THREAD_LOCAL
+#endif
+#endif//AUG_THREAD_LOCAL
+
+#define AUG_ALIGN(size) (((size) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+typedef enum aug_pool_type
+{
+    AUG_POOL_STRING,
+    AUG_POOL_ARRAY,
+    AUG_POOL_MAP,
+    AUG_POOL_ITERATOR,
+    AUG_POOL_RANGE,
+    AUG_POOL_TYPED_ARRAY,
+    AUG_POOL_BUFFER_VIEW,
+    AUG_POOL_VALUE,
+    AUG_POOL_COUNT
+} aug_pool_type;
+
+typedef struct aug_pool
+{
+    size_t element_size;
+    void* free_list; // singly linked through the first word of each free element
+    void* slabs;     // singly linked through the first word of each slab
+} aug_pool;
+
+// Containers buffered by the heap for the cycle collector
+typedef struct aug_heap_values
+{
+    aug_value* values;
+    size_t count;
+    size_t capacity;
+} aug_heap_values;
+
+// Array or map releasing its elements incrementally, see AUG_DEFER_RELEASE_SIZE
+typedef struct aug_heap_deferred
+{
+    aug_value value;
+    size_t cursor; // elements remaining in arrays, next slot in maps
+} aug_heap_deferred;
+
+typedef struct aug_heap
+{
+    aug_allocator allocator;
+    aug_pool pools[AUG_POOL_COUNT];
+
+    // Cycle collection and deferred releases, see aug_collect. Disabled for the default heap, which is never collected
+    bool collect;
+    aug_heap_values roots;      // possible cycle roots
+    aug_heap_values gc_stack;   // containers to visit
+    aug_heap_values gc_marked;  // roots marked by the collection step
+    aug_heap_values gc_garbage; // containers released by the collection step
+    aug_heap_deferred* deferred;
+    size_t deferred_count;
+    size_t deferred_capacity;
+
+    // Open snapshots in the order saved, see aug_heap_track. Each save begins a new epoch
+    aug_snapshot** snapshots;
+    size_t snapshot_count;
+    size_t snapshot_capacity;
+    size_t epoch;
+
+    // Statistics, see aug_vm_stats
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t alloc_count;
+    size_t free_count;
+    size_t live_elements[AUG_POOL_COUNT];
+    size_t incref_count;
+    size_t decref_count;
+    size_t collected_count;
+} aug_heap;
+
+static void* aug_heap_default_alloc(void* user, size_t size)
+{
+    (void)user;
+    return AUG_ALLOC(size);
+}
+
+static void* aug_heap_default_realloc(void* user, void* ptr, size_t size)
+{
+    (void)user;
+    return AUG_REALLOC(ptr, size);
+}
+
+static void aug_heap_default_free(void* user, void* ptr)
+{
+    (void)user;
+    AUG_FREE(ptr);
+}
+
+#define AUG_POOL_INIT(type) { AUG_ALIGN(sizeof(type)), NULL, NULL }
+
+// Used for values created outside of a VM. Each thread has separate pools
+static AUG_THREAD_LOCAL aug_heap aug_heap_default = 
+{
+    { aug_heap_default_alloc, aug_heap_default_realloc, aug_heap_default_free, NULL },
+    {
+        AUG_POOL_INIT(aug_string),
+        AUG_POOL_INIT(aug_array),
+        AUG_POOL_INIT(aug_map),
+        AUG_POOL_INIT(aug_iterator),
+        AUG_POOL_INIT(aug_range),
+        AUG_POOL_INIT(aug_typed_array),
+        AUG_POOL_INIT(aug_buffer_view),
+        AUG_POOL_INIT(aug_value),
+    }
+};
+
+static AUG_THREAD_LOCAL aug_heap* aug_heap_active = NULL;
+
+static inline aug_heap* aug_heap_current()
+{
+    return aug_heap_active != NULL ? aug_heap_active : &aug_heap_default;
+}
+
+// Sets the heap new values are allocated from. Returns the previously active heap to restore
+static inline aug_heap* aug_heap_enter(aug_heap* heap)
+{
+    aug_heap* prev = aug_heap_active;
+    aug_heap_active = heap;
+    return prev;
+}
+
+static inline void aug_heap_leave(aug_heap* prev)
+{
+    aug_heap_active = prev;
+}
+
+static inline void aug_heap_grow(aug_heap* heap, size_t size)
+{
+    heap->live_bytes += size;
+    if(heap->live_bytes > heap->peak_bytes)
+        heap->peak_bytes = heap->live_bytes;
+}
+
+static inline void* aug_heap_alloc(aug_heap* heap, size_t size)
+{
+    ++heap->alloc_count;
+    aug_heap_grow(heap, size);
+    return heap->allocator.alloc(heap->allocator.user, size);
+}
+
+static inline void* aug_heap_realloc(aug_heap* heap, void* ptr, size_t old_size, size_t size)
+{
+    if(ptr == NULL)
+        ++heap->alloc_count;
+    heap->live_bytes -= old_size;
+    aug_heap_grow(heap, size);
+    return heap->allocator.realloc(heap->allocator.user, ptr, size);
+}
+
+// The release functions are not marked inline. Inlining them into every decref grows aug_decref past the point the 
+// compiler inlines it into the VM's dispatch loop
+static void aug_heap_free(aug_heap* heap, void* ptr, size_t size)
+{
+    ++heap->free_count;
+    heap->live_bytes -= size;
+    heap->allocator.free(heap->allocator.user, ptr);
+}
+
+aug_heap* aug_heap_new(const aug_allocator* allocator)
+{
+    if(allocator == NULL)
+        allocator = &aug_heap_default.allocator;
+
+    aug_heap* heap = (aug_heap*)allocator->alloc(allocator->user, sizeof(aug_heap));
+    heap->allocator = *allocator;
+    for(int i = 0; i < AUG_POOL_COUNT; ++i)
+    {
+        heap->pools[i].element_size = aug_heap_default.pools[i].element_size;
+        heap->pools[i].free_list = NULL;
+        heap->pools[i].slabs = NULL;
+        heap->live_elements[i] = 0;
+    }
+    heap->live_bytes = 0;
+    heap->peak_bytes = 0;
+    heap->alloc_count = 0;
+    heap->free_count = 0;
+    heap->incref_count = 0;
+    heap->decref_count = 0;
+    heap->collected_count = 0;
+
+    heap->collect = true;
+    memset(&heap->roots, 0, sizeof(aug_heap_values));
+    memset(&heap->gc_stack, 0, sizeof(aug_heap_values));
+    memset(&heap->gc_marked, 0, sizeof(aug_heap_values));
+    memset(&heap->gc_garbage, 0, sizeof(aug_heap_values));
+    heap->deferred = NULL;
+    heap->deferred_count = 0;
+    heap->deferred_capacity = 0;
+    heap->snapshots = NULL;
+    heap->snapshot_count = 0;
+    heap->snapshot_capacity = 0;
+    heap->epoch = 0;
+    return heap;
+}
+
+static void aug_heap_values_free(aug_heap* heap, aug_heap_values* list)
+{
+    if(list->values != NULL)
+        aug_heap_free(heap, list->values, sizeof(aug_value) * list->capacity);
+}
+
+void aug_heap_delete(aug_heap* heap)
+{
+    if(heap == NULL)
+        return;
+
+    aug_heap_values_free(heap, &heap->roots);
+    aug_heap_values_free(heap, &heap->gc_stack);
+    aug_heap_values_free(heap, &heap->gc_marked);
+    aug_heap_values_free(heap, &heap->gc_garbage);
+    if(heap->deferred != NULL)
+        aug_heap_free(heap, heap->deferred, sizeof(aug_heap_deferred) * heap->deferred_capacity);
+    if(heap->snapshots != NULL)
+        aug_heap_free(heap, heap->snapshots, sizeof(aug_snapshot*) * heap->snapshot_capacity);
+
+    for(int i = 0; i < AUG_POOL_COUNT; ++i)
+    {
+        const size_t slab_size = sizeof(void*) + heap->pools[i].element_size * AUG_POOL_SLAB_COUNT;
+        void* slab = heap->pools[i].slabs;
+        while(slab != NULL)
+        {
+            void* next = *(void**)slab;
+            aug_heap_free(heap, slab, slab_size);
+            slab = next;
+        }
+    }
+
+    const aug_allocator allocator = heap->allocator;
+    allocator.free(allocator.user, heap);
+}
+
+static inline void* aug_heap_pool_alloc(aug_heap* heap, aug_pool_type type)
+{
+    aug_pool* pool = &heap->pools[type];
+    if(pool->free_list == NULL)
+    {
+        // Carve a new slab into free elements. The first word links the slab list
+        char* slab = (char*)aug_heap_alloc(heap, sizeof(void*) + pool->element_size * AUG_POOL_SLAB_COUNT);
+        *(void**)slab = pool->slabs;
+        pool->slabs = slab;
+
+        char* element = slab + sizeof(void*);
+        for(int i = 0; i < AUG_POOL_SLAB_COUNT; ++i, element += pool->element_size)
+        {
+            *(void**)element = pool->free_list;
+            pool->free_list = element;
+        }
+    }
+
+    void* element = pool->free_list;
+    pool->free_list = *(void**)element;
+    ++heap->live_elements[type];
+    return element;
+}
+
+static void aug_heap_pool_free(aug_heap* heap, aug_pool_type type, void* ptr)
+{
+    aug_pool* pool = &heap->pools[type];
+    *(void**)ptr = pool->free_list;
+    pool->free_list = ptr;
+    --heap->live_elements[type];
+}
+
+static void aug_snapshot_track(aug_heap* heap, aug_type type, void* container, size_t* epoch);
+
+// Called before a string, array, map or typed array is changed. The first change since a snapshot was saved copies the 
+// contents to the open snapshots, so that restoring only rewrites the changed containers
+static inline void aug_heap_track(aug_heap* heap, aug_type type, void* container, size_t* epoch)
+{
+    if(heap->snapshot_count > 0 && *epoch != heap->epoch)
+        aug_snapshot_track(heap, type, container, epoch);
+}
+
+// Returns the cycle collector state of containers, NULL for the value types that do not reference other values.
+// Container types that can reference themselves are added here, and to aug_gc_child and aug_gc_count
+static inline aug_gc_node* aug_gc_node_of(const aug_value* value)
+{
+    switch(aug_value_type(value))
+    {
+    case AUG_ARRAY:
+        return &aug_value_array(value)->gc;
+    case AUG_MAP:
+        return &aug_value_map(value)->gc;
+    default:
+        return NULL;
+    }
+}
+
+#if AUG_CYCLE_COLLECT
+static void aug_heap_values_push(aug_heap* heap, aug_heap_values* list, aug_value value)
+{
+    if(list->count == list->capacity)
+    {
+        const size_t capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+        list->values = (aug_value*)aug_heap_realloc(heap, list->values, sizeof(aug_value) * list->capacity, sizeof(aug_value) * capacity);
+        list->capacity = capacity;
+    }
+    list->values[list->count++] = value;
+}
+
+static inline aug_value aug_heap_values_pop(aug_heap_values* list)
+{
+    return list->values[--list->count];
+}
+
+// Buffers the container as a possible root of a cycle. Decrementing to a non zero count can leave a cycle unreferenced
+static void aug_heap_buffer_root(aug_heap* heap, aug_value value, aug_gc_node* gc)
+{
+    gc->root = (int)heap->roots.count;
+    aug_heap_values_push(heap, &heap->roots, value);
+}
+
+static void aug_heap_remove_root(aug_heap* heap, aug_gc_node* gc)
+{
+    aug_value last = heap->roots.values[--heap->roots.count];
+    if(gc->root < (int)heap->roots.count)
+    {
+        heap->roots.values[gc->root] = last;
+        aug_gc_node_of(&last)->root = gc->root;
+    }
+    gc->root = -1;
+}
+#endif//AUG_CYCLE_COLLECT
+
+#if AUG_DEFER_RELEASE_SIZE > 0
+static void aug_heap_defer(aug_heap* heap, aug_value value, size_t cursor)
+{
+    if(heap->deferred_count == heap->deferred_capacity)
+    {
+        const size_t capacity = heap->deferred_capacity == 0 ? 16 : heap->deferred_capacity * 2;
+        heap->deferred = (aug_heap_deferred*)aug_heap_realloc(heap, heap->deferred, 
+            sizeof(aug_heap_deferred) * heap->deferred_capacity, sizeof(aug_heap_deferred) * capacity);
+        heap->deferred_capacity = capacity;
+    }
+    aug_heap_deferred* deferred = &heap->deferred[heap->deferred_count++];
+    deferred->value = value;
+    deferred->cursor = cursor;
+}
+#endif//AUG_DEFER_RELEASE_SIZE
+
+static void aug_heap_release_deferred(aug_heap* heap, size_t count);
+
 // CONTAINER ====================================   CONTAINER   ============================================ CONTAINER // 
 
 // Generic resizeable array data structure that allocates bytes. 
@@ -510,7 +1403,7 @@ char* aug_container_pop(aug_container* container)
 
 char* aug_container_at(const aug_container* container, size_t index)   
 {        
-    return index >= 0 && index < container->length ? &container->buffer[index * container->element_size] : NULL;    
+    return index < container->length ? &container->buffer[index * container->element_size] : NULL;    
 }        
 
 char* aug_container_back(const aug_container* container)   
@@ -536,30 +1429,136 @@ char* aug_container_back(const aug_container* container)
 #define aug_container_back_type(type, container) \
 	*((type*)aug_container_back(container))
 
+// ARENA ========================================   ARENA   ===================================================== ARENA // 
+
+// Bump allocator used by the compile pipeline. Allocations are never freed individually, 
+// the tokens, ast and temporaries of a compilation unit are released at once with the arena.
+
+#ifndef AUG_ARENA_BLOCK_SIZE
+#define AUG_ARENA_BLOCK_SIZE (1024 * 16)
+#endif//AUG_ARENA_BLOCK_SIZE
+
+typedef struct aug_arena_block
+{
+    struct aug_arena_block* next;
+    size_t capacity;
+    size_t length;
+} aug_arena_block;
+
+typedef struct aug_arena
+{
+    aug_arena_block* head;
+    size_t block_size;
+} aug_arena;
+
+aug_arena* aug_arena_new(size_t block_size)
+{
+    aug_arena* arena = (aug_arena*)AUG_ALLOC(sizeof(aug_arena));
+    arena->head = NULL;
+    arena->block_size = block_size;
+    return arena;
+}
+
+void aug_arena_delete(aug_arena* arena)
+{
+    if(arena == NULL)
+        return;
+
+    aug_arena_block* block = arena->head;
+    while(block != NULL)
+    {
+        aug_arena_block* next = block->next;
+        AUG_FREE(block);
+        block = next;
+    }
+    AUG_FREE(arena);
+}
+
+void* aug_arena_alloc(aug_arena* arena, size_t size)
+{
+    size = AUG_ALIGN(size);
+
+    aug_arena_block* block = arena->head;
+    if(block == NULL || block->length + size > block->capacity)
+    {
+        // Oversized allocations get a dedicated block, placed behind the head to keep the current block in use
+        const size_t capacity = size > arena->block_size ? size : arena->block_size;
+        aug_arena_block* new_block = (aug_arena_block*)AUG_ALLOC(AUG_ALIGN(sizeof(aug_arena_block)) + capacity);
+        new_block->capacity = capacity;
+        new_block->length = 0;
+
+        if(block != NULL && size > arena->block_size)
+        {
+            new_block->next = block->next;
+            block->next = new_block;
+        }
+        else
+        {
+            new_block->next = block;
+            arena->head = new_block;
+        }
+        block = new_block;
+    }
+
+    char* data = (char*)block + AUG_ALIGN(sizeof(aug_arena_block)) + block->length;
+    block->length += size;
+    return data;
+}
+
+// Allocates a string of length bytes that lives in the arena. The arena retains a reference so the string is never freed by decref.
+// Marked constant so that modifying functions can not reallocate the arena owned buffer
+aug_string* aug_arena_string_new(aug_arena* arena, size_t length)
+{
+    aug_string* string = (aug_string*)aug_arena_alloc(arena, sizeof(aug_string) + length + 1);
+    string->buffer = (char*)(string + 1);
+    string->ref_count = 2;
+    string->capacity = length + 1;
+    string->length = length;
+    string->hash = 0;
+    string->heap = NULL;
+    string->constant = true;
+    string->source = NULL;
+    string->epoch = 0;
+    string->buffer[length] = '\0';
+    return string;
+}
+
+aug_string* aug_arena_string_create(aug_arena* arena, const char* bytes, size_t length)
+{
+    aug_string* string = aug_arena_string_new(arena, length);
+    if(length > 0)
+        memcpy(string->buffer, bytes, length);
+    return string;
+}
+
 // HASHTABLE ====================================== HASHTABLE =============================================== HASHTABLE//
 
+// String keyed table with linear probing. Slots store the key hash and length, so probes only compare keys on a hash match.
+// Data is stored in a flat buffer parallel to the slots. Pointers to data are invalidated by insert and remove
+
 #ifndef AUG_HASHTABLE_SIZE_DEFAULT
-#define AUG_HASHTABLE_SIZE_DEFAULT 1
+#define AUG_HASHTABLE_SIZE_DEFAULT 8 // must be a power of two
 #endif//AUG_HASHTABLE_SIZE_DEFAULT
 
-#ifndef AUG_HASHTABLE_BUCKET_SIZE_DEFAULT
-#define AUG_HASHTABLE_BUCKET_SIZE_DEFAULT 1
-#endif//AUG_HASHTABLE_BUCKET_SIZE_DEFAULT
+#ifndef AUG_HASHTABLE_LOAD_FACTOR
+#define AUG_HASHTABLE_LOAD_FACTOR 70 // percent of capacity
+#endif//AUG_HASHTABLE_LOAD_FACTOR
 
 typedef size_t(aug_hashtable_hash)(const char* /*str*/);
 typedef void(aug_hashtable_free)(uint8_t* /*data*/);
 typedef void(aug_hashtable_iterator)(uint8_t* /*data*/, void* /*user_data*/);
 
-typedef struct aug_hashtable_bucket
+typedef struct aug_hashtable_slot
 {
-    char** key_buffer;
-    uint8_t* data_buffer;
-    size_t capacity;
-} aug_hashtable_bucket;
+    char* key; // NULL if empty
+    size_t length;
+    size_t hash;
+} aug_hashtable_slot;
 
 typedef struct aug_hashtable
 {
-	aug_hashtable_bucket* buckets;
+	aug_hashtable_slot* slots;
+	uint8_t* data_buffer;
 	size_t capacity;
 	size_t count;
     size_t ref_count;
@@ -569,56 +1568,72 @@ typedef struct aug_hashtable
     aug_hashtable_free * free_func;
 } aug_hashtable;
 
-void aug_hashtable_bucket_init(aug_hashtable* map, int size)
+// Spreads the hash bits so that similar keys do not cluster when masked by capacity
+static inline size_t aug_hash_mix(uint64_t hash)
 {
-    size_t i;
-    for (i = 0; i < map->capacity; ++i)
-    {
-        aug_hashtable_bucket* bucket = &map->buckets[i];
-        bucket->capacity = size;
-        bucket->key_buffer = (char**)AUG_ALLOC(sizeof(char*) * size);
-        bucket->data_buffer = (uint8_t*)AUG_ALLOC(sizeof(uint8_t) * map->element_size * size);
-        memset(bucket->key_buffer, 0, sizeof(char*) * size);
-    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return (size_t)hash;
 }
 
-uint8_t* aug_hashtable_bucket_insert(aug_hashtable* map, aug_hashtable_bucket* bucket, const char* key)
+size_t aug_hashtable_hash_default(const char* str)
 {
-    size_t i;
-    for (i = 0; i < bucket->capacity; ++i)
-    {
-        if (bucket->key_buffer[i] == NULL)
-            break;
-
-        if (strcmp(bucket->key_buffer[i], key) == 0)
-            return NULL;
-    }
+    size_t hash = 5381; // DJB2 hash
+    while(*str)
+        hash = ((hash << 5) + hash) + *str++;
+    return aug_hash_mix(hash);
+}
 
-    if (i >= bucket->capacity)
+static inline size_t aug_hashtable_find(const aug_hashtable* map, const char* key, size_t length, size_t hash)
+{
+    const size_t mask = map->capacity - 1;
+    size_t i = hash & mask;
+    while(map->slots[i].key != NULL)
     {
-        size_t new_size = 2 * bucket->capacity;
-        bucket->key_buffer = (char**)AUG_REALLOC(bucket->key_buffer, sizeof(char*) * new_size);
-        bucket->data_buffer = (uint8_t*)AUG_REALLOC(bucket->data_buffer, map->element_size * new_size);
-
-        size_t j; // init new entries to null 
-        for (j = bucket->capacity; j < new_size; ++j)
-            bucket->key_buffer[j] = NULL;
-        bucket->capacity = new_size;
+        const aug_hashtable_slot* slot = &map->slots[i];
+        if(slot->hash == hash && slot->length == length && memcmp(slot->key, key, length) == 0)
+            return i;
+        i = (i + 1) & mask;
     }
+    return i; // empty slot where the key would be inserted
+}
 
-    if (bucket->key_buffer[i] != NULL)
-        AUG_FREE(bucket->key_buffer[i]);
+void aug_hashtable_reserve(aug_hashtable* map, size_t count)
+{
+    size_t capacity = map->capacity > 0 ? map->capacity : AUG_HASHTABLE_SIZE_DEFAULT;
+    while(count * 100 > capacity * AUG_HASHTABLE_LOAD_FACTOR)
+        capacity *= 2;
+    if(capacity == map->capacity)
+        return;
 
-    ++map->count;
+    aug_hashtable_slot* old_slots = map->slots;
+    uint8_t* old_data = map->data_buffer;
+    const size_t old_capacity = map->capacity;
 
-    const int buff_size = strlen(key) + 1;
-    bucket->key_buffer[i] = (char*)AUG_ALLOC(buff_size);
-#ifdef AUG_SECURE
-    strcpy_s(bucket->key_buffer[i], buff_size, key);
-#else
-    strcpy(bucket->key_buffer[i], key);
-#endif
-    return &bucket->data_buffer[i * map->element_size];
+    map->capacity = capacity;
+    map->slots = (aug_hashtable_slot*)AUG_ALLOC(sizeof(aug_hashtable_slot) * capacity);
+    map->data_buffer = (uint8_t*)AUG_ALLOC(map->element_size * capacity);
+    memset(map->slots, 0, sizeof(aug_hashtable_slot) * capacity);
+
+    // reindex all entries from the cached hashes, keys are moved
+    size_t i;
+    for(i = 0; i < old_capacity; ++i)
+    {
+        const aug_hashtable_slot* slot = &old_slots[i];
+        if(slot->key == NULL)
+            continue;
+
+        size_t j = slot->hash & (capacity - 1);
+        while(map->slots[j].key != NULL)
+            j = (j + 1) & (capacity - 1);
+
+        map->slots[j] = *slot;
+        memcpy(&map->data_buffer[j * map->element_size], &old_data[i * map->element_size], map->element_size);
+    }
+
+    AUG_FREE(old_slots);
+    AUG_FREE(old_data);
 }
 
 aug_hashtable* aug_hashtable_new(size_t size, size_t element_size, aug_hashtable_hash* hash, aug_hashtable_free* free)
@@ -626,59 +1641,19 @@ aug_hashtable* aug_hashtable_new(size_t size, size_t element_size, aug_hashtable
     assert(hash != NULL);
 
     aug_hashtable* map = (aug_hashtable*)AUG_ALLOC(sizeof(aug_hashtable)); 
-    map->capacity = size;
+    map->slots = NULL;
+    map->data_buffer = NULL;
+    map->capacity = 0;
     map->element_size = element_size;
     map->hash_func = hash;
     map->free_func = free;
     map->ref_count = 1;
     map->count = 0;
-    map->buckets = (aug_hashtable_bucket*)AUG_ALLOC(sizeof(aug_hashtable_bucket) * size);
-    aug_hashtable_bucket_init(map, AUG_HASHTABLE_BUCKET_SIZE_DEFAULT);
+    if(size > 0)
+        aug_hashtable_reserve(map, size);
     return map;
 }
 
-void aug_hashtable_resize(aug_hashtable* map, size_t size)
-{
-    size_t old_size = map->capacity;
-    aug_hashtable_bucket* old_buckets = map->buckets;
-
-    map->capacity = size;
-    map->buckets = (aug_hashtable_bucket*)AUG_ALLOC(sizeof(aug_hashtable_bucket) * map->capacity);
-    aug_hashtable_bucket_init(map, AUG_HASHTABLE_BUCKET_SIZE_DEFAULT);
-
-    // reindex all values, copy over raw data 
-    size_t i, j;
-    for (i = 0; i < old_size; ++i)
-    {
-        aug_hashtable_bucket* old_bucket = &old_buckets[i];
-        for (j = 0; j < old_bucket->capacity; ++j)
-        {
-            if (old_bucket->key_buffer[j] != NULL)
-            {
-                char* key = old_bucket->key_buffer[j];
-                uint8_t* data = &old_bucket->data_buffer[j * map->element_size];
-                size_t hash = map->hash_func(key);
-
-                aug_hashtable_bucket* new_bucket = &map->buckets[hash % map->capacity];
-                uint8_t* new_data = aug_hashtable_bucket_insert(map, new_bucket, key);
-                assert(new_data != NULL);
-                size_t e;
-                for (e = 0; e < map->element_size; ++e)
-                    new_data[e] = data[e];
-
-                AUG_FREE(old_bucket->key_buffer[j]);
-            }
-        }
-
-        AUG_FREE(old_bucket->data_buffer);
-        old_bucket->data_buffer = NULL;
-        AUG_FREE(old_bucket->key_buffer);
-        old_bucket->key_buffer = NULL;
-    }
-
-    AUG_FREE(old_buckets);
-}
-
 void aug_hashtable_incref(aug_hashtable* map)
 {
     if(map)
@@ -692,102 +1667,109 @@ aug_hashtable* aug_hashtable_decref(aug_hashtable* map)
         size_t i;
         for(i = 0; i < map->capacity; ++i)
         {
-            aug_hashtable_bucket* bucket = &map->buckets[i];
-            size_t j;
-            for (j = 0; j < bucket->capacity; ++j)
+            aug_hashtable_slot* slot = &map->slots[i];
+            if(slot->key != NULL)
             {
-                if (bucket->key_buffer[j] != NULL)
-                {
-                    if (map->free_func != NULL)
-                        map->free_func(&bucket->data_buffer[j * map->element_size]);
-                    AUG_FREE(bucket->key_buffer[j]);
-                }
+                if(map->free_func != NULL)
+                    map->free_func(&map->data_buffer[i * map->element_size]);
+                AUG_FREE(slot->key);
             }
-            AUG_FREE(bucket->data_buffer);
-            AUG_FREE(bucket->key_buffer);
         }
-        AUG_FREE(map->buckets);
+        AUG_FREE(map->slots);
+        AUG_FREE(map->data_buffer);
         AUG_FREE(map);
         return NULL;
     }
     return map;
 }
 
+// Returns the data for the new key, or NULL if the key exists
 uint8_t* aug_hashtable_create(aug_hashtable* map, const char* key)
 {
-    size_t hash = map->hash_func(key);
-    aug_hashtable_bucket* bucket = &map->buckets[hash % map->capacity];
-    // If a bucket is larger than the map capacity, reindex all entries
-    if (bucket->capacity > map->capacity)
-    {
-        aug_hashtable_resize(map, map->capacity * 2);
-        bucket = &map->buckets[hash % map->capacity];
-    }
+    aug_hashtable_reserve(map, map->count + 1);
 
-    uint8_t* data = aug_hashtable_bucket_insert(map, bucket, key);
-    if(data != NULL)
-        ++map->count;
-    return data;
+    const size_t length = strlen(key);
+    const size_t hash = map->hash_func(key);
+    const size_t i = aug_hashtable_find(map, key, length, hash);
+    aug_hashtable_slot* slot = &map->slots[i];
+    if(slot->key != NULL)
+        return NULL;
+
+    slot->key = (char*)AUG_ALLOC(length + 1);
+    memcpy(slot->key, key, length + 1);
+    slot->length = length;
+    slot->hash = hash;
+    ++map->count;
+    return &map->data_buffer[i * map->element_size];
 }
 
 bool aug_hashtable_remove(aug_hashtable* map, const char* key)
 {
-    const size_t find_hash = map->hash_func(key);
-    aug_hashtable_bucket* bucket = &map->buckets[find_hash % map->capacity];
-    size_t i;
-    for(i = 0; i  < bucket->capacity; ++i)
+    if(map->count == 0)
+        return false;
+
+    size_t i = aug_hashtable_find(map, key, strlen(key), map->hash_func(key));
+    if(map->slots[i].key == NULL)
+        return false;
+
+    if(map->free_func)
+        map->free_func(&map->data_buffer[i * map->element_size]);
+    AUG_FREE(map->slots[i].key);
+    map->slots[i].key = NULL;
+    --map->count;
+
+    // Shift back following entries that can not be reached past the emptied slot
+    const size_t mask = map->capacity - 1;
+    size_t j = i;
+    for(;;)
     {
-        const char* check_key = bucket->key_buffer[i];
-        if(check_key != NULL && strcmp(key, check_key) == 0)
-        {
-            AUG_FREE(bucket->key_buffer[i]);
-            bucket->key_buffer[i] = NULL;
-            if(map->free_func)
-                map->free_func(&bucket->data_buffer[i * map->element_size]);
-            return true;
-        }
+        j = (j + 1) & mask;
+        aug_hashtable_slot* slot = &map->slots[j];
+        if(slot->key == NULL)
+            break;
+
+        const size_t ideal = slot->hash & mask;
+        const bool reachable = i <= j ? (i < ideal && ideal <= j) : (i < ideal || ideal <= j);
+        if(reachable)
+            continue;
+
+        map->slots[i] = *slot;
+        memcpy(&map->data_buffer[i * map->element_size], &map->data_buffer[j * map->element_size], map->element_size);
+        slot->key = NULL;
+        i = j;
     }
-    return false;
+    return true;
+}
+
+// Lookup with a precomputed key length and hash. Used to search several tables for the same key
+uint8_t* aug_hashtable_get_hashed(aug_hashtable* map, const char* key, size_t length, size_t hash)
+{
+    if(map->count == 0)
+        return NULL;
+
+    const size_t i = aug_hashtable_find(map, key, length, hash);
+    return map->slots[i].key != NULL ? &map->data_buffer[i * map->element_size] : NULL;
 }
 
 uint8_t* aug_hashtable_get(aug_hashtable* map, const char* key)
 {
-    const size_t find_hash = map->hash_func(key);
-    aug_hashtable_bucket* bucket = &map->buckets[find_hash % map->capacity];
-    size_t i;
-    for(i = 0; i  < bucket->capacity; ++i)
-    {
-        const char* check_key = bucket->key_buffer[i];
-        if (check_key != NULL && strcmp(key, check_key) == 0)
-            return &bucket->data_buffer[i * map->element_size];
-    }
-    return NULL;
+    if(map->count == 0)
+        return NULL;
+    return aug_hashtable_get_hashed(map, key, strlen(key), map->hash_func(key));
 }
 
 void aug_hashtable_foreach(aug_hashtable* map, aug_hashtable_iterator* iterator, void* user_data)
 {
-    size_t i, j;
+    size_t i;
     for(i = 0; i < map->capacity; ++i)
     {
-        aug_hashtable_bucket* bucket = &map->buckets[i];
-        for(j = 0; j < bucket->capacity; ++j)
-        {        
-            if(bucket->key_buffer[j] != NULL)
-                iterator(&bucket->data_buffer[j * map->element_size], user_data);
-        }
+        if(map->slots[i].key != NULL)
+            iterator(&map->data_buffer[i * map->element_size], user_data);
     }
 }
 
-size_t aug_hashtable_hash_default(const char* str)
-{
-    size_t hash = 5381; // DJB2 hash
-    while(*str)
-        hash = ((hash << 5) + hash) + *str++;
-    return hash;
-}
-
 #define aug_hashtable_new_type(type)\
-    aug_hashtable_new(AUG_HASHTABLE_SIZE_DEFAULT, sizeof(type), aug_hashtable_hash_default, NULL)
+    aug_hashtable_new(0, sizeof(type), aug_hashtable_hash_default, NULL)
 
 #define aug_hashtable_insert_type(type, map, key)\
     ((type*)aug_hashtable_create(map, key))
@@ -795,14 +1777,16 @@ size_t aug_hashtable_hash_default(const char* str)
 #define aug_hashtable_ptr_type(type, map, key)\
     ((type*)aug_hashtable_get(map, key))
 
+#define aug_hashtable_ptr_hashed_type(type, map, key, length, hash)\
+    ((type*)aug_hashtable_get_hashed(map, key, length, hash))
+
 // LOGGING =====================================   LOGGING   ================================================= LOGGING // 
 
 void aug_log_error_internal(aug_error_func* error_func, const char* format, va_list args)
 {
     if(error_func)
     {
-        // TODO: make thread safe
-        static char log_buffer[4096];
+        static AUG_THREAD_LOCAL char log_buffer[4096];
         vsnprintf(log_buffer, sizeof(log_buffer), format, args);
         error_func(log_buffer);
     }
@@ -824,51 +1808,196 @@ void aug_log_error(aug_error_func* error_func, const char* format, ...)
 
 // INPUT ========================================   INPUT   ===================================================== INPUT // 
 
+// Reads the entire file. If supported, the file is mapped, writable mappings are private so that the file is not 
+// modified. Empty files are returned as an allocated empty buffer, as these can not be mapped
+static inline char* aug_file_open(const char* filename, bool writable, size_t* size_out, bool* mapped_out)
+{
+#if __linux
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || file_stat.st_size < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    if(file_stat.st_size == 0)
+    {
+        close(fd);
+        *size_out = 0;
+        *mapped_out = false;
+        return (char*)AUG_ALLOC(1);
+    }
+
+    const int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* data = mmap(NULL, (size_t)file_stat.st_size, protection, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return NULL;
+
+    *size_out = (size_t)file_stat.st_size;
+    *mapped_out = true;
+    return (char*)data;
+#else
+    (void)writable;
+#ifdef AUG_SECURE
+    FILE* file;
+    fopen_s(&file, filename, "rb");
+#else
+    FILE* file = fopen(filename, "rb");
+#endif //AUG_SECURE
+    if(file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if(size < 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    char* data = (char*)AUG_ALLOC((size_t)size + 1);
+    if(fread(data, 1, (size_t)size, file) != (size_t)size)
+    {
+        AUG_FREE(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    *size_out = (size_t)size;
+    *mapped_out = false;
+    return data;
+#endif
+}
+
+static inline void aug_file_close(char* data, size_t size, bool mapped)
+{
+#if __linux
+    if(mapped)
+    {
+        munmap(data, size);
+        return;
+    }
+#else
+    (void)size;
+    (void)mapped;
+#endif
+    AUG_FREE(data);
+}
+
+// Identifies the file's current version. If supported, from the modification time and size, otherwise hashes the 
+// contents. Missing files are stamped 0, so that creating the file changes the stamp
+static inline uint64_t aug_file_stamp(const char* filename)
+{
+#if __linux
+    struct stat file_stat;
+    if(stat(filename, &file_stat) != 0)
+        return 0;
+
+#if defined(st_mtime) // defined as the seconds of st_mtim, if the nanosecond time is available
+    uint64_t stamp = (uint64_t)file_stat.st_mtim.tv_sec * 1000000000ull + (uint64_t)file_stat.st_mtim.tv_nsec;
+#elif defined(__GLIBC__) // without the POSIX 2008 fields, glibc names the nanoseconds st_mtimensec
+    uint64_t stamp = (uint64_t)file_stat.st_mtime * 1000000000ull + (uint64_t)file_stat.st_mtimensec;
+#else
+    uint64_t stamp = (uint64_t)file_stat.st_mtime;
+#endif
+    stamp = aug_hash_mix(stamp ^ ((uint64_t)file_stat.st_size << 1));
+    return stamp != 0 ? stamp : 1;
+#else
+    size_t size = 0;
+    bool mapped = false;
+    char* data = aug_file_open(filename, false, &size, &mapped);
+    if(data == NULL)
+        return 0;
+
+    uint64_t stamp = 5381; // DJB2 hash
+    for(size_t i = 0; i < size; ++i)
+        stamp = ((stamp << 5) + stamp) + (unsigned char)data[i];
+    stamp = aug_hash_mix(stamp ^ size);
+    aug_file_close(data, size, mapped);
+    return stamp != 0 ? stamp : 1;
+#endif
+}
+
+// Positions only record the offset into the input while lexing. The line and column are located when required, 
+// i.e. reporting an error or marking the source of an operation
 typedef struct aug_pos
 {
     size_t filepos;
     size_t linepos;
     size_t line;
     size_t col;
-
-    int c;
 }aug_pos;
 
 typedef struct aug_input
 {
-    FILE* file;
-    const char* str;
+    char* buffer;  // the entire file, or the code literal
+    size_t length;
+    size_t cursor; // offset of the next character to read
+    bool mapped;   // the file is mapped, otherwise the buffer is allocated
+    bool code;     // the buffer is the code literal, not owned by the input
 
     bool valid;
     aug_string* filename;
     size_t track_pos;
-    size_t pos_buffer_index;
-    aug_pos pos_buffer[2]; //store, prev, curr
+    aug_container* line_offsets; // type size_t, created when a position is first located
+
+    aug_arena* arena; // owns the tokens and ast parsed from this input
 
     aug_error_func* error_func;
 }aug_input;
 
-static inline aug_pos* aug_input_pos(aug_input* input)
+static inline aug_pos aug_input_pos(const aug_input* input)
 {
-    return &input->pos_buffer[input->pos_buffer_index];
+    aug_pos pos;
+    pos.filepos = input->cursor < input->length ? input->cursor : input->length;
+    pos.linepos = 0;
+    pos.line = 0;
+    pos.col = 0;
+    return pos;
 }
 
-static inline aug_pos* aug_input_get_pos(aug_input* input, int dir)
+// Resolves the line and column of the position's offset. Lines offsets are gathered once, then searched
+static inline aug_pos aug_input_locate(aug_input* input, aug_pos pos)
 {
     assert(input != NULL);
-    const int buffer_len = (sizeof(input->pos_buffer) / sizeof(input->pos_buffer[0]));
-    const int len = (input->pos_buffer_index + dir) % buffer_len;
-    if (len < 0) input->pos_buffer_index = buffer_len - input->pos_buffer_index;
-    return &input->pos_buffer[len];
-}
+    if(input->line_offsets == NULL)
+    {
+        input->line_offsets = aug_container_new_type(size_t, 16);
+        aug_container_push_type(size_t, input->line_offsets, 0);
+        for(size_t i = 0; i < input->length; ++i)
+        {
+            if(input->buffer[i] == '\n')
+                aug_container_push_type(size_t, input->line_offsets, i + 1);
+        }
+    }
 
-static inline aug_pos* aug_input_move_pos(aug_input* input, int dir)
-{
-    assert(input != NULL);
-    const int buffer_len = (sizeof(input->pos_buffer) / sizeof(input->pos_buffer[0]));
-    input->pos_buffer_index = (input->pos_buffer_index + dir) % buffer_len;
-    if (input->pos_buffer_index < 0) input->pos_buffer_index = buffer_len - input->pos_buffer_index;
-    return &input->pos_buffer[input->pos_buffer_index];
+    if(pos.filepos > input->length)
+        pos.filepos = input->length;
+
+    // Last line beginning at or before the position
+    const size_t* offsets = aug_container_ptr_type(size_t, input->line_offsets, 0);
+    size_t low = 0;
+    size_t high = input->line_offsets->length;
+    while(high - low > 1)
+    {
+        const size_t mid = low + (high - low) / 2;
+        if(offsets[mid] <= pos.filepos)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    pos.line = low;
+    pos.linepos = offsets[low];
+    pos.col = pos.filepos - pos.linepos;
+    return pos;
 }
 
 static inline char aug_input_get(aug_input* input)
@@ -876,109 +2005,62 @@ static inline char aug_input_get(aug_input* input)
     if(input == NULL)
         return -1;
 
-    int c;
-    if(input->file != NULL)
-    {
-        c = fgetc(input->file);
-    }
-    else 
-    {
-        aug_pos* pos = aug_input_pos(input);
-        c = input->str[pos->filepos];
-        if(c == '\0')
-            return -1;
-    }
-
-    aug_pos* pos = aug_input_pos(input);
-    aug_pos* next_pos = aug_input_move_pos(input, 1);
-    next_pos->c = c;
-    next_pos->line = pos->line;
-    next_pos->col = pos->col + 1;
-    next_pos->linepos = pos->linepos;
-    next_pos->filepos = pos->filepos + 1;
-
-    if(c == '\n')
-    {
-        next_pos->col = 0;
-        next_pos->line = pos->line + 1;
-        next_pos->linepos = next_pos->filepos;
-    }
-    return c;
+    // Reads beyond the end still move the cursor, so that these can be ungot as with the end of a file
+    const size_t cursor = input->cursor++;
+    if(cursor >= input->length)
+        return -1;
+    return input->buffer[cursor];
 }
 
 static inline char aug_input_peek(aug_input* input)
 {
     assert(input != NULL);
-    if(input->file != NULL)
-    {
-        int c = fgetc(input->file);
-        ungetc(c, input->file);
-        return c;
-    }
-
-    aug_pos* pos = aug_input_pos(input);
-    int c = input->str[pos->filepos];
-    return c;
+    return input->cursor < input->length ? input->buffer[input->cursor] : EOF;
 }
 
 static inline void aug_input_unget(aug_input* input)
 {
-    assert(input != NULL);
-    aug_pos* pos = aug_input_pos(input);
-    if(input->file != NULL)
-        ungetc(pos->c, input->file);
-    aug_input_move_pos(input, -1);
+    assert(input != NULL && input->cursor > 0);
+    --input->cursor;
 }
 
-aug_input* aug_input_open(const char* filename, aug_error_func* error_func)
+static inline aug_input* aug_input_new(char* buffer, size_t length, const char* filename, aug_error_func* error_func)
 {
-#ifdef AUG_SECURE
-    FILE* file;
-    fopen_s(&file, filename, "r+");
-#else
-    FILE* file = fopen(filename, "r+");
-#endif //AUG_SECURE
-    if(file == NULL)
-    {
-        aug_log_error(error_func, "Input failed to open file %s", filename);
-        return NULL;
-    }
-
     aug_input* input = (aug_input*)AUG_ALLOC(sizeof(aug_input));
     input->error_func = error_func;
-    input->file = file;
-    input->str = NULL;
+    input->buffer = buffer;
+    input->length = length;
+    input->cursor = 0;
+    input->mapped = false;
+    input->code = false;
     input->valid = true;
     input->filename = aug_string_create(filename);
-    input->pos_buffer_index = 0;
+    input->arena = aug_arena_new(AUG_ARENA_BLOCK_SIZE);
     input->track_pos = 0;
+    input->line_offsets = NULL;
+    return input;
+}
 
-    aug_pos* pos = aug_input_pos(input);
-    pos->col = 0;
-    pos->line = 0;
-    pos->c = -1;
-    pos->filepos = pos->linepos = 0;
+aug_input* aug_input_open(const char* filename, aug_error_func* error_func)
+{
+    size_t length = 0;
+    bool mapped = false;
+    char* buffer = aug_file_open(filename, false, &length, &mapped);
+    if(buffer == NULL)
+    {
+        aug_log_error(error_func, "Input failed to open file %s", filename);
+        return NULL;
+    }
 
+    aug_input* input = aug_input_new(buffer, length, filename, error_func);
+    input->mapped = mapped;
     return input;
 }
 
 aug_input* aug_input_open_code(const char* code, aug_error_func* error_func)
 {
-    aug_input* input = (aug_input*)AUG_ALLOC(sizeof(aug_input));
-    input->error_func = error_func;
-    input->file = NULL;
-    input->str = code;
-    input->valid = true;
-    input->filename = aug_string_create("stdin");
-    input->pos_buffer_index = 0;
-    input->track_pos = 0;
-
-    aug_pos* pos = aug_input_pos(input);
-    pos->col = 0;
-    pos->line = 0;
-    pos->c = -1;
-    pos->filepos = pos->linepos = 0;
-
+    aug_input* input = aug_input_new((char*)code, strlen(code), "stdin", error_func);
+    input->code = true;
     return input;
 }
 
@@ -988,8 +2070,11 @@ void aug_input_close(aug_input* input)
         return;
 
     input->filename = aug_string_decref(input->filename);
-    if(input->file != NULL)
-        fclose(input->file);
+    if(!input->code)
+        aug_file_close(input->buffer, input->length, input->mapped);
+
+    input->line_offsets = aug_container_decref(input->line_offsets);
+    aug_arena_delete(input->arena);
 
     AUG_FREE(input);
 }
@@ -997,60 +2082,35 @@ void aug_input_close(aug_input* input)
 static inline void aug_input_start_tracking(aug_input* input)
 {
     assert(input != NULL);
-    aug_pos* pos = aug_input_pos(input);
-    input->track_pos = pos->filepos;
+    input->track_pos = input->cursor;
 }
 
-static inline aug_string* aug_input_end_tracking(aug_input* input)
+// The characters read since tracking started, sliced from the input
+static inline const char* aug_input_tracked(aug_input* input, size_t* length)
 {
     assert(input != NULL);
-    aug_pos* pos = aug_input_pos(input);
-
-    const size_t pos_end = pos->filepos;
-    const size_t len = (pos_end - input->track_pos);
-
-    aug_string* string = aug_string_new(len+1);
-    string->length = len;
-    string->buffer[len] = '\0';
+    const size_t pos_end = input->cursor < input->length ? input->cursor : input->length;
+    *length = pos_end > input->track_pos ? pos_end - input->track_pos : 0;
+    return input->buffer + input->track_pos;
+}
 
-    if(input->file != NULL)
-    {        
-        fseek(input->file, input->track_pos, SEEK_SET);
-        size_t count = fread(string->buffer, sizeof(char), len, input->file);
-        fseek(input->file, pos_end, SEEK_SET);
-        if(count != len)
-        {
-            aug_log_error(input->error_func, "Failed to read %d bytes! %s", len, input->filename->buffer);
-            fseek(input->file, pos_end, SEEK_END);
-        }
-    }
-    else 
-    {
-        size_t i;
-        for(i = 0; i < len; ++i)
-            string->buffer[i] = input->str[i + input->track_pos]; 
-    }
-    return string;
+static inline aug_string* aug_input_end_tracking(aug_input* input)
+{
+    size_t length;
+    const char* bytes = aug_input_tracked(input, &length);
+    return aug_arena_string_create(input->arena, bytes, length);
 }
 
+// Expects a located position
 static inline void aug_log_input_error_hint(aug_input* input, const aug_pos* pos)
 {
     assert(input != NULL);
 
-    if(input->file == NULL)
-        return;
-
-    // save state
-    int curr_pos = ftell(input->file);
-
-    // go to line
-    fseek(input->file, pos->linepos, SEEK_SET);
-
     // skip leading whitespace
+    size_t i = pos->linepos;
     size_t ws_skipped = 0;
-    int c = fgetc(input->file);
-    while (isspace(c) && ++ws_skipped)
-        c = fgetc(input->file);
+    while (i < input->length && isspace(input->buffer[i]) && input->buffer[i] != '\n' && ++ws_skipped)
+        ++i;
 
     aug_log_error(input->error_func, "Error %s:(%d,%d) ", 
         input->filename->buffer, pos->line + 1, pos->col + 1);
@@ -1058,18 +2118,15 @@ static inline void aug_log_input_error_hint(aug_input* input, const aug_pos* pos
     // Draw line
     char buffer[4096];
     size_t n = 0;
-    while (c != EOF && c != '\n' && n < (sizeof(buffer) - 1))
-    {
-        buffer[n++] = c;
-        c = fgetc(input->file);
-    }
+    while (i < input->length && input->buffer[i] != '\n' && n < (sizeof(buffer) - 1))
+        buffer[n++] = input->buffer[i++];
     buffer[n] = '\0';
 
     aug_log_error(input->error_func, "%s", buffer);
 
     // Draw arrow to the error if within buffer
-    size_t tok_col = pos->col - ws_skipped;
-    if (tok_col >= 0 && tok_col < n - 1)
+    size_t tok_col = pos->col >= ws_skipped ? pos->col - ws_skipped : n;
+    if (tok_col + 1 < n)
     {
         size_t i;
         for (i = 0; i < tok_col; ++i)
@@ -1078,14 +2135,16 @@ static inline void aug_log_input_error_hint(aug_input* input, const aug_pos* pos
         buffer[tok_col + 1] = '\0';
         aug_log_error(input->error_func, "%s", buffer);
     }
-
-    // restore state
-    fseek(input->file, curr_pos, SEEK_SET);
 }
 
 void aug_log_input_error(aug_input* input, const char* format, ...)
 {
-    aug_log_input_error_hint(input, aug_input_get_pos(input, -1));
+    // The last character read
+    aug_pos pos = aug_input_pos(input);
+    if(pos.filepos > 0 && input->cursor <= input->length)
+        --pos.filepos;
+    pos = aug_input_locate(input, pos);
+    aug_log_input_error_hint(input, &pos);
 
     va_list args;
     va_start(args, format);
@@ -1095,7 +2154,8 @@ void aug_log_input_error(aug_input* input, const char* format, ...)
 
 void aug_log_input_error_at(aug_input* input, const aug_pos* pos, const char* format, ...)
 {
-    aug_log_input_error_hint(input, pos);
+    const aug_pos located = aug_input_locate(input, *pos);
+    aug_log_input_error_hint(input, &located);
 
     va_list args;
     va_start(args, format);
@@ -1176,6 +2236,7 @@ typedef struct aug_token_detail
     AUG_TOKEN(RETURN,         0, 0, 0, "return")   \
     AUG_TOKEN(BREAK,          0, 0, 0, "break")    \
     AUG_TOKEN(CONTINUE,       0, 0, 0, "continue") \
+    AUG_TOKEN(YIELD,          0, 0, 0, "yield")    \
     AUG_TOKEN(TRUE,           0, 0, 0, "true")     \
     AUG_TOKEN(FALSE,          0, 0, 0, "false")    \
     AUG_TOKEN(NONE,           0, 0, 0, "none")     \
@@ -1218,6 +2279,8 @@ typedef struct aug_token
 typedef struct aug_lexer
 {
     aug_input* input;
+    aug_arena* arena; // token data is allocated from the input's arena
+    aug_string* literal; // scratch buffer for string literals
 
     aug_token tokens[AUG_LEXER_TOKEN_BUFFER_SIZE];
     int at_index;
@@ -1269,6 +2332,8 @@ aug_lexer* aug_lexer_new(aug_input* input)
 {
     aug_lexer* lexer = (aug_lexer*)AUG_ALLOC(sizeof(aug_lexer));
     lexer->input = input;
+    lexer->arena = input->arena;
+    lexer->literal = aug_string_new(4);
     lexer->comment_symbol = '#';
     lexer->at_index = -1;
     lexer->tokenize_index = 0;
@@ -1282,6 +2347,7 @@ void aug_lexer_delete(aug_lexer* lexer)
 {
     for(int i = 0; i < AUG_LEXER_TOKEN_BUFFER_SIZE; ++i)
         aug_token_reset(&lexer->tokens[i]);
+    aug_string_decref(lexer->literal);
     AUG_FREE(lexer);
 }
 
@@ -1306,20 +2372,20 @@ bool aug_lexer_tokenize_char(aug_lexer* lexer, aug_token* token)
     assert(c == '\'');
 
     token->id = AUG_TOKEN_CHAR;
-    token->data = aug_string_new(1);
+    token->data = aug_arena_string_new(lexer->arena, 1);
 
     c = aug_input_get(lexer->input);
     if(c != '\'')
     {
-        aug_string_push(token->data, c);
+        token->data->buffer[0] = c;
         c = aug_input_get(lexer->input); // eat 
     }
     else
-        aug_string_push(token->data, 0);
+        token->data->buffer[0] = 0;
 
     if(c != '\'')
     {
-        token->data = aug_string_decref(token->data);
+        token->data = NULL;
         aug_log_input_error(lexer->input, "char literal missing closing \"");
         return false;
     }
@@ -1332,7 +2398,10 @@ bool aug_lexer_tokenize_string(aug_lexer* lexer, aug_token* token)
     assert(c == '\"');
 
     token->id = AUG_TOKEN_STRING;
-    token->data = aug_string_new(4);
+
+    // Escapes are resolved into the scratch buffer, then copied into the arena once the length is known
+    aug_string* literal = lexer->literal;
+    literal->length = 0;
 
     c = aug_input_get(lexer->input);
 
@@ -1340,7 +2409,6 @@ bool aug_lexer_tokenize_string(aug_lexer* lexer, aug_token* token)
     {
         if(c == EOF)
         {
-            token->data = aug_string_decref(token->data);
             aug_log_input_error(lexer->input, "string literal missing closing \"");
             return false;
         }
@@ -1352,51 +2420,52 @@ bool aug_lexer_tokenize_string(aug_lexer* lexer, aug_token* token)
             switch(c)
             {
             case '\'': 
-                aug_string_push(token->data, '\'');
+                aug_string_push(literal, '\'');
                 break;
             case '\"':
-                aug_string_push(token->data, '\"');
+                aug_string_push(literal, '\"');
                 break;
             case '\\':
-                aug_string_push(token->data, '\\');
+                aug_string_push(literal, '\\');
                 break;
             case '0': //Null
-                aug_string_push(token->data, 0x0);
+                aug_string_push(literal, 0x0);
                 break;
             case 'a': //Alert beep
-                aug_string_push(token->data, 0x07);
+                aug_string_push(literal, 0x07);
                 break;
             case 'b': // Backspace
-                aug_string_push(token->data, 0x08);
+                aug_string_push(literal, 0x08);
                 break;
             case 'f': // Page break
-                aug_string_push(token->data, 0x0C);
+                aug_string_push(literal, 0x0C);
                 break;
             case 'n': // Newline
-                aug_string_push(token->data, 0x0A);
+                aug_string_push(literal, 0x0A);
                 break;
             case 'r': // Carriage return
-                aug_string_push(token->data, 0x0D);
+                aug_string_push(literal, 0x0D);
                 break;
             case 't': // Tab (Horizontal)
-                aug_string_push(token->data, 0x09);
+                aug_string_push(literal, 0x09);
                 break;
             case 'v': // Tab (Vertical)
-                aug_string_push(token->data, 0x0B);
+                aug_string_push(literal, 0x0B);
                 break;
             default:
-                token->data = aug_string_decref(token->data);
                 aug_log_input_error(lexer->input, "invalid escape character \\%c", c);
                 return false;
             }
         }
         else
         {
-            aug_string_push(token->data, c);
+            aug_string_push(literal, c);
         }
 
         c = aug_input_get(lexer->input);
     }
+
+    token->data = aug_arena_string_create(lexer->arena, literal->buffer, literal->length);
     return true;
 }
 
@@ -1508,20 +2577,22 @@ bool aug_lexer_tokenize_name(aug_lexer* lexer, aug_token* token)
         c = aug_input_get(lexer->input);
     aug_input_unget(lexer->input);
 
-    token->id = AUG_TOKEN_NAME;
-    token->data = aug_input_end_tracking(lexer->input);
-
-    // find token id for keyword
+    // find token id for keyword, compared within the input so that keywords do not copy the name
+    size_t length;
+    const char* name = aug_input_tracked(lexer->input, &length);
     for(size_t i = 0; i < (size_t)AUG_TOKEN_COUNT; ++i)
     {
-        if(aug_string_compare_bytes(token->data, aug_token_details[i].keyword))
+        const char* keyword = aug_token_details[i].keyword;
+        if(keyword != NULL && strncmp(keyword, name, length) == 0 && keyword[length] == '\0')
         {
             token->id = (aug_token_id)i;
-            token->data = aug_string_decref(token->data); // keyword is static, free token data
-            break;
+            token->data = NULL; // keyword is static
+            return true;
         }
     }
-    
+
+    token->id = AUG_TOKEN_NAME;
+    token->data = aug_input_end_tracking(lexer->input);
     return true;
 }
 
@@ -1611,7 +2682,7 @@ bool aug_lexer_tokenize_number(aug_lexer* lexer, aug_token* token)
     if(id == AUG_TOKEN_INVALID)
     {
         aug_log_input_error(lexer->input, "invalid numeric format %s", token->data->buffer);
-        token->data = aug_string_decref(token->data);
+        token->data = NULL;
         return false;
     }
 
@@ -1674,7 +2745,7 @@ aug_token aug_lexer_tokenize(aug_lexer* lexer)
         return token;
     }
 
-    token.pos = *aug_input_pos(lexer->input);
+    token.pos = aug_input_pos(lexer->input);
 
     switch (c)
     {
@@ -1797,6 +2868,7 @@ typedef uint8_t aug_ast_type;
     AUG_AST_TYPE(RETURN)             \
     AUG_AST_TYPE(BREAK)              \
     AUG_AST_TYPE(CONTINUE)           \
+    AUG_AST_TYPE(YIELD)              \
     AUG_AST_TYPE(IMPORT_SCRIPT)      \
     AUG_AST_TYPE(IMPORT_LIB)
 
@@ -1834,9 +2906,10 @@ typedef struct aug_ast
     int children_capacity;
 } aug_ast;
 
-aug_ast* aug_ast_new(aug_ast_type type, aug_token token)
+// Nodes and child arrays are allocated from the input's arena and released when the input is closed
+aug_ast* aug_ast_new(aug_arena* arena, aug_ast_type type, aug_token token)
 {
-    aug_ast* node = (aug_ast*)AUG_ALLOC(sizeof(aug_ast));
+    aug_ast* node = (aug_ast*)aug_arena_alloc(arena, sizeof(aug_ast));
     node->type = type;
     node->token = token;
     node->children = NULL;
@@ -1845,36 +2918,25 @@ aug_ast* aug_ast_new(aug_ast_type type, aug_token token)
     return node;
 }
 
-static inline void aug_ast_delete(aug_ast* node)
+static inline void aug_ast_reserve(aug_arena* arena, aug_ast* node, int capacity)
 {
-    if(node == NULL)
-        return;
-    if(node->children)
-    {
-        int i;
-        for(i = 0; i < node->children_size; ++i)
-            aug_ast_delete(node->children[i]);
-        AUG_FREE(node->children);
-    }
-    if(node->token.data)
-    aug_token_reset(&node->token);
-    AUG_FREE(node);
+    aug_ast** children = (aug_ast**)aug_arena_alloc(arena, sizeof(aug_ast*) * capacity);
+    if(node->children_size > 0)
+        memcpy(children, node->children, sizeof(aug_ast*) * node->children_size);
+    node->children = children;
+    node->children_capacity = capacity;
 }
 
-static inline void aug_ast_resize(aug_ast* node, int size)
+static inline void aug_ast_resize(aug_arena* arena, aug_ast* node, int size)
 {    
-    node->children_capacity = size == 0 ? 1 : size;
-    node->children = (aug_ast**)AUG_REALLOC(node->children, sizeof(aug_ast*) * node->children_capacity);
+    aug_ast_reserve(arena, node, size == 0 ? 1 : size);
     node->children_size = size;
 }
 
-static inline void aug_ast_add(aug_ast* node, aug_ast* child)
+static inline void aug_ast_add(aug_arena* arena, aug_ast* node, aug_ast* child)
 {
     if(node->children_size + 1 >= node->children_capacity)
-    {
-        node->children_capacity = node->children_capacity == 0 ? 1 : node->children_capacity * 2;
-        node->children = (aug_ast**)AUG_REALLOC(node->children, sizeof(aug_ast*) * node->children_capacity);
-    }
+        aug_ast_reserve(arena, node, node->children_capacity == 0 ? 1 : node->children_capacity * 2);
     node->children[node->children_size++] = child;
 }
 
@@ -1900,18 +2962,14 @@ static inline bool aug_parse_expr_pop(aug_lexer* lexer, aug_container* op_stack,
     if(expr_stack->length < (size_t)op_argc)
     {
         aug_log_input_error(lexer->input, "Invalid number of arguments to operator %s. Expected %ld, received %d", next_op.detail->label, op_argc, expr_stack->length);
-        while(expr_stack->length > 0)
-        {
-            aug_ast* expr = aug_container_pop_type(aug_ast*, expr_stack);
-            aug_ast_delete(expr);
-        }
+        expr_stack->length = 0; // nodes are owned by the arena
         return false;
     }
 
     // Push binary op onto stack
     aug_ast_type id = (op_argc == 2) ? AUG_AST_BINARY_OP : AUG_AST_UNARY_OP;
-    aug_ast* binaryop = aug_ast_new(id, next_op);
-    aug_ast_resize(binaryop, op_argc);
+    aug_ast* binaryop = aug_ast_new(lexer->arena, id, next_op);
+    aug_ast_resize(lexer->arena, binaryop, op_argc);
     
     int i;
     for(i = 0; i < op_argc; ++i)
@@ -1927,11 +2985,6 @@ static inline bool aug_parse_expr_pop(aug_lexer* lexer, aug_container* op_stack,
 
 static inline void aug_parse_expr_stack_cleanup(aug_container* op_stack, aug_container* expr_stack)
 {
-    while(expr_stack->length > 0)
-    {
-        aug_ast* expr = aug_container_pop_type(aug_ast*, expr_stack);
-        aug_ast_delete(expr);
-    }
     aug_container_decref(expr_stack);
     aug_container_decref(op_stack);
 }
@@ -2017,20 +3070,18 @@ aug_ast* aug_parse_funccall(aug_lexer* lexer, aug_ast* value)
     if(value->type == AUG_AST_VARIABLE)
     {
         // pass token to func call and reset variable token. converts variable into func call
-        funccall = aug_ast_new(AUG_AST_FUNC_CALL, value->token);
-        value->token = aug_token_new();
-        aug_ast_delete(value);
+        funccall = aug_ast_new(lexer->arena, AUG_AST_FUNC_CALL, value->token);
     }
     else
     {
-        funccall = aug_ast_new(AUG_AST_FUNC_CALL_UNNAMED, aug_ast_token_empty(lexer));
-        aug_ast_add(funccall, value); //NOTE: first child is the function value
+        funccall = aug_ast_new(lexer->arena, AUG_AST_FUNC_CALL_UNNAMED, aug_ast_token_empty(lexer));
+        aug_ast_add(lexer->arena, funccall, value); //NOTE: first child is the function value
     }
     
     aug_ast* expr = aug_parse_expr(lexer);
     if(expr != NULL)
     {
-        aug_ast_add(funccall, expr);
+        aug_ast_add(lexer->arena, funccall, expr);
 
         while(expr != NULL && aug_lexer_curr(lexer).id == AUG_TOKEN_COMMA)
         {
@@ -2038,13 +3089,12 @@ aug_ast* aug_parse_funccall(aug_lexer* lexer, aug_ast* value)
 
             expr = aug_parse_expr(lexer);
             if(expr != NULL)
-                aug_ast_add(funccall, expr);
+                aug_ast_add(lexer->arena, funccall, expr);
         }
     }
 
     if(aug_lexer_curr(lexer).id != AUG_TOKEN_RPAREN)
     {
-        aug_ast_delete(funccall);
         aug_log_input_error(lexer->input, "Function call missing closing parentheses");
         return NULL;
     }
@@ -2062,12 +3112,12 @@ aug_ast* aug_parse_array(aug_lexer* lexer)
     aug_lexer_move(lexer); // eat LBRACKET
 
 
-    aug_ast* array = aug_ast_new(AUG_AST_ARRAY, aug_ast_token_empty(lexer));
+    aug_ast* array = aug_ast_new(lexer->arena, AUG_AST_ARRAY, aug_ast_token_empty(lexer));
 
     aug_ast* expr = aug_parse_expr(lexer);
     if(expr != NULL)
     {
-        aug_ast_add(array, expr);
+        aug_ast_add(lexer->arena, array, expr);
 
         while(expr != NULL && aug_lexer_curr(lexer).id == AUG_TOKEN_COMMA)
         {
@@ -2078,13 +3128,12 @@ aug_ast* aug_parse_array(aug_lexer* lexer)
 
             expr = aug_parse_expr(lexer);
             if(expr != NULL)
-                aug_ast_add(array, expr);
+                aug_ast_add(lexer->arena, array, expr);
         }
     }
 
     if(aug_lexer_curr(lexer).id != AUG_TOKEN_RBRACKET)
     {
-        aug_ast_delete(array);
         aug_log_input_error(lexer->input, "Array missing closing bracket");
         return NULL;
     }
@@ -2116,7 +3165,7 @@ aug_ast* aug_parse_key(aug_lexer* lexer)
     if(aug_parse_is_key(aug_lexer_curr(lexer)))
     {
         aug_token token = aug_token_copy(aug_lexer_curr(lexer));
-        aug_ast* value = aug_ast_new(AUG_AST_LITERAL, token);
+        aug_ast* value = aug_ast_new(lexer->arena, AUG_AST_LITERAL, token);
         aug_lexer_move(lexer);
         return value;
     }
@@ -2134,7 +3183,6 @@ aug_ast* aug_parse_map_pair(aug_lexer* lexer)
 
     if (aug_lexer_curr(lexer).id != AUG_TOKEN_COLON)
     {
-        aug_ast_delete(key);
         aug_log_input_error(lexer->input, "Key value expected : after key");
         return NULL;
     }
@@ -2143,14 +3191,13 @@ aug_ast* aug_parse_map_pair(aug_lexer* lexer)
     aug_ast* expr = aug_parse_expr(lexer);
     if (expr == NULL)
     {
-        aug_ast_delete(key);
         aug_log_input_error(lexer->input, "Key value expected value after :");
         return NULL;
     }
 
-    aug_ast* keyvalue = aug_ast_new(AUG_AST_MAP_PAIR, aug_ast_token_empty(lexer));
-    aug_ast_add(keyvalue, key);
-    aug_ast_add(keyvalue, expr);
+    aug_ast* keyvalue = aug_ast_new(lexer->arena, AUG_AST_MAP_PAIR, aug_ast_token_empty(lexer));
+    aug_ast_add(lexer->arena, keyvalue, key);
+    aug_ast_add(lexer->arena, keyvalue, expr);
     return keyvalue;
 }
 
@@ -2165,7 +3212,7 @@ aug_ast* aug_parse_map(aug_lexer* lexer)
     if (aug_lexer_curr(lexer).id == AUG_TOKEN_RBRACE)
     {
         aug_lexer_move(lexer); // eat RBRACE
-        return aug_ast_new(AUG_AST_MAP, aug_ast_token_empty(lexer));
+        return aug_ast_new(lexer->arena, AUG_AST_MAP, aug_ast_token_empty(lexer));
     }
 
     // must have key : comma. Otherwise, not a map literal
@@ -2175,11 +3222,11 @@ aug_ast* aug_parse_map(aug_lexer* lexer)
         return NULL;
     }
 
-    aug_ast* map = aug_ast_new(AUG_AST_MAP, aug_ast_token_empty(lexer));
+    aug_ast* map = aug_ast_new(lexer->arena, AUG_AST_MAP, aug_ast_token_empty(lexer));
     aug_ast* pair = aug_parse_map_pair(lexer);
     if (pair != NULL )
     {
-        aug_ast_add(map, pair);
+        aug_ast_add(lexer->arena, map, pair);
 
         while (pair != NULL && aug_lexer_curr(lexer).id == AUG_TOKEN_COMMA)
         {
@@ -2190,13 +3237,12 @@ aug_ast* aug_parse_map(aug_lexer* lexer)
 
             pair = aug_parse_map_pair(lexer);
             if (pair != NULL)
-                aug_ast_add(map, pair);
+                aug_ast_add(lexer->arena, map, pair);
         }
     }
 
     if (aug_lexer_curr(lexer).id != AUG_TOKEN_RBRACE)
     {
-        aug_ast_delete(map);
         aug_log_input_error(lexer->input, "Map missing closing }");
         return NULL;
     }
@@ -2220,15 +3266,14 @@ aug_ast* aug_parse_element(aug_lexer* lexer, aug_ast* container)
         return NULL;
     }
 
-    aug_ast* element = aug_ast_new(AUG_AST_ELEMENT, aug_ast_token_empty(lexer));
+    aug_ast* element = aug_ast_new(lexer->arena, AUG_AST_ELEMENT, aug_ast_token_empty(lexer));
 
-    aug_ast_resize(element, 2);
+    aug_ast_resize(lexer->arena, element, 2);
     element->children[0] = expr;
     element->children[1] = container;
 
     if(aug_lexer_curr(lexer).id != AUG_TOKEN_RBRACKET)
     {
-        aug_ast_delete(element);
         aug_log_input_error(lexer->input, "Index operator missing closing ]");
         return NULL;
     }
@@ -2252,13 +3297,13 @@ aug_ast* aug_parse_field(aug_lexer* lexer, aug_ast* container)
         return NULL;
     }
 
-    aug_ast* name = aug_ast_new(AUG_AST_VARIABLE, aug_ast_token_empty(lexer));
+    aug_ast* name = aug_ast_new(lexer->arena, AUG_AST_VARIABLE, aug_ast_token_empty(lexer));
 
     aug_lexer_move(lexer); // eat NAME
 
-    aug_ast* field = aug_ast_new(AUG_AST_FIELD, aug_ast_token_empty(lexer));
+    aug_ast* field = aug_ast_new(lexer->arena, AUG_AST_FIELD, aug_ast_token_empty(lexer));
 
-    aug_ast_resize(field, 2);
+    aug_ast_resize(lexer->arena, field, 2);
     field->children[0] = name;
     field->children[1] = container;
 
@@ -2282,7 +3327,7 @@ aug_ast* aug_parse_value(aug_lexer* lexer)
     case AUG_TOKEN_NONE:
     {
         aug_token token = aug_token_copy(aug_lexer_curr(lexer));
-        value = aug_ast_new(AUG_AST_LITERAL, token);
+        value = aug_ast_new(lexer->arena, AUG_AST_LITERAL, token);
 
         aug_lexer_move(lexer);
         break;
@@ -2291,7 +3336,7 @@ aug_ast* aug_parse_value(aug_lexer* lexer)
     {
         // consume token. return variable node
         aug_token token = aug_token_copy(aug_lexer_curr(lexer));
-        value = aug_ast_new(AUG_AST_VARIABLE, token);
+        value = aug_ast_new(lexer->arena, AUG_AST_VARIABLE, token);
 
         aug_lexer_move(lexer); // eat name
         break;
@@ -2317,7 +3362,6 @@ aug_ast* aug_parse_value(aug_lexer* lexer)
         else
         {
             aug_log_input_error(lexer->input, "Expression missing closing parentheses");
-            aug_ast_delete(value);
             value = NULL;
         }
         break;
@@ -2378,16 +3422,15 @@ aug_ast* aug_parse_stmt_expr(aug_lexer* lexer)
     if(expr == NULL)
         return NULL;
     
-    aug_ast* stmt_expr = aug_ast_new(AUG_AST_STMT_EXPR, aug_ast_token_empty(lexer));
-    aug_ast_add(stmt_expr, expr);
+    aug_ast* stmt_expr = aug_ast_new(lexer->arena, AUG_AST_STMT_EXPR, aug_ast_token_empty(lexer));
+    aug_ast_add(lexer->arena, stmt_expr, expr);
 
     // If expression is a non-assignment, discard from the stack
     if(expr->type != AUG_AST_BINARY_OP || !aug_token_is_assign_op(expr->token))
-        aug_ast_add(stmt_expr, aug_ast_new(AUG_AST_DISCARD, aug_ast_token_empty(lexer)));
+        aug_ast_add(lexer->arena, stmt_expr, aug_ast_new(lexer->arena, AUG_AST_DISCARD, aug_ast_token_empty(lexer)));
 
     if(!aug_parse_stmt_semicolon(lexer))
     {
-        aug_ast_delete(expr);
         aug_log_input_error(lexer->input,  "Missing semicolon at end of expression");
         return NULL;
     }
@@ -2414,7 +3457,7 @@ aug_ast* aug_parse_stmt_define_var(aug_lexer* lexer)
     {
         if(aug_parse_stmt_semicolon(lexer))
         {
-            aug_ast* stmt_define = aug_ast_new(AUG_AST_STMT_DEFINE_VAR, name_token);
+            aug_ast* stmt_define = aug_ast_new(lexer->arena, AUG_AST_STMT_DEFINE_VAR, name_token);
             return stmt_define;
         }
 
@@ -2435,13 +3478,12 @@ aug_ast* aug_parse_stmt_define_var(aug_lexer* lexer)
     if(!aug_parse_stmt_semicolon(lexer))
     {
         aug_token_reset(&name_token);
-        aug_ast_delete(expr);
         aug_log_input_error(lexer->input,  "Variable assignment missing semicolon at end of expression");
         return NULL;
     }
 
-    aug_ast* stmt_define = aug_ast_new(AUG_AST_STMT_DEFINE_VAR, name_token);
-    aug_ast_add(stmt_define, expr);
+    aug_ast* stmt_define = aug_ast_new(lexer->arena, AUG_AST_STMT_DEFINE_VAR, name_token);
+    aug_ast_add(lexer->arena, stmt_define, expr);
     return stmt_define;
 }
 
@@ -2451,8 +3493,8 @@ aug_ast* aug_parse_stmt_if_else(aug_lexer* lexer, aug_ast* expr, aug_ast* block)
 {
     aug_lexer_move(lexer); // eat ELSE
 
-    aug_ast* if_else_stmt = aug_ast_new(AUG_AST_STMT_IF_ELSE, aug_ast_token_empty(lexer));
-    aug_ast_resize(if_else_stmt, 3);
+    aug_ast* if_else_stmt = aug_ast_new(lexer->arena, AUG_AST_STMT_IF_ELSE, aug_ast_token_empty(lexer));
+    aug_ast_resize(lexer->arena, if_else_stmt, 3);
     if_else_stmt->children[0] = expr;
     if_else_stmt->children[1] = block;
 
@@ -2462,7 +3504,6 @@ aug_ast* aug_parse_stmt_if_else(aug_lexer* lexer, aug_ast* expr, aug_ast* block)
         aug_ast* trailing_if_stmt = aug_parse_stmt_if(lexer);
         if(trailing_if_stmt == NULL)
         {
-            aug_ast_delete(if_else_stmt);
             return NULL;
         }
         if_else_stmt->children[2] = trailing_if_stmt;
@@ -2472,7 +3513,6 @@ aug_ast* aug_parse_stmt_if_else(aug_lexer* lexer, aug_ast* expr, aug_ast* block)
         aug_ast* else_block = aug_parse_block(lexer);
         if(else_block == NULL)
         {
-            aug_ast_delete(if_else_stmt);
             aug_log_input_error(lexer->input,  "If Else statement missing block");
             return NULL;
         }
@@ -2499,7 +3539,6 @@ aug_ast* aug_parse_stmt_if(aug_lexer* lexer)
     aug_ast* block = aug_parse_block(lexer);
     if(block == NULL)
     {
-        aug_ast_delete(expr);
         aug_log_input_error(lexer->input,  "If statement missing block");
         return NULL;
     }
@@ -2508,8 +3547,8 @@ aug_ast* aug_parse_stmt_if(aug_lexer* lexer)
     if(aug_lexer_curr(lexer).id == AUG_TOKEN_ELSE)
         return aug_parse_stmt_if_else(lexer, expr, block);
 
-    aug_ast* if_stmt = aug_ast_new(AUG_AST_STMT_IF, aug_ast_token_empty(lexer));
-    aug_ast_resize(if_stmt, 2);
+    aug_ast* if_stmt = aug_ast_new(lexer->arena, AUG_AST_STMT_IF, aug_ast_token_empty(lexer));
+    aug_ast_resize(lexer->arena, if_stmt, 2);
     if_stmt->children[0] = expr;
     if_stmt->children[1] = block;
     return if_stmt;
@@ -2532,13 +3571,12 @@ aug_ast* aug_parse_stmt_while(aug_lexer* lexer)
     aug_ast* block = aug_parse_block(lexer);
     if(block == NULL)
     {
-        aug_ast_delete(expr);
         aug_log_input_error(lexer->input,  "While loop missing block");
         return NULL;
     }
 
-    aug_ast* while_stmt = aug_ast_new(AUG_AST_STMT_WHILE, aug_ast_token_empty(lexer));
-    aug_ast_resize(while_stmt, 2);
+    aug_ast* while_stmt = aug_ast_new(lexer->arena, AUG_AST_STMT_WHILE, aug_ast_token_empty(lexer));
+    aug_ast_resize(lexer->arena, while_stmt, 2);
     while_stmt->children[0] = expr;
     while_stmt->children[1] = block;
     return while_stmt;
@@ -2559,14 +3597,13 @@ aug_ast* aug_parse_for_range(aug_lexer* lexer)
     aug_ast* to_expr = aug_parse_expr(lexer);
     if(to_expr == NULL)
     {
-        aug_ast_delete(from_expr);
         aug_log_input_error(lexer->input, "Range missing from from value");
         return NULL;
     }
 
-    aug_ast* range = aug_ast_new(AUG_AST_RANGE, aug_ast_token_empty(lexer));
+    aug_ast* range = aug_ast_new(lexer->arena, AUG_AST_RANGE, aug_ast_token_empty(lexer));
 
-    aug_ast_resize(range, 2);
+    aug_ast_resize(lexer->arena, range, 2);
     range->children[0] = from_expr;
     range->children[1] = to_expr;
     return range;
@@ -2587,12 +3624,11 @@ aug_ast* aug_parse_stmt_for(aug_lexer* lexer)
 
     // consume token. return variable node
     aug_token token = aug_token_copy(aug_lexer_curr(lexer));
-    aug_ast* var = aug_ast_new(AUG_AST_VARIABLE, token);
+    aug_ast* var = aug_ast_new(lexer->arena, AUG_AST_VARIABLE, token);
     aug_lexer_move(lexer); // eat NAME
 
     if(aug_lexer_curr(lexer).id != AUG_TOKEN_IN)
     {
-        aug_ast_delete(var);
         aug_log_input_error(lexer->input,  "For loop expected in after variable name");
         return NULL;
     }
@@ -2601,7 +3637,6 @@ aug_ast* aug_parse_stmt_for(aug_lexer* lexer)
     aug_ast* expr = aug_parse_for_range(lexer);
     if(expr == NULL)
     {
-        aug_ast_delete(var);
         aug_log_input_error(lexer->input,  "For loop missing expression");
         return NULL;
     }
@@ -2609,14 +3644,12 @@ aug_ast* aug_parse_stmt_for(aug_lexer* lexer)
     aug_ast* block = aug_parse_block(lexer);
     if(block == NULL)
     {
-        aug_ast_delete(var);
-        aug_ast_delete(expr);
         aug_log_input_error(lexer->input,  "For loop missing block");
         return NULL;
     }
 
-    aug_ast* for_stmt = aug_ast_new(AUG_AST_STMT_FOR, aug_ast_token_empty(lexer));
-    aug_ast_resize(for_stmt, 3);
+    aug_ast* for_stmt = aug_ast_new(lexer->arena, AUG_AST_STMT_FOR, aug_ast_token_empty(lexer));
+    aug_ast_resize(lexer->arena, for_stmt, 3);
     for_stmt->children[0] = var;
     for_stmt->children[1] = expr;
     for_stmt->children[2] = block;
@@ -2633,11 +3666,11 @@ aug_ast* aug_parse_param_list(aug_lexer* lexer)
 
     aug_lexer_move(lexer); // eat LPAREN
 
-    aug_ast* param_list = aug_ast_new(AUG_AST_PARAM_LIST, aug_ast_token_empty(lexer));
+    aug_ast* param_list = aug_ast_new(lexer->arena, AUG_AST_PARAM_LIST, aug_ast_token_empty(lexer));
     if(aug_lexer_curr(lexer).id == AUG_TOKEN_NAME)
     {
-        aug_ast* param = aug_ast_new(AUG_AST_PARAM, aug_token_copy(aug_lexer_curr(lexer)));
-        aug_ast_add(param_list, param);
+        aug_ast* param = aug_ast_new(lexer->arena, AUG_AST_PARAM, aug_token_copy(aug_lexer_curr(lexer)));
+        aug_ast_add(lexer->arena, param_list, param);
 
         aug_lexer_move(lexer); // eat NAME
 
@@ -2648,12 +3681,11 @@ aug_ast* aug_parse_param_list(aug_lexer* lexer)
             if(aug_lexer_curr(lexer).id != AUG_TOKEN_NAME)
             {
                 aug_log_input_error(lexer->input,  "Invalid function parameter. Expected parameter name");
-                aug_ast_delete(param_list);
                 return NULL;
             }
 
-            param = aug_ast_new(AUG_AST_PARAM, aug_token_copy(aug_lexer_curr(lexer)));
-            aug_ast_add(param_list, param);
+            param = aug_ast_new(lexer->arena, AUG_AST_PARAM, aug_token_copy(aug_lexer_curr(lexer)));
+            aug_ast_add(lexer->arena, param_list, param);
 
             aug_lexer_move(lexer); // eat NAME
         }
@@ -2662,7 +3694,6 @@ aug_ast* aug_parse_param_list(aug_lexer* lexer)
     if(aug_lexer_curr(lexer).id != AUG_TOKEN_RPAREN)
     {
         aug_log_input_error(lexer->input,  "Missing closing parentheses in function parameter list");
-        aug_ast_delete(param_list);
         return NULL;
     }
 
@@ -2699,12 +3730,11 @@ aug_ast* aug_parse_stmt_func(aug_lexer* lexer)
     if(block == NULL)
     {
         aug_token_reset(&func_name_token);
-        aug_ast_delete(param_list);
         return NULL;
     }
 
-    aug_ast* func_def = aug_ast_new(AUG_AST_STMT_DEFINE_FUNC, func_name_token);
-    aug_ast_resize(func_def, 2);
+    aug_ast* func_def = aug_ast_new(lexer->arena, AUG_AST_STMT_DEFINE_FUNC, func_name_token);
+    aug_ast_resize(lexer->arena, func_def, 2);
     func_def->children[0] = param_list;
     func_def->children[1] = block;
     return func_def;
@@ -2717,7 +3747,7 @@ aug_ast* aug_parse_stmt_return(aug_lexer* lexer)
 
     aug_lexer_move(lexer); // eat RETURN
 
-    aug_ast* return_stmt = aug_ast_new(AUG_AST_RETURN, aug_ast_token_empty(lexer));
+    aug_ast* return_stmt = aug_ast_new(lexer->arena, AUG_AST_RETURN, aug_ast_token_empty(lexer));
 
 #if AUG_ALLOW_NO_SEMICOLON
     // Special condition for empty return and no semicolon. Prevent assignment operations from being the return expr. leave as none
@@ -2730,11 +3760,10 @@ aug_ast* aug_parse_stmt_return(aug_lexer* lexer)
 
     aug_ast* expr = aug_parse_expr(lexer);
     if(expr != NULL)
-        aug_ast_add(return_stmt, expr);
+        aug_ast_add(lexer->arena, return_stmt, expr);
 
     if(!aug_parse_stmt_semicolon(lexer))
     {
-        aug_ast_delete(return_stmt);
         aug_log_input_error(lexer->input,  "Missing semicolon at end of return statement");
         return NULL;
     }
@@ -2748,12 +3777,11 @@ aug_ast* aug_parse_stmt_break(aug_lexer* lexer)
         return NULL;
 
     // copy over token to allow error details
-    aug_ast* break_stmt = aug_ast_new(AUG_AST_BREAK, aug_token_copy(aug_lexer_curr(lexer)));
+    aug_ast* break_stmt = aug_ast_new(lexer->arena, AUG_AST_BREAK, aug_token_copy(aug_lexer_curr(lexer)));
     aug_lexer_move(lexer); // eat BREAK
 
     if(!aug_parse_stmt_semicolon(lexer))
     {
-        aug_ast_delete(break_stmt);
         aug_log_input_error(lexer->input,  "Missing semicolon at end of break statement");
         return NULL;
     }
@@ -2761,18 +3789,34 @@ aug_ast* aug_parse_stmt_break(aug_lexer* lexer)
     return break_stmt;
 }
 
+aug_ast* aug_parse_stmt_yield(aug_lexer* lexer)
+{
+    if(aug_lexer_curr(lexer).id != AUG_TOKEN_YIELD)
+        return NULL;
+
+    aug_ast* yield_stmt = aug_ast_new(lexer->arena, AUG_AST_YIELD, aug_token_copy(aug_lexer_curr(lexer)));
+    aug_lexer_move(lexer); // eat YIELD
+
+    if(!aug_parse_stmt_semicolon(lexer))
+    {
+        aug_log_input_error(lexer->input,  "Missing semicolon at end of yield statement");
+        return NULL;
+    }
+
+    return yield_stmt;
+}
+
 aug_ast* aug_parse_stmt_continue(aug_lexer* lexer)
 {
     if(aug_lexer_curr(lexer).id != AUG_TOKEN_CONTINUE)
         return NULL;
 
     // copy over token to allow error details
-    aug_ast* continue_stmt = aug_ast_new(AUG_AST_CONTINUE, aug_token_copy(aug_lexer_curr(lexer)));
+    aug_ast* continue_stmt = aug_ast_new(lexer->arena, AUG_AST_CONTINUE, aug_token_copy(aug_lexer_curr(lexer)));
     aug_lexer_move(lexer); // eat CONTINUE
 
     if(!aug_parse_stmt_semicolon(lexer))
     {
-        aug_ast_delete(continue_stmt);
         aug_log_input_error(lexer->input,  "Missing semicolon at end of continue statement");
         return NULL;
     }
@@ -2793,15 +3837,14 @@ aug_ast* aug_parse_stmt_import(aug_lexer* lexer)
     switch(token.id)
     {
         case AUG_TOKEN_STRING:
-            import_stmt = aug_ast_new(AUG_AST_IMPORT_SCRIPT, aug_token_copy(token));
+            import_stmt = aug_ast_new(lexer->arena, AUG_AST_IMPORT_SCRIPT, aug_token_copy(token));
             aug_lexer_move(lexer); // eat TOKEN 
             break;   
         case AUG_TOKEN_NAME:
-            import_stmt = aug_ast_new(AUG_AST_IMPORT_LIB, aug_token_copy(token));
+            import_stmt = aug_ast_new(lexer->arena, AUG_AST_IMPORT_LIB, aug_token_copy(token));
             aug_lexer_move(lexer); // eat TOKEN 
             break;
         default: 
-            aug_ast_delete(import_stmt);
             aug_log_input_error(lexer->input,  "Use statement expected library name or script path");
             break;
     }
@@ -2811,7 +3854,6 @@ aug_ast* aug_parse_stmt_import(aug_lexer* lexer)
 
     if(!aug_parse_stmt_semicolon(lexer))
     {
-        aug_ast_delete(import_stmt);
         aug_log_input_error(lexer->input,  "Missing semicolon at end of use statement");
         return NULL;
     }
@@ -2853,6 +3895,9 @@ aug_ast* aug_parse_stmt(aug_lexer* lexer, bool is_block)
     case AUG_TOKEN_CONTINUE:
         stmt = aug_parse_stmt_continue(lexer);
         break;
+    case AUG_TOKEN_YIELD:
+        stmt = aug_parse_stmt_yield(lexer);
+        break;
     case AUG_TOKEN_IMPORT:
         if(!is_block)
             stmt = aug_parse_stmt_import(lexer);
@@ -2875,9 +3920,9 @@ aug_ast* aug_parse_block(aug_lexer* lexer)
     if(aug_lexer_curr(lexer).id != AUG_TOKEN_LBRACE)
     {
 #if AUG_ALLOW_SINGLE_STMT_BLOCK
-        aug_ast* block = aug_ast_new(AUG_AST_BLOCK, aug_ast_token_empty(lexer));    
+        aug_ast* block = aug_ast_new(lexer->arena, AUG_AST_BLOCK, aug_ast_token_empty(lexer));    
         aug_ast* stmt = aug_parse_stmt(lexer, true);
-        aug_ast_add(block, stmt);
+        aug_ast_add(lexer->arena, block, stmt);
         return block;
 #else 
         // if no brace, parse single block
@@ -2887,18 +3932,17 @@ aug_ast* aug_parse_block(aug_lexer* lexer)
     }
     aug_lexer_move(lexer); // eat LBRACE
 
-    aug_ast* block = aug_ast_new(AUG_AST_BLOCK, aug_ast_token_empty(lexer));    
+    aug_ast* block = aug_ast_new(lexer->arena, AUG_AST_BLOCK, aug_ast_token_empty(lexer));    
     aug_ast* stmt = aug_parse_stmt(lexer, true);
     while(stmt)
     {
-        aug_ast_add(block, stmt);
+        aug_ast_add(lexer->arena, block, stmt);
         stmt = aug_parse_stmt(lexer, true);
     }   
 
     if(aug_lexer_curr(lexer).id != AUG_TOKEN_RBRACE)
     {
         aug_log_input_error(lexer->input,  "Block missing closing \"}\"");
-        aug_ast_delete(block);
         return NULL;
     }
     aug_lexer_move(lexer); // eat RBRACE
@@ -2913,17 +3957,16 @@ aug_ast* aug_parse_root(aug_lexer* lexer)
 
     aug_lexer_move(lexer); // move to first token
 
-    aug_ast* root = aug_ast_new(AUG_AST_ROOT, aug_ast_token_empty(lexer));
+    aug_ast* root = aug_ast_new(lexer->arena, AUG_AST_ROOT, aug_ast_token_empty(lexer));
     aug_ast* stmt = aug_parse_stmt(lexer, false);
     while(stmt)
     {
-        aug_ast_add(root, stmt);
+        aug_ast_add(lexer->arena, root, stmt);
         stmt = aug_parse_stmt(lexer, false);
     }   
 
     if(root->children_size == 0)
     {
-        aug_ast_delete(root);
         return NULL;
     }
     return root;
@@ -3007,7 +4050,71 @@ typedef uint8_t aug_opcode;
 	AUG_OPCODE(CALL_EXT)          \
 	AUG_OPCODE(ENTER_FUNC)        \
 	AUG_OPCODE(RETURN_FUNC)       \
-    AUG_OPCODE(IMPORT_LIB)        
+    AUG_OPCODE(IMPORT_LIB)        \
+	AUG_OPCODE(ADD_LOCAL_INT)     \
+	AUG_OPCODE(SUB_LOCAL_INT)     \
+	AUG_OPCODE(ADD_GLOBAL_INT)    \
+	AUG_OPCODE(SUB_GLOBAL_INT)    \
+	AUG_OPCODE(ADD_ASSIGN_LOCAL)  \
+	AUG_OPCODE(ADD_ASSIGN_GLOBAL) \
+	AUG_OPCODE(LT_JUMP_ZERO)      \
+	AUG_OPCODE(LTE_JUMP_ZERO)     \
+	AUG_OPCODE(GT_JUMP_ZERO)      \
+	AUG_OPCODE(GTE_JUMP_ZERO)     \
+	AUG_OPCODE(EQ_JUMP_ZERO)      \
+	AUG_OPCODE(NEQ_JUMP_ZERO)     \
+	AUG_OPCODE(RANGE_BEGIN)       \
+	AUG_OPCODE(RANGE_NEXT)        \
+	AUG_OPCODE(ADD_INT_INT)               \
+	AUG_OPCODE(ADD_FLOAT_FLOAT)           \
+	AUG_OPCODE(SUB_INT_INT)               \
+	AUG_OPCODE(SUB_FLOAT_FLOAT)           \
+	AUG_OPCODE(MUL_INT_INT)               \
+	AUG_OPCODE(MUL_FLOAT_FLOAT)           \
+	AUG_OPCODE(DIV_INT_INT)               \
+	AUG_OPCODE(DIV_FLOAT_FLOAT)           \
+	AUG_OPCODE(LT_INT_INT)                \
+	AUG_OPCODE(LT_FLOAT_FLOAT)            \
+	AUG_OPCODE(LTE_INT_INT)               \
+	AUG_OPCODE(LTE_FLOAT_FLOAT)           \
+	AUG_OPCODE(GT_INT_INT)                \
+	AUG_OPCODE(GT_FLOAT_FLOAT)            \
+	AUG_OPCODE(GTE_INT_INT)               \
+	AUG_OPCODE(GTE_FLOAT_FLOAT)           \
+	AUG_OPCODE(EQ_INT_INT)                \
+	AUG_OPCODE(EQ_FLOAT_FLOAT)            \
+	AUG_OPCODE(NEQ_INT_INT)               \
+	AUG_OPCODE(NEQ_FLOAT_FLOAT)           \
+	AUG_OPCODE(LT_JUMP_ZERO_INT_INT)      \
+	AUG_OPCODE(LT_JUMP_ZERO_FLOAT_FLOAT)  \
+	AUG_OPCODE(LTE_JUMP_ZERO_INT_INT)     \
+	AUG_OPCODE(LTE_JUMP_ZERO_FLOAT_FLOAT) \
+	AUG_OPCODE(GT_JUMP_ZERO_INT_INT)      \
+	AUG_OPCODE(GT_JUMP_ZERO_FLOAT_FLOAT)  \
+	AUG_OPCODE(GTE_JUMP_ZERO_INT_INT)     \
+	AUG_OPCODE(GTE_JUMP_ZERO_FLOAT_FLOAT) \
+	AUG_OPCODE(EQ_JUMP_ZERO_INT_INT)      \
+	AUG_OPCODE(EQ_JUMP_ZERO_FLOAT_FLOAT)  \
+	AUG_OPCODE(NEQ_JUMP_ZERO_INT_INT)     \
+	AUG_OPCODE(NEQ_JUMP_ZERO_FLOAT_FLOAT) \
+	AUG_OPCODE(MOVE_REG)                  \
+	AUG_OPCODE(ADD_REG)                   \
+	AUG_OPCODE(SUB_REG)                   \
+	AUG_OPCODE(MUL_REG)                   \
+	AUG_OPCODE(DIV_REG)                   \
+	AUG_OPCODE(LT_REG)                    \
+	AUG_OPCODE(LTE_REG)                   \
+	AUG_OPCODE(GT_REG)                    \
+	AUG_OPCODE(GTE_REG)                   \
+	AUG_OPCODE(EQ_REG)                    \
+	AUG_OPCODE(NEQ_REG)                   \
+	AUG_OPCODE(LT_JUMP_ZERO_REG)          \
+	AUG_OPCODE(LTE_JUMP_ZERO_REG)         \
+	AUG_OPCODE(GT_JUMP_ZERO_REG)          \
+	AUG_OPCODE(GTE_JUMP_ZERO_REG)         \
+	AUG_OPCODE(EQ_JUMP_ZERO_REG)          \
+	AUG_OPCODE(NEQ_JUMP_ZERO_REG)         \
+	AUG_OPCODE(YIELD)             
 
 enum aug_opcodes
 { 
@@ -3017,7 +4124,6 @@ enum aug_opcodes
     AUG_OPCODE_COUNT
 };
 
-#if AUG_DEBUG
 const char* aug_opcode_labels[] =
 {
 #define AUG_OPCODE(opcode) #opcode,
@@ -3027,17 +4133,35 @@ const char* aug_opcode_labels[] =
 
 const char* aug_opcode_label(uint8_t opcode)
 {
-    return aug_opcode_labels[(int)opcode];
+    return opcode < AUG_OPCODE_COUNT ? aug_opcode_labels[(int)opcode] : "INVALID";
 }
 
-#endif //AUG_DEBUG
-#undef AUG_OPCODE_LIST
-
 // Special value used in bytecode to denote an invalid vm offset
 #define AUG_OPCODE_INVALID -1
 // Values pushes onto stack to track function calls. (return address, calling base index)  
 #define AUG_CALL_FRAME_STACK_SIZE 2
 
+// Operands of the register instructions, see aug_ir_allocate_registers. A register is encoded in 16 bits, the kind in 
+// the low 2 bits and the stack offset or int constant in the remaining bits. The source registers of an instruction 
+// share an int operand, the left in the low half. Destinations are encoded the same as sources
+typedef enum aug_register_kind
+{
+    AUG_REGISTER_LOCAL = 0, // local variable or parameter, offset from the frame's base
+    AUG_REGISTER_GLOBAL,    // global variable
+    AUG_REGISTER_INT,       // int constant, only a source
+    AUG_REGISTER_STACK      // temporary on top of the stack. Sources are popped, destinations pushed
+} aug_register_kind;
+
+#define AUG_REGISTER_INDEX_MIN (-(1 << 13))
+#define AUG_REGISTER_INDEX_MAX ((1 << 13) - 1)
+
+#define AUG_REGISTER(kind, index) ((int)((unsigned)(index) << 2) | (int)(kind))
+#define AUG_REGISTER_KIND(reg)    ((aug_register_kind)((reg) & 3))
+#define AUG_REGISTER_INDEX(reg)   ((reg) >> 2)
+#define AUG_REGISTER_PAIR(lhs, rhs) ((int)(((unsigned)(lhs) & 0xFFFFu) | (((unsigned)(rhs) & 0xFFFFu) << 16)))
+#define AUG_REGISTER_LHS(pair)    ((int)(int16_t)((unsigned)(pair) & 0xFFFFu))
+#define AUG_REGISTER_RHS(pair)    ((int)(int16_t)((unsigned)(pair) >> 16))
+
 // Symbols ================================================= Symbols ============================================== Symbols //
 
 // Internally managed script symbol types used by IR symtable and the VM debug symbols
@@ -3117,6 +4241,7 @@ typedef struct aug_ir_operation
 {
     aug_opcode opcode;
     aug_ir_operand operand; //optional parameter. will be encoded in following bytes
+    aug_ir_operand operand_ext; //optional second parameter used by fused operations. will be encoded after the operand
     size_t bytecode_offset;
 } aug_ir_operation;
 
@@ -3139,6 +4264,7 @@ typedef struct aug_ir_frame
 typedef struct aug_ir_loop
 {
     int bytecode_begin;     // the beginning of the loop
+    int stack_offset;       // stack offset at the beginning, break and continue pop the locals above
     size_t end_jump_operation; // used to jump over block on end condition
     aug_container* break_operations; // size_t use to cache break operations for later fixup
 } aug_ir_loop;
@@ -3164,6 +4290,18 @@ typedef struct aug_ir
     // Debug table, index from bytecode addr
     aug_container* markers;
 
+    // Extension function names called from the unit, indexed by CALL_EXT slot
+    aug_container* extension_names; // type aug_string*
+
+    // String literals used in the unit, indexed by PUSH_STRING. Duplicate literals share an index
+    aug_container* constants;         // type aug_string*
+    aug_hashtable* constant_indices;  // literal -> int index into constants
+
+    // Filenames of the scripts imported by the unit. Used to check that a cached compile is up to date
+    aug_container* imports; // type aug_string*
+
+    int optimize_level; // constant expressions are folded while generating, if above 0. See AUG_OPTIMIZE_LEVEL
+    int backend;        // aug_backend, registers are allocated once generated. See AUG_BACKEND
 } aug_ir;
 
 static inline aug_ir* aug_ir_new()
@@ -3175,11 +4313,30 @@ static inline aug_ir* aug_ir_new()
     ir->loop_stack =  aug_container_new_type(aug_ir_loop, 1);
     ir->operations = aug_container_new_type(aug_ir_operation, 1);
     ir->markers = aug_container_new_type(aug_trace_marker, 1);
+    ir->extension_names = aug_container_new_type(aug_string*, 1);
+    ir->constants = aug_container_new_type(aug_string*, 1);
+    ir->constant_indices = aug_hashtable_new_type(int);
+    ir->imports = aug_container_new_type(aug_string*, 1);
+    ir->optimize_level = AUG_OPTIMIZE_LEVEL;
+    ir->backend = AUG_BACKEND;
     
     ir->globals = NULL; // initialized in ast to ir pass
     return ir;
 }
 
+static inline void aug_ir_operand_free(aug_ir_operand operand)
+{
+    // free any allocated operand data
+    switch (operand.type)
+    {
+    case AUG_IR_OPERAND_BYTES:
+        AUG_FREE(operand.data.str);
+        break;
+    default:
+        break;
+    }
+}
+
 static inline void aug_ir_delete(aug_ir* ir)
 {
     ir->globals = aug_hashtable_decref(ir->globals);
@@ -3196,20 +4353,34 @@ static inline void aug_ir_delete(aug_ir* ir)
         }
     }
     ir->markers = aug_container_decref(ir->markers);
+
+    if(ir->extension_names->ref_count == 1)
+    {
+        for(size_t i = 0; i < ir->extension_names->length; ++i)
+            aug_string_decref(aug_container_at_type(aug_string*, ir->extension_names, i));
+    }
+    ir->extension_names = aug_container_decref(ir->extension_names);
+
+    if(ir->constants->ref_count == 1)
+    {
+        for(size_t i = 0; i < ir->constants->length; ++i)
+            aug_string_decref(aug_container_at_type(aug_string*, ir->constants, i));
+    }
+    ir->constants = aug_container_decref(ir->constants);
+    ir->constant_indices = aug_hashtable_decref(ir->constant_indices);
+
+    if(ir->imports->ref_count == 1)
+    {
+        for(size_t i = 0; i < ir->imports->length; ++i)
+            aug_string_decref(aug_container_at_type(aug_string*, ir->imports, i));
+    }
+    ir->imports = aug_container_decref(ir->imports);
  
     for(size_t i = 0; i < ir->operations->length; ++i)
     {
         aug_ir_operation operation = aug_container_at_type(aug_ir_operation, ir->operations, i);
-        aug_ir_operand operand = operation.operand;
-        // free any allocated operand data
-        switch (operand.type)
-        {
-        case AUG_IR_OPERAND_BYTES:
-            AUG_FREE(operand.data.str);
-            break;
-        default:
-            break;
-        }
+        aug_ir_operand_free(operation.operand);
+        aug_ir_operand_free(operation.operand_ext);
     }
 
     ir->operations = aug_container_decref(ir->operations);
@@ -3243,15 +4414,17 @@ static inline size_t aug_ir_operation_size(aug_ir_operation operation)
 {
     size_t size = sizeof(aug_opcode);
     size += aug_ir_operand_size(operation.operand);
+    size += aug_ir_operand_size(operation.operand_ext);
     return size;
 }
 
-static inline size_t aug_ir_add_operation_arg(aug_ir* ir, aug_opcode opcode, aug_ir_operand operand)
+static inline size_t aug_ir_add_operation_args(aug_ir* ir, aug_opcode opcode, aug_ir_operand operand, aug_ir_operand operand_ext)
 {
     assert(ir->operations != NULL);
     aug_ir_operation operation;
     operation.opcode = opcode;
     operation.operand = operand;
+    operation.operand_ext = operand_ext;
     operation.bytecode_offset = ir->bytecode_offset;
 
     ir->bytecode_offset += aug_ir_operation_size(operation);
@@ -3259,6 +4432,13 @@ static inline size_t aug_ir_add_operation_arg(aug_ir* ir, aug_opcode opcode, aug
     return ir->operations->length-1;
 }
 
+static inline size_t aug_ir_add_operation_arg(aug_ir* ir, aug_opcode opcode, aug_ir_operand operand)
+{
+    aug_ir_operand operand_ext;
+    operand_ext.type = AUG_IR_OPERAND_NONE;
+    return aug_ir_add_operation_args(ir, opcode, operand, operand_ext);
+}
+
 static inline size_t aug_ir_add_operation(aug_ir* ir, aug_opcode opcode)
 {
     aug_ir_operand operand;
@@ -3463,6 +4643,7 @@ static inline void aug_ir_begin_loop(aug_ir* ir)
 {
     aug_ir_loop loop;
     loop.bytecode_begin = ir->bytecode_offset;
+    loop.stack_offset = aug_ir_current_scope(ir)->stack_offset;
     loop.end_jump_operation = 0;
     loop.break_operations = aug_container_new_type(size_t, 1);
     aug_container_push_type(aug_ir_loop, ir->loop_stack, loop);
@@ -3477,6 +4658,14 @@ static inline void aug_ir_check_loop(aug_ir* ir)
     loop->end_jump_operation = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP_ZERO, stub_operand);
 }
 
+// Pops the locals declared within the loop, before leaving the block with a break or continue
+static inline void aug_ir_exit_loop_scopes(aug_ir* ir, const aug_ir_loop* loop)
+{
+    const int delta = aug_ir_current_scope(ir)->stack_offset - loop->stack_offset;
+    if(delta > 0)
+        aug_ir_add_operation_arg(ir, AUG_OPCODE_POP, aug_ir_operand_from_int(delta));
+}
+
 static inline bool aug_ir_continue_loop(aug_ir* ir)
 {
     aug_container* loop_stack = ir->loop_stack;
@@ -3484,6 +4673,7 @@ static inline bool aug_ir_continue_loop(aug_ir* ir)
     if(loop == NULL)
         return false;
 
+    aug_ir_exit_loop_scopes(ir, loop);
     const aug_ir_operand begin_addr_operand = aug_ir_operand_from_int(loop->bytecode_begin);
     aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP, begin_addr_operand);
     return true;
@@ -3496,20 +4686,26 @@ static inline bool aug_ir_break_loop(aug_ir* ir)
     if(loop == NULL)
         return false;
 
+    aug_ir_exit_loop_scopes(ir, loop);
     const aug_ir_operand stub_operand = aug_ir_operand_from_int(0);
     size_t break_operation = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP, stub_operand);
     aug_container_push_type(size_t, loop->break_operations, break_operation);
     return true;
 }
 
-static inline void aug_ir_end_loop(aug_ir* ir)
+// Numeric range loops check the counter and bound slots beginning at counter_offset, then assign the variable slot
+static inline void aug_ir_check_range_loop(aug_ir* ir, int counter_offset)
 {
-    aug_ir_loop loop = aug_container_pop_type(aug_ir_loop, ir->loop_stack);
-    
-    // Close the loop, jump back to beginning
-    const aug_ir_operand begin_addr_operand = aug_ir_operand_from_int(loop.bytecode_begin);
-    aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP, begin_addr_operand);
+    aug_container* loop_stack = ir->loop_stack;
+    aug_ir_loop* loop = aug_container_ptr_type(aug_ir_loop, loop_stack, loop_stack->length-1);
 
+    const aug_ir_operand stub_operand = aug_ir_operand_from_int(0);
+    const aug_ir_operand counter_operand = aug_ir_operand_from_int(counter_offset);
+    loop->end_jump_operation = aug_ir_add_operation_args(ir, AUG_OPCODE_RANGE_BEGIN, stub_operand, counter_operand);
+}
+
+static inline void aug_ir_close_loop(aug_ir* ir, aug_ir_loop loop)
+{
     // Fixup stubbed block offsets
     const size_t end_block_addr = ir->bytecode_offset;
 
@@ -3527,6 +4723,29 @@ static inline void aug_ir_end_loop(aug_ir* ir)
     loop.break_operations = aug_container_decref(loop.break_operations);
 }
 
+static inline void aug_ir_end_loop(aug_ir* ir)
+{
+    aug_ir_loop loop = aug_container_pop_type(aug_ir_loop, ir->loop_stack);
+    
+    // Close the loop, jump back to beginning
+    const aug_ir_operand begin_addr_operand = aug_ir_operand_from_int(loop.bytecode_begin);
+    aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP, begin_addr_operand);
+
+    aug_ir_close_loop(ir, loop);
+}
+
+// Close the range loop, the counter is stepped and branches back to the block in a single operation
+static inline void aug_ir_end_range_loop(aug_ir* ir, int counter_offset, int block_begin)
+{
+    aug_ir_loop loop = aug_container_pop_type(aug_ir_loop, ir->loop_stack);
+
+    const aug_ir_operand block_addr_operand = aug_ir_operand_from_int(block_begin);
+    const aug_ir_operand counter_operand = aug_ir_operand_from_int(counter_offset);
+    aug_ir_add_operation_args(ir, AUG_OPCODE_RANGE_NEXT, block_addr_operand, counter_operand);
+
+    aug_ir_close_loop(ir, loop);
+}
+
 static inline void aug_ir_mark_symbol(aug_ir* ir, aug_symbol symbol)
 {
     aug_trace_marker marker;
@@ -3538,10 +4757,12 @@ static inline void aug_ir_mark_symbol(aug_ir* ir, aug_symbol symbol)
     aug_string_incref(marker.symbol_name);
 }
 
-static inline void aug_ir_mark_source(aug_ir* ir, aug_string* filename, aug_pos pos)
+static inline void aug_ir_mark_source(aug_ir* ir, aug_input* input, aug_pos pos)
 {
+    aug_string* filename = input->filename;
+
     aug_trace_marker marker;
-    marker.pos = pos;
+    marker.pos = aug_input_locate(input, pos);
     marker.symbol_name = NULL;
     marker.filename = filename;
     marker.bytecode_addr = ir->bytecode_offset;
@@ -3550,6 +4771,34 @@ static inline void aug_ir_mark_source(aug_ir* ir, aug_string* filename, aug_pos
     aug_string_incref(filename);
 }
 
+static inline int aug_ir_get_extension_slot(aug_ir* ir, const aug_string* func_name)
+{
+    // Extension names are few per unit, linear search is sufficient 
+    for(size_t i = 0; i < ir->extension_names->length; ++i)
+    {
+        if(aug_string_compare(aug_container_at_type(aug_string*, ir->extension_names, i), func_name))
+            return (int)i;
+    }
+
+    aug_container_push_type(aug_string*, ir->extension_names, aug_string_create(func_name->buffer));
+    return (int)ir->extension_names->length - 1;
+}
+
+static inline int aug_ir_get_constant_index(aug_ir* ir, const aug_string* str)
+{
+    int* index = aug_hashtable_ptr_type(int, ir->constant_indices, str->buffer);
+    if(index != NULL)
+        return *index;
+
+    aug_string* constant = aug_string_create(str->buffer);
+    constant->constant = true;
+
+    index = aug_hashtable_insert_type(int, ir->constant_indices, str->buffer);
+    *index = (int)ir->constants->length;
+    aug_container_push_type(aug_string*, ir->constants, constant);
+    return *index;
+}
+
 static inline bool aug_ir_set_var(aug_ir* ir, aug_string* var_name)
 {
     aug_ir_scope* scope = aug_ir_current_scope(ir);
@@ -3571,7 +4820,7 @@ static inline bool aug_ir_set_var(aug_ir* ir, aug_string* var_name)
         return false;
 
     *symbol_ptr = symbol;
-    aug_string_incref(symbol_ptr->name);
+    symbol_ptr->name = aug_string_create(symbol.name->buffer); // token data is owned by the compile arena
     return true;
 }
 
@@ -3596,8 +4845,7 @@ static inline bool aug_ir_set_param(aug_ir* ir, aug_string* param_name)
         return false;
 
     *symbol_ptr = symbol;
-
-    aug_string_incref(symbol_ptr->name);
+    symbol_ptr->name = aug_string_create(symbol.name->buffer); // token data is owned by the compile arena
     return true;
 }
 
@@ -3620,27 +4868,32 @@ static inline bool aug_ir_set_func(aug_ir* ir, aug_string* func_name, int param_
     aug_symbol* symbol_ptr = aug_hashtable_insert_type(aug_symbol, scope->symtable, symbol.name->buffer);
     if(symbol_ptr == NULL)
     {
-        if(update)
-            symbol_ptr = aug_hashtable_ptr_type(aug_symbol, scope->symtable, func_name->buffer);
-        else
+        if(!update)
             return false;
+        // Retain the existing name
+        symbol_ptr = aug_hashtable_ptr_type(aug_symbol, scope->symtable, func_name->buffer);
+        symbol.name = symbol_ptr->name;
+    }
+    else
+    {
+        symbol.name = aug_string_create(symbol.name->buffer); // token data is owned by the compile arena
     }
 
     *symbol_ptr = symbol;
-    if(!update)
-        aug_string_incref(symbol_ptr->name);
     return true;
 }
 
 static inline aug_symbol aug_ir_get_symbol(aug_ir* ir, aug_string* name)
 {
+    // Symbol tables use the default hash. Hash once for the lookup across all frame scopes
+    const size_t hash = aug_hashtable_hash_default(name->buffer);
     for(int i = ir->frame_stack->length - 1; i >= 0; --i)
     {
         aug_ir_frame frame = aug_container_at_type(aug_ir_frame, ir->frame_stack, i);
         for(int j = frame.scope_stack->length - 1; j >= 0; --j)
         {
             aug_ir_scope scope = aug_container_at_type(aug_ir_scope, frame.scope_stack, j);
-            aug_symbol* symbol_ptr = aug_hashtable_ptr_type(aug_symbol, scope.symtable, name->buffer);
+            aug_symbol* symbol_ptr = aug_hashtable_ptr_hashed_type(aug_symbol, scope.symtable, name->buffer, name->length, hash);
             if (symbol_ptr != NULL && symbol_ptr->type != AUG_SYM_NONE)
                 return *symbol_ptr;
         }
@@ -3653,13 +4906,15 @@ static inline aug_symbol aug_ir_get_symbol(aug_ir* ir, aug_string* name)
 
 static inline aug_symbol aug_ir_get_symbol_relative(aug_ir* ir, aug_string* name)
 {
+    // Symbol tables use the default hash. Hash once for the lookup across all frame scopes
+    const size_t hash = aug_hashtable_hash_default(name->buffer);
     for(int i = ir->frame_stack->length - 1; i >= 0; --i)
     {
         aug_ir_frame frame = aug_container_at_type(aug_ir_frame, ir->frame_stack, i);
         for(int j = frame.scope_stack->length - 1; j >= 0; --j)
         {
             aug_ir_scope scope = aug_container_at_type(aug_ir_scope, frame.scope_stack, j);
-            aug_symbol* symbol_ptr = aug_hashtable_ptr_type(aug_symbol, scope.symtable, name->buffer);
+            aug_symbol* symbol_ptr = aug_hashtable_ptr_hashed_type(aug_symbol, scope.symtable, name->buffer, name->length, hash);
             if (symbol_ptr != NULL && symbol_ptr->type != AUG_SYM_NONE)
             {
                 aug_symbol symbol = *symbol_ptr;
@@ -3704,12 +4959,50 @@ static inline aug_symbol aug_ir_get_symbol_local(aug_ir* ir, aug_string* name)
 
 // VALUE ===============================================   VALUE   ============================================= VALUE // 
 
+// Value initializers. These write the type and payload for either value layout, see AUG_COMPACT_VALUE
+#if AUG_COMPACT_VALUE
+#define aug_value_init(value, type, payload) \
+    ((value)->bits = ((uint64_t)(type) << AUG_VALUE_TYPE_SHIFT) | ((uint64_t)(payload) & AUG_VALUE_PAYLOAD_MASK))
+
+#define aug_value_init_type(value, type)   aug_value_init(value, type, 0)
+#define aug_value_init_bool(value, data)   aug_value_init(value, AUG_BOOL, (data) ? 1 : 0)
+#define aug_value_init_char(value, data)   aug_value_init(value, AUG_CHAR, (unsigned char)(data))
+#define aug_value_init_int(value, type, data) aug_value_init(value, type, (uint32_t)(data))
+
+static inline void aug_value_init_float(aug_value* value, float data)
+{
+    union { float f; uint32_t u; } pun;
+    pun.f = data;
+    aug_value_init(value, AUG_FLOAT, pun.u);
+}
+
+static inline void aug_value_init_pointer(aug_value* value, aug_type type, void* data)
+{
+    assert(((uint64_t)(uintptr_t)data & ~AUG_VALUE_PAYLOAD_MASK) == 0);
+    aug_value_init(value, type, (uintptr_t)data);
+}
+
+// Replaces the pointer payload, keeping the type
+static inline void aug_value_set_pointer(aug_value* value, void* data)
+{
+    assert(((uint64_t)(uintptr_t)data & ~AUG_VALUE_PAYLOAD_MASK) == 0);
+    value->bits = (value->bits & ~AUG_VALUE_PAYLOAD_MASK) | (uint64_t)(uintptr_t)data;
+}
+#else
+#define aug_value_init_type(value, type_)          ((value)->type = (type_))
+#define aug_value_init_bool(value, data)           ((value)->type = AUG_BOOL, (value)->b = (data))
+#define aug_value_init_char(value, data)           ((value)->type = AUG_CHAR, (value)->c = (data))
+#define aug_value_init_int(value, type_, data)     ((value)->type = (type_), (value)->i = (data))
+#define aug_value_init_float(value, data)          ((value)->type = AUG_FLOAT, (value)->f = (data))
+#define aug_value_init_pointer(value, type_, data) ((value)->type = (type_), (value)->userdata = (data))
+#define aug_value_set_pointer(value, data)         ((value)->userdata = (data))
+#endif//AUG_COMPACT_VALUE
+
 static inline bool aug_set_bool(aug_value* value, bool data)
 {
     if(value == NULL)
         return false;
-    value->type = AUG_BOOL;
-    value->b = data;
+    aug_value_init_bool(value, data);
     return true;
 }
 
@@ -3717,8 +5010,7 @@ static inline bool aug_set_int(aug_value* value, int data)
 {
     if(value == NULL)
         return false;
-    value->type = AUG_INT;
-    value->i = data;
+    aug_value_init_int(value, AUG_INT, data);
     return true;
 }
 
@@ -3726,8 +5018,7 @@ static inline bool aug_set_char(aug_value* value, char data)
 {
     if(value == NULL)
         return false;
-    value->type = AUG_CHAR;
-    value->c = data;
+    aug_value_init_char(value, data);
     return true;
 }
 
@@ -3735,8 +5026,7 @@ static inline bool aug_set_float(aug_value* value, float data)
 {
     if(value == NULL)
         return false;
-    value->type = AUG_FLOAT;
-    value->f = data;
+    aug_value_init_float(value, data);
     return true;
 }
 
@@ -3745,8 +5035,7 @@ static inline bool aug_set_string(aug_value* value, const char* data)
     if(value == NULL)
         return false;
 
-    value->type = AUG_STRING;
-    value->str = aug_string_create(data);
+    aug_value_init_pointer(value, AUG_STRING, aug_string_create(data));
     return true;
 }
 
@@ -3755,8 +5044,7 @@ static inline bool aug_set_array(aug_value* value)
     if(value == NULL)
         return false;
 
-    value->type = AUG_ARRAY;
-    value->array = aug_array_new(1);
+    aug_value_init_pointer(value, AUG_ARRAY, aug_array_new(1));
     return true;
 }
 
@@ -3765,8 +5053,7 @@ static inline bool aug_set_map(aug_value* value)
     if(value == NULL)
         return false;
 
-    value->type = AUG_MAP;
-    value->map = aug_map_new(1);
+    aug_value_init_pointer(value, AUG_MAP, aug_map_new(1));
     return true;
 }
 
@@ -3774,8 +5061,7 @@ static inline bool aug_set_func(aug_value* value, int data)
 {
     if(value == NULL)
         return false;
-    value->type = AUG_FUNCTION;
-    value->i = data;
+    aug_value_init_int(value, AUG_FUNCTION, data);
     return true;
 }
 
@@ -3784,9 +5070,8 @@ static inline bool aug_set_iterator(aug_value* value, aug_value* iterable)
     if(value == NULL)
         return false;
 
-    value->type = AUG_ITERATOR;
-    value->it = aug_iterator_new(iterable);
-    return value->it != NULL;
+    aug_value_init_pointer(value, AUG_ITERATOR, aug_iterator_new(iterable));
+    return aug_value_iterator(value) != NULL;
 }
 
 static inline bool aug_set_range(aug_value* value, aug_value* from, aug_value* to)
@@ -3794,27 +5079,26 @@ static inline bool aug_set_range(aug_value* value, aug_value* from, aug_value* t
     if(value == NULL)
         return false;
 
-    if(to == NULL || to->type != AUG_INT || from == NULL || from->type != AUG_INT)
+    if(to == NULL || aug_value_type(to) != AUG_INT || from == NULL || aug_value_type(from) != AUG_INT)
         return false;
 
 
-    value->type = AUG_RANGE;
-    value->range = aug_range_new(from->i, to->i);
-    return value->range != NULL;
+    aug_value_init_pointer(value, AUG_RANGE, aug_range_new(aug_value_int(from), aug_value_int(to)));
+    return aug_value_range(value) != NULL;
 }
 
 static inline bool aug_iterate(aug_value* value, aug_value* out_element)
 {
-    if(value == NULL || value->type != AUG_ITERATOR)
+    if(value == NULL || aug_value_type(value) != AUG_ITERATOR)
         return false;
-    aug_iterator_next(value->it);
-    return aug_iterator_get(value->it, out_element);
+    aug_iterator_next(aug_value_iterator(value));
+    return aug_iterator_get(aug_value_iterator(value), out_element);
 }
 
 aug_value aug_none()
 {
     aug_value value;
-    value.type = AUG_NONE;
+    aug_value_init_type(&value, AUG_NONE);
     return value;
 }
 
@@ -3832,39 +5116,60 @@ aug_value aug_create_map()
     return value;
 }
 
+aug_value aug_create_typed_array(aug_type element_type, size_t length)
+{
+    aug_value value;
+    aug_typed_array* typed = aug_typed_array_new(element_type, length);
+    aug_value_init_pointer(&value, typed != NULL ? AUG_TYPED_ARRAY : AUG_NONE, typed);
+    return value;
+}
+
+aug_value aug_create_buffer_view(void* data, aug_view_type element_type, size_t length, size_t stride, 
+    aug_view_release_func* release, void* user)
+{
+    aug_value value;
+    aug_buffer_view* view = aug_buffer_view_new(data, element_type, length, stride, release, user);
+    aug_value_init_pointer(&value, view != NULL ? AUG_BUFFER_VIEW : AUG_NONE, view);
+    return value;
+}
+
 bool aug_to_bool(const aug_value* value)
 {
     if(value == NULL)
         return false;
 
-    switch (value->type)
+    switch (aug_value_type(value))
     {
     case AUG_NONE:
         return false;    
     case AUG_BOOL:
-        return value->b;
+        return aug_value_bool(value);
     case AUG_INT:
-        return value->i != 0;
+        return aug_value_int(value) != 0;
     case AUG_CHAR:
-        return value->c != 0;
+        return aug_value_char(value) != 0;
     case AUG_FLOAT:
-        return value->f != 0.0f;
+        return aug_value_float(value) != 0.0f;
     case AUG_STRING:
-        return value->str != NULL;
+        return aug_value_string(value) != NULL;
     case AUG_ARRAY:
-        return value->array != NULL;
+        return aug_value_array(value) != NULL;
     case AUG_MAP:
-        return value->map != NULL;
+        return aug_value_map(value) != NULL;
     case AUG_OBJECT:
-        return value->obj != NULL;
+        return aug_value_object(value) != NULL;
     case AUG_FUNCTION:
-        return value->i != 0;
+        return aug_value_int(value) != 0;
     case AUG_ITERATOR:
-        return value->it != NULL && value->it->index != NULL;
+        return aug_value_iterator(value) != NULL && aug_value_iterator(value)->index != NULL;
     case AUG_RANGE:
-        return value->range != NULL;
+        return aug_value_range(value) != NULL;
     case AUG_USERDATA:
-        return value->userdata != NULL; 
+        return aug_value_userdata(value) != NULL; 
+    case AUG_TYPED_ARRAY:
+        return aug_value_typed_array(value) != NULL;
+    case AUG_BUFFER_VIEW:
+        return aug_value_buffer_view(value) != NULL;
     }
     return false;
 }
@@ -3874,16 +5179,16 @@ int aug_to_int(const aug_value* value)
     if(value == NULL)
         return 0;
 
-    switch (value->type)
+    switch (aug_value_type(value))
     {
     case AUG_BOOL:
-        return value->b ? 1 : 0;
+        return aug_value_bool(value) ? 1 : 0;
     case AUG_INT:
-        return value->i;
+        return aug_value_int(value);
     case AUG_CHAR:
-        return (int)value->c;
+        return (int)aug_value_char(value);
     case AUG_FLOAT:
-        return (int)value->f;
+        return (int)aug_value_float(value);
     default:
         return 0;
     }
@@ -3895,16 +5200,16 @@ float aug_to_float(const aug_value* value)
     if(value == NULL)
     	return 0.0f;
 
-    switch (value->type)
+    switch (aug_value_type(value))
     { 
     case AUG_BOOL:
-        return value->b ? 1.0f : 0.0f;
+        return aug_value_bool(value) ? 1.0f : 0.0f;
     case AUG_INT:
-        return (float)value->i;
+        return (float)aug_value_int(value);
     case AUG_CHAR:
-        return (float)value->c;
+        return (float)aug_value_char(value);
     case AUG_FLOAT:
-        return value->f;
+        return aug_value_float(value);
     default:
         return 0.0f;
     }
@@ -3913,27 +5218,27 @@ float aug_to_float(const aug_value* value)
 
 bool aug_compare(aug_value* a, aug_value* b)
 {
-    if(a->type != b->type)
+    if(aug_value_type(a) != aug_value_type(b))
         return false;
     
-    switch (a->type)
+    switch (aug_value_type(a))
     {
     case AUG_NONE:
         return true;
     case AUG_FUNCTION:
-        return a->i == b->i;
+        return aug_value_int(a) == aug_value_int(b);
     case AUG_BOOL:
-        return a->b == b->b;
+        return aug_value_bool(a) == aug_value_bool(b);
     case AUG_INT:
-        return a->i == b->i;
+        return aug_value_int(a) == aug_value_int(b);
     case AUG_CHAR:
-        return a->c == b->c;
+        return aug_value_char(a) == aug_value_char(b);
     case AUG_FLOAT:
-        return (float)fabs(a->f - b->f) < AUG_APPROX_THRESHOLD;
+        return (float)fabs(aug_value_float(a) - aug_value_float(b)) < AUG_APPROX_THRESHOLD;
     case AUG_STRING:
-        return aug_string_compare(a->str, b->str);
+        return aug_string_compare(aug_value_string(a), aug_value_string(b));
     case AUG_ARRAY:
-        return aug_array_compare(a->array, b->array);
+        return aug_array_compare(aug_value_array(a), aug_value_array(b));
     case AUG_RANGE:
         return false; //should not be user accesible to compare
     case AUG_MAP:
@@ -3945,7 +5250,11 @@ bool aug_compare(aug_value* a, aug_value* b)
     case AUG_ITERATOR:
         return false; //should not be user accesible to compare
     case AUG_USERDATA:
-        return a->userdata == b->userdata;
+        return aug_value_userdata(a) == aug_value_userdata(b);
+    case AUG_TYPED_ARRAY:
+        return aug_typed_array_compare(aug_value_typed_array(a), aug_value_typed_array(b));
+    case AUG_BUFFER_VIEW:
+        return aug_buffer_view_compare(aug_value_buffer_view(a), aug_value_buffer_view(b));
     }
     return false;
 }
@@ -3953,7 +5262,7 @@ bool aug_compare(aug_value* a, aug_value* b)
 const char* aug_type_label(const aug_value* value)
 {
     if (value == NULL) return "null";
-    switch (value->type)
+    switch (aug_value_type(value))
     {
     case AUG_NONE:      return "none";
     case AUG_BOOL:      return "bool";
@@ -3968,6 +5277,8 @@ const char* aug_type_label(const aug_value* value)
     case AUG_RANGE:     return "range";
     case AUG_ITERATOR:  return "iterator";
     case AUG_USERDATA:  return "custom";
+    case AUG_TYPED_ARRAY: return "typed_array";
+    case AUG_BUFFER_VIEW: return "buffer_view";
     }
     return NULL;
 }
@@ -3977,26 +5288,32 @@ void aug_decref(aug_value* value)
     if(value == NULL)
         return;
 
-    switch (value->type)
+    switch (aug_value_type(value))
     {
     case AUG_STRING:
-        value->str = aug_string_decref(value->str);
+        aug_value_set_pointer(value, aug_string_decref(aug_value_string(value)));
         break;
     case AUG_ARRAY:
-        value->array = aug_array_decref(value->array);
+        aug_value_set_pointer(value, aug_array_decref(aug_value_array(value)));
         break;
     case AUG_MAP:
-        value->map = aug_map_decref(value->map);
+        aug_value_set_pointer(value, aug_map_decref(aug_value_map(value)));
         break;
     case AUG_ITERATOR:
-        value->it = aug_iterator_decref(value->it);
+        aug_value_set_pointer(value, aug_iterator_decref(aug_value_iterator(value)));
         break;
     case AUG_RANGE:
-        value->range = aug_range_decref(value->range);
+        aug_value_set_pointer(value, aug_range_decref(aug_value_range(value)));
+        break;
+    case AUG_TYPED_ARRAY:
+        aug_value_set_pointer(value, aug_typed_array_decref(aug_value_typed_array(value)));
+        break;
+    case AUG_BUFFER_VIEW:
+        aug_value_set_pointer(value, aug_buffer_view_decref(aug_value_buffer_view(value)));
         break;
     case AUG_OBJECT:
-        if(value->obj && --value->obj->ref_count <= 0)
-            AUG_FREE(value->obj);
+        if(aug_value_object(value) && --aug_value_object(value)->ref_count <= 0)
+            AUG_FREE(aug_value_object(value));
         break;
     default:
         break;
@@ -4010,26 +5327,32 @@ void aug_incref(aug_value* value)
     if(value == NULL)
         return;
 
-    switch (value->type)
+    switch (aug_value_type(value))
     {
     case AUG_STRING:
-        aug_string_incref(value->str);
+        aug_string_incref(aug_value_string(value));
         break;
     case AUG_ARRAY:
-        aug_array_incref(value->array);
+        aug_array_incref(aug_value_array(value));
         break;
     case AUG_MAP:
-        aug_map_incref(value->map);
+        aug_map_incref(aug_value_map(value));
         break;
     case AUG_ITERATOR:
-        aug_iterator_incref(value->it);
+        aug_iterator_incref(aug_value_iterator(value));
         break;
     case AUG_RANGE:
-        aug_range_incref(value->range);
+        aug_range_incref(aug_value_range(value));
+        break;
+    case AUG_TYPED_ARRAY:
+        aug_typed_array_incref(aug_value_typed_array(value));
+        break;
+    case AUG_BUFFER_VIEW:
+        aug_buffer_view_incref(aug_value_buffer_view(value));
         break;
     case AUG_OBJECT:
-        assert(value->obj);
-        ++value->obj->ref_count;
+        assert(aug_value_object(value));
+        ++aug_value_object(value)->ref_count;
         break;
     default:
         break;
@@ -4064,12 +5387,12 @@ static inline bool aug_get_element(aug_value* value, aug_value* index, aug_value
     if(value == NULL || index == NULL)
         return false;
 
-    switch (value->type)
+    switch (aug_value_type(value))
     {
     case AUG_STRING:
     {
         size_t i = (size_t)aug_to_int(index);
-        char c = aug_string_at(value->str, i);
+        char c = aug_string_at(aug_value_string(value), i);
         if(c == -1)
             return false;
         *element_out = aug_create_char(c);
@@ -4078,7 +5401,7 @@ static inline bool aug_get_element(aug_value* value, aug_value* index, aug_value
     case AUG_ARRAY:
     {
         size_t i = (size_t)aug_to_int(index);
-        aug_value* element = aug_array_at(value->array, i);
+        aug_value* element = aug_array_at(aug_value_array(value), i);
         if(element == NULL)
             return false;
         *element_out = *element;
@@ -4086,7 +5409,7 @@ static inline bool aug_get_element(aug_value* value, aug_value* index, aug_value
     }
     case AUG_MAP:
     {
-        aug_value* element = aug_map_get(value->map, index);
+        aug_value* element = aug_map_get(aug_value_map(value), index);
         if(element == NULL)
             return true; // Allow maps to return non if index is invalid
 
@@ -4095,16 +5418,20 @@ static inline bool aug_get_element(aug_value* value, aug_value* index, aug_value
     }
     case AUG_RANGE:
     {
-        if(index->type != AUG_INT)
+        if(aug_value_type(index) != AUG_INT)
             return false;
 
         int i = (size_t)aug_to_int(index);
-        if(i < value->range->from || i >= value->range->to)
+        if(i < aug_value_range(value)->from || i >= aug_value_range(value)->to)
             return false;
 
         *element_out = aug_create_int(i);
         return true;
     }
+    case AUG_TYPED_ARRAY:
+        return aug_typed_array_get(aug_value_typed_array(value), (size_t)aug_to_int(index), element_out);
+    case AUG_BUFFER_VIEW:
+        return aug_buffer_view_get(aug_value_buffer_view(value), (size_t)aug_to_int(index), element_out);
     default:
         break;
     }
@@ -4116,24 +5443,28 @@ static inline bool aug_set_element(aug_value* value, aug_value* index, aug_value
     if(value == NULL || index == NULL || element == NULL)
         return false;
 
-    switch (value->type)
+    switch (aug_value_type(value))
     {
     case AUG_STRING:
     {
         size_t i = (size_t)aug_to_int(index);
-        if(element->type == AUG_CHAR)
-            return aug_string_set(value->str, i, element->c);
+        if(aug_value_type(element) == AUG_CHAR)
+            return aug_string_set(aug_value_string(value), i, aug_value_char(element));
         return false;
     }
     case AUG_ARRAY:
     {
         size_t i = (size_t)aug_to_int(index);
-        return aug_array_set(value->array, i, element);
+        return aug_array_set(aug_value_array(value), i, element);
     }
     case AUG_MAP:
     {
-        return aug_map_insert_or_update(value->map, index, element);
+        return aug_map_insert_or_update(aug_value_map(value), index, element);
     }
+    case AUG_TYPED_ARRAY:
+        return aug_typed_array_set(aug_value_typed_array(value), (size_t)aug_to_int(index), element);
+    case AUG_BUFFER_VIEW:
+        return aug_buffer_view_set(aug_value_buffer_view(value), (size_t)aug_to_int(index), element);
     default:
         break;
     }
@@ -4153,10 +5484,10 @@ static inline bool aug_set_element(aug_value* value, aug_value* index, aug_value
 {                                                               \
     if(result == NULL || lhs == NULL || rhs == NULL )           \
         return false;                                           \
-    switch(lhs->type)                                           \
+    switch(aug_value_type(lhs))                                 \
     {                                                           \
         case AUG_INT:                                           \
-            switch(rhs->type)                                   \
+            switch(aug_value_type(rhs))                         \
             {                                                   \
                 case AUG_INT:   int_int_case;                   \
                 case AUG_FLOAT: int_float_case;                 \
@@ -4164,7 +5495,7 @@ static inline bool aug_set_element(aug_value* value, aug_value* index, aug_value
             }                                                   \
             break;                                              \
         case AUG_FLOAT:                                         \
-           switch(rhs->type)                                    \
+           switch(aug_value_type(rhs))                          \
             {                                                   \
                 case AUG_INT:   float_int_case;                 \
                 case AUG_FLOAT: float_float_case;               \
@@ -4172,14 +5503,14 @@ static inline bool aug_set_element(aug_value* value, aug_value* index, aug_value
             }                                                   \
             break;                                              \
         case AUG_CHAR:                                          \
-            switch (rhs->type)                                  \
+            switch (aug_value_type(rhs))                        \
             {                                                   \
                 case AUG_CHAR: char_char_case;                  \
                 default: break;                                 \
             }                                                   \
             break;                                              \
         case AUG_BOOL:                                          \
-            switch (rhs->type)                                  \
+            switch (aug_value_type(rhs))                        \
             {                                                   \
                 case AUG_BOOL: bool_bool_case;                  \
                 default: break;                                 \
@@ -4189,27 +5520,91 @@ static inline bool aug_set_element(aug_value* value, aug_value* index, aug_value
     }                                                           \
 }
 
+// Concatenates a string with a string or char, or an array with an array. The left operand is appended to in place if
+// it is the only reference, and is returned as the result. Otherwise the result is a new container
+static inline bool aug_concat(aug_value* result, aug_value* lhs, aug_value* rhs)
+{
+    switch(aug_value_type(lhs))
+    {
+    case AUG_STRING:
+    {
+        aug_string* string = aug_value_string(lhs);
+        char c;
+        const char* bytes;
+        size_t length;
+        switch(aug_value_type(rhs))
+        {
+        case AUG_STRING:
+            bytes = aug_value_string(rhs)->buffer;
+            length = aug_value_string(rhs)->length;
+            break;
+        case AUG_CHAR:
+            c = aug_value_char(rhs);
+            bytes = &c;
+            length = 1;
+            break;
+        default:
+            return false;
+        }
+
+        if(string->ref_count == 1 && !string->constant)
+        {
+            aug_string_append_bytes(string, bytes, (int)length);
+            *result = *lhs;
+            aug_incref(result);
+            return true;
+        }
+        aug_string* concat = aug_string_new(string->length + length + 1);
+        aug_string_append_bytes(concat, string->buffer, (int)string->length);
+        aug_string_append_bytes(concat, bytes, (int)length);
+        aug_value_init_pointer(result, AUG_STRING, concat);
+        return true;
+    }
+    case AUG_ARRAY:
+    {
+        if(aug_value_type(rhs) != AUG_ARRAY)
+            return false;
+
+        aug_array* array = aug_value_array(lhs);
+        if(array->ref_count == 1)
+        {
+            aug_array_concat(array, aug_value_array(rhs));
+            *result = *lhs;
+            aug_incref(result);
+            return true;
+        }
+        aug_array* concat = aug_array_new(array->length + aug_value_array(rhs)->length + 1);
+        aug_array_concat(concat, array);
+        aug_array_concat(concat, aug_value_array(rhs));
+        aug_value_init_pointer(result, AUG_ARRAY, concat);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
 static inline bool aug_add(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_int(result, lhs->i + rhs->i),
-        return aug_set_float(result, lhs->i + rhs->f),
-        return aug_set_float(result, lhs->f + rhs->i),
-        return aug_set_float(result, lhs->f + rhs->f),
-        return aug_set_char(result, lhs->c + rhs->c),
+        return aug_set_int(result, aug_value_int(lhs) + aug_value_int(rhs)),
+        return aug_set_float(result, aug_value_int(lhs) + aug_value_float(rhs)),
+        return aug_set_float(result, aug_value_float(lhs) + aug_value_int(rhs)),
+        return aug_set_float(result, aug_value_float(lhs) + aug_value_float(rhs)),
+        return aug_set_char(result, aug_value_char(lhs) + aug_value_char(rhs)),
         return false
     );
-    return false;
+    return aug_concat(result, lhs, rhs);
 }
 
 static inline bool aug_sub(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_int(result, lhs->i - rhs->i),
-        return aug_set_float(result, lhs->i - rhs->f),
-        return aug_set_float(result, lhs->f - rhs->i),
-        return aug_set_float(result, lhs->f - rhs->f),
-        return aug_set_char(result, lhs->c - rhs->c),
+        return aug_set_int(result, aug_value_int(lhs) - aug_value_int(rhs)),
+        return aug_set_float(result, aug_value_int(lhs) - aug_value_float(rhs)),
+        return aug_set_float(result, aug_value_float(lhs) - aug_value_int(rhs)),
+        return aug_set_float(result, aug_value_float(lhs) - aug_value_float(rhs)),
+        return aug_set_char(result, aug_value_char(lhs) - aug_value_char(rhs)),
         return false
     );
     return false;
@@ -4218,11 +5613,11 @@ static inline bool aug_sub(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_mul(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_int(result, lhs->i * rhs->i),
-        return aug_set_float(result, lhs->i * rhs->f),
-        return aug_set_float(result, lhs->f * rhs->i),
-        return aug_set_float(result, lhs->f * rhs->f),
-        return aug_set_char(result, lhs->c * rhs->c),
+        return aug_set_int(result, aug_value_int(lhs) * aug_value_int(rhs)),
+        return aug_set_float(result, aug_value_int(lhs) * aug_value_float(rhs)),
+        return aug_set_float(result, aug_value_float(lhs) * aug_value_int(rhs)),
+        return aug_set_float(result, aug_value_float(lhs) * aug_value_float(rhs)),
+        return aug_set_char(result, aug_value_char(lhs) * aug_value_char(rhs)),
         return false
     );
     return false;
@@ -4231,11 +5626,11 @@ static inline bool aug_mul(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_div(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_float(result, (float)lhs->i / rhs->i),
-        return aug_set_float(result, lhs->i / rhs->f),
-        return aug_set_float(result, lhs->f / rhs->i),
-        return aug_set_float(result, lhs->f / rhs->f),
-        return aug_set_char(result, lhs->c / rhs->c),
+        return aug_set_float(result, (float)aug_value_int(lhs) / aug_value_int(rhs)),
+        return aug_set_float(result, aug_value_int(lhs) / aug_value_float(rhs)),
+        return aug_set_float(result, aug_value_float(lhs) / aug_value_int(rhs)),
+        return aug_set_float(result, aug_value_float(lhs) / aug_value_float(rhs)),
+        return aug_set_char(result, aug_value_char(lhs) / aug_value_char(rhs)),
         return false
     );
     return false;
@@ -4244,10 +5639,10 @@ static inline bool aug_div(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_pow(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_int(result, (int)powf((float)lhs->i, (float)rhs->i)),
-        return aug_set_float(result, powf((float)lhs->i, rhs->f)),
-        return aug_set_float(result, powf(lhs->f, (float)rhs->i)),
-        return aug_set_float(result, powf(lhs->f, rhs->f)),
+        return aug_set_int(result, (int)powf((float)aug_value_int(lhs), (float)aug_value_int(rhs))),
+        return aug_set_float(result, powf((float)aug_value_int(lhs), aug_value_float(rhs))),
+        return aug_set_float(result, powf(aug_value_float(lhs), (float)aug_value_int(rhs))),
+        return aug_set_float(result, powf(aug_value_float(lhs), aug_value_float(rhs))),
         return false,
         return false
     );
@@ -4257,10 +5652,10 @@ static inline bool aug_pow(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_mod(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_int(result, lhs->i % rhs->i),
-        return aug_set_float(result, (float)fmod(lhs->i, rhs->f)),
-        return aug_set_float(result, (float)fmod(lhs->f, rhs->i)),
-        return aug_set_float(result, (float)fmod(lhs->f, rhs->f)),
+        return aug_set_int(result, aug_value_int(lhs) % aug_value_int(rhs)),
+        return aug_set_float(result, (float)fmod(aug_value_int(lhs), aug_value_float(rhs))),
+        return aug_set_float(result, (float)fmod(aug_value_float(lhs), aug_value_int(rhs))),
+        return aug_set_float(result, (float)fmod(aug_value_float(lhs), aug_value_float(rhs))),
         return false,
         return false
     );
@@ -4270,11 +5665,11 @@ static inline bool aug_mod(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_lt(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_bool(result, lhs->i < rhs->i),
-        return aug_set_bool(result, lhs->i < rhs->f),
-        return aug_set_bool(result, lhs->f < rhs->i),
-        return aug_set_bool(result, lhs->f < rhs->f),
-        return aug_set_bool(result, lhs->c < rhs->c),
+        return aug_set_bool(result, aug_value_int(lhs) < aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_int(lhs) < aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) < aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) < aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_char(lhs) < aug_value_char(rhs)),
         return false
     );
     return false;
@@ -4283,11 +5678,11 @@ static inline bool aug_lt(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_lte(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_bool(result, lhs->i <= rhs->i),
-        return aug_set_bool(result, lhs->i <= rhs->f),
-        return aug_set_bool(result, lhs->f <= rhs->i),
-        return aug_set_bool(result, lhs->f <= rhs->f),
-        return aug_set_bool(result, lhs->c <= rhs->c),
+        return aug_set_bool(result, aug_value_int(lhs) <= aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_int(lhs) <= aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) <= aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) <= aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_char(lhs) <= aug_value_char(rhs)),
         return false
     );
     return false;
@@ -4296,11 +5691,11 @@ static inline bool aug_lte(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_gt(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_bool(result, lhs->i > rhs->i),
-        return aug_set_bool(result, lhs->i > rhs->f),
-        return aug_set_bool(result, lhs->f > rhs->i),
-        return aug_set_bool(result, lhs->f > rhs->f),
-        return aug_set_bool(result, lhs->c > rhs->c),
+        return aug_set_bool(result, aug_value_int(lhs) > aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_int(lhs) > aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) > aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) > aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_char(lhs) > aug_value_char(rhs)),
         return false
     );
     return false;
@@ -4309,11 +5704,11 @@ static inline bool aug_gt(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_gte(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_bool(result, lhs->i >= rhs->i),
-        return aug_set_bool(result, lhs->i >= rhs->f),
-        return aug_set_bool(result, lhs->f >= rhs->i),
-        return aug_set_bool(result, lhs->f >= rhs->f),
-        return aug_set_bool(result, lhs->c >= rhs->c),
+        return aug_set_bool(result, aug_value_int(lhs) >= aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_int(lhs) >= aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) >= aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) >= aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_char(lhs) >= aug_value_char(rhs)),
         return false
     );
     return false;
@@ -4322,24 +5717,26 @@ static inline bool aug_gte(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_eq(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_bool(result, lhs->i == rhs->i),
-        return aug_set_bool(result, lhs->i == rhs->f),
-        return aug_set_bool(result, lhs->f == rhs->i),
-        return aug_set_bool(result, lhs->f == rhs->f),
-        return aug_set_bool(result, lhs->c == rhs->c),
-        return aug_set_bool(result, lhs->b == rhs->b)
+        return aug_set_bool(result, aug_value_int(lhs) == aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_int(lhs) == aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) == aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) == aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_char(lhs) == aug_value_char(rhs)),
+        return aug_set_bool(result, aug_value_bool(lhs) == aug_value_bool(rhs))
     );
 
-    if (lhs->type == AUG_NONE || rhs->type == AUG_NONE)
-        return aug_set_bool(result, lhs->type == rhs->type);
+    if (aug_value_type(lhs) == AUG_NONE || aug_value_type(rhs) == AUG_NONE)
+        return aug_set_bool(result, aug_value_type(lhs) == aug_value_type(rhs));
 
-    if (lhs->type != rhs->type)
+    if (aug_value_type(lhs) != aug_value_type(rhs))
         return false;
 
-    switch (lhs->type)
+    switch (aug_value_type(lhs))
     {
-    case AUG_STRING: return aug_set_bool(result, aug_string_compare(lhs->str, rhs->str));
-    case AUG_ARRAY: return aug_set_bool(result, aug_array_compare(lhs->array, rhs->array));
+    case AUG_STRING: return aug_set_bool(result, aug_string_compare(aug_value_string(lhs), aug_value_string(rhs)));
+    case AUG_ARRAY: return aug_set_bool(result, aug_array_compare(aug_value_array(lhs), aug_value_array(rhs)));
+    case AUG_TYPED_ARRAY: return aug_set_bool(result, aug_typed_array_compare(aug_value_typed_array(lhs), aug_value_typed_array(rhs)));
+    case AUG_BUFFER_VIEW: return aug_set_bool(result, aug_buffer_view_compare(aug_value_buffer_view(lhs), aug_value_buffer_view(rhs)));
     default: break;
     }
     return false;
@@ -4348,24 +5745,26 @@ static inline bool aug_eq(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_neq(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_bool(result, lhs->i != rhs->i),
-        return aug_set_bool(result, lhs->i != rhs->f),
-        return aug_set_bool(result, lhs->f != rhs->i),
-        return aug_set_bool(result, lhs->f != rhs->f),
-        return aug_set_bool(result, lhs->c != rhs->c),
-        return aug_set_bool(result, lhs->b != rhs->b)
+        return aug_set_bool(result, aug_value_int(lhs) != aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_int(lhs) != aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) != aug_value_int(rhs)),
+        return aug_set_bool(result, aug_value_float(lhs) != aug_value_float(rhs)),
+        return aug_set_bool(result, aug_value_char(lhs) != aug_value_char(rhs)),
+        return aug_set_bool(result, aug_value_bool(lhs) != aug_value_bool(rhs))
     );
 
-    if (lhs->type == AUG_NONE || rhs->type == AUG_NONE)
-        return aug_set_bool(result, lhs->type != rhs->type);
+    if (aug_value_type(lhs) == AUG_NONE || aug_value_type(rhs) == AUG_NONE)
+        return aug_set_bool(result, aug_value_type(lhs) != aug_value_type(rhs));
 
-    if (lhs->type != rhs->type)
+    if (aug_value_type(lhs) != aug_value_type(rhs))
         return false;
 
-    switch (lhs->type)
+    switch (aug_value_type(lhs))
     {
-    case AUG_STRING: return aug_set_bool(result, !aug_string_compare(lhs->str, rhs->str));
-    case AUG_ARRAY: return aug_set_bool(result, !aug_array_compare(lhs->array, rhs->array));
+    case AUG_STRING: return aug_set_bool(result, !aug_string_compare(aug_value_string(lhs), aug_value_string(rhs)));
+    case AUG_ARRAY: return aug_set_bool(result, !aug_array_compare(aug_value_array(lhs), aug_value_array(rhs)));
+    case AUG_TYPED_ARRAY: return aug_set_bool(result, !aug_typed_array_compare(aug_value_typed_array(lhs), aug_value_typed_array(rhs)));
+    case AUG_BUFFER_VIEW: return aug_set_bool(result, !aug_buffer_view_compare(aug_value_buffer_view(lhs), aug_value_buffer_view(rhs)));
     default: break;
     }
     return false;
@@ -4374,12 +5773,12 @@ static inline bool aug_neq(aug_value* result, aug_value* lhs, aug_value* rhs)
 static inline bool aug_approxeq(aug_value* result, aug_value* lhs, aug_value* rhs)
 {
     AUG_DEFINE_BINOP_POD(result, lhs, rhs,
-        return aug_set_bool(result, lhs->i == rhs->i),
-        return aug_set_bool(result, (float)fabs(lhs->i - rhs->f) < AUG_APPROX_THRESHOLD),
-        return aug_set_bool(result, (float)fabs(lhs->f - rhs->i) < AUG_APPROX_THRESHOLD),
-        return aug_set_bool(result, (float)fabs(lhs->f - rhs->f) < AUG_APPROX_THRESHOLD),
-        return aug_set_bool(result, lhs->c == rhs->c),
-        return aug_set_bool(result, lhs->b == rhs->b)
+        return aug_set_bool(result, aug_value_int(lhs) == aug_value_int(rhs)),
+        return aug_set_bool(result, (float)fabs(aug_value_int(lhs) - aug_value_float(rhs)) < AUG_APPROX_THRESHOLD),
+        return aug_set_bool(result, (float)fabs(aug_value_float(lhs) - aug_value_int(rhs)) < AUG_APPROX_THRESHOLD),
+        return aug_set_bool(result, (float)fabs(aug_value_float(lhs) - aug_value_float(rhs)) < AUG_APPROX_THRESHOLD),
+        return aug_set_bool(result, aug_value_char(lhs) == aug_value_char(rhs)),
+        return aug_set_bool(result, aug_value_bool(lhs) == aug_value_bool(rhs))
     );
     return false;
 }
@@ -4401,6 +5800,231 @@ static inline bool aug_not(aug_value* result, aug_value* arg)
 
 #undef AUG_DEFINE_BINOP_POD
 
+// PROFILER ============================================ PROFILER ========================================== PROFILER // 
+
+// Clock read at each instruction while profiling. Defaults to the CPU timestamp counter, otherwise the process clock
+#ifndef AUG_PROFILE_CLOCK
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define AUG_PROFILE_CLOCK() ((uint64_t)__rdtsc())
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AUG_PROFILE_CLOCK() ((uint64_t)__builtin_ia32_rdtsc())
+#else
+#define AUG_PROFILE_CLOCK() ((uint64_t)clock())
+#endif
+#endif//AUG_PROFILE_CLOCK
+
+// Call tree node. Each function called from the node's function has a child node, so that nodes represent call stacks
+struct aug_profile_node
+{
+    char* name; // function name, NULL for the root
+    aug_profile_node* parent;
+    aug_profile_node* child;   // first child
+    aug_profile_node* sibling; // next child of the parent
+    uint64_t calls;
+    uint64_t ticks; // self ticks, spent in the function's own instructions
+};
+
+typedef struct aug_profile_line
+{
+    char* filename;
+    size_t line;
+    uint64_t samples;
+    uint64_t ticks; // ticks since the previous sample
+} aug_profile_line;
+
+struct aug_profiler
+{
+    uint64_t opcode_counts[AUG_OPCODE_COUNT];
+    uint64_t opcode_ticks[AUG_OPCODE_COUNT];
+    aug_profile_node root;
+    aug_hashtable* lines; // "filename:line" -> aug_profile_line
+
+    int opcode;           // opcode being timed, AUG_OPCODE_COUNT if none
+    uint64_t time;        // clock when the opcode was dispatched
+    uint64_t sample_time; // clock at the previous line sample
+    int sample_countdown;
+    int budget_remaining; // instructions remaining in the coroutine budget, counted while profiling
+};
+
+static void aug_profile_line_free(uint8_t* data)
+{
+    aug_profile_line* line = (aug_profile_line*)data;
+    AUG_FREE(line->filename);
+}
+
+static void aug_profile_node_delete(aug_profile_node* node)
+{
+    aug_profile_node* child = node->child;
+    while(child != NULL)
+    {
+        aug_profile_node* sibling = child->sibling;
+        aug_profile_node_delete(child);
+        AUG_FREE(child->name);
+        AUG_FREE(child);
+        child = sibling;
+    }
+    node->child = NULL;
+}
+
+// Counters are cleared, but the nodes are kept as suspended coroutines may still be executing within them
+static void aug_profile_node_reset(aug_profile_node* node)
+{
+    node->calls = 0;
+    node->ticks = 0;
+    for(aug_profile_node* child = node->child; child != NULL; child = child->sibling)
+        aug_profile_node_reset(child);
+}
+
+// Returns the child node of the called function, created on the first call
+static aug_profile_node* aug_profile_node_enter(aug_profile_node* node, const char* name)
+{
+    aug_profile_node* child;
+    for(child = node->child; child != NULL; child = child->sibling)
+    {
+        if(strcmp(child->name, name) == 0)
+            break;
+    }
+
+    if(child == NULL)
+    {
+        const size_t len = strlen(name);
+        child = (aug_profile_node*)AUG_ALLOC(sizeof(aug_profile_node));
+        child->name = (char*)AUG_ALLOC(len + 1);
+        memcpy(child->name, name, len + 1);
+        child->parent = node;
+        child->child = NULL;
+        child->sibling = node->child;
+        child->calls = 0;
+        child->ticks = 0;
+        node->child = child;
+    }
+
+    ++child->calls;
+    return child;
+}
+
+// Index of the first marker at or after the bytecode address. Markers are ordered by address
+static size_t aug_profile_find_marker(const aug_container* markers, int addr)
+{
+    size_t low = 0;
+    size_t high = markers->length;
+    while(low < high)
+    {
+        const size_t mid = low + (high - low) / 2;
+        if(aug_container_ptr_type(aug_trace_marker, markers, mid)->bytecode_addr < addr)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// Functions are marked with their symbol at the entry address
+static const char* aug_profile_function_name(const aug_context* context, int addr)
+{
+    if(context->markers == NULL)
+        return "(anonymous)";
+
+    for(size_t i = aug_profile_find_marker(context->markers, addr); i < context->markers->length; ++i)
+    {
+        const aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, context->markers, i);
+        if(marker->bytecode_addr != addr)
+            break;
+        if(marker->symbol_name != NULL)
+            return marker->symbol_name->buffer;
+    }
+    return "(anonymous)";
+}
+
+// Attributes the ticks to the source line of the closest source marker preceding the instruction
+static void aug_profile_sample_line(aug_profiler* profiler, const aug_context* context, int addr, uint64_t ticks)
+{
+    if(context->markers == NULL)
+        return;
+
+    size_t i = aug_profile_find_marker(context->markers, addr + 1);
+    while(i > 0)
+    {
+        const aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, context->markers, --i);
+        if(marker->filename == NULL)
+            continue;
+
+        char key[1024];
+        snprintf(key, sizeof(key), "%s:%zu", marker->filename->buffer, marker->pos.line + 1);
+
+        aug_profile_line* line = aug_hashtable_ptr_type(aug_profile_line, profiler->lines, key);
+        if(line == NULL)
+        {
+            line = aug_hashtable_insert_type(aug_profile_line, profiler->lines, key);
+            line->filename = (char*)AUG_ALLOC(marker->filename->length + 1);
+            memcpy(line->filename, marker->filename->buffer, marker->filename->length + 1);
+            line->line = marker->pos.line + 1;
+            line->samples = 0;
+            line->ticks = 0;
+        }
+        ++line->samples;
+        line->ticks += ticks;
+        return;
+    }
+}
+
+static void aug_profile_begin(aug_profiler* profiler, aug_context* context)
+{
+    profiler->opcode = AUG_OPCODE_COUNT;
+    profiler->time = AUG_PROFILE_CLOCK();
+    profiler->sample_time = profiler->time;
+    profiler->sample_countdown = AUG_PROFILE_SAMPLE_INTERVAL;
+    profiler->budget_remaining = context->budget;
+    if(context->profile_node == NULL)
+        context->profile_node = &profiler->root;
+}
+
+// Times the previous opcode, then records the instruction about to be executed
+static void aug_profile_instruction(aug_profiler* profiler, aug_context* context)
+{
+    const uint64_t time = AUG_PROFILE_CLOCK();
+    aug_profile_node* node = context->profile_node;
+    if(profiler->opcode != AUG_OPCODE_COUNT)
+    {
+        profiler->opcode_ticks[profiler->opcode] += time - profiler->time;
+        node->ticks += time - profiler->time;
+    }
+    profiler->time = time;
+
+    const int addr = (int)(context->instruction - context->bytecode);
+    if(--profiler->sample_countdown == 0)
+    {
+        aug_profile_sample_line(profiler, context, addr, time - profiler->sample_time);
+        profiler->sample_time = time;
+        profiler->sample_countdown = AUG_PROFILE_SAMPLE_INTERVAL;
+    }
+
+    const aug_opcode opcode = (aug_opcode)(*context->instruction);
+    profiler->opcode = opcode;
+    ++profiler->opcode_counts[opcode];
+
+    // Function calls jump to the entry of the function, and the return is timed within the caller
+    if(opcode == AUG_OPCODE_ENTER_FUNC)
+        context->profile_node = aug_profile_node_enter(node, aug_profile_function_name(context, addr));
+    else if(opcode == AUG_OPCODE_RETURN_FUNC && node->parent != NULL)
+        context->profile_node = node->parent;
+}
+
+// Times the last opcode. Unless suspended, the call tree position is restored in case execution stopped on an error
+static void aug_profile_end(aug_profiler* profiler, aug_context* context, aug_profile_node* base_node)
+{
+    if(profiler->opcode != AUG_OPCODE_COUNT)
+    {
+        const uint64_t ticks = AUG_PROFILE_CLOCK() - profiler->time;
+        profiler->opcode_ticks[profiler->opcode] += ticks;
+        context->profile_node->ticks += ticks;
+        profiler->opcode = AUG_OPCODE_COUNT;
+    }
+
+    if(!context->suspended)
+        context->profile_node = base_node;
+}
+
 // VM  =====================================================  VM  ================================================== VM // 
 
 // Used to convert values to/from bytes for constant values
@@ -4413,231 +6037,345 @@ typedef union aug_vm_bytecode_value
     unsigned char bytes[sizeof(float)]; //Used to access raw byte data to bool, float and int types
 } aug_vm_bytecode_value;
 
-aug_trace_marker* aug_vm_get_marker(aug_vm* vm)
+aug_trace_marker* aug_vm_get_marker(aug_context* context)
 {
-    const int addr = vm->last_instruction - vm->bytecode;
+    const int addr = context->last_instruction - context->bytecode;
     // TODO: index by address for faster lookup. Not priority as this will only occur on VM error 
-    for(size_t i = 0; i < vm->markers->length; ++i)
+    for(size_t i = 0; i < context->markers->length; ++i)
     {
-        aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, vm->markers, i);
+        aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, context->markers, i);
         if(marker->bytecode_addr == addr && marker->symbol_name == NULL)
             return marker;
     }
     return NULL;
 }
 
-aug_string* aug_vm_get_marker_symbol(aug_vm* vm, size_t operand_size)
+aug_string* aug_vm_get_marker_symbol(aug_context* context, size_t operand_size)
 {
-    const int addr = vm->last_instruction - vm->bytecode;
+    const int addr = context->last_instruction - context->bytecode;
     // TODO: index by address for faster lookup. Not priority as this will only occur on VM error 
-    for(size_t i = 0; i < vm->markers->length; ++i)
+    for(size_t i = 0; i < context->markers->length; ++i)
     {
-        aug_trace_marker marker = aug_container_at_type(aug_trace_marker, vm->markers, i);
+        aug_trace_marker marker = aug_container_at_type(aug_trace_marker, context->markers, i);
         if(marker.bytecode_addr == addr && marker.symbol_name != NULL)
             return marker.symbol_name;
     }
     return NULL;
 }
 
-void aug_log_vm_warn(aug_vm* vm, const char* format, ...)
+void aug_log_vm_warn(aug_context* context, const char* format, ...)
 {
     // Log the source code, or debug symbol if it exists
-    aug_trace_marker* marker = aug_vm_get_marker(vm);
+    aug_trace_marker* marker = aug_vm_get_marker(context);
     if(marker != NULL && marker->filename != NULL)
     {
-        aug_input* input = aug_input_open(marker->filename->buffer, vm->error_func);
+        aug_input* input = aug_input_open(marker->filename->buffer, context->vm->error_func);
         aug_log_input_error_hint(input, &marker->pos);
         aug_input_close(input);
     }
 
     va_list args;
     va_start(args, format);
-    aug_log_error_internal(vm->error_func, format, args);
+    aug_log_error_internal(context->vm->error_func, format, args);
     va_end(args);
 }
 
 
-void aug_log_vm_error(aug_vm* vm, const char* format, ...)
+void aug_log_vm_error(aug_context* context, const char* format, ...)
 {
     // Do not cascade multiple errors
-    if (vm->instruction == NULL)
+    if (context->instruction == NULL)
         return;
-    vm->instruction = NULL;
+    context->instruction = NULL;
 
-    aug_trace_marker* marker = aug_vm_get_marker(vm);
+    aug_trace_marker* marker = aug_vm_get_marker(context);
     if(marker != NULL && marker->filename != NULL)
     {
-        aug_input* input = aug_input_open(marker->filename->buffer, vm->error_func);
+        aug_input* input = aug_input_open(marker->filename->buffer, context->vm->error_func);
         aug_log_input_error_hint(input, &marker->pos);
         aug_input_close(input);
     }
 
     va_list args;
     va_start(args, format);
-    aug_log_error_internal(vm->error_func, format, args);
+    aug_log_error_internal(context->vm->error_func, format, args);
     va_end(args);
 }
 
-static inline aug_value* aug_vm_top(aug_vm* vm)
+static inline aug_value* aug_vm_top(aug_context* context)
 {
-    return &vm->stack[vm->stack_index -1];
+    return &context->stack[context->stack_index -1];
 }
 
-static inline aug_value* aug_vm_push(aug_vm* vm)
+static inline aug_value* aug_vm_push(aug_context* context)
 {
-    if(vm->stack_index >= AUG_STACK_SIZE)
+    if(context->stack_index >= context->stack_size)
     {                                              
-        //aug_log_vm_error(vm, "Stack overflow");      
+        //aug_log_vm_error(context, "Stack overflow");      
         return NULL;                           
     }
-    aug_value* top = &vm->stack[vm->stack_index++];
+    aug_value* top = &context->stack[context->stack_index++];
     return top;
 }
 
-static inline aug_value* aug_vm_pop(aug_vm* vm)
+static inline aug_value* aug_vm_pop(aug_context* context)
 {
-    aug_value* top = aug_vm_top(vm);
-    --vm->stack_index;
+    aug_value* top = aug_vm_top(context);
+    --context->stack_index;
     return top;
 }
 
-static inline aug_value* aug_vm_get_global(aug_vm* vm, int stack_offset)
+// Releases a popped operand. Most operands are numbers, which are checked before calling into aug_decref
+static inline void aug_vm_release(aug_value* value)
+{
+    if(aug_value_type(value) >= AUG_STRING)
+        aug_decref(value);
+}
+
+static inline aug_value* aug_vm_get_global(aug_context* context, int stack_offset)
 {
     if(stack_offset < 0)
     {
-        //aug_log_vm_error(vm, "Stack underflow");
+        //aug_log_vm_error(context, "Stack underflow");
         return NULL;
     }
-    else if(stack_offset >= AUG_STACK_SIZE)
+    else if(stack_offset >= context->globals_size)
     {
-        //aug_log_vm_error(vm, "Stack overflow");
+        //aug_log_vm_error(context, "Stack overflow");
         return NULL;
     }
 
-    return &vm->stack[stack_offset];
+    return &context->globals[stack_offset];
 }
 
-static inline void aug_vm_push_call_frame(aug_vm* vm, int return_addr)
+static inline void aug_vm_push_call_frame(aug_context* context, int return_addr)
 {
     // NOTE: pushing 2 values onto stack. if this changes, must modify AUG_CALL_FRAME_STACK_SIZE 
     //       note that the call also pushes the argument count
-    aug_value* ret_value = aug_vm_push(vm);
+    aug_value* ret_value = aug_vm_push(context);
     if(ret_value == NULL)
         return;
-    ret_value->type = AUG_INT;
-    ret_value->i = return_addr;
+    aug_value_init_int(ret_value, AUG_INT, return_addr);
 
-    aug_value* base_value = aug_vm_push(vm);
+    aug_value* base_value = aug_vm_push(context);
     if(base_value == NULL)
         return;
-    base_value->type = AUG_INT;
-    base_value->i = vm->base_index;    
+    aug_value_init_int(base_value, AUG_INT, context->base_index);    
+}
+
+static inline aug_value* aug_vm_get_local(aug_context* context, int stack_offset)
+{
+    stack_offset += context->base_index;
+    if(stack_offset < 0 || stack_offset >= context->stack_size)
+        return NULL;
+    return &context->stack[stack_offset];
+}
+
+// Source operand of a register instruction. Int constants are written to the immediate. Stack temporaries are popped, 
+// and released by aug_vm_release_register
+static inline aug_value* aug_vm_get_register(aug_context* context, int reg, aug_value* immediate)
+{
+    switch(AUG_REGISTER_KIND(reg))
+    {
+    case AUG_REGISTER_LOCAL:
+        return aug_vm_get_local(context, AUG_REGISTER_INDEX(reg));
+    case AUG_REGISTER_GLOBAL:
+        return aug_vm_get_global(context, AUG_REGISTER_INDEX(reg));
+    case AUG_REGISTER_INT:
+        aug_set_int(immediate, AUG_REGISTER_INDEX(reg));
+        return immediate;
+    case AUG_REGISTER_STACK:
+        break;
+    }
+    return context->stack_index > 0 ? aug_vm_pop(context) : NULL;
+}
+
+static inline void aug_vm_release_register(int reg, aug_value* value)
+{
+    if(value != NULL && AUG_REGISTER_KIND(reg) == AUG_REGISTER_STACK)
+        aug_vm_release(value);
 }
 
-static inline aug_value* aug_vm_get_local(aug_vm* vm, int stack_offset)
+// Moves the value to the destination register. Stack temporaries are pushed
+static inline void aug_vm_set_register(aug_context* context, int reg, aug_value* value)
 {
-    return aug_vm_get_global(vm, vm->base_index + stack_offset);
+    aug_value* target = NULL;
+    switch(AUG_REGISTER_KIND(reg))
+    {
+    case AUG_REGISTER_LOCAL:
+        target = aug_vm_get_local(context, AUG_REGISTER_INDEX(reg));
+        break;
+    case AUG_REGISTER_GLOBAL:
+        target = aug_vm_get_global(context, AUG_REGISTER_INDEX(reg));
+        break;
+    case AUG_REGISTER_STACK:
+        target = aug_vm_push(context);
+        break;
+    case AUG_REGISTER_INT:
+        break;
+    }
+
+    if(target == NULL)
+    {
+        aug_vm_release(value);
+        aug_log_vm_error(context, "Invalid register");
+        return;
+    }
+    aug_vm_release(target);
+    *target = *value;
 }
 
-static inline int aug_vm_read_bool(aug_vm* vm)
+static inline int aug_vm_read_bool(aug_context* context)
 {
     aug_vm_bytecode_value bytecode_value;
     for(size_t i = 0; i < sizeof(bytecode_value.b); ++i)
-        bytecode_value.bytes[i] = *(vm->instruction++);
+        bytecode_value.bytes[i] = *(context->instruction++);
     return bytecode_value.b;
 }
 
-static inline int aug_vm_read_int(aug_vm* vm)
+static inline int aug_vm_read_int(aug_context* context)
 {
     aug_vm_bytecode_value bytecode_value;
     for(size_t i = 0; i < sizeof(bytecode_value.i); ++i)
-        bytecode_value.bytes[i] = *(vm->instruction++);
+        bytecode_value.bytes[i] = *(context->instruction++);
     return bytecode_value.i;
 }
 
-static inline char aug_vm_read_char(aug_vm* vm)
+static inline char aug_vm_read_char(aug_context* context)
 {
     aug_vm_bytecode_value bytecode_value;
     for(size_t i = 0; i < sizeof(bytecode_value.c); ++i)
-        bytecode_value.bytes[i] = *(vm->instruction++);
+        bytecode_value.bytes[i] = *(context->instruction++);
     return bytecode_value.c;
 }
 
-static inline float aug_vm_read_float(aug_vm* vm)
+static inline float aug_vm_read_float(aug_context* context)
 {
     aug_vm_bytecode_value bytecode_value;
     for(size_t i = 0; i < sizeof(bytecode_value.f); ++i)
-        bytecode_value.bytes[i] = *(vm->instruction++);
+        bytecode_value.bytes[i] = *(context->instruction++);
     return bytecode_value.f;
 }
 
-static inline const char* aug_vm_read_bytes(aug_vm* vm)
+static inline const char* aug_vm_read_bytes(aug_context* context)
 {
     size_t len = 1; // include null terminating
-    while(*(vm->instruction++))
+    while(*(context->instruction++))
         len++;
-    return vm->instruction - len;
-}
+    return context->instruction - len;
+}
+
+void aug_vm_startup(aug_context* context)
+{
+    context->bytecode = NULL;
+    context->registers = false;
+#if AUG_JIT
+    context->jit = NULL;
+#endif//AUG_JIT
+    context->instruction = NULL;
+    context->stack_index = 0;
+    context->base_index = 0;
+    context->arg_count = 0;
+    context->valid = false; 
+    context->running = false; 
+    context->coroutine = false;
+    context->suspended = false;
+    context->budget = 0;
+    context->profile_node = NULL;
+    context->extension_names = NULL;
+    context->extension_slots = NULL;
+    context->extension_version = 0;
+    context->constants = NULL;
+    context->globals = context->stack;
+    context->globals_size = context->stack_size;
+}
+
+void aug_vm_shutdown(aug_context* context)
+{
+    context->running = false; 
 
-void aug_vm_startup(aug_vm* vm)
-{
-    vm->bytecode = NULL;
-    vm->instruction = NULL;
-    vm->stack_index = 0;
-    vm->base_index = 0;
-    vm->arg_count = 0;
-    vm->valid = false; 
-    vm->running = false; 
+    //Cleanup stack values. Free any outstanding values
+    while(context->stack_index > 0)
+        aug_decref(aug_vm_pop(context));
+
+    // Ensure that stack has returned to beginning state
+    if(context->stack_index != 0)
+        aug_log_error(context->vm->error_func, "Virtual machine shutdown error. Invalid stack state");
+
+    // Errors stop execution within the calling frame. Loads do not startup the context, and expect the base frame
+    context->base_index = 0;
 }
 
-void aug_vm_shutdown(aug_vm* vm)
+// Resolves the loaded script's extension slots from the lib extensions, then the globally registered extensions
+void aug_vm_resolve_extensions(aug_context* context)
 {
-    vm->running = false; 
+    context->extension_version = context->vm->extensions_version;
+    if(context->extension_names == NULL)
+        return;
 
-    //Cleanup stack values. Free any outstanding values
-    while(vm->stack_index > 0)
-        aug_decref(aug_vm_pop(vm));
+    for(size_t i = 0; i < context->extension_names->length; ++i)
+    {
+        const aug_string* func_name = aug_container_at_type(aug_string*, context->extension_names, i);
 
-    // Ensure that stack has returned to beginning state
-    if(vm->stack_index != 0)
-        aug_log_error(vm->error_func, "Virtual machine shutdown error. Invalid stack state");
+        aug_extension* extension = NULL;
+        if(context->lib_extensions != NULL)
+            extension = aug_hashtable_ptr_type(aug_extension, context->lib_extensions, func_name->buffer);
+        if(extension == NULL)
+            extension = aug_hashtable_ptr_type(aug_extension, context->vm->extensions, func_name->buffer);
+
+        context->extension_slots[i] = extension ? extension->func : NULL;
+    }
 }
 
-void aug_vm_load_script(aug_vm* vm, const aug_script* script)
+void aug_vm_load_script(aug_context* context, const aug_script* script)
 {
-    if(vm == NULL || script == NULL)
+    if(context == NULL || script == NULL)
         return;
 
     if(script->bytecode == NULL)
-        vm->bytecode = NULL;
+        context->bytecode = NULL;
     else
-        vm->bytecode = script->bytecode;
+        context->bytecode = script->bytecode;
+    context->registers = script->backend == AUG_BACKEND_REGISTER;
+#if AUG_JIT
+    context->jit = script->jit;
+#endif//AUG_JIT
     
-    vm->instruction = vm->bytecode;
-    vm->valid = (vm->bytecode != NULL);
-    vm->markers = script->markers; //NOTE weak ref
-    vm->lib_extensions = script->lib_extensions;
-
+    context->instruction = context->bytecode;
+    context->valid = (context->bytecode != NULL);
+    context->markers = script->markers; //NOTE weak ref
+    context->lib_extensions = script->lib_extensions;
+    context->extension_names = script->extension_names;
+    context->extension_slots = script->extension_slots;
+    context->extension_version = script->extension_version;
+    context->constants = script->constants;
+
+    // Top level statements define the globals on the stack. Once saved, the globals remain resident in the script state 
     if(script->stack_state != NULL)
     {
-        for(size_t i = 0; i < script->stack_state->length; ++i)
-        {
-            aug_value* top = aug_vm_push(vm);
-            if(top)
-                *top = *aug_array_at(script->stack_state, i);
-        }
+        context->globals = script->stack_state->buffer;
+        context->globals_size = (int)script->stack_state->length;
+    }
+    else
+    {
+        context->globals = context->stack;
+        context->globals_size = context->stack_size;
     }
 }
 
-void aug_vm_unload_script(aug_vm* vm, aug_script* script)
+void aug_vm_unload_script(aug_context* context, aug_script* script)
 {
-    if(vm == NULL || script == NULL)
+    if(context == NULL || script == NULL)
         return;
 
-    vm->instruction = vm->bytecode = NULL;
-    while (vm->stack_index > 0)
+    context->instruction = context->bytecode = NULL;
+    context->registers = false;
+#if AUG_JIT
+    context->jit = NULL;
+#endif//AUG_JIT
+    while (context->stack_index > 0)
     {
-        aug_value* top = aug_vm_pop(vm);
+        aug_value* top = aug_vm_pop(context);
         aug_decref(top);
     }
 
@@ -4653,36 +6391,73 @@ void aug_vm_unload_script(aug_vm* vm, aug_script* script)
     }
 }
 
-void aug_vm_save_script(aug_vm* vm, aug_script* script)
+void aug_vm_save_script(aug_context* context, aug_script* script)
 {
-    if(vm == NULL || script == NULL)
+    if(context == NULL || script == NULL)
         return;
 
     // Move ownership
-    script->lib_extensions = vm->lib_extensions;
-    vm->lib_extensions = NULL;
+    script->lib_extensions = context->lib_extensions;
+    context->lib_extensions = NULL;
 
-    // reset script stack state to match vm
+    // Keep the resolved slots if still valid
+    script->extension_version = context->extension_version;
+
+    // reset script stack state to match context
     script->stack_state = aug_array_decref(script->stack_state);
-    if (vm->stack_index > 0)
+    if (context->stack_index > 0)
     {
         script->stack_state = aug_array_new(1);
 
-        aug_array_reserve(script->stack_state, vm->stack_index);
-        script->stack_state->length = vm->stack_index;
+        aug_array_reserve(script->stack_state, context->stack_index);
+        script->stack_state->length = context->stack_index;
 
-        while(vm->stack_index > 0)
+        while(context->stack_index > 0)
         {
-            aug_value* top = aug_vm_pop(vm);
-            aug_value* element = aug_array_at(script->stack_state, vm->stack_index);
+            aug_value* top = aug_vm_pop(context);
+            aug_value* element = aug_array_at(script->stack_state, context->stack_index);
             *element = aug_none();
-            aug_assign(element, top);
+            aug_move(element, top);
+        }
+    }
+}
+
+// Adds the library's extensions to the loading context's script
+void aug_vm_lib_extend(aug_context* context, const aug_lib* lib)
+{
+    aug_hashtable* extensions = lib->extensions;
+    if(context->lib_extensions == NULL)
+        return;
+
+    for(size_t i = 0; i < extensions->capacity; ++i)
+    {
+        const char* func_name = extensions->slots[i].key;
+        if(func_name == NULL)
+            continue;
+
+        if(aug_hashtable_get(context->lib_extensions, func_name) != 0)
+        {
+            aug_log_vm_warn(context, "Failed to register library extension Function %s. Already registered!", func_name);
+            continue;
         }
+
+        aug_extension* extension = aug_hashtable_insert_type(aug_extension, context->lib_extensions, func_name);
+        if(extension != NULL)
+            *extension = *(aug_extension*)&extensions->data_buffer[i * extensions->element_size];
     }
+    ++context->vm->extensions_version;
 }
 
-void aug_vm_lib_load(aug_vm* vm, const char* libname)
+void aug_vm_lib_load(aug_context* context, const char* libname)
 {
+    // Libraries are loaded once per VM. Later imports reuse the extensions registered by the first
+    aug_lib* cached_lib = aug_hashtable_ptr_type(aug_lib, context->vm->libs, libname);
+    if(cached_lib != NULL)
+    {
+        aug_vm_lib_extend(context, cached_lib);
+        return;
+    }
+
 #if _WIN32
     char libpath[1024];
     snprintf(libpath, sizeof(libpath), "%s.dll", libname); //seach locally
@@ -4690,7 +6465,7 @@ void aug_vm_lib_load(aug_vm* vm, const char* libname)
     HINSTANCE handle = LoadLibraryA(libpath);
     if (handle == NULL)
     {
-        aug_log_error(vm->error_func, "Failed to open library %s", libname);
+        aug_log_error(context->vm->error_func, "Failed to open library %s", libname);
         return;
     }
 
@@ -4698,7 +6473,7 @@ void aug_vm_lib_load(aug_vm* vm, const char* libname)
     aug_register_lib_func register_lib = (aug_register_lib_func)GetProcAddress(handle, AUG_REGISTER_LIB_FUNC);
     if (register_lib == NULL)
     {
-        aug_log_error(vm->error_func, "Library %s failed to setup", libname);
+        aug_log_error(context->vm->error_func, "Library %s failed to setup", libname);
         FreeLibrary(handle);
         return;
     }
@@ -4710,7 +6485,7 @@ void aug_vm_lib_load(aug_vm* vm, const char* libname)
     if (handle == NULL) 
     {
         char* error = dlerror();
-        aug_log_error(vm->error_func, "Failed to open library %s. %s", libname, error);
+        aug_log_error(context->vm->error_func, "Failed to open library %s. %s", libname, error);
         return;
     }
 
@@ -4718,14 +6493,26 @@ void aug_vm_lib_load(aug_vm* vm, const char* libname)
     char* error = dlerror();
     if (error != NULL)
     {
-        aug_log_error(vm->error_func, "Library %s failed to setup. %s", libname, error);
+        aug_log_error(context->vm->error_func, "Library %s failed to setup. %s", libname, error);
         dlclose(handle);
         return;
     }
 #endif
 
-    register_lib(vm);
-    aug_container_push_type(aug_lib_handle, vm->libs, (aug_lib_handle)handle);
+    aug_lib* lib = aug_hashtable_insert_type(aug_lib, context->vm->libs, libname);
+    lib->handle = (aug_lib_handle)handle;
+    lib->extensions = aug_hashtable_new_type(aug_extension);
+
+    // Extensions registered by the lib are recorded in the lib, then added to the loading context's script
+    aug_context* prev_context = context->vm->context;
+    aug_hashtable* prev_extensions = context->lib_extensions;
+    context->vm->context = context;
+    context->lib_extensions = lib->extensions;
+    register_lib(context->vm);
+    context->lib_extensions = prev_extensions;
+    context->vm->context = prev_context;
+
+    aug_vm_lib_extend(context, lib);
 }
 
 void aug_vm_lib_unload(aug_vm* vm, aug_lib_handle handle)
@@ -4739,797 +6526,2601 @@ void aug_vm_lib_unload(aug_vm* vm, aug_lib_handle handle)
 #endif
 }
 
+void aug_vm_lib_free(uint8_t* data, void* user_data)
+{
+    aug_lib* lib = (aug_lib*)data;
+    lib->extensions = aug_hashtable_decref(lib->extensions);
+    aug_vm_lib_unload((aug_vm*)user_data, lib->handle);
+}
+
+#if AUG_THREADED_DISPATCH && !defined(__GNUC__)
+#undef AUG_THREADED_DISPATCH
+#define AUG_THREADED_DISPATCH 0
+#endif//AUG_THREADED_DISPATCH
+
+#if AUG_DEBUG
+#define AUG_VM_DEBUG_POST_INSTRUCTION()                                             \
+    if(context->vm->debug_post_instruction)                                         \
+        context->vm->debug_post_instruction(context, opcode);
+#else
+#define AUG_VM_DEBUG_POST_INSTRUCTION()
+#endif //AUG_DEBUG
+
+// Counts down the instructions remaining in the coroutine budget. Suspends before the next instruction once exhausted
+// Without a budget the count is renewed, so that a single branch is taken per instruction. 
+// While profiling, the countdown expires at every instruction to record it
+#define AUG_VM_BUDGET()                                                             \
+    if(--budget == 0)                                                               \
+    {                                                                               \
+        budget = aug_vm_countdown(context, profiler);                               \
+        if(budget == 0)                                                             \
+            goto AUG_VM_LABEL_END;                                                  \
+    }
+
+#if AUG_THREADED_DISPATCH
+// Each instruction handler jumps directly to the next handler. Replicating the dispatch at the end of every handler 
+// gives the branch predictor a separate history per opcode, instead of a single shared indirect jump in the switch
+#define AUG_VM_CASE(opcode) AUG_VM_LABEL_##opcode:
+#define AUG_VM_DEFAULT
+#define AUG_VM_DISPATCH()                                                           \
+{                                                                                   \
+    if(context->instruction == NULL)                                                \
+        goto AUG_VM_LABEL_END;                                                      \
+    AUG_VM_BUDGET();                                                                \
+    context->last_instruction = context->instruction;                               \
+    opcode = (aug_opcode)(*context->instruction++);                                 \
+    goto *dispatch_table[opcode];                                                   \
+}
+#define AUG_VM_NEXT                                                                 \
+{                                                                                   \
+    AUG_VM_DEBUG_POST_INSTRUCTION();                                                \
+    AUG_VM_DISPATCH();                                                              \
+}
+// Opens the instruction loop of an execute function, closed by AUG_VM_LOOP_END. The table holds the label of every 
+// opcode, so each execute function defines a case for all of them
+#define AUG_VM_LOOP_BEGIN                                                           \
+    static const void* dispatch_table[AUG_OPCODE_COUNT] = { AUG_OPCODE_LIST };     \
+    aug_opcode opcode;                                                              \
+    AUG_VM_DISPATCH();                                                              \
+    {                                                                               \
+        {
+#define AUG_VM_LOOP_END                                                             \
+        }                                                                           \
+    }
+#else
+#define AUG_VM_CASE(opcode) case AUG_OPCODE_##opcode:
+#define AUG_VM_DEFAULT default:
+#define AUG_VM_NEXT break
+#define AUG_VM_LOOP_BEGIN                                                           \
+    while(context->instruction)                                                     \
+    {                                                                               \
+        AUG_VM_BUDGET();                                                            \
+        context->last_instruction = context->instruction;                           \
+                                                                                    \
+        aug_opcode opcode = (aug_opcode)(*context->instruction++);                  \
+        switch(opcode)                                                              \
+        {
+#define AUG_VM_LOOP_END                                                             \
+        }                                                                           \
+        AUG_VM_DEBUG_POST_INSTRUCTION();                                            \
+    }
+#endif //AUG_THREADED_DISPATCH
+
+#if AUG_JIT
+static void aug_jit_enter(aug_context* context);
+static void aug_jit_loop(aug_context* context);
+static void aug_jit_run(aug_context* context);
+
+// Entering a function counts the call, and continues in native code once compiled. Returning continues in native code
+// if the caller was compiled. Branching back to a loop counts the iteration, and continues in native code once compiled
+#define AUG_VM_JIT_ENTER() if(context->jit != NULL) aug_jit_enter(context)
+#define AUG_VM_JIT_RESUME() if(context->jit != NULL) aug_jit_run(context)
+#define AUG_VM_JIT_LOOP() if(context->jit != NULL && context->instruction < context->last_instruction) aug_jit_loop(context)
+#else
+#define AUG_VM_JIT_ENTER()
+#define AUG_VM_JIT_RESUME()
+#define AUG_VM_JIT_LOOP()
+#endif//AUG_JIT
+
 #define AUG_OPCODE_UNOP(opfunc, str)                                                \
 {                                                                                   \
-    aug_value* arg = aug_vm_pop(vm);                                                \
+    aug_value* arg = aug_vm_pop(context);                                           \
     aug_value target = aug_none();                                                  \
     if (!opfunc(&target, arg))                                                      \
-        aug_log_vm_error(vm, "%s %s not defined", str, aug_type_label(arg));        \
-    aug_decref(arg);                                                                \
-    aug_move(aug_vm_push(vm), &target);                                             \
-    break;                                                                          \
+        aug_log_vm_error(context, "%s %s not defined", str, aug_type_label(arg));   \
+    aug_vm_release(arg);                                                            \
+    aug_move(aug_vm_push(context), &target);                                        \
+    AUG_VM_NEXT;                                                                    \
 }
 
 #define AUG_OPCODE_BINOP(opfunc, str)                                                                       \
 {                                                                                                           \
-    aug_value* rhs = aug_vm_pop(vm);                                                                        \
-    aug_value* lhs = aug_vm_pop(vm);                                                                        \
+    aug_value* rhs = aug_vm_pop(context);                                                                   \
+    aug_value* lhs = aug_vm_pop(context);                                                                   \
     aug_value target = aug_none();                                                                          \
     if (!opfunc(&target, lhs, rhs))                                                                         \
-        aug_log_vm_error(vm, "%s %s %s not defined", aug_type_label(lhs), str, aug_type_label(rhs));        \
-    aug_decref(lhs);                                                                                        \
-    aug_decref(rhs);                                                                                        \
-    aug_move(aug_vm_push(vm), &target);                                                                     \
-    break;                                                                                                  \
+        aug_log_vm_error(context, "%s %s %s not defined", aug_type_label(lhs), str, aug_type_label(rhs));   \
+    aug_vm_release(lhs);                                                                                    \
+    aug_vm_release(rhs);                                                                                    \
+    aug_move(aug_vm_push(context), &target);                                                                \
+    AUG_VM_NEXT;                                                                                            \
+}
+
+// Fused binary operation on a variable slot and an int immediate, stores the result in the slot
+#define AUG_OPCODE_BINOP_INT(opfunc, str, get_func)                                                         \
+{                                                                                                           \
+    const int stack_offset = aug_vm_read_int(context);                                                      \
+    aug_value rhs;                                                                                          \
+    aug_set_int(&rhs, aug_vm_read_int(context));                                                            \
+    aug_value* lhs = get_func(context, stack_offset);                                                       \
+    aug_value target = aug_none();                                                                          \
+    if (!opfunc(&target, lhs, &rhs))                                                                        \
+        aug_log_vm_error(context, "%s %s %s not defined", aug_type_label(lhs), str, aug_type_label(&rhs));  \
+    aug_move(lhs, &target);                                                                                 \
+    AUG_VM_NEXT;                                                                                            \
 }
 
-void aug_vm_execute(aug_vm* vm)
+// Compound addition to a variable slot, stores the sum in the slot. The left operand is the slot's value, pushed before 
+// the right operand. If it still references the slot's string or array, the stack copy is released first, so that an 
+// unshared container is appended to in place
+#define AUG_OPCODE_ADD_ASSIGN(get_func)                                                                     \
+{                                                                                                           \
+    const int stack_offset = aug_vm_read_int(context);                                                      \
+    aug_value* rhs = aug_vm_pop(context);                                                                   \
+    aug_value* lhs = aug_vm_pop(context);                                                                   \
+    aug_value* slot = get_func(context, stack_offset);                                                      \
+    if(slot != NULL && aug_value_type(lhs) == AUG_INT && aug_value_type(rhs) == AUG_INT                     \
+        && aug_value_type(slot) < AUG_STRING)                                                               \
+    {                                                                                                       \
+        aug_set_int(slot, aug_value_int(lhs) + aug_value_int(rhs));                                         \
+        AUG_VM_NEXT;                                                                                        \
+    }                                                                                                       \
+    const bool borrowed = slot != NULL && aug_value_type(lhs) >= AUG_STRING                                 \
+        && aug_value_type(lhs) == aug_value_type(slot) && aug_value_pointer(lhs) == aug_value_pointer(slot);\
+    if(borrowed)                                                                                            \
+        aug_decref(lhs);                                                                                    \
+    aug_value target = aug_none();                                                                          \
+    if (slot == NULL || !aug_add(&target, borrowed ? slot : lhs, rhs))                                      \
+        aug_log_vm_error(context, "%s + %s not defined", aug_type_label(lhs), aug_type_label(rhs));         \
+    else                                                                                                    \
+        aug_move(slot, &target);                                                                            \
+    if(!borrowed)                                                                                           \
+        aug_vm_release(lhs);                                                                                \
+    aug_vm_release(rhs);                                                                                    \
+    AUG_VM_NEXT;                                                                                            \
+}
+
+// Fused binary comparison, jumps to the address operand if the result is false
+#define AUG_OPCODE_BINOP_JUMP_ZERO(opfunc, str)                                                             \
+{                                                                                                           \
+    const int instruction_offset = aug_vm_read_int(context);                                                \
+    aug_value* rhs = aug_vm_pop(context);                                                                   \
+    aug_value* lhs = aug_vm_pop(context);                                                                   \
+    aug_value cond = aug_none();                                                                            \
+    if (!opfunc(&cond, lhs, rhs))                                                                           \
+        aug_log_vm_error(context, "%s %s %s not defined", aug_type_label(lhs), str, aug_type_label(rhs));   \
+    else if(aug_to_bool(&cond) == 0)                                                                        \
+        context->instruction = context->bytecode + instruction_offset;                                      \
+    aug_vm_release(lhs);                                                                                    \
+    aug_vm_release(rhs);                                                                                    \
+    aug_vm_release(&cond);                                                                                  \
+    AUG_VM_NEXT;                                                                                            \
+}
+
+#if AUG_QUICKEN
+// Rewrites the opcode of the executing instruction. Contexts created for other threads quicken their own bytecode copy
+#define AUG_VM_QUICKEN(opcode) (*(char*)context->last_instruction = (char)AUG_OPCODE_##opcode)
+
+// Quickens a generic binary operation to its int or float variant if both operands on the stack are of that type
+#define AUG_VM_QUICKEN_BINOP(opcode)                                                                        \
+    aug_vm_quicken_binop(context, AUG_OPCODE_##opcode##_INT_INT, AUG_OPCODE_##opcode##_FLOAT_FLOAT);
+#else
+#define AUG_VM_QUICKEN(opcode)
+#define AUG_VM_QUICKEN_BINOP(opcode)
+#endif//AUG_QUICKEN
+
+static inline void aug_vm_quicken_binop(aug_context* context, aug_opcode int_opcode, aug_opcode float_opcode)
 {
-    if(vm == NULL)
+    const aug_value* rhs = aug_vm_top(context);
+    const aug_value* lhs = rhs - 1;
+    const aug_type type = aug_value_type(lhs);
+    if(type != aug_value_type(rhs))
         return;
 
-    vm->running = true; 
-    while(vm->instruction)
-    {
-        vm->last_instruction = vm->instruction;
-
-        aug_opcode opcode = (aug_opcode)(*vm->instruction++);
-        switch(opcode)
-        {
-            case AUG_OPCODE_ADD:      AUG_OPCODE_BINOP(aug_add, "+");
-            case AUG_OPCODE_SUB:      AUG_OPCODE_BINOP(aug_sub, "-");
-            case AUG_OPCODE_MUL:      AUG_OPCODE_BINOP(aug_mul, "*");
-            case AUG_OPCODE_DIV:      AUG_OPCODE_BINOP(aug_div, "/");
-            case AUG_OPCODE_POW:      AUG_OPCODE_BINOP(aug_pow, "^");
-            case AUG_OPCODE_MOD:      AUG_OPCODE_BINOP(aug_mod, "%");
-            case AUG_OPCODE_AND:      AUG_OPCODE_BINOP(aug_and, "and");
-            case AUG_OPCODE_OR:       AUG_OPCODE_BINOP(aug_or,  "or");
-            case AUG_OPCODE_LT:       AUG_OPCODE_BINOP(aug_lt,  "<");
-            case AUG_OPCODE_LTE:      AUG_OPCODE_BINOP(aug_lte, "<=");
-            case AUG_OPCODE_GT:       AUG_OPCODE_BINOP(aug_gt,  ">");
-            case AUG_OPCODE_GTE:      AUG_OPCODE_BINOP(aug_gte, ">=");
-            case AUG_OPCODE_EQ:       AUG_OPCODE_BINOP(aug_eq,  "==");
-            case AUG_OPCODE_NEQ:      AUG_OPCODE_BINOP(aug_neq, "!=");
-            case AUG_OPCODE_APPROXEQ: AUG_OPCODE_BINOP(aug_approxeq, "~=");
-            case AUG_OPCODE_NOT:      AUG_OPCODE_UNOP(aug_not, "!");
-            case AUG_OPCODE_NO_OP:
-                break;
-            case AUG_OPCODE_EXIT:
-            {
-                vm->instruction = NULL;
-                break;
-            }
-            case AUG_OPCODE_POP:
-            {
-                int delta = aug_vm_read_int(vm);
-                while(--delta >= 0)
-                    aug_decref(aug_vm_pop(vm));
-                break;
-            }
-            case AUG_OPCODE_PUSH_NONE:
-            {
-                aug_value* value = aug_vm_push(vm);
-                if(value == NULL)
-                    break;
-                value->type = AUG_NONE;
-                break;
-            }
-            case AUG_OPCODE_PUSH_BOOL:
-            {
-                aug_value* value = aug_vm_push(vm);
-                if(value == NULL)
-                    break;
-                aug_set_bool(value, aug_vm_read_bool(vm));
-                break;
-            }
-            case AUG_OPCODE_PUSH_INT:   
-            {
-                aug_value* value = aug_vm_push(vm);
-                if(value == NULL) 
-                    break;
-                aug_set_int(value, aug_vm_read_int(vm));
-                break;
-            }
-            case AUG_OPCODE_PUSH_CHAR:   
-            {
-                aug_value* value = aug_vm_push(vm);
-                if(value == NULL) 
-                    break;
-                aug_set_char(value, aug_vm_read_char(vm));
-                break;
-            }
-            case AUG_OPCODE_PUSH_FLOAT:
-            {
-                aug_value* value = aug_vm_push(vm);
-                if(value == NULL) 
-                    break;
-                aug_set_float(value, aug_vm_read_float(vm));
-                break;
-            }                                  
-            case AUG_OPCODE_PUSH_STRING:
-            {
-                aug_value value;
-                aug_set_string(&value, aug_vm_read_bytes(vm));
-
-                aug_value* top = aug_vm_push(vm);                
-                aug_move(top, &value);
-                break;
-            }
-           case AUG_OPCODE_PUSH_ARRAY:
-            {
-                aug_value value;
-                aug_set_array(&value);
+    if(type == AUG_INT)
+        *(char*)context->last_instruction = (char)int_opcode;
+    else if(type == AUG_FLOAT)
+        *(char*)context->last_instruction = (char)float_opcode;
+}
 
-                int count = aug_vm_read_int(vm);
-                while(--count >= 0)
-                {
-                    aug_value* arg = aug_vm_pop(vm);
-                    aug_value* element = aug_array_push(value.array);
-                    if(element != NULL) 
-                    {
-                        *element = aug_none();
-                        aug_move(element, arg);
-                    }
-                }
+// Quickened binary operation on two operands of the given number type. The result replaces the lhs operand in place,
+// as numbers are not reference counted. Otherwise, reverts the instruction to the generic opcode and executes it
+#define AUG_OPCODE_BINOP_QUICK(generic, type, opfunc, str, set_func, expr)                                 \
+{                                                                                                           \
+    aug_value* rhs = aug_vm_top(context);                                                                   \
+    aug_value* lhs = rhs - 1;                                                                               \
+    if(aug_value_type(lhs) == type && aug_value_type(rhs) == type)                                          \
+    {                                                                                                       \
+        --context->stack_index;                                                                             \
+        set_func(lhs, expr);                                                                                \
+        AUG_VM_NEXT;                                                                                        \
+    }                                                                                                       \
+    AUG_VM_QUICKEN(generic);                                                                                \
+    AUG_OPCODE_BINOP(opfunc, str);                                                                          \
+}
+
+// Quickened fused comparison on two operands of the given number type, jumps to the address operand if false
+#define AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(generic, type, opfunc, str, expr)                                  \
+{                                                                                                           \
+    aug_value* rhs = aug_vm_top(context);                                                                   \
+    aug_value* lhs = rhs - 1;                                                                               \
+    if(aug_value_type(lhs) == type && aug_value_type(rhs) == type)                                          \
+    {                                                                                                       \
+        const int instruction_offset = aug_vm_read_int(context);                                            \
+        context->stack_index -= 2;                                                                          \
+        if(!(expr))                                                                                         \
+            context->instruction = context->bytecode + instruction_offset;                                  \
+        AUG_VM_NEXT;                                                                                        \
+    }                                                                                                       \
+    AUG_VM_QUICKEN(generic);                                                                                \
+    AUG_OPCODE_BINOP_JUMP_ZERO(opfunc, str);                                                                \
+}
+
+// Three address operation of the register backend, stores the result in the destination register. Numbers of the same 
+// type are computed inline. Variables are not owned by the operation, so a string or array variable is only appended 
+// to in place if it is also the destination, and not the right operand
+#define AUG_OPCODE_BINOP_REG(opfunc, str, int_set_func, int_expr, float_set_func, float_expr)              \
+{                                                                                                           \
+    const int dst = aug_vm_read_int(context);                                                               \
+    const int src = aug_vm_read_int(context);                                                               \
+    aug_value lhs_immediate, rhs_immediate;                                                                 \
+    aug_value* rhs = aug_vm_get_register(context, AUG_REGISTER_RHS(src), &rhs_immediate);                  \
+    aug_value* lhs = aug_vm_get_register(context, AUG_REGISTER_LHS(src), &lhs_immediate);                  \
+    aug_value target = aug_none();                                                                          \
+    if(lhs == NULL || rhs == NULL)                                                                          \
+        aug_log_vm_error(context, "Invalid register");                                                      \
+    else if(aug_value_type(lhs) == AUG_INT && aug_value_type(rhs) == AUG_INT)                               \
+        int_set_func(&target, int_expr);                                                                    \
+    else if(aug_value_type(lhs) == AUG_FLOAT && aug_value_type(rhs) == AUG_FLOAT)                           \
+        float_set_func(&target, float_expr);                                                                \
+    else                                                                                                    \
+    {                                                                                                       \
+        aug_value shared = *lhs;                                                                            \
+        const bool borrowed = aug_value_type(lhs) >= AUG_STRING                                             \
+            && AUG_REGISTER_KIND(AUG_REGISTER_LHS(src)) != AUG_REGISTER_STACK                               \
+            && (AUG_REGISTER_LHS(src) != dst || (aug_value_type(lhs) == aug_value_type(rhs)                  \
+                && aug_value_pointer(lhs) == aug_value_pointer(rhs)));                                      \
+        if(borrowed)                                                                                        \
+            aug_incref(&shared);                                                                            \
+        if(!opfunc(&target, &shared, rhs))                                                                  \
+            aug_log_vm_error(context, "%s %s %s not defined", aug_type_label(lhs), str, aug_type_label(rhs));\
+        if(borrowed)                                                                                        \
+            aug_decref(&shared);                                                                            \
+    }                                                                                                       \
+    aug_vm_release_register(AUG_REGISTER_LHS(src), lhs);                                                    \
+    aug_vm_release_register(AUG_REGISTER_RHS(src), rhs);                                                    \
+    aug_vm_set_register(context, dst, &target);                                                             \
+    AUG_VM_NEXT;                                                                                            \
+}
+
+// Fused comparison of the register backend, jumps to the address operand if false
+#define AUG_OPCODE_BINOP_JUMP_ZERO_REG(opfunc, str, int_expr, float_expr)                                   \
+{                                                                                                           \
+    const int instruction_offset = aug_vm_read_int(context);                                                \
+    const int src = aug_vm_read_int(context);                                                               \
+    aug_value lhs_immediate, rhs_immediate;                                                                 \
+    aug_value* rhs = aug_vm_get_register(context, AUG_REGISTER_RHS(src), &rhs_immediate);                  \
+    aug_value* lhs = aug_vm_get_register(context, AUG_REGISTER_LHS(src), &lhs_immediate);                  \
+    if(lhs == NULL || rhs == NULL)                                                                          \
+        aug_log_vm_error(context, "Invalid register");                                                      \
+    else if(aug_value_type(lhs) == AUG_INT && aug_value_type(rhs) == AUG_INT)                               \
+    {                                                                                                       \
+        if(!(int_expr))                                                                                     \
+            context->instruction = context->bytecode + instruction_offset;                                  \
+    }                                                                                                       \
+    else if(aug_value_type(lhs) == AUG_FLOAT && aug_value_type(rhs) == AUG_FLOAT)                           \
+    {                                                                                                       \
+        if(!(float_expr))                                                                                   \
+            context->instruction = context->bytecode + instruction_offset;                                  \
+    }                                                                                                       \
+    else                                                                                                    \
+    {                                                                                                       \
+        aug_value cond = aug_none();                                                                        \
+        if (!opfunc(&cond, lhs, rhs))                                                                       \
+            aug_log_vm_error(context, "%s %s %s not defined", aug_type_label(lhs), str, aug_type_label(rhs));\
+        else if(aug_to_bool(&cond) == 0)                                                                    \
+            context->instruction = context->bytecode + instruction_offset;                                  \
+        aug_vm_release(&cond);                                                                              \
+    }                                                                                                       \
+    aug_vm_release_register(AUG_REGISTER_LHS(src), lhs);                                                    \
+    aug_vm_release_register(AUG_REGISTER_RHS(src), rhs);                                                    \
+    AUG_VM_NEXT;                                                                                            \
+}
+
+// Copies the source register to the destination register
+#define AUG_VM_OP_MOVE_REG()                                                                                \
+{                                                                                                           \
+    const int dst = aug_vm_read_int(context);                                                               \
+    const int src = AUG_REGISTER_LHS(aug_vm_read_int(context));                                             \
+    aug_value immediate;                                                                                    \
+    aug_value* value = aug_vm_get_register(context, src, &immediate);                                       \
+    if(value == NULL)                                                                                       \
+    {                                                                                                       \
+        aug_log_vm_error(context, "Invalid register");                                                      \
+        AUG_VM_NEXT;                                                                                        \
+    }                                                                                                       \
+    aug_value copy = *value;                                                                                \
+    if(AUG_REGISTER_KIND(src) == AUG_REGISTER_STACK)                                                        \
+        *value = aug_none();                                                                                \
+    else if(aug_value_type(&copy) >= AUG_STRING)                                                            \
+        aug_incref(&copy);                                                                                  \
+    aug_vm_set_register(context, dst, &copy);                                                               \
+    AUG_VM_NEXT;                                                                                            \
+}
+
+#define AUG_VM_OP_EXIT()                                                                                \
+{                                                                                                       \
+    context->instruction = NULL;                                                                        \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_POP()                                                                                 \
+{                                                                                                       \
+    int delta = aug_vm_read_int(context);                                                               \
+    while(--delta >= 0)                                                                                 \
+        aug_decref(aug_vm_pop(context));                                                                \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_NONE()                                                                           \
+{                                                                                                       \
+    aug_value* value = aug_vm_push(context);                                                            \
+    if(value == NULL)                                                                                   \
+        AUG_VM_NEXT;                                                                                    \
+    aug_value_init_type(value, AUG_NONE);                                                               \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_BOOL()                                                                           \
+{                                                                                                       \
+    aug_value* value = aug_vm_push(context);                                                            \
+    if(value == NULL)                                                                                   \
+        AUG_VM_NEXT;                                                                                    \
+    aug_set_bool(value, aug_vm_read_bool(context));                                                     \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_INT()                                                                            \
+{                                                                                                       \
+    aug_value* value = aug_vm_push(context);                                                            \
+    if(value == NULL)                                                                                   \
+        AUG_VM_NEXT;                                                                                    \
+    aug_set_int(value, aug_vm_read_int(context));                                                       \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_CHAR()                                                                           \
+{                                                                                                       \
+    aug_value* value = aug_vm_push(context);                                                            \
+    if(value == NULL)                                                                                   \
+        AUG_VM_NEXT;                                                                                    \
+    aug_set_char(value, aug_vm_read_char(context));                                                     \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_FLOAT()                                                                          \
+{                                                                                                       \
+    aug_value* value = aug_vm_push(context);                                                            \
+    if(value == NULL)                                                                                   \
+        AUG_VM_NEXT;                                                                                    \
+    aug_set_float(value, aug_vm_read_float(context));                                                   \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_STRING()                                                                                \
+{                                                                                                              \
+    /* Shares the buffer of the script's constant string, copied by the first modification */                 \
+    const int index = aug_vm_read_int(context);                                                                \
+    aug_value* top = aug_vm_push(context);                                                                     \
+    if(top == NULL)                                                                                            \
+        AUG_VM_NEXT;                                                                                           \
+    aug_string* string = aug_string_share(aug_container_at_type(aug_string*, context->constants, index));      \
+    aug_value_init_pointer(top, AUG_STRING, string);                                                           \
+    AUG_VM_NEXT;                                                                                               \
+}
+
+#define AUG_VM_OP_PUSH_ARRAY()                                                                          \
+{                                                                                                       \
+    aug_value value;                                                                                    \
+    aug_set_array(&value);                                                                              \
+                                                                                                        \
+    int count = aug_vm_read_int(context);                                                               \
+    while(--count >= 0)                                                                                 \
+    {                                                                                                   \
+        aug_value* arg = aug_vm_pop(context);                                                           \
+        aug_value* element = aug_array_push(aug_value_array(&value));                                   \
+        if(element != NULL)                                                                             \
+        {                                                                                               \
+            *element = aug_none();                                                                      \
+            aug_move(element, arg);                                                                     \
+        }                                                                                               \
+    }                                                                                                   \
+                                                                                                        \
+    aug_value* top = aug_vm_push(context);                                                              \
+    aug_move(top, &value);                                                                              \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_MAP()                                                                            \
+{                                                                                                       \
+    aug_value value;                                                                                    \
+    aug_set_map(&value);                                                                                \
+                                                                                                        \
+    int count = aug_vm_read_int(context);                                                               \
+    while (--count >= 0)                                                                                \
+    {                                                                                                   \
+        aug_value* arg_value = aug_vm_pop(context);                                                     \
+        aug_value* arg_key = aug_vm_pop(context);                                                       \
+        aug_map_insert(aug_value_map(&value), arg_key, arg_value);                                      \
+        aug_decref(arg_key);                                                                            \
+        aug_decref(arg_value);                                                                          \
+    }                                                                                                   \
+                                                                                                        \
+    aug_value* top = aug_vm_push(context);                                                              \
+    aug_move(top, &value);                                                                              \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_FUNC()                                                                           \
+{                                                                                                       \
+    int func_addr = aug_vm_read_int(context);                                                           \
+    aug_value* value = aug_vm_push(context);                                                            \
+    if(value == NULL)                                                                                   \
+        AUG_VM_NEXT;                                                                                    \
+    aug_set_func(value, func_addr);                                                                     \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_LOCAL()                                                                          \
+{                                                                                                       \
+    const int stack_offset = aug_vm_read_int(context);                                                  \
+    aug_value* local = aug_vm_get_local(context, stack_offset);                                         \
+                                                                                                        \
+    aug_value* top = aug_vm_push(context);                                                              \
+    aug_assign(top, local);                                                                             \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_GLOBAL()                                                                         \
+{                                                                                                       \
+    const int stack_offset = aug_vm_read_int(context);                                                  \
+    aug_value* local = aug_vm_get_global(context, stack_offset);                                        \
+                                                                                                        \
+    aug_value* top = aug_vm_push(context);                                                              \
+    aug_assign(top, local);                                                                             \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_ELEMENT()                                                                        \
+{                                                                                                       \
+    aug_value* container = aug_vm_pop(context);                                                         \
+    aug_value* index = aug_vm_pop(context);                                                             \
+                                                                                                        \
+    aug_value value = aug_none();                                                                       \
+    if(!aug_get_element(container, index, &value))                                                      \
+        aug_log_vm_error(context, "Index out of range error"); /* TODO: more descriptive */             \
+    aug_decref(container);                                                                              \
+    aug_decref(index);                                                                                  \
+                                                                                                        \
+    aug_value* top = aug_vm_push(context);                                                              \
+    aug_assign(top, &value);                                                                            \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_PUSH_RANGE()                                                                                                                           \
+{                                                                                                                                                        \
+    aug_value* to = aug_vm_pop(context);                                                                                                                 \
+    aug_value* from = aug_vm_pop(context);                                                                                                               \
+                                                                                                                                                         \
+    aug_value value = aug_none();                                                                                                                        \
+    if(!aug_set_range(&value, from, to))                                                                                                                 \
+        aug_log_vm_error(context, "Could not create a range from type %s to %s", aug_type_label(from), aug_type_label(to)); /* TODO: more descriptive */ \
+    aug_decref(to);                                                                                                                                      \
+    aug_decref(from);                                                                                                                                    \
+                                                                                                                                                         \
+    aug_value* top = aug_vm_push(context);                                                                                                               \
+    aug_move(top, &value);                                                                                                                               \
+    AUG_VM_NEXT;                                                                                                                                         \
+}
+
+#define AUG_VM_OP_PUSH_ITERATOR()                                                                                       \
+{                                                                                                                       \
+    aug_value* iterable = aug_vm_pop(context);                                                                          \
+                                                                                                                        \
+    /* Create new iterator, move into iterable slot. Iterator retains pointer to iterable */                            \
+    aug_value value;                                                                                                    \
+    if(!aug_set_iterator(&value, iterable))                                                                             \
+        aug_log_vm_error(context, "Type %s is not an iterable", aug_type_label(iterable)); /* TODO: more descriptive */ \
+                                                                                                                        \
+    aug_value* top = aug_vm_push(context);                                                                              \
+    aug_move(top, &value);                                                                                              \
+    AUG_VM_NEXT;                                                                                                        \
+}
+
+#define AUG_VM_OP_ITERATE()                                                                             \
+{                                                                                                       \
+    const int stack_offset = aug_vm_read_int(context);                                                  \
+    aug_value* iterator = aug_vm_get_local(context, stack_offset);                                      \
+                                                                                                        \
+    aug_value element;                                                                                  \
+    bool success = aug_iterate(iterator, &element);                                                     \
+                                                                                                        \
+    if(success)                                                                                         \
+    {                                                                                                   \
+        aug_value* value = aug_vm_push(context);                                                        \
+        if(value != NULL)                                                                               \
+            aug_assign(value, &element);                                                                \
+    }                                                                                                   \
+                                                                                                        \
+    aug_value* condition = aug_vm_push(context);                                                        \
+    if(condition != NULL)                                                                               \
+        aug_set_bool(condition, success);                                                               \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_RANGE_BEGIN()                                                                                                      \
+{                                                                                                                                    \
+    const int instruction_offset = aug_vm_read_int(context);                                                                         \
+    const int stack_offset = aug_vm_read_int(context);                                                                               \
+                                                                                                                                     \
+    /* Range slots are the counter, bound and variable */                                                                            \
+    aug_value* counter = aug_vm_get_local(context, stack_offset);                                                                    \
+    aug_value* bound = counter + 1;                                                                                                  \
+    if(aug_value_type(counter) != AUG_INT || aug_value_type(bound) != AUG_INT)                                                       \
+    {                                                                                                                                \
+        aug_log_vm_error(context, "Could not create a range from type %s to %s", aug_type_label(counter), aug_type_label(bound));    \
+        AUG_VM_NEXT;                                                                                                                 \
+    }                                                                                                                                \
+                                                                                                                                     \
+    if(aug_value_int(counter) < aug_value_int(bound))                                                                                \
+    {                                                                                                                                \
+        aug_value* element = counter + 2;                                                                                            \
+        aug_vm_release(element);                                                                                                     \
+        aug_value_init_int(element, AUG_INT, aug_value_int(counter));                                                                \
+        aug_value_init_int(counter, AUG_INT, aug_value_int(counter) + 1);                                                            \
+    }                                                                                                                                \
+    else                                                                                                                             \
+        context->instruction = context->bytecode + instruction_offset;                                                               \
+    AUG_VM_NEXT;                                                                                                                     \
+}
+
+#define AUG_VM_OP_RANGE_NEXT()                                                                          \
+{                                                                                                       \
+    const int instruction_offset = aug_vm_read_int(context);                                            \
+    const int stack_offset = aug_vm_read_int(context);                                                  \
+                                                                                                        \
+    /* Types were checked by RANGE_BEGIN, the slots are not accessible to the script */                 \
+    aug_value* counter = aug_vm_get_local(context, stack_offset);                                       \
+    if(aug_value_int(counter) < aug_value_int(counter + 1))                                             \
+    {                                                                                                   \
+        aug_value* element = counter + 2;                                                               \
+        aug_vm_release(element);                                                                        \
+        aug_value_init_int(element, AUG_INT, aug_value_int(counter));                                   \
+        aug_value_init_int(counter, AUG_INT, aug_value_int(counter) + 1);                               \
+        context->instruction = context->bytecode + instruction_offset;                                  \
+        AUG_VM_JIT_LOOP();                                                                              \
+    }                                                                                                   \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_LOAD_LOCAL()                                                                          \
+{                                                                                                       \
+    const int stack_offset = aug_vm_read_int(context);                                                  \
+    aug_value* local = aug_vm_get_local(context, stack_offset);                                         \
+    aug_value* top = aug_vm_pop(context);                                                               \
+    aug_move(local, top);                                                                               \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_LOAD_GLOBAL()                                                                         \
+{                                                                                                       \
+    const int stack_offset = aug_vm_read_int(context);                                                  \
+    aug_value* global = aug_vm_get_global(context, stack_offset);                                       \
+    aug_value* top = aug_vm_pop(context);                                                               \
+    aug_move(global, top);                                                                              \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_LOAD_ELEMENT()                                                                                 \
+{                                                                                                                \
+    aug_value* container = aug_vm_pop(context);                                                                  \
+    aug_value* index = aug_vm_pop(context);                                                                      \
+    aug_value* value = aug_vm_pop(context);                                                                      \
+    if(!aug_set_element(container, index, value))                                                                \
+        aug_log_vm_error(context, "Index out of range error"); /* TODO: more descriptive */                      \
+    aug_decref(container);                                                                                       \
+    aug_decref(index);                                                                                           \
+    aug_decref(value);                                                                                           \
+    AUG_VM_NEXT;                                                                                                 \
+}
+
+#define AUG_VM_OP_JUMP()                                                                                \
+{                                                                                                       \
+    const int instruction_offset = aug_vm_read_int(context);                                            \
+    context->instruction = context->bytecode + instruction_offset;                                      \
+    AUG_VM_JIT_LOOP();                                                                                  \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_JUMP_NZERO()                                                                          \
+{                                                                                                       \
+    const int instruction_offset = aug_vm_read_int(context);                                            \
+    aug_value* cond = aug_vm_pop(context);                                                              \
+    if(aug_to_bool(cond) != 0)                                                                          \
+        context->instruction = context->bytecode + instruction_offset;                                  \
+    aug_decref(cond);                                                                                   \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_JUMP_ZERO()                                                                           \
+{                                                                                                       \
+    const int instruction_offset = aug_vm_read_int(context);                                            \
+    aug_value* cond = aug_vm_pop(context);                                                              \
+    if(aug_to_bool(cond) == 0)                                                                          \
+        context->instruction = context->bytecode + instruction_offset;                                  \
+    aug_decref(cond);                                                                                   \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_CALL_FRAME()                                                                          \
+{                                                                                                       \
+    const int ret_addr = aug_vm_read_int(context);                                                      \
+    aug_vm_push_call_frame(context, ret_addr);                                                          \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_CALL()                                                                                \
+{                                                                                                       \
+    const int func_addr = aug_vm_read_int(context);                                                     \
+    context->instruction = context->bytecode + func_addr;                                               \
+    context->base_index = context->stack_index;                                                         \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_CALL_TOP()                                                                            \
+{                                                                                                       \
+    aug_value* top = aug_vm_pop(context);                                                               \
+    if(top == NULL || aug_value_type(top) != AUG_FUNCTION)                                              \
+    {                                                                                                   \
+        aug_string* symbol = aug_vm_get_marker_symbol(context, sizeof(int));                            \
+        aug_log_vm_error(context, "Unnamed value %s is not a function",                                 \
+            symbol ? symbol->buffer : "(anonymous)");                                                   \
+        AUG_VM_NEXT;                                                                                    \
+    }                                                                                                   \
+                                                                                                        \
+    const int func_addr = aug_value_int(top);                                                           \
+    context->instruction = context->bytecode + func_addr;                                               \
+    context->base_index = context->stack_index;                                                         \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_CALL_LOCAL()                                                                          \
+{                                                                                                       \
+    const int stack_offset = aug_vm_read_int(context);                                                  \
+    aug_value* local = aug_vm_get_local(context, stack_offset);                                         \
+    if(local == NULL || aug_value_type(local) != AUG_FUNCTION)                                          \
+    {                                                                                                   \
+        aug_string* symbol = aug_vm_get_marker_symbol(context, sizeof(int));                            \
+        aug_log_vm_error(context, "Local variable %s can not a function",                               \
+            symbol ? symbol->buffer : "(anonymous)");                                                   \
+        AUG_VM_NEXT;                                                                                    \
+    }                                                                                                   \
+                                                                                                        \
+    const int func_addr = aug_value_int(local);                                                         \
+    context->instruction = context->bytecode + func_addr;                                               \
+    context->base_index = context->stack_index;                                                         \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_CALL_GLOBAL()                                                                         \
+{                                                                                                       \
+    const int stack_offset = aug_vm_read_int(context);                                                  \
+    aug_value* global = aug_vm_get_global(context, stack_offset);                                       \
+    if(global == NULL || aug_value_type(global) != AUG_FUNCTION)                                        \
+    {                                                                                                   \
+        aug_string* symbol = aug_vm_get_marker_symbol(context, sizeof(int));                            \
+        aug_log_vm_error(context, "Global variable %s can not a function",                              \
+            symbol ? symbol->buffer : "(anonymous)");                                                   \
+        AUG_VM_NEXT;                                                                                    \
+    }                                                                                                   \
+                                                                                                        \
+    context->instruction = context->bytecode + aug_value_int(global);                                   \
+    context->base_index = context->stack_index;                                                         \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_CALL_EXT()                                                                                         \
+{                                                                                                                    \
+    const int slot = aug_vm_read_int(context);                                                                       \
+    const int arg_count = aug_vm_read_int(context);                                                                  \
+                                                                                                                     \
+    /* Resolve all the script's extension slots if extensions were registered or unregistered since last resolved */ \
+    if(context->extension_version != context->vm->extensions_version)                                                \
+        aug_vm_resolve_extensions(context);                                                                          \
+                                                                                                                     \
+    if(context->extension_names == NULL || slot < 0 || (size_t)slot >= context->extension_names->length)             \
+    {                                                                                                                \
+        aug_log_vm_error(context, "Extension function call slot %d is invalid", slot);                               \
+        AUG_VM_NEXT;                                                                                                 \
+    }                                                                                                                \
+                                                                                                                     \
+    aug_extension_func* func = context->extension_slots[slot];                                                       \
+    if(func == NULL)                                                                                                 \
+    {                                                                                                                \
+        const aug_string* func_name = aug_container_at_type(aug_string*, context->extension_names, slot);            \
+        aug_log_vm_error(context, "Extension function %s not registered", func_name->buffer);                        \
+        AUG_VM_NEXT;                                                                                                 \
+    }                                                                                                                \
+                                                                                                                     \
+    if(context->stack_index - context->base_index < arg_count)                                                       \
+    {                                                                                                                \
+        aug_log_vm_error(context, "Extension function call expected %d arguments on stack", arg_count);              \
+        AUG_VM_NEXT;                                                                                                 \
+    }                                                                                                                \
+                                                                                                                     \
+    /* Arguments are passed in place from the top of the stack */                                                    \
+    aug_value* args = &context->stack[context->stack_index - arg_count];                                             \
+    aug_value ret_value = func(arg_count, args);                                                                     \
+                                                                                                                     \
+    /* Cleanup arguments */                                                                                          \
+    for(int i = 0; i < arg_count; ++i)                                                                               \
+        aug_decref(aug_vm_pop(context));                                                                             \
+                                                                                                                     \
+    /* Return on top */                                                                                              \
+    aug_value* top = aug_vm_push(context);                                                                           \
+    if(top)                                                                                                          \
+        aug_move(top, &ret_value);                                                                                   \
+    AUG_VM_NEXT;                                                                                                     \
+}
+
+#define AUG_VM_OP_ARG_COUNT()                                                                           \
+{                                                                                                       \
+    context->arg_count = aug_vm_read_int(context);                                                      \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_ENTER_FUNC()                                                                               \
+{                                                                                                            \
+    const int param_count = aug_vm_read_int(context);                                                        \
+    if (context->arg_count != param_count)                                                                   \
+    {                                                                                                        \
+        aug_string* symbol = aug_vm_get_marker_symbol(context, sizeof(int));                                 \
+        aug_log_vm_error(context, "Incorrect number of arguments passed to %s. Received %d expected %d ",    \
+            symbol ? symbol->buffer : "anonymous", context->arg_count, param_count);                         \
+        AUG_VM_NEXT;                                                                                         \
+    }                                                                                                        \
+    AUG_VM_JIT_ENTER();                                                                                      \
+    AUG_VM_NEXT;                                                                                             \
+}
+
+#define AUG_VM_OP_RETURN_FUNC()                                                                         \
+{                                                                                                       \
+    /* get func return value */                                                                         \
+    aug_value* ret_value = aug_vm_pop(context);                                                         \
+                                                                                                        \
+    /* Free locals */                                                                                   \
+    const int delta = aug_vm_read_int(context);                                                         \
+    for(int i = 0; i < delta; ++i)                                                                      \
+        aug_decref(aug_vm_pop(context));                                                                \
+                                                                                                        \
+    /* Restore base index */                                                                            \
+    aug_value* ret_base = aug_vm_pop(context);                                                          \
+    if(ret_base == NULL)                                                                                \
+    {                                                                                                   \
+        aug_log_vm_error(context, "Calling frame setup incorrectly. Stack missing stack base");         \
+        AUG_VM_NEXT;                                                                                    \
+    }                                                                                                   \
+                                                                                                        \
+    context->base_index = aug_value_int(ret_base);                                                      \
+    aug_decref(ret_base);                                                                               \
+                                                                                                        \
+    /* jump to return instruction */                                                                    \
+    aug_value* ret_addr = aug_vm_pop(context);                                                          \
+    if(ret_addr == NULL)                                                                                \
+    {                                                                                                   \
+        aug_log_vm_error(context, "Calling frame setup incorrectly. Stack missing return address");     \
+        AUG_VM_NEXT;                                                                                    \
+    }                                                                                                   \
+                                                                                                        \
+    if(aug_value_int(ret_addr) == AUG_OPCODE_INVALID)                                                   \
+        context->instruction = NULL;                                                                    \
+    else                                                                                                \
+        context->instruction = context->bytecode + aug_value_int(ret_addr);                             \
+    aug_decref(ret_addr);                                                                               \
+                                                                                                        \
+    /* push return value back onto stack, for callee */                                                 \
+    aug_value* top = aug_vm_push(context);                                                              \
+    if(ret_value != NULL && top != NULL)                                                                \
+        aug_move(top, ret_value);                                                                       \
+                                                                                                        \
+    AUG_VM_JIT_RESUME();                                                                                \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OP_IMPORT_LIB()                                                                          \
+{                                                                                                       \
+    aug_vm_lib_load(context, aug_vm_read_bytes(context));                                               \
+    AUG_VM_NEXT;                                                                                        \
+}
+
+#define AUG_VM_OPCODE_HANDLERS                                                                                          \
+    AUG_VM_HANDLER(ADD,                         AUG_VM_QUICKEN_BINOP(ADD) AUG_OPCODE_BINOP(aug_add, "+"))               \
+    AUG_VM_HANDLER(SUB,                         AUG_VM_QUICKEN_BINOP(SUB) AUG_OPCODE_BINOP(aug_sub, "-"))               \
+    AUG_VM_HANDLER(MUL,                         AUG_VM_QUICKEN_BINOP(MUL) AUG_OPCODE_BINOP(aug_mul, "*"))               \
+    AUG_VM_HANDLER(DIV,                         AUG_VM_QUICKEN_BINOP(DIV) AUG_OPCODE_BINOP(aug_div, "/"))               \
+    AUG_VM_HANDLER(POW,                         AUG_OPCODE_BINOP(aug_pow, "^"))                                         \
+    AUG_VM_HANDLER(MOD,                         AUG_OPCODE_BINOP(aug_mod, "%"))                                         \
+    AUG_VM_HANDLER(AND,                         AUG_OPCODE_BINOP(aug_and, "and"))                                       \
+    AUG_VM_HANDLER(OR,                          AUG_OPCODE_BINOP(aug_or,  "or"))                                        \
+    AUG_VM_HANDLER(LT,                          AUG_VM_QUICKEN_BINOP(LT) AUG_OPCODE_BINOP(aug_lt,  "<"))                \
+    AUG_VM_HANDLER(LTE,                         AUG_VM_QUICKEN_BINOP(LTE) AUG_OPCODE_BINOP(aug_lte, "<="))              \
+    AUG_VM_HANDLER(GT,                          AUG_VM_QUICKEN_BINOP(GT) AUG_OPCODE_BINOP(aug_gt,  ">"))                \
+    AUG_VM_HANDLER(GTE,                         AUG_VM_QUICKEN_BINOP(GTE) AUG_OPCODE_BINOP(aug_gte, ">="))              \
+    AUG_VM_HANDLER(EQ,                          AUG_VM_QUICKEN_BINOP(EQ) AUG_OPCODE_BINOP(aug_eq,  "=="))               \
+    AUG_VM_HANDLER(NEQ,                         AUG_VM_QUICKEN_BINOP(NEQ) AUG_OPCODE_BINOP(aug_neq, "!="))              \
+    AUG_VM_HANDLER(APPROXEQ,                    AUG_OPCODE_BINOP(aug_approxeq, "~="))                                   \
+    AUG_VM_HANDLER(NOT,                         AUG_OPCODE_UNOP(aug_not, "!"))                                          \
+    AUG_VM_HANDLER(NO_OP,                       AUG_VM_NEXT;)                                                           \
+    AUG_VM_HANDLER(EXIT,                        AUG_VM_OP_EXIT())                                                       \
+    AUG_VM_HANDLER(POP,                         AUG_VM_OP_POP())                                                        \
+    AUG_VM_HANDLER(PUSH_NONE,                   AUG_VM_OP_PUSH_NONE())                                                  \
+    AUG_VM_HANDLER(PUSH_BOOL,                   AUG_VM_OP_PUSH_BOOL())                                                  \
+    AUG_VM_HANDLER(PUSH_INT,                    AUG_VM_OP_PUSH_INT())                                                   \
+    AUG_VM_HANDLER(PUSH_CHAR,                   AUG_VM_OP_PUSH_CHAR())                                                  \
+    AUG_VM_HANDLER(PUSH_FLOAT,                  AUG_VM_OP_PUSH_FLOAT())                                                 \
+    AUG_VM_HANDLER(PUSH_STRING,                 AUG_VM_OP_PUSH_STRING())                                                \
+    AUG_VM_HANDLER(PUSH_ARRAY,                  AUG_VM_OP_PUSH_ARRAY())                                                 \
+    AUG_VM_HANDLER(PUSH_MAP,                    AUG_VM_OP_PUSH_MAP())                                                   \
+    AUG_VM_HANDLER(PUSH_FUNC,                   AUG_VM_OP_PUSH_FUNC())                                                  \
+    AUG_VM_HANDLER(PUSH_LOCAL,                  AUG_VM_OP_PUSH_LOCAL())                                                 \
+    AUG_VM_HANDLER(PUSH_GLOBAL,                 AUG_VM_OP_PUSH_GLOBAL())                                                \
+    AUG_VM_HANDLER(PUSH_ELEMENT,                AUG_VM_OP_PUSH_ELEMENT())                                               \
+    AUG_VM_HANDLER(PUSH_RANGE,                  AUG_VM_OP_PUSH_RANGE())                                                 \
+    AUG_VM_HANDLER(PUSH_ITERATOR,               AUG_VM_OP_PUSH_ITERATOR())                                              \
+    AUG_VM_HANDLER(ITERATE,                     AUG_VM_OP_ITERATE())                                                    \
+    AUG_VM_HANDLER(RANGE_BEGIN,                 AUG_VM_OP_RANGE_BEGIN())                                                \
+    AUG_VM_HANDLER(RANGE_NEXT,                  AUG_VM_OP_RANGE_NEXT())                                                 \
+    AUG_VM_HANDLER(LOAD_LOCAL,                  AUG_VM_OP_LOAD_LOCAL())                                                 \
+    AUG_VM_HANDLER(LOAD_GLOBAL,                 AUG_VM_OP_LOAD_GLOBAL())                                                \
+    AUG_VM_HANDLER(LOAD_ELEMENT,                AUG_VM_OP_LOAD_ELEMENT())                                               \
+    AUG_VM_HANDLER(JUMP,                        AUG_VM_OP_JUMP())                                                       \
+    AUG_VM_HANDLER(JUMP_NZERO,                  AUG_VM_OP_JUMP_NZERO())                                                 \
+    AUG_VM_HANDLER(JUMP_ZERO,                   AUG_VM_OP_JUMP_ZERO())                                                  \
+    AUG_VM_HANDLER(CALL_FRAME,                  AUG_VM_OP_CALL_FRAME())                                                 \
+    AUG_VM_HANDLER(CALL,                        AUG_VM_OP_CALL())                                                       \
+    AUG_VM_HANDLER(CALL_TOP,                    AUG_VM_OP_CALL_TOP())                                                   \
+    AUG_VM_HANDLER(CALL_LOCAL,                  AUG_VM_OP_CALL_LOCAL())                                                 \
+    AUG_VM_HANDLER(CALL_GLOBAL,                 AUG_VM_OP_CALL_GLOBAL())                                                \
+    AUG_VM_HANDLER(CALL_EXT,                    AUG_VM_OP_CALL_EXT())                                                   \
+    AUG_VM_HANDLER(ARG_COUNT,                   AUG_VM_OP_ARG_COUNT())                                                  \
+    AUG_VM_HANDLER(ENTER_FUNC,                  AUG_VM_OP_ENTER_FUNC())                                                 \
+    AUG_VM_HANDLER(RETURN_FUNC,                 AUG_VM_OP_RETURN_FUNC())                                                \
+    AUG_VM_HANDLER(IMPORT_LIB,                  AUG_VM_OP_IMPORT_LIB())                                                 \
+    AUG_VM_HANDLER(ADD_LOCAL_INT,               AUG_OPCODE_BINOP_INT(aug_add, "+", aug_vm_get_local))                   \
+    AUG_VM_HANDLER(SUB_LOCAL_INT,               AUG_OPCODE_BINOP_INT(aug_sub, "-", aug_vm_get_local))                   \
+    AUG_VM_HANDLER(ADD_GLOBAL_INT,              AUG_OPCODE_BINOP_INT(aug_add, "+", aug_vm_get_global))                  \
+    AUG_VM_HANDLER(SUB_GLOBAL_INT,              AUG_OPCODE_BINOP_INT(aug_sub, "-", aug_vm_get_global))                  \
+    AUG_VM_HANDLER(ADD_ASSIGN_LOCAL,            AUG_OPCODE_ADD_ASSIGN(aug_vm_get_local))                                \
+    AUG_VM_HANDLER(ADD_ASSIGN_GLOBAL,           AUG_OPCODE_ADD_ASSIGN(aug_vm_get_global))                               \
+    AUG_VM_HANDLER(LT_JUMP_ZERO,                AUG_VM_QUICKEN_BINOP(LT_JUMP_ZERO) AUG_OPCODE_BINOP_JUMP_ZERO(aug_lt,  "<"))\
+    AUG_VM_HANDLER(LTE_JUMP_ZERO,               AUG_VM_QUICKEN_BINOP(LTE_JUMP_ZERO) AUG_OPCODE_BINOP_JUMP_ZERO(aug_lte, "<="))\
+    AUG_VM_HANDLER(GT_JUMP_ZERO,                AUG_VM_QUICKEN_BINOP(GT_JUMP_ZERO) AUG_OPCODE_BINOP_JUMP_ZERO(aug_gt,  ">"))\
+    AUG_VM_HANDLER(GTE_JUMP_ZERO,               AUG_VM_QUICKEN_BINOP(GTE_JUMP_ZERO) AUG_OPCODE_BINOP_JUMP_ZERO(aug_gte, ">="))\
+    AUG_VM_HANDLER(EQ_JUMP_ZERO,                AUG_VM_QUICKEN_BINOP(EQ_JUMP_ZERO) AUG_OPCODE_BINOP_JUMP_ZERO(aug_eq,  "=="))\
+    AUG_VM_HANDLER(NEQ_JUMP_ZERO,               AUG_VM_QUICKEN_BINOP(NEQ_JUMP_ZERO) AUG_OPCODE_BINOP_JUMP_ZERO(aug_neq, "!="))\
+    AUG_VM_HANDLER(ADD_INT_INT,                 AUG_OPCODE_BINOP_QUICK(ADD, AUG_INT, aug_add, "+", aug_set_int, aug_value_int(lhs) + aug_value_int(rhs)))\
+    AUG_VM_HANDLER(ADD_FLOAT_FLOAT,             AUG_OPCODE_BINOP_QUICK(ADD, AUG_FLOAT, aug_add, "+", aug_set_float, aug_value_float(lhs) + aug_value_float(rhs)))\
+    AUG_VM_HANDLER(SUB_INT_INT,                 AUG_OPCODE_BINOP_QUICK(SUB, AUG_INT, aug_sub, "-", aug_set_int, aug_value_int(lhs) - aug_value_int(rhs)))\
+    AUG_VM_HANDLER(SUB_FLOAT_FLOAT,             AUG_OPCODE_BINOP_QUICK(SUB, AUG_FLOAT, aug_sub, "-", aug_set_float, aug_value_float(lhs) - aug_value_float(rhs)))\
+    AUG_VM_HANDLER(MUL_INT_INT,                 AUG_OPCODE_BINOP_QUICK(MUL, AUG_INT, aug_mul, "*", aug_set_int, aug_value_int(lhs) * aug_value_int(rhs)))\
+    AUG_VM_HANDLER(MUL_FLOAT_FLOAT,             AUG_OPCODE_BINOP_QUICK(MUL, AUG_FLOAT, aug_mul, "*", aug_set_float, aug_value_float(lhs) * aug_value_float(rhs)))\
+    AUG_VM_HANDLER(DIV_INT_INT,                 AUG_OPCODE_BINOP_QUICK(DIV, AUG_INT, aug_div, "/", aug_set_float, (float)aug_value_int(lhs) / aug_value_int(rhs)))\
+    AUG_VM_HANDLER(DIV_FLOAT_FLOAT,             AUG_OPCODE_BINOP_QUICK(DIV, AUG_FLOAT, aug_div, "/", aug_set_float, aug_value_float(lhs) / aug_value_float(rhs)))\
+    AUG_VM_HANDLER(LT_INT_INT,                  AUG_OPCODE_BINOP_QUICK(LT, AUG_INT, aug_lt, "<", aug_set_bool, aug_value_int(lhs) < aug_value_int(rhs)))\
+    AUG_VM_HANDLER(LT_FLOAT_FLOAT,              AUG_OPCODE_BINOP_QUICK(LT, AUG_FLOAT, aug_lt, "<", aug_set_bool, aug_value_float(lhs) < aug_value_float(rhs)))\
+    AUG_VM_HANDLER(LTE_INT_INT,                 AUG_OPCODE_BINOP_QUICK(LTE, AUG_INT, aug_lte, "<=", aug_set_bool, aug_value_int(lhs) <= aug_value_int(rhs)))\
+    AUG_VM_HANDLER(LTE_FLOAT_FLOAT,             AUG_OPCODE_BINOP_QUICK(LTE, AUG_FLOAT, aug_lte, "<=", aug_set_bool, aug_value_float(lhs) <= aug_value_float(rhs)))\
+    AUG_VM_HANDLER(GT_INT_INT,                  AUG_OPCODE_BINOP_QUICK(GT, AUG_INT, aug_gt, ">", aug_set_bool, aug_value_int(lhs) > aug_value_int(rhs)))\
+    AUG_VM_HANDLER(GT_FLOAT_FLOAT,              AUG_OPCODE_BINOP_QUICK(GT, AUG_FLOAT, aug_gt, ">", aug_set_bool, aug_value_float(lhs) > aug_value_float(rhs)))\
+    AUG_VM_HANDLER(GTE_INT_INT,                 AUG_OPCODE_BINOP_QUICK(GTE, AUG_INT, aug_gte, ">=", aug_set_bool, aug_value_int(lhs) >= aug_value_int(rhs)))\
+    AUG_VM_HANDLER(GTE_FLOAT_FLOAT,             AUG_OPCODE_BINOP_QUICK(GTE, AUG_FLOAT, aug_gte, ">=", aug_set_bool, aug_value_float(lhs) >= aug_value_float(rhs)))\
+    AUG_VM_HANDLER(EQ_INT_INT,                  AUG_OPCODE_BINOP_QUICK(EQ, AUG_INT, aug_eq, "==", aug_set_bool, aug_value_int(lhs) == aug_value_int(rhs)))\
+    AUG_VM_HANDLER(EQ_FLOAT_FLOAT,              AUG_OPCODE_BINOP_QUICK(EQ, AUG_FLOAT, aug_eq, "==", aug_set_bool, aug_value_float(lhs) == aug_value_float(rhs)))\
+    AUG_VM_HANDLER(NEQ_INT_INT,                 AUG_OPCODE_BINOP_QUICK(NEQ, AUG_INT, aug_neq, "!=", aug_set_bool, aug_value_int(lhs) != aug_value_int(rhs)))\
+    AUG_VM_HANDLER(NEQ_FLOAT_FLOAT,             AUG_OPCODE_BINOP_QUICK(NEQ, AUG_FLOAT, aug_neq, "!=", aug_set_bool, aug_value_float(lhs) != aug_value_float(rhs)))\
+    AUG_VM_HANDLER(LT_JUMP_ZERO_INT_INT,        AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(LT_JUMP_ZERO, AUG_INT, aug_lt, "<", aug_value_int(lhs) < aug_value_int(rhs)))\
+    AUG_VM_HANDLER(LT_JUMP_ZERO_FLOAT_FLOAT,    AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(LT_JUMP_ZERO, AUG_FLOAT, aug_lt, "<", aug_value_float(lhs) < aug_value_float(rhs)))\
+    AUG_VM_HANDLER(LTE_JUMP_ZERO_INT_INT,       AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(LTE_JUMP_ZERO, AUG_INT, aug_lte, "<=", aug_value_int(lhs) <= aug_value_int(rhs)))\
+    AUG_VM_HANDLER(LTE_JUMP_ZERO_FLOAT_FLOAT,   AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(LTE_JUMP_ZERO, AUG_FLOAT, aug_lte, "<=", aug_value_float(lhs) <= aug_value_float(rhs)))\
+    AUG_VM_HANDLER(GT_JUMP_ZERO_INT_INT,        AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(GT_JUMP_ZERO, AUG_INT, aug_gt, ">", aug_value_int(lhs) > aug_value_int(rhs)))\
+    AUG_VM_HANDLER(GT_JUMP_ZERO_FLOAT_FLOAT,    AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(GT_JUMP_ZERO, AUG_FLOAT, aug_gt, ">", aug_value_float(lhs) > aug_value_float(rhs)))\
+    AUG_VM_HANDLER(GTE_JUMP_ZERO_INT_INT,       AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(GTE_JUMP_ZERO, AUG_INT, aug_gte, ">=", aug_value_int(lhs) >= aug_value_int(rhs)))\
+    AUG_VM_HANDLER(GTE_JUMP_ZERO_FLOAT_FLOAT,   AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(GTE_JUMP_ZERO, AUG_FLOAT, aug_gte, ">=", aug_value_float(lhs) >= aug_value_float(rhs)))\
+    AUG_VM_HANDLER(EQ_JUMP_ZERO_INT_INT,        AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(EQ_JUMP_ZERO, AUG_INT, aug_eq, "==", aug_value_int(lhs) == aug_value_int(rhs)))\
+    AUG_VM_HANDLER(EQ_JUMP_ZERO_FLOAT_FLOAT,    AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(EQ_JUMP_ZERO, AUG_FLOAT, aug_eq, "==", aug_value_float(lhs) == aug_value_float(rhs)))\
+    AUG_VM_HANDLER(NEQ_JUMP_ZERO_INT_INT,       AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(NEQ_JUMP_ZERO, AUG_INT, aug_neq, "!=", aug_value_int(lhs) != aug_value_int(rhs)))\
+    AUG_VM_HANDLER(NEQ_JUMP_ZERO_FLOAT_FLOAT,   AUG_OPCODE_BINOP_JUMP_ZERO_QUICK(NEQ_JUMP_ZERO, AUG_FLOAT, aug_neq, "!=", aug_value_float(lhs) != aug_value_float(rhs)))
+
+// Instructions of the register backend, see aug_ir_allocate_registers. Executed by aug_vm_execute_registers
+#define AUG_VM_REGISTER_HANDLERS                                                                                        \
+    AUG_VM_HANDLER(MOVE_REG,                    AUG_VM_OP_MOVE_REG())\
+    AUG_VM_HANDLER(ADD_REG,                     AUG_OPCODE_BINOP_REG(aug_add, "+", aug_set_int, aug_value_int(lhs) + aug_value_int(rhs), aug_set_float, aug_value_float(lhs) + aug_value_float(rhs)))\
+    AUG_VM_HANDLER(SUB_REG,                     AUG_OPCODE_BINOP_REG(aug_sub, "-", aug_set_int, aug_value_int(lhs) - aug_value_int(rhs), aug_set_float, aug_value_float(lhs) - aug_value_float(rhs)))\
+    AUG_VM_HANDLER(MUL_REG,                     AUG_OPCODE_BINOP_REG(aug_mul, "*", aug_set_int, aug_value_int(lhs) * aug_value_int(rhs), aug_set_float, aug_value_float(lhs) * aug_value_float(rhs)))\
+    AUG_VM_HANDLER(DIV_REG,                     AUG_OPCODE_BINOP_REG(aug_div, "/", aug_set_float, (float)aug_value_int(lhs) / aug_value_int(rhs), aug_set_float, aug_value_float(lhs) / aug_value_float(rhs)))\
+    AUG_VM_HANDLER(LT_REG,                      AUG_OPCODE_BINOP_REG(aug_lt, "<", aug_set_bool, aug_value_int(lhs) < aug_value_int(rhs), aug_set_bool, aug_value_float(lhs) < aug_value_float(rhs)))\
+    AUG_VM_HANDLER(LTE_REG,                     AUG_OPCODE_BINOP_REG(aug_lte, "<=", aug_set_bool, aug_value_int(lhs) <= aug_value_int(rhs), aug_set_bool, aug_value_float(lhs) <= aug_value_float(rhs)))\
+    AUG_VM_HANDLER(GT_REG,                      AUG_OPCODE_BINOP_REG(aug_gt, ">", aug_set_bool, aug_value_int(lhs) > aug_value_int(rhs), aug_set_bool, aug_value_float(lhs) > aug_value_float(rhs)))\
+    AUG_VM_HANDLER(GTE_REG,                     AUG_OPCODE_BINOP_REG(aug_gte, ">=", aug_set_bool, aug_value_int(lhs) >= aug_value_int(rhs), aug_set_bool, aug_value_float(lhs) >= aug_value_float(rhs)))\
+    AUG_VM_HANDLER(EQ_REG,                      AUG_OPCODE_BINOP_REG(aug_eq, "==", aug_set_bool, aug_value_int(lhs) == aug_value_int(rhs), aug_set_bool, aug_value_float(lhs) == aug_value_float(rhs)))\
+    AUG_VM_HANDLER(NEQ_REG,                     AUG_OPCODE_BINOP_REG(aug_neq, "!=", aug_set_bool, aug_value_int(lhs) != aug_value_int(rhs), aug_set_bool, aug_value_float(lhs) != aug_value_float(rhs)))\
+    AUG_VM_HANDLER(LT_JUMP_ZERO_REG,            AUG_OPCODE_BINOP_JUMP_ZERO_REG(aug_lt, "<", aug_value_int(lhs) < aug_value_int(rhs), aug_value_float(lhs) < aug_value_float(rhs)))\
+    AUG_VM_HANDLER(LTE_JUMP_ZERO_REG,           AUG_OPCODE_BINOP_JUMP_ZERO_REG(aug_lte, "<=", aug_value_int(lhs) <= aug_value_int(rhs), aug_value_float(lhs) <= aug_value_float(rhs)))\
+    AUG_VM_HANDLER(GT_JUMP_ZERO_REG,            AUG_OPCODE_BINOP_JUMP_ZERO_REG(aug_gt, ">", aug_value_int(lhs) > aug_value_int(rhs), aug_value_float(lhs) > aug_value_float(rhs)))\
+    AUG_VM_HANDLER(GTE_JUMP_ZERO_REG,           AUG_OPCODE_BINOP_JUMP_ZERO_REG(aug_gte, ">=", aug_value_int(lhs) >= aug_value_int(rhs), aug_value_float(lhs) >= aug_value_float(rhs)))\
+    AUG_VM_HANDLER(EQ_JUMP_ZERO_REG,            AUG_OPCODE_BINOP_JUMP_ZERO_REG(aug_eq, "==", aug_value_int(lhs) == aug_value_int(rhs), aug_value_float(lhs) == aug_value_float(rhs)))\
+    AUG_VM_HANDLER(NEQ_JUMP_ZERO_REG,           AUG_OPCODE_BINOP_JUMP_ZERO_REG(aug_neq, "!=", aug_value_int(lhs) != aug_value_int(rhs), aug_value_float(lhs) != aug_value_float(rhs)))
+
+// Called once the instruction countdown expires. Returns the next countdown, or 0 once the coroutine budget is exhausted
+static int aug_vm_countdown(aug_context* context, aug_profiler* profiler)
+{
+    if(profiler != NULL)
+    {
+        if(context->budget > 0 && --profiler->budget_remaining == 0)
+        {
+            context->suspended = true;
+            return 0;
+        }
+        aug_profile_instruction(profiler, context);
+        return 1;
+    }
 
-                aug_value* top = aug_vm_push(vm);          
-                aug_move(top, &value);
-                break;
-            }
-           case AUG_OPCODE_PUSH_MAP:
-           {
-               aug_value value;
-               aug_set_map(&value);
-
-               int count = aug_vm_read_int(vm);
-               while (--count >= 0)
-               {
-                   aug_value* arg_value = aug_vm_pop(vm);
-                   aug_value* arg_key = aug_vm_pop(vm);
-                   aug_map_insert(value.map, arg_key, arg_value);
-                   aug_decref(arg_key);
-                   aug_decref(arg_value);
-               }
-
-               aug_value* top = aug_vm_push(vm);
-               aug_move(top, &value);
-               break;
-           }
-            case AUG_OPCODE_PUSH_FUNC:   
-            {
-                int func_addr = aug_vm_read_int(vm);
-                aug_value* value = aug_vm_push(vm);
-                if(value == NULL) 
-                    break;
-                aug_set_func(value, func_addr);
-                break;
-            }
-            case AUG_OPCODE_PUSH_LOCAL:
-            {
-                const int stack_offset = aug_vm_read_int(vm);
-                aug_value* local = aug_vm_get_local(vm, stack_offset);
+    if(context->budget > 0)
+    {
+        context->suspended = true;
+        return 0;
+    }
+    return INT_MAX;
+}
 
-                aug_value* top = aug_vm_push(vm);
-                aug_assign(top, local);
-                break;
-            }
-            case AUG_OPCODE_PUSH_GLOBAL:
-            {
-                const int stack_offset = aug_vm_read_int(vm);
-                aug_value* local = aug_vm_get_global(vm, stack_offset);
+// Begins an execution, returns the instruction countdown. The profiler is fixed for the duration of the execution
+static inline int aug_vm_execute_begin(aug_context* context, aug_profiler* profiler, aug_profile_node** profile_base)
+{
+    context->running = true; 
+    context->suspended = false;
 
-                aug_value* top = aug_vm_push(vm);
-                aug_assign(top, local);
-                break;
-            }
-            case AUG_OPCODE_PUSH_ELEMENT:
-            {
-                aug_value* container = aug_vm_pop(vm);
-                aug_value* index = aug_vm_pop(vm);
+    *profile_base = NULL;
+    if(profiler != NULL)
+    {
+        aug_profile_begin(profiler, context);
+        *profile_base = context->profile_node;
+    }
+    return profiler != NULL ? 1 : context->budget > 0 ? context->budget : INT_MAX;
+}
 
-                aug_value value = aug_none();
-                if(!aug_get_element(container, index, &value))
-                    aug_log_vm_error(vm, "Index out of range error"); // TODO: more descriptive
-                aug_decref(container);
-                aug_decref(index);
+static inline void aug_vm_execute_end(aug_context* context, aug_profiler* profiler, aug_profile_node* profile_base)
+{
+    if(profiler != NULL)
+        aug_profile_end(profiler, context, profile_base);
+    context->running = false; 
+}
 
-                aug_value* top = aug_vm_push(vm);
-                aug_assign(top, &value);
-                break;
-            }
-            case AUG_OPCODE_PUSH_RANGE:
-            {
-                aug_value* to = aug_vm_pop(vm);
-                aug_value* from = aug_vm_pop(vm);
+#define AUG_VM_YIELD_HANDLER                                                        \
+    AUG_VM_CASE(YIELD)                                                              \
+    {                                                                               \
+        /* Only coroutines are suspended, otherwise execution continues */         \
+        if(context->coroutine)                                                      \
+        {                                                                           \
+            context->suspended = true;                                              \
+            goto AUG_VM_LABEL_END;                                                  \
+        }                                                                           \
+        AUG_VM_NEXT;                                                                \
+    }
 
-                aug_value value;
-                if(!aug_set_range(&value, from, to))    
-                    aug_log_vm_error(vm, "Could not create a range from type %s to %s", aug_type_label(from), aug_type_label(to)); // TODO: more descriptive
-                aug_decref(to);
-                aug_decref(from);
+#define AUG_VM_UNSUPPORTED_HANDLERS                                                 \
+    AUG_VM_CASE(XOR)                                                                \
+    AUG_VM_CASE(NEG)                                                                \
+    AUG_VM_CASE(CMP)                                                                \
+    AUG_VM_CASE(ABS)                                                                \
+    AUG_VM_CASE(SIN)                                                                \
+    AUG_VM_CASE(COS)                                                                \
+    AUG_VM_CASE(ATAN)                                                               \
+    AUG_VM_CASE(LN)                                                                 \
+    AUG_VM_CASE(SQRT)                                                               \
+    AUG_VM_CASE(INC)                                                                \
+    AUG_VM_CASE(DEC)                                                                \
+    AUG_VM_DEFAULT                                                                  \
+        assert(0);                                                                  \
+    AUG_VM_NEXT;
 
-                aug_value* top = aug_vm_push(vm);
-                aug_move(top, &value);
-                break;
-            }
-            case AUG_OPCODE_PUSH_ITERATOR:
-            {
-                aug_value* iterable = aug_vm_pop(vm);
+// Dispatch table entries of the threaded execute functions
+#define AUG_OPCODE(opcode) &&AUG_VM_LABEL_##opcode,
 
-                // Create new iterator, move into iterable slot. Iterator retains pointer to iterable
-                aug_value value;
-                if(!aug_set_iterator(&value, iterable))    
-                    aug_log_vm_error(vm, "Type %s is not an iterable", aug_type_label(iterable)); // TODO: more descriptive
+// Executes the bytecode of the stack backend
+static void aug_vm_execute_stack(aug_context* context)
+{
+    aug_profiler* profiler = context->profiler;
+    aug_profile_node* profile_base;
+    int budget = aug_vm_execute_begin(context, profiler, &profile_base);
 
-                aug_value* top = aug_vm_push(vm);
-                aug_move(top, &value);
-                break;
-            }
-            case AUG_OPCODE_ITERATE:
-            {
-                const int stack_offset = aug_vm_read_int(vm);
-                aug_value* iterator = aug_vm_get_local(vm, stack_offset);
+    AUG_VM_LOOP_BEGIN
+#define AUG_VM_HANDLER(opcode, handler) AUG_VM_CASE(opcode) handler
+            AUG_VM_OPCODE_HANDLERS
+#undef AUG_VM_HANDLER
+            AUG_VM_YIELD_HANDLER
+            // Unsupported opcodes. Register instructions are only generated by the register backend
+#define AUG_VM_HANDLER(opcode, handler) AUG_VM_CASE(opcode)
+            AUG_VM_REGISTER_HANDLERS
+#undef AUG_VM_HANDLER
+            AUG_VM_UNSUPPORTED_HANDLERS
+    AUG_VM_LOOP_END
 
-                aug_value element;
-                bool success = aug_iterate(iterator, &element);
+AUG_VM_LABEL_END:
+    aug_vm_execute_end(context, profiler, profile_base);
+}
 
-                if(success)
-                {
-                    aug_value* value = aug_vm_push(vm);
-                    if(value != NULL)
-                        aug_assign(value, &element);
-                }
+// Executes the bytecode of the register backend. The stack instructions remain for the operations without a register 
+// form, i.e. calls, containers and iteration. Kept apart from aug_vm_execute_stack, so that the backends are measured 
+// with their own dispatch
+static void aug_vm_execute_registers(aug_context* context)
+{
+    aug_profiler* profiler = context->profiler;
+    aug_profile_node* profile_base;
+    int budget = aug_vm_execute_begin(context, profiler, &profile_base);
 
-                aug_value* condition = aug_vm_push(vm);
-                if(condition != NULL)
-                    aug_set_bool(condition, success);
-                break;
-            }
-            case AUG_OPCODE_LOAD_LOCAL:
-            {
-                const int stack_offset = aug_vm_read_int(vm);
-                aug_value* local = aug_vm_get_local(vm, stack_offset);
-                aug_value* top = aug_vm_pop(vm);
-                aug_move(local, top);
-                break;
-            }
-            case AUG_OPCODE_LOAD_GLOBAL:
-            {
-                const int stack_offset = aug_vm_read_int(vm);
-                aug_value* global = aug_vm_get_global(vm, stack_offset);
-                aug_value* top = aug_vm_pop(vm);
-                aug_move(global, top);
-                break;
-            }
-            case AUG_OPCODE_LOAD_ELEMENT:
-            {
-                aug_value* container = aug_vm_pop(vm);
-                aug_value* index = aug_vm_pop(vm);
-                aug_value* value = aug_vm_pop(vm);
-                if(!aug_set_element(container, index, value))    
-                    aug_log_vm_error(vm, "Index out of range error"); // TODO: more descriptive
-                aug_decref(container);
-                aug_decref(index);
-                aug_decref(value);
-                break;
-            }
-            case AUG_OPCODE_JUMP:
-            {
-                const int instruction_offset = aug_vm_read_int(vm);
-                vm->instruction = vm->bytecode + instruction_offset;
-                break;
-            }
-            case AUG_OPCODE_JUMP_NZERO:
-            {
-                const int instruction_offset = aug_vm_read_int(vm);
-                aug_value* cond = aug_vm_pop(vm);
-                if(aug_to_bool(cond) != 0)
-                    vm->instruction = vm->bytecode + instruction_offset;
-                aug_decref(cond);
-                break;
-            }
-            case AUG_OPCODE_JUMP_ZERO:
-            {
-                const int instruction_offset = aug_vm_read_int(vm);
-                aug_value* cond = aug_vm_pop(vm);
-                if(aug_to_bool(cond) == 0)
-                    vm->instruction = vm->bytecode + instruction_offset;
-                aug_decref(cond);
-                break;
-            }
-            case AUG_OPCODE_CALL_FRAME:
-            {
-                const int ret_addr = aug_vm_read_int(vm);
-                aug_vm_push_call_frame(vm, ret_addr);
-                break;
-            }
-            case AUG_OPCODE_CALL:
-            {
-                const int func_addr = aug_vm_read_int(vm);
-                vm->instruction = vm->bytecode + func_addr;
-                vm->base_index = vm->stack_index;
-                break;
-            }
-            case AUG_OPCODE_CALL_TOP:
-            {
-                aug_value* top = aug_vm_pop(vm);
-                if(top == NULL || top->type != AUG_FUNCTION)
-                {
-                    aug_string* symbol = aug_vm_get_marker_symbol(vm, sizeof(int));
-                    aug_log_vm_error(vm, "Unnamed value %s is not a function", 
-                        symbol ? symbol->buffer : "(anonymous)");
-                    break;
-                }
+    AUG_VM_LOOP_BEGIN
+#define AUG_VM_HANDLER(opcode, handler) AUG_VM_CASE(opcode) handler
+            AUG_VM_REGISTER_HANDLERS
+            AUG_VM_OPCODE_HANDLERS
+#undef AUG_VM_HANDLER
+            AUG_VM_YIELD_HANDLER
+            // Unsupported opcodes
+            AUG_VM_UNSUPPORTED_HANDLERS
+    AUG_VM_LOOP_END
 
-                const int func_addr = top->i;
-                vm->instruction = vm->bytecode + func_addr;
-                vm->base_index = vm->stack_index;
-                break;
-            }
-            case AUG_OPCODE_CALL_LOCAL:
-            {
-                const int stack_offset = aug_vm_read_int(vm);
-                aug_value* local = aug_vm_get_local(vm, stack_offset);
-                if(local == NULL || local->type != AUG_FUNCTION)
-                {
-                    aug_string* symbol = aug_vm_get_marker_symbol(vm, sizeof(int));
-                    aug_log_vm_error(vm, "Local variable %s can not a function", 
-                        symbol ? symbol->buffer : "(anonymous)");
-                    break;
-                }
+AUG_VM_LABEL_END:
+    aug_vm_execute_end(context, profiler, profile_base);
+}
 
-                const int func_addr = local->i;
-                vm->instruction = vm->bytecode + func_addr;
-                vm->base_index = vm->stack_index;
-                break;
-            }
-            case AUG_OPCODE_CALL_GLOBAL:
-            {
-                const int stack_offset = aug_vm_read_int(vm);
-                aug_value* global = aug_vm_get_global(vm, stack_offset);
-                if(global == NULL || global->type != AUG_FUNCTION)
-                {                    
-                    aug_string* symbol = aug_vm_get_marker_symbol(vm, sizeof(int));
-                    aug_log_vm_error(vm, "Global variable %s can not a function", 
-                        symbol ? symbol->buffer : "(anonymous)");
-                    break;
-                }
+#undef AUG_OPCODE
 
-                vm->instruction = vm->bytecode + global->i;
-                vm->base_index = vm->stack_index;
-                break;
-            }
-            case AUG_OPCODE_CALL_EXT:
-            {
-                aug_value* func_name_value = aug_vm_pop(vm);
-                if(func_name_value == NULL || func_name_value->type != AUG_STRING)
-                {
-                    aug_decref(func_name_value);
-                    aug_log_vm_error(vm, "Extension function call expected function name to be pushed on stack");
-                    break;
-                }
+void aug_vm_execute(aug_context* context)
+{
+    if(context == NULL)
+        return;
 
-                const char* func_name = func_name_value->str->buffer;
+    if(context->registers)
+        aug_vm_execute_registers(context);
+    else
+        aug_vm_execute_stack(context);
+}
 
-                // TODO: room for optimization. use a single extension map ? Load/Unload lib extensions on script load/unload may have better amortized runtime
-                aug_extension* extension = aug_hashtable_ptr_type(aug_extension, vm->lib_extensions, func_name);
-                if(extension == NULL )
-                {                    
-                    extension = aug_hashtable_ptr_type(aug_extension, vm->extensions, func_name);
-                    if(extension == NULL || extension->func == NULL)
-                    {
-                        aug_log_vm_error(vm, "Extension function %s not registered", func_name_value->str->buffer);
-                        aug_decref(func_name_value);
-                        break;
-                    }
-                }
+// JIT ======================================================= JIT ======================================================= JIT //
 
-                // Gather arguments
-                const int arg_count = aug_vm_read_int(vm);
-                aug_value* args = (aug_value*)AUG_ALLOC(sizeof(aug_value) * arg_count);
-                for(int i = arg_count - 1; i >= 0; --i)
-                {
-                    aug_value* arg = aug_vm_pop(vm);
-                    if(arg != NULL)
-                    {
-                        aug_value value = aug_none();
-                        aug_move(&value, arg);
-                        args[arg_count - i - 1] = value;
-                    }
-                }
+#if AUG_JIT
 
-                // Call the function, Move return value on to top of stack
-                aug_value ret_value = extension->func(arg_count, args);
-
-                // Cleanup argumentsl
-                aug_decref(func_name_value);
-                for (int i = 0; i < arg_count; ++i)
-                    aug_decref(&args[i]);
-                AUG_FREE(args);
-                
-                // Return on top
-                aug_value* top = aug_vm_push(vm);
-                if(top)
-                    aug_move(top, &ret_value);
-                break;
-            }
-            case AUG_OPCODE_ARG_COUNT:
-            {                
-                vm->arg_count = aug_vm_read_int(vm);
-                break;
-            }
-            case AUG_OPCODE_ENTER_FUNC:
-            {                
-                const int param_count = aug_vm_read_int(vm);
-                if (vm->arg_count != param_count)
-                {
-                    aug_string* symbol = aug_vm_get_marker_symbol(vm, sizeof(int));
-                    aug_log_vm_error(vm, "Incorrect number of arguments passed to %s. Received %d expected %d ", 
-                        symbol ? symbol->buffer : "anonymous", vm->arg_count, param_count);
-                    break;
-                }
-                break;
-            }
-            case AUG_OPCODE_RETURN_FUNC:
-            {
-                // get func return value
-                aug_value* ret_value = aug_vm_pop(vm);
-                
-                // Free locals
-                const int delta = aug_vm_read_int(vm);
-                for(int i = 0; i < delta; ++i)
-                    aug_decref(aug_vm_pop(vm));
-                
-                // Restore base index
-                aug_value* ret_base = aug_vm_pop(vm);
-                if(ret_base == NULL)
-                {                    
-                    aug_log_vm_error(vm, "Calling frame setup incorrectly. Stack missing stack base");
-                    break;
-                }
+// Each instruction handler is compiled into a function, that executes the instruction at the given address and returns
+// the address of the next instruction. Native code runs the templates of the frequent instructions inline, calls the 
+// handlers of the others, and branches directly to the native code of the returned address. Errors set the instruction 
+// to NULL, which exits the native code
+#undef AUG_VM_NEXT
+#define AUG_VM_NEXT return context->instruction
+#undef AUG_VM_JIT_ENTER
+#define AUG_VM_JIT_ENTER()
+#undef AUG_VM_JIT_RESUME
+#define AUG_VM_JIT_RESUME()
+#undef AUG_VM_JIT_LOOP
+#define AUG_VM_JIT_LOOP()
 
-                vm->base_index = ret_base->i;
-                aug_decref(ret_base);
+typedef const char* (aug_jit_op)(aug_context* context, const char* instruction);
+typedef void (aug_jit_func)(aug_context* context);
 
-                // jump to return instruction
-                aug_value* ret_addr = aug_vm_pop(vm);
-                if(ret_addr == NULL)
-                {                    
-                    aug_log_vm_error(vm, "Calling frame setup incorrectly. Stack missing return address");
-                    break;
-                }
-                
-                if(ret_addr->i == AUG_OPCODE_INVALID)
-                    vm->instruction = NULL;
-                else
-                    vm->instruction = vm->bytecode + ret_addr->i;
-                aug_decref(ret_addr);
+#define AUG_VM_HANDLER(opcode, handler)                                                     \
+static const char* aug_jit_op_##opcode(aug_context* context, const char* instruction)      \
+{                                                                                           \
+    context->last_instruction = instruction;                                                \
+    context->instruction = instruction + 1;                                                 \
+    handler                                                                                 \
+    return context->instruction;                                                            \
+}
+AUG_VM_OPCODE_HANDLERS
+AUG_VM_REGISTER_HANDLERS
+#undef AUG_VM_HANDLER
 
-                // push return value back onto stack, for callee
-                aug_value* top = aug_vm_push(vm);
-                if(ret_value != NULL && top != NULL)
-                    aug_move(top, ret_value);
+// Native code is never executed by coroutines, yield statements continue
+static const char* aug_jit_op_YIELD(aug_context* context, const char* instruction)
+{
+    context->last_instruction = instruction;
+    context->instruction = instruction + 1;
+    return context->instruction;
+}
 
-                break;
-            }
-            case AUG_OPCODE_IMPORT_LIB:
-            {
-                aug_vm_lib_load(vm, aug_vm_read_bytes(vm));
-                break;
-            }
-            default:
-                assert(0);
-            break;
-        }
+static aug_jit_op* aug_jit_op_lookup(aug_opcode opcode)
+{
+    switch(opcode)
+    {
+#define AUG_VM_HANDLER(opcode, handler) case AUG_OPCODE_##opcode: return aug_jit_op_##opcode;
+    AUG_VM_OPCODE_HANDLERS
+    AUG_VM_REGISTER_HANDLERS
+#undef AUG_VM_HANDLER
+    case AUG_OPCODE_YIELD: return aug_jit_op_YIELD;
+    default: break;
+    }
+    return NULL;
+}
 
-#if AUG_DEBUG
-        if(vm->debug_post_instruction)
-            vm->debug_post_instruction(vm, opcode);
-#endif // AUG_DEBUG
+// Instructions rewritten by quickening while executing, see AUG_QUICKEN. Either the generic or a specialized variant
+static inline bool aug_jit_op_is_quickened(aug_opcode opcode)
+{
+#if AUG_QUICKEN
+    switch(opcode)
+    {
+    case AUG_OPCODE_ADD: case AUG_OPCODE_SUB: case AUG_OPCODE_MUL: case AUG_OPCODE_DIV:
+    case AUG_OPCODE_LT: case AUG_OPCODE_LTE: case AUG_OPCODE_GT: case AUG_OPCODE_GTE: case AUG_OPCODE_EQ: case AUG_OPCODE_NEQ:
+    case AUG_OPCODE_LT_JUMP_ZERO: case AUG_OPCODE_LTE_JUMP_ZERO: case AUG_OPCODE_GT_JUMP_ZERO:
+    case AUG_OPCODE_GTE_JUMP_ZERO: case AUG_OPCODE_EQ_JUMP_ZERO: case AUG_OPCODE_NEQ_JUMP_ZERO:
+    case AUG_OPCODE_ADD_INT_INT: case AUG_OPCODE_ADD_FLOAT_FLOAT: case AUG_OPCODE_SUB_INT_INT: case AUG_OPCODE_SUB_FLOAT_FLOAT:
+    case AUG_OPCODE_MUL_INT_INT: case AUG_OPCODE_MUL_FLOAT_FLOAT: case AUG_OPCODE_DIV_INT_INT: case AUG_OPCODE_DIV_FLOAT_FLOAT:
+    case AUG_OPCODE_LT_INT_INT: case AUG_OPCODE_LT_FLOAT_FLOAT: case AUG_OPCODE_LTE_INT_INT: case AUG_OPCODE_LTE_FLOAT_FLOAT:
+    case AUG_OPCODE_GT_INT_INT: case AUG_OPCODE_GT_FLOAT_FLOAT: case AUG_OPCODE_GTE_INT_INT: case AUG_OPCODE_GTE_FLOAT_FLOAT:
+    case AUG_OPCODE_EQ_INT_INT: case AUG_OPCODE_EQ_FLOAT_FLOAT: case AUG_OPCODE_NEQ_INT_INT: case AUG_OPCODE_NEQ_FLOAT_FLOAT:
+    case AUG_OPCODE_LT_JUMP_ZERO_INT_INT: case AUG_OPCODE_LT_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_LTE_JUMP_ZERO_INT_INT: case AUG_OPCODE_LTE_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_GT_JUMP_ZERO_INT_INT: case AUG_OPCODE_GT_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_GTE_JUMP_ZERO_INT_INT: case AUG_OPCODE_GTE_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_EQ_JUMP_ZERO_INT_INT: case AUG_OPCODE_EQ_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_NEQ_JUMP_ZERO_INT_INT: case AUG_OPCODE_NEQ_JUMP_ZERO_FLOAT_FLOAT:
+        return true;
+    default:
+        break;
     }
+#else
+    (void)opcode;
+#endif//AUG_QUICKEN
+    return false;
+}
 
-    vm->running = false; 
+// Calls the handler of the current opcode. Quickened instructions switch between the generic and specialized opcodes 
+// after compiling, so their handler is not fixed in the native code
+static const char* aug_jit_op_QUICKENED(aug_context* context, const char* instruction)
+{
+    return aug_jit_op_lookup((aug_opcode)*instruction)(context, instruction);
+}
+
+// Size of the instruction's operands in bytes, or -1 if the opcode is not supported
+static int aug_jit_operand_size(const char* instruction)
+{
+    aug_vm_bytecode_value value;
+    switch((aug_opcode)*instruction)
+    {
+    case AUG_OPCODE_EXIT:
+    case AUG_OPCODE_NO_OP:
+    case AUG_OPCODE_PUSH_NONE:
+    case AUG_OPCODE_PUSH_ELEMENT:
+    case AUG_OPCODE_PUSH_ITERATOR:
+    case AUG_OPCODE_PUSH_RANGE:
+    case AUG_OPCODE_LOAD_ELEMENT:
+    case AUG_OPCODE_CALL_TOP:
+    case AUG_OPCODE_YIELD:
+    case AUG_OPCODE_ADD: case AUG_OPCODE_SUB: case AUG_OPCODE_MUL: case AUG_OPCODE_DIV:
+    case AUG_OPCODE_POW: case AUG_OPCODE_MOD: case AUG_OPCODE_AND: case AUG_OPCODE_OR: case AUG_OPCODE_NOT:
+    case AUG_OPCODE_LT: case AUG_OPCODE_LTE: case AUG_OPCODE_GT: case AUG_OPCODE_GTE:
+    case AUG_OPCODE_EQ: case AUG_OPCODE_NEQ: case AUG_OPCODE_APPROXEQ:
+    case AUG_OPCODE_ADD_INT_INT: case AUG_OPCODE_ADD_FLOAT_FLOAT: case AUG_OPCODE_SUB_INT_INT: case AUG_OPCODE_SUB_FLOAT_FLOAT:
+    case AUG_OPCODE_MUL_INT_INT: case AUG_OPCODE_MUL_FLOAT_FLOAT: case AUG_OPCODE_DIV_INT_INT: case AUG_OPCODE_DIV_FLOAT_FLOAT:
+    case AUG_OPCODE_LT_INT_INT: case AUG_OPCODE_LT_FLOAT_FLOAT: case AUG_OPCODE_LTE_INT_INT: case AUG_OPCODE_LTE_FLOAT_FLOAT:
+    case AUG_OPCODE_GT_INT_INT: case AUG_OPCODE_GT_FLOAT_FLOAT: case AUG_OPCODE_GTE_INT_INT: case AUG_OPCODE_GTE_FLOAT_FLOAT:
+    case AUG_OPCODE_EQ_INT_INT: case AUG_OPCODE_EQ_FLOAT_FLOAT: case AUG_OPCODE_NEQ_INT_INT: case AUG_OPCODE_NEQ_FLOAT_FLOAT:
+        return 0;
+    case AUG_OPCODE_PUSH_BOOL:
+        return (int)sizeof(value.b);
+    case AUG_OPCODE_PUSH_CHAR:
+        return (int)sizeof(value.c);
+    case AUG_OPCODE_PUSH_FLOAT:
+        return (int)sizeof(value.f);
+    case AUG_OPCODE_IMPORT_LIB:
+        return (int)strlen(instruction + 1) + 1;
+    case AUG_OPCODE_CALL_EXT:
+    case AUG_OPCODE_ADD_LOCAL_INT:
+    case AUG_OPCODE_SUB_LOCAL_INT:
+    case AUG_OPCODE_ADD_GLOBAL_INT:
+    case AUG_OPCODE_SUB_GLOBAL_INT:
+    case AUG_OPCODE_RANGE_BEGIN:
+    case AUG_OPCODE_RANGE_NEXT:
+    case AUG_OPCODE_MOVE_REG:
+    case AUG_OPCODE_ADD_REG: case AUG_OPCODE_SUB_REG: case AUG_OPCODE_MUL_REG: case AUG_OPCODE_DIV_REG:
+    case AUG_OPCODE_LT_REG: case AUG_OPCODE_LTE_REG: case AUG_OPCODE_GT_REG: 
+    case AUG_OPCODE_GTE_REG: case AUG_OPCODE_EQ_REG: case AUG_OPCODE_NEQ_REG:
+    case AUG_OPCODE_LT_JUMP_ZERO_REG: case AUG_OPCODE_LTE_JUMP_ZERO_REG: case AUG_OPCODE_GT_JUMP_ZERO_REG:
+    case AUG_OPCODE_GTE_JUMP_ZERO_REG: case AUG_OPCODE_EQ_JUMP_ZERO_REG: case AUG_OPCODE_NEQ_JUMP_ZERO_REG:
+        return (int)sizeof(value.i) * 2;
+    case AUG_OPCODE_POP:
+    case AUG_OPCODE_PUSH_INT:
+    case AUG_OPCODE_PUSH_STRING:
+    case AUG_OPCODE_PUSH_ARRAY:
+    case AUG_OPCODE_PUSH_MAP:
+    case AUG_OPCODE_PUSH_FUNC:
+    case AUG_OPCODE_PUSH_LOCAL:
+    case AUG_OPCODE_PUSH_GLOBAL:
+    case AUG_OPCODE_LOAD_LOCAL:
+    case AUG_OPCODE_LOAD_GLOBAL:
+    case AUG_OPCODE_ADD_ASSIGN_LOCAL:
+    case AUG_OPCODE_ADD_ASSIGN_GLOBAL:
+    case AUG_OPCODE_ITERATE:
+    case AUG_OPCODE_JUMP:
+    case AUG_OPCODE_JUMP_ZERO:
+    case AUG_OPCODE_JUMP_NZERO:
+    case AUG_OPCODE_CALL_FRAME:
+    case AUG_OPCODE_ARG_COUNT:
+    case AUG_OPCODE_CALL:
+    case AUG_OPCODE_CALL_LOCAL:
+    case AUG_OPCODE_CALL_GLOBAL:
+    case AUG_OPCODE_ENTER_FUNC:
+    case AUG_OPCODE_RETURN_FUNC:
+    case AUG_OPCODE_LT_JUMP_ZERO: case AUG_OPCODE_LTE_JUMP_ZERO: case AUG_OPCODE_GT_JUMP_ZERO:
+    case AUG_OPCODE_GTE_JUMP_ZERO: case AUG_OPCODE_EQ_JUMP_ZERO: case AUG_OPCODE_NEQ_JUMP_ZERO:
+    case AUG_OPCODE_LT_JUMP_ZERO_INT_INT: case AUG_OPCODE_LT_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_LTE_JUMP_ZERO_INT_INT: case AUG_OPCODE_LTE_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_GT_JUMP_ZERO_INT_INT: case AUG_OPCODE_GT_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_GTE_JUMP_ZERO_INT_INT: case AUG_OPCODE_GTE_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_EQ_JUMP_ZERO_INT_INT: case AUG_OPCODE_EQ_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_NEQ_JUMP_ZERO_INT_INT: case AUG_OPCODE_NEQ_JUMP_ZERO_FLOAT_FLOAT:
+        return (int)sizeof(value.i);
+    default:
+        break;
+    }
+    return -1;
 }
 
-aug_value aug_vm_execute_from_frame(aug_vm* vm, int func_addr, int argc, aug_value* args)
+// Int operand of the instruction at the index
+static inline int aug_jit_read_operand(const char* instruction, int index)
 {
-    // Manually set expected call frame
-    aug_vm_push_call_frame(vm, AUG_OPCODE_INVALID);
-
-    vm->arg_count = argc; // setup expected argument count 
+    aug_vm_bytecode_value value;
+    for(size_t i = 0; i < sizeof(value.i); ++i)
+        value.bytes[i] = instruction[1 + index * sizeof(value.i) + i];
+    return value.i;
+}
 
-    // Jump to function call
-    vm->instruction = vm->bytecode + func_addr;
+// First int operand of the instruction
+static inline int aug_jit_read_int(const char* instruction)
+{
+    return aug_jit_read_operand(instruction, 0);
+}
 
-    for(int i = 0; i < argc; ++i)
+// Branch target of the instruction, the first operand of jumps and range loops. Returns -1 if the instruction does not branch
+static int aug_jit_branch_target(const char* instruction)
+{
+    switch((aug_opcode)*instruction)
     {
-        aug_value* value = aug_vm_push(vm);
-        if(value)
-            *value = args[i];
+    case AUG_OPCODE_JUMP:
+    case AUG_OPCODE_JUMP_ZERO:
+    case AUG_OPCODE_JUMP_NZERO:
+    case AUG_OPCODE_RANGE_BEGIN:
+    case AUG_OPCODE_RANGE_NEXT:
+    case AUG_OPCODE_LT_JUMP_ZERO: case AUG_OPCODE_LTE_JUMP_ZERO: case AUG_OPCODE_GT_JUMP_ZERO:
+    case AUG_OPCODE_GTE_JUMP_ZERO: case AUG_OPCODE_EQ_JUMP_ZERO: case AUG_OPCODE_NEQ_JUMP_ZERO:
+    case AUG_OPCODE_LT_JUMP_ZERO_INT_INT: case AUG_OPCODE_LT_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_LTE_JUMP_ZERO_INT_INT: case AUG_OPCODE_LTE_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_GT_JUMP_ZERO_INT_INT: case AUG_OPCODE_GT_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_GTE_JUMP_ZERO_INT_INT: case AUG_OPCODE_GTE_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_EQ_JUMP_ZERO_INT_INT: case AUG_OPCODE_EQ_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_NEQ_JUMP_ZERO_INT_INT: case AUG_OPCODE_NEQ_JUMP_ZERO_FLOAT_FLOAT:
+    case AUG_OPCODE_LT_JUMP_ZERO_REG: case AUG_OPCODE_LTE_JUMP_ZERO_REG: case AUG_OPCODE_GT_JUMP_ZERO_REG:
+    case AUG_OPCODE_GTE_JUMP_ZERO_REG: case AUG_OPCODE_EQ_JUMP_ZERO_REG: case AUG_OPCODE_NEQ_JUMP_ZERO_REG:
+        return aug_jit_read_int(instruction);
+    default:
+        break;
     }
+    return -1;
+}
 
-    vm->base_index = vm->stack_index;
-    aug_vm_execute(vm);
+#define AUG_JIT_SLOW_PATCHES 8
 
-    aug_value ret_value = aug_none();
-    if(vm->stack_index >= 1)
+// Handler call of an instruction compiled from a native template, taken when the template does not apply
+typedef struct aug_jit_slow
+{
+    int offset;                            // bytecode offset of the instruction
+    int patches[AUG_JIT_SLOW_PATCHES];     // code offsets of the branch displacements to the call
+    int patch_count;
+} aug_jit_slow;
+
+// Native code buffer, with the branches to patch once the code for all the instructions is emitted
+typedef struct aug_jit_code
+{
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    bool valid;
+
+    const char* bytecode;
+    int start; // bytecode offsets of the compiled region
+    int end;
+
+    int* labels;       // code offset of the instruction at each bytecode offset in the region, -1 if not an instruction
+    int* patch_offset; // code offsets of the branch displacements to patch
+    int* patch_target; // bytecode offset branched to, or -1 for the exit
+    int patch_count;
+    int patch_capacity;
+
+    aug_jit_slow slow;          // slow path of the instruction being emitted
+    aug_container* slow_paths;  // type aug_jit_slow, emitted after the instructions
+} aug_jit_code;
+
+// Native code compiled from a bytecode. Executable memory is mapped per compiled function
+typedef struct aug_jit
+{
+    const char* bytecode;
+    size_t bytecode_size;
+    aug_jit_func** entries; // native code continuing from each bytecode offset, NULL if not compiled
+    int* counters;          // call counts of each function entry and iterations of each loop, negative if it failed to compile
+    aug_container* code;    // type aug_jit_mapping
+} aug_jit;
+
+typedef struct aug_jit_mapping
+{
+    void* data;
+    size_t size;
+} aug_jit_mapping;
+
+static void aug_jit_emit(aug_jit_code* code, const void* bytes, size_t size)
+{
+    if(code->size + size > code->capacity)
     {
-        // If stack is valid, get the pushed value
-        aug_value* top = aug_vm_pop(vm);
-        if(top)
-            ret_value = *top;
+        size_t capacity = code->capacity * 2;
+        while(capacity < code->size + size)
+            capacity *= 2;
+        code->data = (uint8_t*)AUG_REALLOC(code->data, capacity);
+        code->capacity = capacity;
     }
-    return ret_value;
+    memcpy(code->data + code->size, bytes, size);
+    code->size += size;
 }
 
-// COMPILER ============================================== COMPILER ========================================== COMPILER // 
+static void aug_jit_emit_patch(aug_jit_code* code, int target)
+{
+    if(code->patch_count == code->patch_capacity)
+    {
+        code->patch_capacity *= 2;
+        code->patch_offset = (int*)AUG_REALLOC(code->patch_offset, sizeof(int) * code->patch_capacity);
+        code->patch_target = (int*)AUG_REALLOC(code->patch_target, sizeof(int) * code->patch_capacity);
+    }
+    code->patch_offset[code->patch_count] = (int)code->size;
+    code->patch_target[code->patch_count] = target;
+    ++code->patch_count;
+}
 
-void aug_generate_ir_pass(const aug_ast* node, aug_ir* ir, aug_input* input);
+// x86-64 System V. The context is kept in rbx, which is preserved across the handler calls
 
-void aug_generate_ir_prepass(const aug_ast* node, aug_ir* ir, aug_input* input)
+static void aug_jit_emit_imm64(aug_jit_code* code, uint8_t opcode, uint64_t imm)
 {
-    // This is a statement prepass. Will gather globals and handle use calls
-    if(node == NULL || !ir->valid || input == NULL)
-        return;
+    const uint8_t mov[2] = { 0x48, opcode }; // mov r64, imm64
+    aug_jit_emit(code, mov, sizeof(mov));
+    aug_jit_emit(code, &imm, sizeof(imm));
+}
 
-    const aug_token token = node->token;
-    aug_string* token_data = token.data; 
-    aug_ast** children = node->children;
-    const int children_size = node->children_size;
+static void aug_jit_emit_prologue(aug_jit_code* code)
+{
+    const uint8_t prologue[] = { 0x53, 0x48, 0x89, 0xFB }; // push rbx; mov rbx, rdi
+    aug_jit_emit(code, prologue, sizeof(prologue));
+}
 
-    switch(node->type)
-    {
-        case AUG_AST_ROOT:
-        case AUG_AST_BLOCK: 
-        {
-            for(int i = 0; i < children_size; ++ i)
-                aug_generate_ir_prepass(children[i], ir, input);
-            break;
-        }
-        case AUG_AST_STMT_DEFINE_FUNC: 
-        {
-            assert(token_data != NULL && children_size == 2); //func token [0] {[1]};
+static void aug_jit_emit_epilogue(aug_jit_code* code)
+{
+    const uint8_t epilogue[] = { 0x5B, 0xC3 }; // pop rbx; ret
+    aug_jit_emit(code, epilogue, sizeof(epilogue));
+}
 
-            aug_ast* params = children[0];
-            assert(params && params->type == AUG_AST_PARAM_LIST);
-            const int param_count = params->children_size;
+// Calls the handler with the context and instruction address. The next address is returned in rax
+static void aug_jit_emit_call(aug_jit_code* code, aug_jit_op* op, const char* instruction)
+{
+    const uint8_t mov_context[] = { 0x48, 0x89, 0xDF }; // mov rdi, rbx
+    aug_jit_emit(code, mov_context, sizeof(mov_context));
+    aug_jit_emit_imm64(code, 0xBE, (uint64_t)(uintptr_t)instruction); // mov rsi, instruction
+    aug_jit_emit_imm64(code, 0xB8, (uint64_t)(uintptr_t)op);          // mov rax, op
+    const uint8_t call[] = { 0xFF, 0xD0 };                             // call rax
+    aug_jit_emit(code, call, sizeof(call));
+}
 
-            if(!aug_ir_set_func(ir, token_data, param_count, false))
-            {
-                ir->valid = false;
-                aug_log_input_error_at(input, &token.pos, "Global %s already defined", token_data->buffer);
-                break;
-            }
-            break;
-        }
-        case AUG_AST_IMPORT_LIB:
-        {
-            const aug_ir_operand operand = aug_ir_operand_from_str(token_data);
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_IMPORT_LIB, operand);
-            break;
-        } 
-        case AUG_AST_IMPORT_SCRIPT:
-        {
-            // TODO: open and parse script, should be relative to the current input. (i.e. trunk filename, add relative path and get absolute?) 
-            aug_string* imported_filename = aug_string_create(input->filename->buffer);
-            size_t dir_pos = imported_filename->length;
-            while(--dir_pos >= 0)
-            {
-                if(imported_filename->buffer[dir_pos] == '/' || imported_filename->buffer[dir_pos] == '\\')
-                {
-                    ++dir_pos;
-                    break;
-                }
-            }
+// Branches to the target if the returned address is the instruction, or if not equal when negated
+static void aug_jit_emit_branch_if(aug_jit_code* code, const char* instruction, bool equal, int target)
+{
+    aug_jit_emit_imm64(code, 0xB9, (uint64_t)(uintptr_t)instruction); // mov rcx, instruction
+    const uint8_t cmp[] = { 0x48, 0x39, 0xC8, 0x0F, (uint8_t)(equal ? 0x84 : 0x85) }; // cmp rax, rcx; je/jne rel32
+    aug_jit_emit(code, cmp, sizeof(cmp));
+    aug_jit_emit_patch(code, target);
+    const int32_t rel = 0;
+    aug_jit_emit(code, &rel, sizeof(rel));
+}
 
-            for(size_t i = 0; i <= token_data->length; ++i) // <= note include null term
-            {
-                if(i+dir_pos >= imported_filename->length)
-                    aug_string_push(imported_filename, token_data->buffer[i]);
-                else
-                    aug_string_set(imported_filename, i+dir_pos, token_data->buffer[i]);
-            }
+static void aug_jit_emit_branch(aug_jit_code* code, int target)
+{
+    const uint8_t jmp = 0xE9; // jmp rel32
+    aug_jit_emit(code, &jmp, sizeof(jmp));
+    aug_jit_emit_patch(code, target);
+    const int32_t rel = 0;
+    aug_jit_emit(code, &rel, sizeof(rel));
+}
 
-            // Parse file
-            aug_input* imported_input = aug_input_open(imported_filename->buffer, input->error_func);
-            aug_ast* root = aug_parse(imported_input);
-            if (root == NULL)
-            {
-                aug_string_decref(imported_filename);
-                aug_input_close(imported_input);
-                aug_log_input_error_at(input, &token.pos, "Failed to use script %s", token_data->buffer);
-                break;
-            }
+static bool aug_jit_patch(aug_jit_code* code, int offset, int label)
+{
+    const int32_t rel = label - (offset + (int)sizeof(int32_t));
+    memcpy(code->data + offset, &rel, sizeof(rel));
+    return true;
+}
 
-            // Generate IR / 
-            // TODO: fix memory leak error with symbols being improperly tracked when freed from ast and held by the user IR
-            aug_generate_ir_pass(root, ir, imported_input);
+// Exits the native code to continue interpreting at the bytecode offset
+static void aug_jit_emit_exit_to(aug_jit_code* code, int target)
+{
+    aug_jit_emit_imm64(code, 0xB8, (uint64_t)(uintptr_t)(code->bytecode + target)); // mov rax, instruction
+    const uint8_t store[] = { 0x48, 0x89, 0x83 };                                    // mov [rbx + instruction], rax
+    const int32_t disp = (int32_t)offsetof(aug_context, instruction);
+    aug_jit_emit(code, store, sizeof(store));
+    aug_jit_emit(code, &disp, sizeof(disp));
+    aug_jit_emit_branch(code, -1);
+}
 
-            aug_string_decref(imported_filename);
-            aug_input_close(imported_input);
-            aug_ast_delete(root);
-            break;  
-        } 
-        default: 
-            break;
-    }
+// Size of aug_jit_emit_exit_to
+#define AUG_JIT_EXIT_TO_SIZE 22
+
+static inline bool aug_jit_in_region(const aug_jit_code* code, int target)
+{
+    return target >= code->start && target < code->end;
 }
 
-void aug_generate_ir_pass(const aug_ast* node, aug_ir* ir, aug_input* input)
+// Continues at the bytecode offset, in native code if within the region
+static void aug_jit_emit_goto(aug_jit_code* code, int target)
 {
-    if(node == NULL || !ir->valid)
-        return;
+    if(aug_jit_in_region(code, target))
+        aug_jit_emit_branch(code, target);
+    else
+        aug_jit_emit_exit_to(code, target);
+}
 
-    const aug_token token = node->token;
-    aug_string* token_data = token.data; 
-    aug_ast** children = node->children;
-    const int children_size = node->children_size;
+// Calls the instruction's handler, then continues at the returned address. Out of line calls are the slow paths of 
+// native templates, and branch back to the next instruction
+static void aug_jit_emit_handler(aug_jit_code* code, const char* instruction, bool out_of_line)
+{
+    const aug_opcode opcode = (aug_opcode)*instruction;
+    const int next = (int)(instruction - code->bytecode) + 1 + aug_jit_operand_size(instruction);
+    const int target = aug_jit_branch_target(instruction);
 
-    switch(node->type)
+    aug_jit_op* op = aug_jit_op_is_quickened(opcode) ? aug_jit_op_QUICKENED : aug_jit_op_lookup(opcode);
+    aug_jit_emit_call(code, op, instruction);
+    if(aug_jit_in_region(code, target))
+        aug_jit_emit_branch_if(code, code->bytecode + target, true, target);
+    if(next >= code->end)
+        aug_jit_emit_branch(code, -1);
+    else if(out_of_line)
     {
-        case AUG_AST_ROOT:
-        {
-            // gather globals, uses etc..
-            aug_generate_ir_prepass(node, ir, input);
+        aug_jit_emit_branch_if(code, code->bytecode + next, true, next);
+        aug_jit_emit_branch(code, -1);
+    }
+    else
+        aug_jit_emit_branch_if(code, code->bytecode + next, false, -1);
+}
 
-            for(int i = 0; i < children_size; ++ i)
-                aug_generate_ir_pass(children[i], ir, input);
-            break;
-        }
-        case AUG_AST_BLOCK: 
-        {
-            for(int i = 0; i < children_size; ++ i)
-                aug_generate_ir_pass(children[i], ir, input);
+#if !AUG_COMPACT_VALUE
+// Native templates of the frequent instructions on numbers. They read the context and the stack values directly, and
+// branch to the handler for any other operand types, as well as the stack bounds errors
 
-            break;
-        }
-        case AUG_AST_LITERAL:
-        {
-            switch (token.id)
-            {
-                case AUG_TOKEN_CHAR:
-                {
-                    assert(token_data && token_data->length == 1);
-                    const char data = token_data->buffer[0];
-                    const aug_ir_operand operand = aug_ir_operand_from_char(data);
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_CHAR, operand);
-                    break;
-                }
-                case AUG_TOKEN_INT:
-                {
-                    assert(token_data && token_data->length > 0);
-                    const int data = strtol(token_data->buffer, NULL, 10);
-                    const aug_ir_operand operand = aug_ir_operand_from_int(data);
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_INT, operand);
-                    break;
-                }
-                case AUG_TOKEN_HEX:
-                {
-                    assert(token_data && token_data->length > 2 && token_data->buffer[1] == 'x'); 
-                    const unsigned int data = strtoul(token_data->buffer + 2, NULL, 16); // +2 skip 0x 
-                    const aug_ir_operand operand = aug_ir_operand_from_int(data);
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_INT, operand);
-                    break;
-                }
-                case AUG_TOKEN_BINARY:
-                {
-                    assert(token_data && token_data->length > 2 && token_data->buffer[1] == 'b');
-                    const unsigned int data = strtoul(token_data->buffer + 2, NULL, 2);// +2 skip 0b 
-                    const aug_ir_operand operand = aug_ir_operand_from_int(data);
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_INT, operand);
-                    break;
-                }
-                case AUG_TOKEN_FLOAT:
-                {
-                    assert(token_data && token_data->length > 0);
-                    const float data = strtof(token_data->buffer, NULL);
-                    const aug_ir_operand operand = aug_ir_operand_from_float(data);
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_FLOAT, operand);
-                    break;
-                }
-                case AUG_TOKEN_STRING:
-                {
-                    const aug_ir_operand operand = aug_ir_operand_from_str(token_data);
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_STRING, operand);
-                    break;
-                }
-                case AUG_TOKEN_TRUE:
-                {
-                    const aug_ir_operand operand = aug_ir_operand_from_bool(true);
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_BOOL, operand);
-                    break;
-                }
-                case AUG_TOKEN_FALSE:
-                {
-                    const aug_ir_operand operand = aug_ir_operand_from_bool(false);
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_BOOL, operand);
-                    break;
-                }
-                case AUG_TOKEN_NONE:
-                {
-                    aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE);
-                    break;
-                }
-                default:
-                    assert(0);
-                    break;
-            }
-            break;
-        }
-        case AUG_AST_VARIABLE:
-        {
-            assert(token_data != NULL);
+enum { AUG_JIT_RAX = 0, AUG_JIT_RCX = 1, AUG_JIT_RDX = 2, AUG_JIT_RBX = 3 };
+enum { AUG_JIT_B = 0x2, AUG_JIT_AE = 0x3, AUG_JIT_E = 0x4, AUG_JIT_NE = 0x5, AUG_JIT_BE = 0x6, AUG_JIT_A = 0x7, 
+    AUG_JIT_L = 0xC, AUG_JIT_GE = 0xD, AUG_JIT_LE = 0xE, AUG_JIT_G = 0xF };
 
-            const aug_symbol symbol = aug_ir_get_symbol_relative(ir, token_data);
-            if(symbol.type == AUG_SYM_NONE)
-            {
-                ir->valid = false;
-                aug_log_input_error_at(input, &token.pos, "Variable %s not defined in current block", 
-                    token_data->buffer);
-                return;
-            }
+#define AUG_JIT_CONTEXT(field) ((int32_t)offsetof(aug_context, field))
+#define AUG_JIT_TYPE ((int32_t)offsetof(aug_value, type))
+#define AUG_JIT_DATA ((int32_t)offsetof(aug_value, i))
+#define AUG_JIT_VALUE ((int32_t)sizeof(aug_value))
 
-            aug_ir_mark_symbol(ir, symbol);
+// Emits the opcode with a register and a [base + disp32] operand
+static void aug_jit_emit_mem(aug_jit_code* code, const uint8_t* op, size_t op_size, int reg, int base, int32_t disp)
+{
+    const uint8_t modrm = (uint8_t)(0x80 | (reg << 3) | base);
+    aug_jit_emit(code, op, op_size);
+    aug_jit_emit(code, &modrm, sizeof(modrm));
+    aug_jit_emit(code, &disp, sizeof(disp));
+}
 
-            if(symbol.type == AUG_SYM_FUNC)
-            {
-                //TODO: create function type
-                const aug_ir_operand address_operand = aug_ir_operand_from_symbol(symbol);
-                aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_FUNC, address_operand);
-                break;
-            }
+static void aug_jit_emit_mem_imm(aug_jit_code* code, uint8_t op, int ext, int base, int32_t disp, int32_t imm)
+{
+    aug_jit_emit_mem(code, &op, sizeof(op), ext, base, disp);
+    aug_jit_emit(code, &imm, sizeof(imm));
+}
 
-            const aug_ir_operand address_operand = aug_ir_operand_from_symbol(symbol);
-            if(symbol.scope == AUG_SYM_SCOPE_GLOBAL)
-                aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_GLOBAL, address_operand);
-            else // if local or param
-                aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_LOCAL, address_operand);
-            break;
-        }
-        case AUG_AST_UNARY_OP:
-        {
-            assert(children_size == 1); // token [0]
+// Condition branch displacement, patched once the target is emitted
+static int aug_jit_emit_jcc(aug_jit_code* code, uint8_t cc)
+{
+    const uint8_t jcc[] = { 0x0F, (uint8_t)(0x80 | cc) }; // jcc rel32
+    const int32_t rel = 0;
+    aug_jit_emit(code, jcc, sizeof(jcc));
+    aug_jit_emit(code, &rel, sizeof(rel));
+    return (int)code->size - (int)sizeof(rel);
+}
 
-            aug_generate_ir_pass(children[0], ir, input);
+static void aug_jit_bind(aug_jit_code* code, int patch)
+{
+    aug_jit_patch(code, patch, (int)code->size);
+}
 
-            switch (token.id)
-            {
-            case AUG_TOKEN_NOT: aug_ir_add_operation(ir, AUG_OPCODE_NOT); break;
-            default:
-                assert(0);
-                break;
-            }
-            break;
-        }
-        case AUG_AST_BINARY_OP:
-        {
-            assert(children_size == 2); // [0] token [1]
+// Continues at the bytecode offset if the condition code holds. Condition codes negate by their lowest bit
+static void aug_jit_emit_goto_if(aug_jit_code* code, uint8_t cc, int target)
+{
+    if(aug_jit_in_region(code, target))
+    {
+        const uint8_t jcc[] = { 0x0F, (uint8_t)(0x80 | cc) }; // jcc rel32
+        aug_jit_emit(code, jcc, sizeof(jcc));
+        aug_jit_emit_patch(code, target);
+        const int32_t rel = 0;
+        aug_jit_emit(code, &rel, sizeof(rel));
+        return;
+    }
+    const uint8_t jncc[] = { (uint8_t)(0x70 | (cc ^ 1)), AUG_JIT_EXIT_TO_SIZE }; // jncc rel8
+    aug_jit_emit(code, jncc, sizeof(jncc));
+    aug_jit_emit_exit_to(code, target);
+}
 
-            aug_token_id id = token.id;
-            if(id != AUG_TOKEN_ASSIGN) // special condition, assignment handles lhs via the addr/element
-                aug_generate_ir_pass(children[0], ir, input); // LHS
-            aug_generate_ir_pass(children[1], ir, input); // RHS
+static void aug_jit_emit_slow_if(aug_jit_code* code, uint8_t cc)
+{
+    assert(code->slow.patch_count < AUG_JIT_SLOW_PATCHES);
+    code->slow.patches[code->slow.patch_count++] = aug_jit_emit_jcc(code, cc);
+}
 
-            aug_ir_mark_source(ir, input->filename, token.pos);
+// Takes the slow path unless the value has the type
+static void aug_jit_emit_check_type(aug_jit_code* code, int base, int32_t disp, aug_type type)
+{
+    aug_jit_emit_mem_imm(code, 0x81, 7, base, disp + AUG_JIT_TYPE, (int32_t)type); // cmp dword [base + disp], type
+    aug_jit_emit_slow_if(code, AUG_JIT_NE);
+}
 
-            switch (token.id)
-            {
-                case AUG_TOKEN_ADD:        aug_ir_add_operation(ir, AUG_OPCODE_ADD);      break;
-                case AUG_TOKEN_SUB:        aug_ir_add_operation(ir, AUG_OPCODE_SUB);      break;
-                case AUG_TOKEN_MUL:        aug_ir_add_operation(ir, AUG_OPCODE_MUL);      break;
-                case AUG_TOKEN_DIV:        aug_ir_add_operation(ir, AUG_OPCODE_DIV);      break;
-                case AUG_TOKEN_MOD:        aug_ir_add_operation(ir, AUG_OPCODE_MOD);      break;
-                case AUG_TOKEN_POW:        aug_ir_add_operation(ir, AUG_OPCODE_POW);      break;
-                case AUG_TOKEN_AND:        aug_ir_add_operation(ir, AUG_OPCODE_AND);      break;
-                case AUG_TOKEN_OR:         aug_ir_add_operation(ir, AUG_OPCODE_OR);       break;
-                case AUG_TOKEN_LT:         aug_ir_add_operation(ir, AUG_OPCODE_LT);       break;
-                case AUG_TOKEN_LT_EQ:      aug_ir_add_operation(ir, AUG_OPCODE_LTE);      break;
-                case AUG_TOKEN_GT:         aug_ir_add_operation(ir, AUG_OPCODE_GT);       break;
-                case AUG_TOKEN_GT_EQ:      aug_ir_add_operation(ir, AUG_OPCODE_GTE);      break;
+// Takes the slow path if the value is reference counted, and needs the handler to release or retain it
+static void aug_jit_emit_check_unmanaged(aug_jit_code* code, int base, int32_t disp)
+{
+    aug_jit_emit_mem_imm(code, 0x81, 7, base, disp + AUG_JIT_TYPE, (int32_t)AUG_STRING); // cmp dword [base + disp], AUG_STRING
+    const uint8_t jb[] = { 0x72, 16 };                                                   // jb over the none check
+    aug_jit_emit(code, jb, sizeof(jb));
+    aug_jit_emit_mem_imm(code, 0x81, 7, base, disp + AUG_JIT_TYPE, (int32_t)AUG_NONE);   // cmp dword [base + disp], AUG_NONE
+    aug_jit_emit_slow_if(code, AUG_JIT_NE);
+}
+
+// rcx = the local at the stack offset from the frame base, see aug_vm_get_local
+static void aug_jit_emit_local(aug_jit_code* code, int stack_offset)
+{
+    const uint8_t movsxd[] = { 0x48, 0x63 };
+    aug_jit_emit_mem(code, movsxd, sizeof(movsxd), AUG_JIT_RCX, AUG_JIT_RBX, AUG_JIT_CONTEXT(base_index));
+    const uint8_t add[] = { 0x48, 0x81, 0xC1 }; // add rcx, stack_offset
+    const int32_t imm = stack_offset;
+    aug_jit_emit(code, add, sizeof(add));
+    aug_jit_emit(code, &imm, sizeof(imm));
+    const uint8_t cmp = 0x3B;                   // cmp ecx, [rbx + stack_size], unsigned to also reject negative offsets
+    aug_jit_emit_mem(code, &cmp, sizeof(cmp), AUG_JIT_RCX, AUG_JIT_RBX, AUG_JIT_CONTEXT(stack_size));
+    aug_jit_emit_slow_if(code, AUG_JIT_AE);
+    const uint8_t shl[] = { 0x48, 0xC1, 0xE1, 0x04 }; // shl rcx, log2(sizeof(aug_value))
+    aug_jit_emit(code, shl, sizeof(shl));
+    const uint8_t add_stack[] = { 0x48, 0x03 };
+    aug_jit_emit_mem(code, add_stack, sizeof(add_stack), AUG_JIT_RCX, AUG_JIT_RBX, AUG_JIT_CONTEXT(stack));
+}
+
+// rax = the stack slot past the top. Pushing takes the slow path if the stack is full
+static void aug_jit_emit_top(aug_jit_code* code, bool push)
+{
+    const uint8_t movsxd[] = { 0x48, 0x63 };
+    aug_jit_emit_mem(code, movsxd, sizeof(movsxd), AUG_JIT_RAX, AUG_JIT_RBX, AUG_JIT_CONTEXT(stack_index));
+    if(push)
+    {
+        const uint8_t cmp = 0x3B; // cmp eax, [rbx + stack_size]
+        aug_jit_emit_mem(code, &cmp, sizeof(cmp), AUG_JIT_RAX, AUG_JIT_RBX, AUG_JIT_CONTEXT(stack_size));
+        aug_jit_emit_slow_if(code, AUG_JIT_GE);
+    }
+    const uint8_t shl[] = { 0x48, 0xC1, 0xE0, 0x04 }; // shl rax, log2(sizeof(aug_value))
+    aug_jit_emit(code, shl, sizeof(shl));
+    const uint8_t add_stack[] = { 0x48, 0x03 };
+    aug_jit_emit_mem(code, add_stack, sizeof(add_stack), AUG_JIT_RAX, AUG_JIT_RBX, AUG_JIT_CONTEXT(stack));
+}
+
+static void aug_jit_emit_stack_add(aug_jit_code* code, int count)
+{
+    aug_jit_emit_mem_imm(code, 0x81, 0, AUG_JIT_RBX, AUG_JIT_CONTEXT(stack_index), count); // add dword [rbx + stack_index], count
+}
+
+static void aug_jit_emit_copy(aug_jit_code* code, int dst, int32_t dst_disp, int src, int32_t src_disp)
+{
+    const uint8_t load[] = { 0x0F, 0x10 };  // movups xmm0, [src]
+    const uint8_t store[] = { 0x0F, 0x11 }; // movups [dst], xmm0
+    aug_jit_emit_mem(code, load, sizeof(load), 0, src, src_disp);
+    aug_jit_emit_mem(code, store, sizeof(store), 0, dst, dst_disp);
+}
+
+// Takes the slow path unless the two operands on top of the stack have the type. rax is the slot past the top
+static void aug_jit_emit_binop_operands(aug_jit_code* code, aug_type type)
+{
+    aug_jit_emit_top(code, false);
+    aug_jit_emit_check_type(code, AUG_JIT_RAX, -2 * AUG_JIT_VALUE, type);
+    aug_jit_emit_check_type(code, AUG_JIT_RAX, -AUG_JIT_VALUE, type);
+}
+
+// Compares the int operands, setting the flags for lhs - rhs
+static void aug_jit_emit_compare_int(aug_jit_code* code)
+{
+    const uint8_t load = 0x8B; // mov edx, [lhs]
+    const uint8_t cmp = 0x3B;  // cmp edx, [rhs]
+    aug_jit_emit_mem(code, &load, sizeof(load), AUG_JIT_RDX, AUG_JIT_RAX, -2 * AUG_JIT_VALUE + AUG_JIT_DATA);
+    aug_jit_emit_mem(code, &cmp, sizeof(cmp), AUG_JIT_RDX, AUG_JIT_RAX, -AUG_JIT_VALUE + AUG_JIT_DATA);
+}
+
+// Compares the float operands, setting the flags as unsigned for first - second. Unordered operands set CF and ZF
+static void aug_jit_emit_compare_float(aug_jit_code* code, bool swap)
+{
+    const uint8_t load[] = { 0xF3, 0x0F, 0x10 }; // movss xmm0, [first]
+    const uint8_t cmp[] = { 0x0F, 0x2E };        // ucomiss xmm0, [second]
+    const int32_t lhs = -2 * AUG_JIT_VALUE + AUG_JIT_DATA, rhs = -AUG_JIT_VALUE + AUG_JIT_DATA;
+    aug_jit_emit_mem(code, load, sizeof(load), 0, AUG_JIT_RAX, swap ? rhs : lhs);
+    aug_jit_emit_mem(code, cmp, sizeof(cmp), 0, AUG_JIT_RAX, swap ? lhs : rhs);
+}
+
+// Replaces the lhs operand with the bool of the condition code, and pops the rhs
+static void aug_jit_emit_set_bool(aug_jit_code* code, uint8_t cc)
+{
+    const uint8_t set[] = { 0x0F, (uint8_t)(0x90 | cc), 0xC2, 0x0F, 0xB6, 0xD2 }; // setcc dl; movzx edx, dl
+    const uint8_t store = 0x89;                                                    // mov [lhs], edx
+    aug_jit_emit(code, set, sizeof(set));
+    aug_jit_emit_mem(code, &store, sizeof(store), AUG_JIT_RDX, AUG_JIT_RAX, -2 * AUG_JIT_VALUE + AUG_JIT_DATA);
+    aug_jit_emit_mem_imm(code, 0xC7, 0, AUG_JIT_RAX, -2 * AUG_JIT_VALUE + AUG_JIT_TYPE, (int32_t)AUG_BOOL);
+    aug_jit_emit_stack_add(code, -1);
+}
+
+static void aug_jit_emit_binop_int(aug_jit_code* code, const uint8_t* op, size_t op_size)
+{
+    const int32_t lhs = -2 * AUG_JIT_VALUE + AUG_JIT_DATA, rhs = -AUG_JIT_VALUE + AUG_JIT_DATA;
+    const uint8_t load = 0x8B;  // mov edx, [lhs]
+    const uint8_t store = 0x89; // mov [lhs], edx
+    aug_jit_emit_binop_operands(code, AUG_INT);
+    aug_jit_emit_mem(code, &load, sizeof(load), AUG_JIT_RDX, AUG_JIT_RAX, lhs);
+    aug_jit_emit_mem(code, op, op_size, AUG_JIT_RDX, AUG_JIT_RAX, rhs);
+    aug_jit_emit_mem(code, &store, sizeof(store), AUG_JIT_RDX, AUG_JIT_RAX, lhs);
+    aug_jit_emit_stack_add(code, -1);
+}
+
+static void aug_jit_emit_binop_float(aug_jit_code* code, uint8_t op)
+{
+    const int32_t lhs = -2 * AUG_JIT_VALUE + AUG_JIT_DATA, rhs = -AUG_JIT_VALUE + AUG_JIT_DATA;
+    const uint8_t load[] = { 0xF3, 0x0F, 0x10 };    // movss xmm0, [lhs]
+    const uint8_t compute[] = { 0xF3, 0x0F, op };   // op xmm0, [rhs]
+    const uint8_t store[] = { 0xF3, 0x0F, 0x11 };   // movss [lhs], xmm0
+    aug_jit_emit_binop_operands(code, AUG_FLOAT);
+    aug_jit_emit_mem(code, load, sizeof(load), 0, AUG_JIT_RAX, lhs);
+    aug_jit_emit_mem(code, compute, sizeof(compute), 0, AUG_JIT_RAX, rhs);
+    aug_jit_emit_mem(code, store, sizeof(store), 0, AUG_JIT_RAX, lhs);
+    aug_jit_emit_stack_add(code, -1);
+}
+
+// Pops the int operands, and continues at the target if the comparison is false
+static void aug_jit_emit_jump_zero_int(aug_jit_code* code, uint8_t cc, int target)
+{
+    aug_jit_emit_binop_operands(code, AUG_INT);
+    aug_jit_emit_stack_add(code, -2);
+    aug_jit_emit_compare_int(code);
+    aug_jit_emit_goto_if(code, cc ^ 1, target);
+}
+
+// Pops the float operands, and continues at the target if the comparison is false, including unordered operands
+static void aug_jit_emit_jump_zero_float(aug_jit_code* code, uint8_t cc, bool swap, int target)
+{
+    aug_jit_emit_binop_operands(code, AUG_FLOAT);
+    aug_jit_emit_stack_add(code, -2);
+    aug_jit_emit_compare_float(code, swap);
+    aug_jit_emit_goto_if(code, cc ^ 1, target);
+}
+
+// Emits the native template of the instruction. Returns false if the instruction has none, and only calls its handler
+static bool aug_jit_emit_template(aug_jit_code* code, const char* instruction)
+{
+    // Slots are addressed by shifting the index, see aug_jit_emit_local
+    if(sizeof(aug_value) != 16)
+        return false;
+
+    const int32_t lhs_type = -2 * AUG_JIT_VALUE + AUG_JIT_TYPE;
+    switch((aug_opcode)*instruction)
+    {
+    case AUG_OPCODE_JUMP:
+        aug_jit_emit_goto(code, aug_jit_read_int(instruction));
+        return true;
+    case AUG_OPCODE_PUSH_INT:
+        aug_jit_emit_top(code, true);
+        aug_jit_emit_mem_imm(code, 0xC7, 0, AUG_JIT_RAX, AUG_JIT_TYPE, (int32_t)AUG_INT);
+        aug_jit_emit_mem_imm(code, 0xC7, 0, AUG_JIT_RAX, AUG_JIT_DATA, aug_jit_read_int(instruction));
+        aug_jit_emit_stack_add(code, 1);
+        return true;
+    case AUG_OPCODE_PUSH_LOCAL:
+        aug_jit_emit_local(code, aug_jit_read_int(instruction));
+        aug_jit_emit_check_unmanaged(code, AUG_JIT_RCX, 0);
+        aug_jit_emit_top(code, true);
+        aug_jit_emit_check_unmanaged(code, AUG_JIT_RAX, 0);
+        aug_jit_emit_copy(code, AUG_JIT_RAX, 0, AUG_JIT_RCX, 0);
+        aug_jit_emit_stack_add(code, 1);
+        return true;
+    case AUG_OPCODE_LOAD_LOCAL:
+        // Moves the top into the local, leaving none in the popped slot
+        aug_jit_emit_local(code, aug_jit_read_int(instruction));
+        aug_jit_emit_check_unmanaged(code, AUG_JIT_RCX, 0);
+        aug_jit_emit_top(code, false);
+        aug_jit_emit_copy(code, AUG_JIT_RCX, 0, AUG_JIT_RAX, -AUG_JIT_VALUE);
+        aug_jit_emit_mem_imm(code, 0xC7, 0, AUG_JIT_RAX, -AUG_JIT_VALUE + AUG_JIT_TYPE, (int32_t)AUG_NONE);
+        aug_jit_emit_stack_add(code, -1);
+        return true;
+    case AUG_OPCODE_ADD_LOCAL_INT:
+    case AUG_OPCODE_SUB_LOCAL_INT:
+        aug_jit_emit_local(code, aug_jit_read_operand(instruction, 0));
+        aug_jit_emit_check_type(code, AUG_JIT_RCX, 0, AUG_INT);
+        aug_jit_emit_mem_imm(code, 0x81, (aug_opcode)*instruction == AUG_OPCODE_ADD_LOCAL_INT ? 0 : 5, 
+            AUG_JIT_RCX, AUG_JIT_DATA, aug_jit_read_operand(instruction, 1)); // add/sub dword [local], imm
+        return true;
+    case AUG_OPCODE_RANGE_NEXT:
+    {
+        // Types were checked by RANGE_BEGIN. Slots are the counter, bound and variable
+        const uint8_t load = 0x8B, cmp = 0x3B, store = 0x89;
+        const uint8_t increment[] = { 0x83, 0xC2, 0x01 }; // add edx, 1
+        aug_jit_emit_local(code, aug_jit_read_operand(instruction, 1));
+        aug_jit_emit_mem(code, &load, sizeof(load), AUG_JIT_RDX, AUG_JIT_RCX, AUG_JIT_DATA);
+        aug_jit_emit_mem(code, &cmp, sizeof(cmp), AUG_JIT_RDX, AUG_JIT_RCX, AUG_JIT_VALUE + AUG_JIT_DATA);
+        const int done = aug_jit_emit_jcc(code, AUG_JIT_GE);
+        aug_jit_emit_check_unmanaged(code, AUG_JIT_RCX, 2 * AUG_JIT_VALUE);
+        aug_jit_emit_mem_imm(code, 0xC7, 0, AUG_JIT_RCX, 2 * AUG_JIT_VALUE + AUG_JIT_TYPE, (int32_t)AUG_INT);
+        aug_jit_emit_mem(code, &store, sizeof(store), AUG_JIT_RDX, AUG_JIT_RCX, 2 * AUG_JIT_VALUE + AUG_JIT_DATA);
+        aug_jit_emit(code, increment, sizeof(increment));
+        aug_jit_emit_mem(code, &store, sizeof(store), AUG_JIT_RDX, AUG_JIT_RCX, AUG_JIT_DATA);
+        aug_jit_emit_goto(code, aug_jit_read_operand(instruction, 0));
+        aug_jit_bind(code, done);
+        return true;
+    }
+    case AUG_OPCODE_ADD_INT_INT:
+    {
+        const uint8_t op = 0x03; // add edx, [rhs]
+        aug_jit_emit_binop_int(code, &op, sizeof(op));
+        return true;
+    }
+    case AUG_OPCODE_SUB_INT_INT:
+    {
+        const uint8_t op = 0x2B; // sub edx, [rhs]
+        aug_jit_emit_binop_int(code, &op, sizeof(op));
+        return true;
+    }
+    case AUG_OPCODE_MUL_INT_INT:
+    {
+        const uint8_t op[] = { 0x0F, 0xAF }; // imul edx, [rhs]
+        aug_jit_emit_binop_int(code, op, sizeof(op));
+        return true;
+    }
+    case AUG_OPCODE_DIV_INT_INT:
+    {
+        // The quotient is a float
+        const uint8_t convert[] = { 0xF3, 0x0F, 0x2A };                // cvtsi2ss xmm, [operand]
+        const uint8_t divide[] = { 0xF3, 0x0F, 0x5E, 0xC1 };           // divss xmm0, xmm1
+        const uint8_t store[] = { 0xF3, 0x0F, 0x11 };                  // movss [lhs], xmm0
+        aug_jit_emit_binop_operands(code, AUG_INT);
+        aug_jit_emit_mem(code, convert, sizeof(convert), 0, AUG_JIT_RAX, -2 * AUG_JIT_VALUE + AUG_JIT_DATA);
+        aug_jit_emit_mem(code, convert, sizeof(convert), 1, AUG_JIT_RAX, -AUG_JIT_VALUE + AUG_JIT_DATA);
+        aug_jit_emit(code, divide, sizeof(divide));
+        aug_jit_emit_mem(code, store, sizeof(store), 0, AUG_JIT_RAX, -2 * AUG_JIT_VALUE + AUG_JIT_DATA);
+        aug_jit_emit_mem_imm(code, 0xC7, 0, AUG_JIT_RAX, lhs_type, (int32_t)AUG_FLOAT);
+        aug_jit_emit_stack_add(code, -1);
+        return true;
+    }
+    case AUG_OPCODE_ADD_FLOAT_FLOAT: aug_jit_emit_binop_float(code, 0x58); return true; // addss
+    case AUG_OPCODE_SUB_FLOAT_FLOAT: aug_jit_emit_binop_float(code, 0x5C); return true; // subss
+    case AUG_OPCODE_MUL_FLOAT_FLOAT: aug_jit_emit_binop_float(code, 0x59); return true; // mulss
+    case AUG_OPCODE_DIV_FLOAT_FLOAT: aug_jit_emit_binop_float(code, 0x5E); return true; // divss
+
+#define AUG_JIT_COMPARE_INT(opcode, cc)                                                                     \
+    case AUG_OPCODE_##opcode##_INT_INT:                                                                     \
+        aug_jit_emit_binop_operands(code, AUG_INT);                                                         \
+        aug_jit_emit_compare_int(code);                                                                     \
+        aug_jit_emit_set_bool(code, cc);                                                                    \
+        return true;                                                                                        \
+    case AUG_OPCODE_##opcode##_JUMP_ZERO_INT_INT:                                                           \
+        aug_jit_emit_jump_zero_int(code, cc, aug_jit_read_int(instruction));                                \
+        return true;
+    AUG_JIT_COMPARE_INT(LT, AUG_JIT_L)
+    AUG_JIT_COMPARE_INT(LTE, AUG_JIT_LE)
+    AUG_JIT_COMPARE_INT(GT, AUG_JIT_G)
+    AUG_JIT_COMPARE_INT(GTE, AUG_JIT_GE)
+    AUG_JIT_COMPARE_INT(EQ, AUG_JIT_E)
+    AUG_JIT_COMPARE_INT(NEQ, AUG_JIT_NE)
+#undef AUG_JIT_COMPARE_INT
+
+    // Ordered float comparisons compare rhs - lhs for less than, so that unordered operands are false
+#define AUG_JIT_COMPARE_FLOAT(opcode, cc, swap)                                                             \
+    case AUG_OPCODE_##opcode##_FLOAT_FLOAT:                                                                 \
+        aug_jit_emit_binop_operands(code, AUG_FLOAT);                                                       \
+        aug_jit_emit_compare_float(code, swap);                                                             \
+        aug_jit_emit_set_bool(code, cc);                                                                    \
+        return true;                                                                                        \
+    case AUG_OPCODE_##opcode##_JUMP_ZERO_FLOAT_FLOAT:                                                       \
+        aug_jit_emit_jump_zero_float(code, cc, swap, aug_jit_read_int(instruction));                        \
+        return true;
+    AUG_JIT_COMPARE_FLOAT(LT, AUG_JIT_A, true)
+    AUG_JIT_COMPARE_FLOAT(LTE, AUG_JIT_AE, true)
+    AUG_JIT_COMPARE_FLOAT(GT, AUG_JIT_A, false)
+    AUG_JIT_COMPARE_FLOAT(GTE, AUG_JIT_AE, false)
+#undef AUG_JIT_COMPARE_FLOAT
+
+    default:
+        break;
+    }
+    return false;
+}
+
+#undef AUG_JIT_CONTEXT
+#undef AUG_JIT_TYPE
+#undef AUG_JIT_DATA
+#undef AUG_JIT_VALUE
+#else
+// Values are tagged by their upper bits, and every instruction calls its handler
+static bool aug_jit_emit_template(aug_jit_code* code, const char* instruction)
+{
+    if((aug_opcode)*instruction != AUG_OPCODE_JUMP)
+        return false;
+    aug_jit_emit_goto(code, aug_jit_read_int(instruction));
+    return true;
+}
+#endif//!AUG_COMPACT_VALUE
+
+#undef AUG_JIT_EXIT_TO_SIZE
+
+aug_jit* aug_jit_new(const char* bytecode, size_t bytecode_size)
+{
+    if(bytecode == NULL || bytecode_size == 0)
+        return NULL;
+
+    aug_jit* jit = (aug_jit*)AUG_ALLOC(sizeof(aug_jit));
+    jit->bytecode = bytecode;
+    jit->bytecode_size = bytecode_size;
+    jit->entries = (aug_jit_func**)AUG_ALLOC(sizeof(aug_jit_func*) * bytecode_size);
+    jit->counters = (int*)AUG_ALLOC(sizeof(int) * bytecode_size);
+    for(size_t i = 0; i < bytecode_size; ++i)
+    {
+        jit->entries[i] = NULL;
+        jit->counters[i] = 0;
+    }
+    jit->code = aug_container_new_type(aug_jit_mapping, 1);
+    return jit;
+}
+
+void aug_jit_delete(aug_jit* jit)
+{
+    if(jit == NULL)
+        return;
+
+    for(size_t i = 0; i < jit->code->length; ++i)
+    {
+        aug_jit_mapping mapping = aug_container_at_type(aug_jit_mapping, jit->code, i);
+        munmap(mapping.data, mapping.size);
+    }
+    jit->code = aug_container_decref(jit->code);
+    AUG_FREE(jit->entries);
+    AUG_FREE(jit->counters);
+    AUG_FREE(jit);
+}
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS 0x20 // Linux value, not declared by strict standard modes
+#endif//MAP_ANONYMOUS
+
+// Offset past the function starting at its ENTER_FUNC instruction, at the first return past all forward branches. 
+// Returns -1 if the function can not be compiled
+static int aug_jit_function_end(const aug_jit* jit, int start)
+{
+    const char* bytecode = jit->bytecode;
+    const int size = (int)jit->bytecode_size;
+
+    int end = start;
+    int furthest = start;
+    while(true)
+    {
+        if(end >= size)
+            return -1;
+        const int operand_size = aug_jit_operand_size(bytecode + end);
+        if(operand_size < 0)
+            return -1;
+
+        const int target = aug_jit_branch_target(bytecode + end);
+        if(target > furthest)
+            furthest = target;
+
+        const bool is_return = (aug_opcode)bytecode[end] == AUG_OPCODE_RETURN_FUNC;
+        end += 1 + operand_size;
+        if(is_return && end > furthest)
+            return end;
+    }
+}
+
+// Compiles the region of bytecode from start to end, either a function starting at its ENTER_FUNC instruction or a loop
+// ending at its backward branch. The region start, a function's body and the return addresses of its calls become 
+// native code entries, so that calls and returns between compiled code continue in native code
+static bool aug_jit_compile(aug_jit* jit, int start, int end)
+{
+    const char* bytecode = jit->bytecode;
+    for(int offset = start; offset < end; )
+    {
+        const int operand_size = aug_jit_operand_size(bytecode + offset);
+        if(operand_size < 0 || aug_jit_op_lookup((aug_opcode)bytecode[offset]) == NULL)
+            return false;
+        offset += 1 + operand_size;
+        if(offset > end)
+            return false;
+    }
+
+    aug_jit_code code;
+    code.capacity = 256;
+    code.size = 0;
+    code.data = (uint8_t*)AUG_ALLOC(code.capacity);
+    code.bytecode = bytecode;
+    code.start = start;
+    code.end = end;
+    code.patch_capacity = 16;
+    code.patch_count = 0;
+    code.patch_offset = (int*)AUG_ALLOC(sizeof(int) * code.patch_capacity);
+    code.patch_target = (int*)AUG_ALLOC(sizeof(int) * code.patch_capacity);
+    code.labels = (int*)AUG_ALLOC(sizeof(int) * (end - start));
+    for(int i = 0; i < end - start; ++i)
+        code.labels[i] = -1;
+    code.slow_paths = aug_container_new_type(aug_jit_slow, 4);
+
+    // Entries are the region start, a function's body, and the return addresses of calls within the region
+    aug_container* entries = aug_container_new_type(int, 4);
+    aug_container_push_type(int, entries, start);
+    if((aug_opcode)bytecode[start] == AUG_OPCODE_ENTER_FUNC)
+        aug_container_push_type(int, entries, start + 1 + aug_jit_operand_size(bytecode + start));
+
+    int offset = start;
+    while(offset < end)
+    {
+        const char* instruction = bytecode + offset;
+        const int next = offset + 1 + aug_jit_operand_size(instruction);
+        code.labels[offset - start] = (int)code.size;
+
+        if((aug_opcode)*instruction == AUG_OPCODE_CALL_FRAME)
+        {
+            const int ret_addr = aug_jit_read_int(instruction);
+            if(ret_addr >= start && ret_addr < end)
+                aug_container_push_type(int, entries, ret_addr);
+        }
+
+        code.slow.offset = offset;
+        code.slow.patch_count = 0;
+        if(aug_jit_emit_template(&code, instruction))
+        {
+            if(code.slow.patch_count > 0)
+                aug_container_push_type(aug_jit_slow, code.slow_paths, code.slow);
+            if(next >= end)
+                aug_jit_emit_exit_to(&code, next);
+        }
+        else
+            aug_jit_emit_handler(&code, instruction, false);
+        offset = next;
+    }
+
+    // Slow paths are out of line, so that the templates continue directly to the next instruction
+    for(size_t i = 0; i < code.slow_paths->length; ++i)
+    {
+        const aug_jit_slow slow = aug_container_at_type(aug_jit_slow, code.slow_paths, i);
+        for(int j = 0; j < slow.patch_count; ++j)
+            aug_jit_patch(&code, slow.patches[j], (int)code.size);
+        aug_jit_emit_handler(&code, bytecode + slow.offset, true);
+    }
+
+    const int exit_label = (int)code.size;
+    aug_jit_emit_epilogue(&code);
+
+    int* entry_labels = (int*)AUG_ALLOC(sizeof(int) * entries->length);
+    for(size_t i = 0; i < entries->length; ++i)
+    {
+        entry_labels[i] = (int)code.size;
+        aug_jit_emit_prologue(&code);
+        aug_jit_emit_branch(&code, aug_container_at_type(int, entries, i));
+    }
+
+    // Resolve the branches to the instruction labels
+    code.valid = true;
+    for(int i = 0; i < code.patch_count; ++i)
+    {
+        const int target = code.patch_target[i];
+        const int label = target < 0 ? exit_label : code.labels[target - start];
+        if(label < 0 || !aug_jit_patch(&code, code.patch_offset[i], label))
+            code.valid = false;
+    }
+
+    void* data = NULL;
+    if(code.valid)
+    {
+        data = mmap(NULL, code.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(data == MAP_FAILED)
+            data = NULL;
+    }
+
+    if(data != NULL)
+    {
+        memcpy(data, code.data, code.size);
+        if(mprotect(data, code.size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(data, code.size);
+            data = NULL;
+        }
+    }
+
+    if(data != NULL)
+    {
+        __builtin___clear_cache((char*)data, (char*)data + code.size);
+
+        aug_jit_mapping mapping;
+        mapping.data = data;
+        mapping.size = code.size;
+        aug_container_push_type(aug_jit_mapping, jit->code, mapping);
+
+        for(size_t i = 0; i < entries->length; ++i)
+        {
+            const int entry = aug_container_at_type(int, entries, i);
+            if(jit->entries[entry] == NULL)
+                jit->entries[entry] = (aug_jit_func*)((uint8_t*)data + entry_labels[i]);
+        }
+    }
+
+    AUG_FREE(entry_labels);
+    aug_container_decref(entries);
+    aug_container_decref(code.slow_paths);
+    AUG_FREE(code.labels);
+    AUG_FREE(code.patch_offset);
+    AUG_FREE(code.patch_target);
+    AUG_FREE(code.data);
+    return data != NULL;
+}
+
+static inline bool aug_jit_enabled(aug_context* context)
+{
+    // Native code does not count instructions for the budget or the profiler
+    if(context->coroutine || context->profiler != NULL)
+        return false;
+#if AUG_DEBUG
+    if(context->vm->debug_post_instruction != NULL)
+        return false;
+#endif//AUG_DEBUG
+    return true;
+}
+
+// Executes native code while the next instruction has been compiled. Returns to the interpreter otherwise
+static void aug_jit_run(aug_context* context)
+{
+    aug_jit* jit = context->jit;
+    if(!aug_jit_enabled(context))
+        return;
+
+    while(context->instruction != NULL)
+    {
+        const size_t offset = (size_t)(context->instruction - jit->bytecode);
+        if(offset >= jit->bytecode_size || jit->entries[offset] == NULL)
+            break;
+        jit->entries[offset](context);
+    }
+}
+
+// Count of calls or loop iterations interpreted before compiling. The interpreted code quickens the executed instructions
+#define AUG_JIT_CALLS (AUG_JIT_THRESHOLD > 1 ? AUG_JIT_THRESHOLD : 2)
+
+// Counts the calls of the function entered, compiling it once called AUG_JIT_THRESHOLD times
+static void aug_jit_enter(aug_context* context)
+{
+    aug_jit* jit = context->jit;
+    const size_t offset = (size_t)(context->last_instruction - jit->bytecode);
+    if(offset >= jit->bytecode_size || !aug_jit_enabled(context))
+        return;
+
+    if(jit->entries[offset] == NULL)
+    {
+        int* counter = &jit->counters[offset];
+        if(*counter < 0 || ++(*counter) < AUG_JIT_CALLS)
+            return;
+        const int end = aug_jit_function_end(jit, (int)offset);
+        if(end < 0 || !aug_jit_compile(jit, (int)offset, end))
+        {
+            *counter = -1;
+            return;
+        }
+    }
+    aug_jit_run(context);
+}
+
+// Counts the iterations of the loop branched back to, compiling the loop once iterated AUG_JIT_THRESHOLD times. 
+// The loop spans from the branch target to the branch
+static void aug_jit_loop(aug_context* context)
+{
+    aug_jit* jit = context->jit;
+    const size_t offset = (size_t)(context->instruction - jit->bytecode);
+    const size_t branch = (size_t)(context->last_instruction - jit->bytecode);
+    if(branch >= jit->bytecode_size || !aug_jit_enabled(context))
+        return;
+
+    if(jit->entries[offset] == NULL)
+    {
+        int* counter = &jit->counters[offset];
+        if(*counter < 0 || ++(*counter) < AUG_JIT_CALLS)
+            return;
+        const int end = (int)branch + 1 + aug_jit_operand_size(jit->bytecode + branch);
+        if(!aug_jit_compile(jit, (int)offset, end))
+        {
+            *counter = -1;
+            return;
+        }
+    }
+    aug_jit_run(context);
+}
+
+#undef AUG_JIT_CALLS
+
+#endif//AUG_JIT
+
+#undef AUG_VM_CASE
+#undef AUG_VM_DEFAULT
+#undef AUG_VM_NEXT
+#undef AUG_VM_DISPATCH
+#undef AUG_VM_DEBUG_POST_INSTRUCTION
+#undef AUG_VM_BUDGET
+#undef AUG_VM_JIT_ENTER
+#undef AUG_VM_JIT_RESUME
+#undef AUG_VM_JIT_LOOP
+#undef AUG_OPCODE_UNOP
+#undef AUG_OPCODE_BINOP
+#undef AUG_OPCODE_BINOP_INT
+#undef AUG_OPCODE_BINOP_JUMP_ZERO
+#undef AUG_OPCODE_BINOP_REG
+#undef AUG_OPCODE_BINOP_JUMP_ZERO_REG
+#undef AUG_VM_LOOP_BEGIN
+#undef AUG_VM_LOOP_END
+#undef AUG_VM_YIELD_HANDLER
+#undef AUG_VM_UNSUPPORTED_HANDLERS
+#undef AUG_OPCODE_LIST
+
+// Pushes the call frame and arguments of a call from the host, then jumps to the function. The call returns to
+// the host, stopping execution
+static inline void aug_vm_push_host_frame(aug_context* context, int func_addr, int argc, aug_value* args)
+{
+    // Manually set expected call frame
+    aug_vm_push_call_frame(context, AUG_OPCODE_INVALID);
+
+    context->arg_count = argc; // setup expected argument count 
+
+    // Jump to function call
+    context->instruction = context->bytecode + func_addr;
+
+    for(int i = 0; i < argc; ++i)
+    {
+        aug_value* value = aug_vm_push(context);
+        if(value)
+            *value = args[i];
+    }
+
+    context->base_index = context->stack_index;
+}
+
+aug_value aug_vm_execute_from_frame(aug_context* context, int func_addr, int argc, aug_value* args)
+{
+    aug_vm_push_host_frame(context, func_addr, argc, args);
+    aug_vm_execute(context);
+
+    aug_value ret_value = aug_none();
+    if(!context->suspended && context->stack_index >= 1)
+    {
+        // If stack is valid, get the pushed value
+        aug_value* top = aug_vm_pop(context);
+        if(top)
+            ret_value = *top;
+    }
+    return ret_value;
+}
+
+// Calls the function once per argument tuple, from the same stack state. Returns the number of calls that returned
+int aug_vm_execute_batch(aug_context* context, int func_addr, int count, int argc, aug_value* args, aug_value* results)
+{
+    const int stack_index = context->stack_index;
+    const int base_index = context->base_index;
+    int returned = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        aug_vm_push_host_frame(context, func_addr, argc, argc > 0 ? args + (size_t)i * argc : NULL);
+        aug_vm_execute(context);
+
+        // Returning restores the base, and leaves only the return value. Discard any values left by a failed call
+        aug_value ret_value = aug_none();
+        if(context->base_index == base_index && context->stack_index == stack_index + 1)
+        {
+            ret_value = *aug_vm_pop(context);
+            ++returned;
+        }
+        while(context->stack_index > stack_index)
+            aug_decref(aug_vm_pop(context));
+        context->base_index = base_index;
+
+        if(results != NULL)
+            results[i] = ret_value;
+        else
+            aug_decref(&ret_value);
+    }
+    return returned;
+}
+
+aug_context* aug_vm_context_new(aug_vm* vm, aug_heap* heap, int stack_size)
+{
+    aug_context* context = (aug_context*)aug_heap_alloc(heap, sizeof(aug_context));
+    context->vm = vm;
+    context->heap = heap;
+    context->script = NULL;
+    context->last_instruction = NULL;
+    context->markers = NULL;
+    context->lib_extensions = NULL;
+    context->profiler = NULL;
+    context->profile_node = NULL;
+
+    context->stack_size = stack_size > 0 ? stack_size : AUG_STACK_SIZE;
+    context->stack = (aug_value*)aug_heap_alloc(heap, sizeof(aug_value) * context->stack_size);
+    for (int i = 0; i < context->stack_size; ++i)
+        context->stack[i] = aug_none();
+
+    aug_vm_startup(context);
+    return context;
+}
+
+void aug_vm_context_delete(aug_context* context)
+{
+    aug_heap* heap = context->heap;
+    aug_heap_free(heap, context->stack, sizeof(aug_value) * context->stack_size);
+    aug_heap_free(heap, context, sizeof(aug_context));
+}
+
+// COMPILER ============================================== COMPILER ========================================== COMPILER // 
+
+void aug_generate_ir_pass(const aug_ast* node, aug_ir* ir, aug_input* input);
+
+void aug_generate_ir_prepass(const aug_ast* node, aug_ir* ir, aug_input* input)
+{
+    // This is a statement prepass. Will gather globals and handle use calls
+    if(node == NULL || !ir->valid || input == NULL)
+        return;
+
+    const aug_token token = node->token;
+    aug_string* token_data = token.data; 
+    aug_ast** children = node->children;
+    const int children_size = node->children_size;
+
+    switch(node->type)
+    {
+        case AUG_AST_ROOT:
+        case AUG_AST_BLOCK: 
+        {
+            for(int i = 0; i < children_size; ++ i)
+                aug_generate_ir_prepass(children[i], ir, input);
+            break;
+        }
+        case AUG_AST_STMT_DEFINE_FUNC: 
+        {
+            assert(token_data != NULL && children_size == 2); //func token [0] {[1]};
+
+            aug_ast* params = children[0];
+            assert(params && params->type == AUG_AST_PARAM_LIST);
+            const int param_count = params->children_size;
+
+            if(!aug_ir_set_func(ir, token_data, param_count, false))
+            {
+                ir->valid = false;
+                aug_log_input_error_at(input, &token.pos, "Global %s already defined", token_data->buffer);
+                break;
+            }
+            break;
+        }
+        case AUG_AST_IMPORT_LIB:
+        {
+            const aug_ir_operand operand = aug_ir_operand_from_str(token_data);
+            aug_ir_add_operation_arg(ir, AUG_OPCODE_IMPORT_LIB, operand);
+            break;
+        } 
+        case AUG_AST_IMPORT_SCRIPT:
+        {
+            // TODO: open and parse script, should be relative to the current input. (i.e. trunk filename, add relative path and get absolute?) 
+            aug_string* imported_filename = aug_string_create(input->filename->buffer);
+            size_t dir_pos = imported_filename->length;
+            while(dir_pos > 0 && imported_filename->buffer[dir_pos - 1] != '/' && imported_filename->buffer[dir_pos - 1] != '\\')
+                --dir_pos;
+
+            for(size_t i = 0; i <= token_data->length; ++i) // <= note include null term
+            {
+                if(i+dir_pos >= imported_filename->length)
+                    aug_string_push(imported_filename, token_data->buffer[i]);
+                else
+                    aug_string_set(imported_filename, i+dir_pos, token_data->buffer[i]);
+            }
+
+            // Parse file
+            aug_input* imported_input = aug_input_open(imported_filename->buffer, input->error_func);
+            aug_ast* root = aug_parse(imported_input);
+
+            // Keep the filename to check the imported script for modifications, including scripts that failed to parse
+            aug_container_push_type(aug_string*, ir->imports, imported_filename);
+            if (root == NULL)
+            {
+                aug_input_close(imported_input);
+                aug_log_input_error_at(input, &token.pos, "Failed to use script %s", token_data->buffer);
+                break;
+            }
+
+            // Generate IR. Symbols copy their names so they outlive the imported input's arena
+            aug_generate_ir_pass(root, ir, imported_input);
+            aug_input_close(imported_input);
+            break;  
+        } 
+        default: 
+            break;
+    }
+}
+
+// Values of the literal tokens other than strings, which are pushed from the constants
+static inline bool aug_ir_literal_value(const aug_token* token, aug_value* value)
+{
+    const aug_string* token_data = token->data;
+    switch (token->id)
+    {
+        case AUG_TOKEN_CHAR:
+            assert(token_data && token_data->length == 1);
+            return aug_set_char(value, token_data->buffer[0]);
+        case AUG_TOKEN_INT:
+            assert(token_data && token_data->length > 0);
+            return aug_set_int(value, strtol(token_data->buffer, NULL, 10));
+        case AUG_TOKEN_HEX:
+            assert(token_data && token_data->length > 2 && token_data->buffer[1] == 'x'); 
+            return aug_set_int(value, strtoul(token_data->buffer + 2, NULL, 16)); // +2 skip 0x 
+        case AUG_TOKEN_BINARY:
+            assert(token_data && token_data->length > 2 && token_data->buffer[1] == 'b');
+            return aug_set_int(value, strtoul(token_data->buffer + 2, NULL, 2)); // +2 skip 0b 
+        case AUG_TOKEN_FLOAT:
+            assert(token_data && token_data->length > 0);
+            return aug_set_float(value, strtof(token_data->buffer, NULL));
+        case AUG_TOKEN_TRUE:
+            return aug_set_bool(value, true);
+        case AUG_TOKEN_FALSE:
+            return aug_set_bool(value, false);
+        case AUG_TOKEN_NONE:
+            *value = aug_none();
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+static inline void aug_ir_add_push_constant(aug_ir* ir, const aug_value* value)
+{
+    switch (aug_value_type(value))
+    {
+        case AUG_BOOL:  aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_BOOL, aug_ir_operand_from_bool(aug_value_bool(value)));    break;
+        case AUG_INT:   aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_INT, aug_ir_operand_from_int(aug_value_int(value)));       break;
+        case AUG_CHAR:  aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_CHAR, aug_ir_operand_from_char(aug_value_char(value)));    break;
+        case AUG_FLOAT: aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_FLOAT, aug_ir_operand_from_float(aug_value_float(value))); break;
+        case AUG_NONE:  aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE); break;
+        default:
+            assert(0);
+            break;
+    }
+}
+
+// Integer modulo and char division by zero trap on the host, these are left to fail when executed
+static inline bool aug_ir_fold_divisor_valid(const aug_value* divisor)
+{
+    switch (aug_value_type(divisor))
+    {
+        case AUG_INT:  return aug_value_int(divisor) != 0 && aug_value_int(divisor) != -1;
+        case AUG_CHAR: return aug_value_char(divisor) != 0;
+        default:
+            break;
+    }
+    return true;
+}
+
+// Evaluates an expression of literals while generating. The same operations as the VM are used, so the result is 
+// identical to executing the expression. Returns false if the expression is not constant, or the operation is not 
+// defined for the operands, in which case the operations are generated and report the error when executed
+static bool aug_ir_fold_constant(const aug_ast* node, aug_value* result)
+{
+    if(node == NULL)
+        return false;
+
+    switch (node->type)
+    {
+        case AUG_AST_LITERAL:
+            return aug_ir_literal_value(&node->token, result);
+        case AUG_AST_UNARY_OP:
+        {
+            aug_value arg;
+            if(node->token.id != AUG_TOKEN_NOT || !aug_ir_fold_constant(node->children[0], &arg))
+                return false;
+            return aug_not(result, &arg);
+        }
+        case AUG_AST_BINARY_OP:
+        {
+            aug_value lhs, rhs;
+            if(!aug_ir_fold_constant(node->children[0], &lhs) || !aug_ir_fold_constant(node->children[1], &rhs))
+                return false;
+
+            switch (node->token.id)
+            {
+                case AUG_TOKEN_ADD:       return aug_add(result, &lhs, &rhs);
+                case AUG_TOKEN_SUB:       return aug_sub(result, &lhs, &rhs);
+                case AUG_TOKEN_MUL:       return aug_mul(result, &lhs, &rhs);
+                case AUG_TOKEN_DIV:       return aug_ir_fold_divisor_valid(&rhs) && aug_div(result, &lhs, &rhs);
+                case AUG_TOKEN_MOD:       return aug_ir_fold_divisor_valid(&rhs) && aug_mod(result, &lhs, &rhs);
+                case AUG_TOKEN_POW:       return aug_pow(result, &lhs, &rhs);
+                case AUG_TOKEN_AND:       return aug_and(result, &lhs, &rhs);
+                case AUG_TOKEN_OR:        return aug_or(result, &lhs, &rhs);
+                case AUG_TOKEN_LT:        return aug_lt(result, &lhs, &rhs);
+                case AUG_TOKEN_LT_EQ:     return aug_lte(result, &lhs, &rhs);
+                case AUG_TOKEN_GT:        return aug_gt(result, &lhs, &rhs);
+                case AUG_TOKEN_GT_EQ:     return aug_gte(result, &lhs, &rhs);
+                case AUG_TOKEN_EQ:        return aug_eq(result, &lhs, &rhs);
+                case AUG_TOKEN_NOT_EQ:    return aug_neq(result, &lhs, &rhs);
+                case AUG_TOKEN_APPROX_EQ: return aug_approxeq(result, &lhs, &rhs);
+                default:
+                    break; // assignments
+            }
+            return false;
+        }
+        default:
+            break;
+    }
+    return false;
+}
+
+void aug_generate_ir_pass(const aug_ast* node, aug_ir* ir, aug_input* input)
+{
+    if(node == NULL || !ir->valid)
+        return;
+
+    const aug_token token = node->token;
+    aug_string* token_data = token.data; 
+    aug_ast** children = node->children;
+    const int children_size = node->children_size;
+
+    switch(node->type)
+    {
+        case AUG_AST_ROOT:
+        {
+            // gather globals, uses etc..
+            aug_generate_ir_prepass(node, ir, input);
+
+            for(int i = 0; i < children_size; ++ i)
+                aug_generate_ir_pass(children[i], ir, input);
+            break;
+        }
+        case AUG_AST_BLOCK: 
+        {
+            for(int i = 0; i < children_size; ++ i)
+                aug_generate_ir_pass(children[i], ir, input);
+
+            break;
+        }
+        case AUG_AST_LITERAL:
+        {
+            if(token.id == AUG_TOKEN_STRING)
+            {
+                const aug_ir_operand operand = aug_ir_operand_from_int(aug_ir_get_constant_index(ir, token_data));
+                aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_STRING, operand);
+                break;
+            }
+
+            aug_value value;
+            if(aug_ir_literal_value(&token, &value))
+                aug_ir_add_push_constant(ir, &value);
+            else
+                assert(0);
+            break;
+        }
+        case AUG_AST_VARIABLE:
+        {
+            assert(token_data != NULL);
+
+            const aug_symbol symbol = aug_ir_get_symbol_relative(ir, token_data);
+            if(symbol.type == AUG_SYM_NONE)
+            {
+                ir->valid = false;
+                aug_log_input_error_at(input, &token.pos, "Variable %s not defined in current block", 
+                    token_data->buffer);
+                return;
+            }
+
+            aug_ir_mark_symbol(ir, symbol);
+
+            if(symbol.type == AUG_SYM_FUNC)
+            {
+                //TODO: create function type
+                const aug_ir_operand address_operand = aug_ir_operand_from_symbol(symbol);
+                aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_FUNC, address_operand);
+                break;
+            }
+
+            const aug_ir_operand address_operand = aug_ir_operand_from_symbol(symbol);
+            if(symbol.scope == AUG_SYM_SCOPE_GLOBAL)
+                aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_GLOBAL, address_operand);
+            else // if local or param
+                aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_LOCAL, address_operand);
+            break;
+        }
+        case AUG_AST_UNARY_OP:
+        {
+            assert(children_size == 1); // token [0]
+
+            aug_value constant;
+            if(ir->optimize_level > 0 && aug_ir_fold_constant(node, &constant))
+            {
+                aug_ir_add_push_constant(ir, &constant);
+                break;
+            }
+
+            aug_generate_ir_pass(children[0], ir, input);
+
+            switch (token.id)
+            {
+            case AUG_TOKEN_NOT: aug_ir_add_operation(ir, AUG_OPCODE_NOT); break;
+            default:
+                assert(0);
+                break;
+            }
+            break;
+        }
+        case AUG_AST_BINARY_OP:
+        {
+            assert(children_size == 2); // [0] token [1]
+
+            aug_value constant;
+            if(ir->optimize_level > 0 && aug_ir_fold_constant(node, &constant))
+            {
+                aug_ir_add_push_constant(ir, &constant);
+                break;
+            }
+
+            aug_token_id id = token.id;
+            if(id != AUG_TOKEN_ASSIGN) // special condition, assignment handles lhs via the addr/element
+                aug_generate_ir_pass(children[0], ir, input); // LHS
+            aug_generate_ir_pass(children[1], ir, input); // RHS
+
+            aug_ir_mark_source(ir, input, token.pos);
+
+            switch (token.id)
+            {
+                case AUG_TOKEN_ADD:        aug_ir_add_operation(ir, AUG_OPCODE_ADD);      break;
+                case AUG_TOKEN_SUB:        aug_ir_add_operation(ir, AUG_OPCODE_SUB);      break;
+                case AUG_TOKEN_MUL:        aug_ir_add_operation(ir, AUG_OPCODE_MUL);      break;
+                case AUG_TOKEN_DIV:        aug_ir_add_operation(ir, AUG_OPCODE_DIV);      break;
+                case AUG_TOKEN_MOD:        aug_ir_add_operation(ir, AUG_OPCODE_MOD);      break;
+                case AUG_TOKEN_POW:        aug_ir_add_operation(ir, AUG_OPCODE_POW);      break;
+                case AUG_TOKEN_AND:        aug_ir_add_operation(ir, AUG_OPCODE_AND);      break;
+                case AUG_TOKEN_OR:         aug_ir_add_operation(ir, AUG_OPCODE_OR);       break;
+                case AUG_TOKEN_LT:         aug_ir_add_operation(ir, AUG_OPCODE_LT);       break;
+                case AUG_TOKEN_LT_EQ:      aug_ir_add_operation(ir, AUG_OPCODE_LTE);      break;
+                case AUG_TOKEN_GT:         aug_ir_add_operation(ir, AUG_OPCODE_GT);       break;
+                case AUG_TOKEN_GT_EQ:      aug_ir_add_operation(ir, AUG_OPCODE_GTE);      break;
                 case AUG_TOKEN_EQ:         aug_ir_add_operation(ir, AUG_OPCODE_EQ);       break;
                 case AUG_TOKEN_NOT_EQ:     aug_ir_add_operation(ir, AUG_OPCODE_NEQ);      break;
                 case AUG_TOKEN_APPROX_EQ:  aug_ir_add_operation(ir, AUG_OPCODE_APPROXEQ); break;
-                case AUG_TOKEN_ADD_ASSIGN: aug_ir_add_operation(ir, AUG_OPCODE_ADD); id = AUG_TOKEN_ASSIGN; break;
+                case AUG_TOKEN_ADD_ASSIGN: 
+                    // Variables are added to by ADD_ASSIGN_LOCAL/GLOBAL, which append to unshared strings and arrays in place
+                    if(children[0]->type != AUG_AST_VARIABLE)
+                        aug_ir_add_operation(ir, AUG_OPCODE_ADD); 
+                    id = AUG_TOKEN_ASSIGN; 
+                    break;
                 case AUG_TOKEN_SUB_ASSIGN: aug_ir_add_operation(ir, AUG_OPCODE_SUB); id = AUG_TOKEN_ASSIGN; break;
                 case AUG_TOKEN_MUL_ASSIGN: aug_ir_add_operation(ir, AUG_OPCODE_MUL); id = AUG_TOKEN_ASSIGN; break;
                 case AUG_TOKEN_DIV_ASSIGN: aug_ir_add_operation(ir, AUG_OPCODE_DIV); id = AUG_TOKEN_ASSIGN; break;
@@ -5538,1492 +9129,5375 @@ void aug_generate_ir_pass(const aug_ast* node, aug_ir* ir, aug_input* input)
                 default: break;
             }
 
-            if(id == AUG_TOKEN_ASSIGN)
-            {
-                aug_ast* var_node = children[0];
+            if(id == AUG_TOKEN_ASSIGN)
+            {
+                aug_ast* var_node = children[0];
+
+                // LHS must be an element of variable
+                if(var_node->type != AUG_AST_VARIABLE && var_node->type != AUG_AST_ELEMENT)
+                {
+                    ir->valid = false;
+                    aug_log_input_error_at(input, &token.pos, "Left hand of assignment must be a variable or element");
+                    break;
+                }
+
+                if(var_node->type == AUG_AST_VARIABLE)
+                {
+                    aug_string* var_token_data = var_node->token.data;
+                    assert(var_token_data);
+
+                    const aug_symbol symbol = aug_ir_get_symbol_relative(ir, var_token_data);
+                    if(symbol.type == AUG_SYM_NONE)
+                    {
+                        ir->valid = false;
+                        aug_log_input_error_at(input, &token.pos, "Variable %s not defined", var_token_data->buffer);
+                        break;
+                    }
+                    if(symbol.type == AUG_SYM_FUNC)
+                    {
+                        ir->valid = false;
+                        aug_log_input_error_at(input, &token.pos, "Can not assign function %s to a value", var_token_data->buffer);
+                        break;
+                    }
+
+                    aug_ir_mark_symbol(ir, symbol);
+
+                    const aug_ir_operand address_operand = aug_ir_operand_from_symbol(symbol);
+                    const bool add = token.id == AUG_TOKEN_ADD_ASSIGN;
+                    if(symbol.scope == AUG_SYM_SCOPE_GLOBAL)
+                        aug_ir_add_operation_arg(ir, add ? AUG_OPCODE_ADD_ASSIGN_GLOBAL : AUG_OPCODE_LOAD_GLOBAL, address_operand);
+                    else // if local or param
+                        aug_ir_add_operation_arg(ir, add ? AUG_OPCODE_ADD_ASSIGN_LOCAL : AUG_OPCODE_LOAD_LOCAL, address_operand);
+                }
+                else if(var_node->type == AUG_AST_ELEMENT)
+                {
+                    assert(var_node->children_size == 2); // 0[1]
+                    aug_generate_ir_pass(var_node->children[0], ir, input); // push index expr
+                    aug_generate_ir_pass(var_node->children[1], ir, input); // push container                    
+                    
+                    aug_ir_mark_source(ir, input, token.pos);
+                    aug_ir_add_operation(ir, AUG_OPCODE_LOAD_ELEMENT);
+                }
+            }
+            break;
+        }
+        case AUG_AST_ARRAY:
+        {
+            for(int i = children_size - 1; i >= 0; --i)
+                aug_generate_ir_pass(children[i], ir, input);
+
+            const aug_ir_operand count_operand = aug_ir_operand_from_int(children_size);
+            aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_ARRAY, count_operand);
+            break;
+        }
+        case AUG_AST_MAP:
+        {
+            int i;
+            for (i = children_size - 1; i >= 0; --i)
+                aug_generate_ir_pass(children[i], ir, input);
+
+            const aug_ir_operand count_operand = aug_ir_operand_from_int(children_size);
+            aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_MAP, count_operand);
+            break;
+        }
+        case AUG_AST_MAP_PAIR:
+        {
+            assert(children_size == 2); // 0[1]
+            aug_generate_ir_pass(children[0], ir, input); // push key
+            aug_generate_ir_pass(children[1], ir, input); // push value
+            break;
+        }
+        case AUG_AST_ELEMENT:
+        {
+            assert(children_size == 2); // 0[1]
+            aug_generate_ir_pass(children[0], ir, input); // push index expr
+            aug_generate_ir_pass(children[1], ir, input); // push container
+
+            aug_ir_mark_source(ir, input, token.pos);
+            aug_ir_add_operation(ir, AUG_OPCODE_PUSH_ELEMENT);
+            break;
+        }
+        case AUG_AST_RANGE:
+        {
+            assert(children_size == 2); // 0[1]
+            aug_generate_ir_pass(children[0], ir, input); // push from 
+            aug_generate_ir_pass(children[1], ir, input); // push to
+
+            aug_ir_mark_source(ir, input, token.pos);
+            aug_ir_add_operation(ir, AUG_OPCODE_PUSH_RANGE);
+            break;
+        }
+        case AUG_AST_STMT_EXPR:
+        {
+            int i;
+            for( i = 0; i < children_size; ++i)
+                aug_generate_ir_pass(children[i], ir, input);
+            break;
+        }
+        case AUG_AST_DISCARD:
+        {
+            // if evaluating an input string, do not discard global return values. These may be returned to user
+            if(input->code)
+            {
+                bool global = aug_ir_current_scope_is_global(ir); 
+                if(!global)
+                    aug_ir_add_operation_arg(ir, AUG_OPCODE_POP, aug_ir_operand_from_int(1));
+            }
+            else //executing a file, discard all unused return values
+            {
+                aug_ir_add_operation_arg(ir, AUG_OPCODE_POP, aug_ir_operand_from_int(1));
+            }
+            break;
+        }
+        case AUG_AST_STMT_DEFINE_VAR:
+        {
+            assert(token_data != NULL);
+
+            if(children_size == 1) // token = [0]
+                aug_generate_ir_pass(children[0], ir, input);
+            else
+                aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE);
+
+            // Get variable in the current block. If it exists, error out. If it does not exist, set in table
+            aug_symbol symbol = aug_ir_get_symbol_local(ir, token_data);
+            if(symbol.type != AUG_SYM_NONE)
+            {
+                ir->valid = false;
+                aug_log_input_error_at(input, &token.pos, "Variable %s already defined in block", token_data->buffer);
+                break;
+            }
+
+            aug_ir_set_var(ir, token_data);
+            break;
+        }
+        case AUG_AST_STMT_IF:
+        {
+            assert(children_size == 2); //if([0]) {[1]}
+
+            // Evaluate expression. 
+            aug_generate_ir_pass(children[0], ir, input);
+
+            //Jump to end if false
+            const aug_ir_operand stub_operand = aug_ir_operand_from_int(0);
+            const size_t end_block_jmp = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP_ZERO, stub_operand);
+
+            // True block
+            aug_ir_push_scope(ir);
+            aug_generate_ir_pass(children[1], ir, input);
+            aug_ir_pop_scope(ir);
+
+            const size_t end_block_addr = ir->bytecode_offset;
+
+            // Fixup stubbed block offsets
+            aug_ir_get_operation(ir, end_block_jmp)->operand = aug_ir_operand_from_int(end_block_addr);
+
+            break;
+        }
+        case AUG_AST_STMT_IF_ELSE:
+        {
+            assert(children_size == 3); //if([0]) {[1]} else {[2]}
+
+            // Evaluate expression. 
+            aug_generate_ir_pass(children[0], ir, input);
+
+            //Jump to else if false
+            const aug_ir_operand stub_operand = aug_ir_operand_from_int(0);
+            const size_t else_block_jmp = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP_ZERO, stub_operand);
+
+            // True block
+            aug_ir_push_scope(ir);
+            aug_generate_ir_pass(children[1], ir, input);
+            aug_ir_pop_scope(ir);
+
+            //Jump to end after true
+            const size_t end_block_jmp = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP, stub_operand);
+            const size_t else_block_addr = ir->bytecode_offset;
+
+            // Else block
+            aug_ir_push_scope(ir);
+            aug_generate_ir_pass(children[2], ir, input);
+            aug_ir_pop_scope(ir);
+
+            // Tag end address
+            const size_t end_block_addr = ir->bytecode_offset;
+
+            // Fixup stubbed block offsets
+            aug_ir_get_operation(ir, else_block_jmp)->operand = aug_ir_operand_from_int(else_block_addr);
+            aug_ir_get_operation(ir, end_block_jmp)->operand = aug_ir_operand_from_int(end_block_addr);
+
+            break;
+        }
+        case AUG_AST_STMT_WHILE:
+        {
+            assert(children_size == 2); //while [0] {[1]}
+
+            aug_ir_begin_loop(ir);
+
+            // Evaluate expression. 
+            aug_generate_ir_pass(children[0], ir, input);
+            aug_ir_check_loop(ir);
+
+            // Loop block
+            aug_ir_push_scope(ir);
+            aug_generate_ir_pass(children[1], ir, input);
+            aug_ir_pop_scope(ir);
+
+            aug_ir_end_loop(ir);
+            break;
+        }
+        case AUG_AST_STMT_FOR:
+        {
+            assert(children_size == 3); //for [0] in [1] {[2]}
+            assert(children[0] && children[0]->type == AUG_AST_VARIABLE);
+
+            aug_string* var_token_data = children[0]->token.data; 
+            if(children[1]->type == AUG_AST_RANGE)
+            {
+                // Numeric range. The counter and bound are kept in stack slots, followed by the variable slot
+                const aug_ast* range = children[1];
+                assert(range->children_size == 2); // [0]:[1]
+
+                aug_ir_scope* scope = aug_ir_current_scope(ir);
+                const int counter_offset = aug_ir_current_frame_local_offset(ir, scope->stack_offset, 0);
+                scope->stack_offset += 2;
+                aug_generate_ir_pass(range->children[0], ir, input); // push from, the counter
+                aug_generate_ir_pass(range->children[1], ir, input); // push to, the bound
+
+                aug_ir_push_scope(ir);
+                aug_ir_set_var(ir, var_token_data);
+                aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE); // initialize the slot for the var
+
+                // Top of the loop. Continues re-enter the check
+                aug_ir_begin_loop(ir);
+                aug_ir_mark_source(ir, input, token.pos);
+                aug_ir_check_range_loop(ir, counter_offset);
+
+                // Loop block
+                const int block_begin = ir->bytecode_offset;
+                aug_ir_push_scope(ir);
+                aug_generate_ir_pass(children[2], ir, input);
+                aug_ir_pop_scope(ir);
+
+                aug_ir_end_range_loop(ir, counter_offset, block_begin);
+
+                // pop the variable, bound and counter slots to restore stack (3)
+                aug_ir_pop_scope(ir);
+                aug_ir_add_operation_arg(ir, AUG_OPCODE_POP, aug_ir_operand_from_int(2));
+
+                scope = aug_ir_current_scope(ir);
+                scope->stack_offset -= 2; // remove counter and bound from stack
+                break;
+            }
+
+            // Evaluate and initialize iterable expression. 
+            aug_ir_scope* scope = aug_ir_current_scope(ir);
+            int it_offset = scope->stack_offset++;
+            it_offset = aug_ir_current_frame_local_offset(ir, it_offset, 0);
+            aug_generate_ir_pass(children[1], ir, input);
+
+            aug_ir_mark_source(ir, input, token.pos);
+            aug_ir_add_operation(ir, AUG_OPCODE_PUSH_ITERATOR);
+
+            // initialize the variable
+            aug_ir_push_scope(ir);
+            aug_ir_set_var(ir, var_token_data);
+            aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE); // initialize the slot for the var
+
+            aug_symbol var_symbol = aug_ir_get_symbol_relative(ir, var_token_data);
+
+            // Top of the loop. The variable slot is kept between iterations
+            aug_ir_begin_loop(ir);
+
+            //Move the iterator, and check the loop
+            aug_ir_add_operation_arg(ir, AUG_OPCODE_ITERATE, aug_ir_operand_from_int(it_offset));
+            aug_ir_check_loop(ir);
+
+            // If success, the iterator pushes the element value, load this into local
+            aug_ir_add_operation_arg(ir, AUG_OPCODE_LOAD_LOCAL, aug_ir_operand_from_symbol(var_symbol));
+
+            // Loop block
+            aug_ir_push_scope(ir);
+            aug_generate_ir_pass(children[2], ir, input);
+            aug_ir_pop_scope(ir);
+
+            aug_ir_end_loop(ir);
+
+            // pop the variable and the temporary iterator to restore stack (2)
+            aug_ir_pop_scope(ir);
+            aug_ir_add_operation_arg(ir, AUG_OPCODE_POP, aug_ir_operand_from_int(1));
+
+            scope = aug_ir_current_scope(ir);
+            scope->stack_offset--; // remove iterator from stack
+            break;
+        }
+        case AUG_AST_BREAK:
+        {
+            if(!aug_ir_break_loop(ir))
+            {
+                ir->valid = false;
+                aug_log_input_error_at(input, &token.pos, "Break statement must be inside loop");
+            }
+            break;
+        }
+        case AUG_AST_YIELD:
+        {
+            aug_ir_add_operation(ir, AUG_OPCODE_YIELD);
+            break;
+        }
+        case AUG_AST_CONTINUE:
+        {
+            if(!aug_ir_continue_loop(ir))
+            {
+                ir->valid = false;
+                aug_log_input_error_at(input, &token.pos, "Continue statement must be inside loop");
+            }
+            break;
+        }
+        case AUG_AST_FUNC_CALL:
+        {
+            assert(token_data != NULL); // func name is token data
+            const int arg_count = children_size;
+
+            const aug_symbol symbol = aug_ir_get_symbol(ir, token_data);
+            if(symbol.type != AUG_SYM_NONE)
+            {
+                // If the symbol is a user defined function, check arg count.
+                if(symbol.type == AUG_SYM_FUNC && symbol.argc != arg_count)
+                {
+                    ir->valid = false;
+                    aug_log_input_error_at(input, &token.pos, "Function Call %s passed %d arguments, expected %d", 
+                        token_data->buffer, arg_count, symbol.argc);
+                }
+                else
+                {
+                    // offset to account for the pushed base
+                    size_t push_frame = aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL_FRAME, aug_ir_operand_from_int(0));
+
+                    // Push arguments onto stack
+                    int i;
+                    for(i = 0; i < children_size; ++ i)
+                        aug_generate_ir_pass(children[i], ir, input);
+
+                    // TODO: Push arg count, and have the function body check that arg count matches in the vm runtime
+                    aug_ir_operand arg_count = aug_ir_operand_from_int(children_size);
+                    aug_ir_add_operation_arg(ir, AUG_OPCODE_ARG_COUNT, arg_count);
+                                        
+                    if(symbol.type == AUG_SYM_FUNC)  
+                    {
+                        aug_ir_mark_symbol(ir, symbol);
+
+                        aug_ir_operand address_operand = aug_ir_operand_from_symbol(symbol);
+                        aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL, address_operand);
+                    }
+                    if(symbol.type == AUG_SYM_VAR)
+                    {
+                        const aug_symbol var_symbol = aug_ir_get_symbol_relative(ir, token_data);
+                        aug_ir_mark_symbol(ir, var_symbol);
+
+                        aug_ir_operand address_operand = aug_ir_operand_from_symbol(var_symbol);
+                        if(var_symbol.scope == AUG_SYM_SCOPE_GLOBAL)
+                            aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL_GLOBAL, address_operand);
+                        else // if local or param
+                            aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL_LOCAL, address_operand);
+                    }
+                    
+                    // fixup the return address to after the call
+                    aug_ir_get_operation(ir, push_frame)->operand = aug_ir_operand_from_int(ir->bytecode_offset);
+                }
+                break;
+            }
+
+            // Arguments are pushed in order, so the extension can read them directly from the stack
+            for(int i = 0; i < arg_count; ++i)
+                aug_generate_ir_pass(children[i], ir, input);
+
+            // call ext by slot with the arg count
+            const int slot = aug_ir_get_extension_slot(ir, token_data);
+            aug_ir_add_operation_args(ir, AUG_OPCODE_CALL_EXT, aug_ir_operand_from_int(slot), aug_ir_operand_from_int(arg_count));
+            break;
+        }
+        case AUG_AST_FUNC_CALL_UNNAMED:
+        {
+            assert(children_size >= 1); 
+            const int arg_count = children_size - 1; // off by one since first child is the value to push onto the stack to be called
+
+            // offset to account for the pushed base
+            size_t push_frame = aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL_FRAME, aug_ir_operand_from_int(0));
+
+            // Push arguments onto stack
+            for(int i = 1; i < children_size; ++i)
+                aug_generate_ir_pass(children[i], ir, input);
+
+            // First arg is the value of the function to call 
+            aug_generate_ir_pass(children[0], ir, input);
+
+            // TODO: Push arg count, and have the function body check that arg count matches in the vm runtime
+            aug_ir_add_operation_arg(ir, AUG_OPCODE_ARG_COUNT, aug_ir_operand_from_int(arg_count));
+            aug_ir_add_operation(ir, AUG_OPCODE_CALL_TOP);
+
+            // fixup the return address to after the call
+            aug_ir_get_operation(ir, push_frame)->operand = aug_ir_operand_from_int(ir->bytecode_offset);
+
+            break;
+        }
+        case AUG_AST_RETURN:
+        {
+            const aug_ir_operand offset = aug_ir_operand_from_int(aug_ir_calling_offset(ir));
+            if(children_size == 1) //return [0];
+            {
+                aug_generate_ir_pass(children[0], ir, input);
+                aug_ir_add_operation_arg(ir, AUG_OPCODE_RETURN_FUNC, offset);
+            }
+            else
+            {
+                aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE);
+                aug_ir_add_operation_arg(ir, AUG_OPCODE_RETURN_FUNC, offset);
+            }
+            break;
+        }
+        case AUG_AST_PARAM:
+        {
+            assert(token_data != NULL);
+            aug_ir_set_param(ir, token_data);
+            break;
+        }
+        case AUG_AST_PARAM_LIST:
+        {
+            for(int i = 0; i < children_size; ++ i)
+                aug_generate_ir_pass(children[i], ir, input);
+            break;
+        }
+        case AUG_AST_STMT_DEFINE_FUNC:
+        {
+            assert(token_data != NULL && children_size == 2); //func token [0] {[1]};
+
+            // Jump over the func def
+            const aug_ir_operand stub_operand = aug_ir_operand_from_int(0);
+            const size_t end_block_jmp = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP, stub_operand);
+
+            aug_ast* params = children[0];
+            assert(params && params->type == AUG_AST_PARAM_LIST);
+            const int param_count = params->children_size;
+
+            // Gather global pass handles global symbol table. The offset however is incorrect, this pass will fixup the function offset  
+            bool update = aug_ir_current_scope_is_global(ir); 
+
+            // Try to set function in symbol table. Func name is token
+            if(!aug_ir_set_func(ir, token_data, param_count, update))
+            {
+                ir->valid = false;
+                aug_log_input_error_at(input, &token.pos, "Function %s already defined", token_data->buffer);
+                break;
+            }
+
+            // Parameter frame
+            aug_ir_push_scope(ir);
+            aug_generate_ir_pass(children[0], ir, input);
+
+            aug_ir_mark_symbol(ir, aug_ir_get_symbol(ir, token_data));
+
+            // TODO: Argument count check
+            aug_ir_operand param_count_arg = aug_ir_operand_from_int(param_count);
+            aug_ir_add_operation_arg(ir, AUG_OPCODE_ENTER_FUNC, param_count_arg);
+
+            // Function block frame
+            aug_ir_push_frame(ir, param_count);
+            aug_generate_ir_pass(children[1], ir, input);
+
+            // Ensure there is a return
+            if(aug_ir_last_operation(ir)->opcode != AUG_OPCODE_RETURN_FUNC)
+            {
+                const aug_ir_operand offset = aug_ir_operand_from_int(aug_ir_calling_offset(ir));
+                aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE);
+                aug_ir_add_operation_arg(ir, AUG_OPCODE_RETURN_FUNC, offset);
+            }
+
+            aug_ir_pop_frame(ir);
+            aug_ir_pop_scope(ir);
+
+            // fixup jump operand
+            const size_t end_block_addr = ir->bytecode_offset;
+            aug_ir_get_operation(ir, end_block_jmp)->operand = aug_ir_operand_from_int(end_block_addr);
+
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Operations whose int operand is an absolute bytecode address
+static inline bool aug_ir_operation_is_addressed(const aug_ir_operation* operation)
+{
+    switch(operation->opcode)
+    {
+        case AUG_OPCODE_JUMP:
+        case AUG_OPCODE_JUMP_ZERO:
+        case AUG_OPCODE_JUMP_NZERO:
+        case AUG_OPCODE_LT_JUMP_ZERO:
+        case AUG_OPCODE_LTE_JUMP_ZERO:
+        case AUG_OPCODE_GT_JUMP_ZERO:
+        case AUG_OPCODE_GTE_JUMP_ZERO:
+        case AUG_OPCODE_EQ_JUMP_ZERO:
+        case AUG_OPCODE_NEQ_JUMP_ZERO:
+        case AUG_OPCODE_LT_JUMP_ZERO_REG:
+        case AUG_OPCODE_LTE_JUMP_ZERO_REG:
+        case AUG_OPCODE_GT_JUMP_ZERO_REG:
+        case AUG_OPCODE_GTE_JUMP_ZERO_REG:
+        case AUG_OPCODE_EQ_JUMP_ZERO_REG:
+        case AUG_OPCODE_NEQ_JUMP_ZERO_REG:
+        case AUG_OPCODE_RANGE_BEGIN:
+        case AUG_OPCODE_RANGE_NEXT:
+        case AUG_OPCODE_CALL_FRAME:
+            return true;
+        case AUG_OPCODE_CALL:
+        case AUG_OPCODE_PUSH_FUNC:
+            // Global functions are symbol operands, resolved from the globals table
+            return operation->operand.type == AUG_IR_OPERAND_INT;
+        default:
+            break;
+    }
+    return false;
+}
+
+// Operations that only push a value onto the stack, without any side effects
+static inline bool aug_ir_operation_is_push(const aug_ir_operation* operation)
+{
+    switch(operation->opcode)
+    {
+        case AUG_OPCODE_PUSH_NONE:
+        case AUG_OPCODE_PUSH_BOOL:
+        case AUG_OPCODE_PUSH_INT:
+        case AUG_OPCODE_PUSH_CHAR:
+        case AUG_OPCODE_PUSH_FLOAT:
+        case AUG_OPCODE_PUSH_STRING:
+        case AUG_OPCODE_PUSH_FUNC:
+        case AUG_OPCODE_PUSH_LOCAL:
+        case AUG_OPCODE_PUSH_GLOBAL:
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+// Operations that push a constant value. The truth of the value is written to truth, as evaluated by aug_to_bool
+static inline bool aug_ir_operation_is_constant(const aug_ir_operation* operation, bool* truth)
+{
+    switch(operation->opcode)
+    {
+        case AUG_OPCODE_PUSH_NONE:  *truth = false;                               return true;
+        case AUG_OPCODE_PUSH_BOOL:  *truth = operation->operand.data.b;           return true;
+        case AUG_OPCODE_PUSH_INT:   *truth = operation->operand.data.i != 0;      return true;
+        case AUG_OPCODE_PUSH_CHAR:  *truth = operation->operand.data.c != 0;      return true;
+        case AUG_OPCODE_PUSH_FLOAT: *truth = operation->operand.data.f != 0.0f;   return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+// Operations that never continue to the next operation
+static inline bool aug_ir_operation_is_terminal(const aug_ir_operation* operation)
+{
+    switch(operation->opcode)
+    {
+        case AUG_OPCODE_EXIT:
+        case AUG_OPCODE_JUMP:
+        case AUG_OPCODE_RETURN_FUNC:
+            return true;
+        default:
+            break;
+    }
+    return false;
+}
+
+static inline bool aug_ir_operand_equal(aug_ir_operand a, aug_ir_operand b)
+{
+    if(a.type != b.type)
+        return false;
+    switch(a.type)
+    {
+        case AUG_IR_OPERAND_INT:
+            return a.data.i == b.data.i;
+        case AUG_IR_OPERAND_SYMBOL:
+            return strcmp(a.data.str, b.data.str) == 0;
+        default:
+            break;
+    }
+    return false;
+}
+
+static inline aug_opcode aug_ir_compare_jump_opcode(aug_opcode opcode)
+{
+    switch(opcode)
+    {
+        case AUG_OPCODE_LT:  return AUG_OPCODE_LT_JUMP_ZERO;
+        case AUG_OPCODE_LTE: return AUG_OPCODE_LTE_JUMP_ZERO;
+        case AUG_OPCODE_GT:  return AUG_OPCODE_GT_JUMP_ZERO;
+        case AUG_OPCODE_GTE: return AUG_OPCODE_GTE_JUMP_ZERO;
+        case AUG_OPCODE_EQ:  return AUG_OPCODE_EQ_JUMP_ZERO;
+        case AUG_OPCODE_NEQ: return AUG_OPCODE_NEQ_JUMP_ZERO;
+        default:
+            break;
+    }
+    return (aug_opcode)AUG_OPCODE_INVALID;
+}
+
+// Matches a sequence of operations beginning at index that can be replaced. 
+// Returns the number of operations matched, the replacement is written to fused. If the fused opcode is invalid, the sequence is removed
+static inline size_t aug_ir_optimize_match(aug_ir* ir, const bool* targets, size_t index, int level, aug_ir_operation* fused)
+{
+    aug_container* operations = ir->operations;
+    const size_t count = operations->length - index;
+    const aug_ir_operation* ops = aug_container_ptr_type(aug_ir_operation, operations, index);
+
+    // Can not fuse across a branch target. Only the first operation in the sequence can be jumped to
+    size_t length = 1;
+    while(length < 4 && length < count && !targets[ops[length].bytecode_offset])
+        ++length;
+
+    fused->opcode = (aug_opcode)AUG_OPCODE_INVALID;
+    fused->operand.type = AUG_IR_OPERAND_NONE;
+    fused->operand_ext.type = AUG_IR_OPERAND_NONE;
+
+    // POP 0 
+    if(ops[0].opcode == AUG_OPCODE_POP && ops[0].operand.data.i == 0)
+        return 1;
+
+    // PUSH_X, POP a -> POP a-1
+    if(length >= 2 && aug_ir_operation_is_push(&ops[0]) 
+        && ops[1].opcode == AUG_OPCODE_POP && ops[1].operand.data.i >= 1)
+    {
+        if(ops[1].operand.data.i > 1)
+        {
+            fused->opcode = AUG_OPCODE_POP;
+            fused->operand = aug_ir_operand_from_int(ops[1].operand.data.i - 1);
+        }
+        return 2;
+    }
+
+    // PUSH_BOOL true, JUMP_ZERO a -> removed. PUSH_BOOL false, JUMP_ZERO a -> JUMP a
+    bool truth;
+    if(length >= 2 && (ops[1].opcode == AUG_OPCODE_JUMP_ZERO || ops[1].opcode == AUG_OPCODE_JUMP_NZERO) 
+        && aug_ir_operation_is_constant(&ops[0], &truth))
+    {
+        if(truth == (ops[1].opcode == AUG_OPCODE_JUMP_NZERO))
+        {
+            fused->opcode = AUG_OPCODE_JUMP;
+            fused->operand = ops[1].operand;
+        }
+        return 2;
+    }
+
+    // JUMP to the next operation
+    if(ops[0].opcode == AUG_OPCODE_JUMP
+        && (size_t)ops[0].operand.data.i == ops[0].bytecode_offset + aug_ir_operation_size(ops[0]))
+        return 1;
+
+    // JUMP a, unreachable operations... -> JUMP a. Unreachable until the next branch target
+    if(aug_ir_operation_is_terminal(&ops[0]) && count >= 2 && !targets[ops[1].bytecode_offset])
+    {
+        size_t unreachable = 1;
+        while(unreachable < count && !targets[ops[unreachable].bytecode_offset])
+            ++unreachable;
+
+        *fused = ops[0];
+        return unreachable;
+    }
+
+    // POP a, POP b -> POP a+b
+    if(length >= 2 && ops[0].opcode == AUG_OPCODE_POP && ops[1].opcode == AUG_OPCODE_POP)
+    {
+        fused->opcode = AUG_OPCODE_POP;
+        fused->operand = aug_ir_operand_from_int(ops[0].operand.data.i + ops[1].operand.data.i);
+        return 2;
+    }
+
+    if(level < 2)
+        return 0;
+
+    // PUSH_LOCAL a, PUSH_INT b, ADD, LOAD_LOCAL a -> ADD_LOCAL_INT a b
+    if(length >= 4 && ops[1].opcode == AUG_OPCODE_PUSH_INT
+        && (ops[2].opcode == AUG_OPCODE_ADD || ops[2].opcode == AUG_OPCODE_SUB))
+    {
+        const bool add = ops[2].opcode == AUG_OPCODE_ADD;
+        if(ops[0].opcode == AUG_OPCODE_PUSH_LOCAL && ops[3].opcode == AUG_OPCODE_LOAD_LOCAL 
+            && aug_ir_operand_equal(ops[0].operand, ops[3].operand))
+            fused->opcode = add ? AUG_OPCODE_ADD_LOCAL_INT : AUG_OPCODE_SUB_LOCAL_INT;
+        else if(ops[0].opcode == AUG_OPCODE_PUSH_GLOBAL && ops[3].opcode == AUG_OPCODE_LOAD_GLOBAL 
+            && aug_ir_operand_equal(ops[0].operand, ops[3].operand))
+            fused->opcode = add ? AUG_OPCODE_ADD_GLOBAL_INT : AUG_OPCODE_SUB_GLOBAL_INT;
+
+        if(fused->opcode != (aug_opcode)AUG_OPCODE_INVALID)
+        {
+            fused->operand = ops[0].operand;
+            fused->operand_ext = ops[1].operand;
+            return 4;
+        }
+    }
+
+    // PUSH_LOCAL a, PUSH_INT b, ADD_ASSIGN_LOCAL a -> ADD_LOCAL_INT a b
+    if(length >= 3 && ops[1].opcode == AUG_OPCODE_PUSH_INT && aug_ir_operand_equal(ops[0].operand, ops[2].operand))
+    {
+        if(ops[0].opcode == AUG_OPCODE_PUSH_LOCAL && ops[2].opcode == AUG_OPCODE_ADD_ASSIGN_LOCAL)
+            fused->opcode = AUG_OPCODE_ADD_LOCAL_INT;
+        else if(ops[0].opcode == AUG_OPCODE_PUSH_GLOBAL && ops[2].opcode == AUG_OPCODE_ADD_ASSIGN_GLOBAL)
+            fused->opcode = AUG_OPCODE_ADD_GLOBAL_INT;
+
+        if(fused->opcode != (aug_opcode)AUG_OPCODE_INVALID)
+        {
+            fused->operand = ops[0].operand;
+            fused->operand_ext = ops[1].operand;
+            return 3;
+        }
+    }
+
+    // LT, JUMP_ZERO a -> LT_JUMP_ZERO a
+    if(length >= 2 && ops[1].opcode == AUG_OPCODE_JUMP_ZERO)
+    {
+        fused->opcode = aug_ir_compare_jump_opcode(ops[0].opcode);
+        if(fused->opcode != (aug_opcode)AUG_OPCODE_INVALID)
+        {
+            fused->operand = ops[1].operand;
+            return 2;
+        }
+    }
+
+    return 0;
+}
+
+static void aug_ir_optimize_mark_func(uint8_t* data, void* user_data)
+{
+    const aug_symbol* symbol = (const aug_symbol*)data;
+    bool* targets = (bool*)user_data;
+    if(symbol->type == AUG_SYM_FUNC)
+        targets[symbol->offset] = true;
+}
+
+static void aug_ir_optimize_remap_func(uint8_t* data, void* user_data)
+{
+    aug_symbol* symbol = (aug_symbol*)data;
+    const int* addr_map = (const int*)user_data;
+    if(symbol->type == AUG_SYM_FUNC)
+        symbol->offset = addr_map[symbol->offset];
+}
+
+// Gathers all the addresses that can be branched to, i.e. jump targets, call frame returns and functions
+static inline bool* aug_ir_optimize_targets(aug_ir* ir)
+{
+    const size_t bytecode_size = ir->bytecode_offset;
+    aug_container* operations = ir->operations;
+
+    bool* targets = (bool*)AUG_ALLOC(sizeof(bool) * (bytecode_size + 1));
+    memset(targets, 0, sizeof(bool) * (bytecode_size + 1));
+    for(size_t i = 0; i < operations->length; ++i)
+    {
+        const aug_ir_operation* operation = aug_container_ptr_type(aug_ir_operation, operations, i);
+        if(aug_ir_operation_is_addressed(operation))
+        {
+            const int addr = operation->operand.data.i;
+            if(addr >= 0 && (size_t)addr <= bytecode_size)
+                targets[addr] = true;
+        }
+    }
+    if(ir->globals)
+        aug_hashtable_foreach(ir->globals, aug_ir_optimize_mark_func, targets);
+    return targets;
+}
+
+// Replaces the operations with the rewritten operations. The addresses of the replaced operations, of size bytecode_size, 
+// are relocated by the address map, i.e. jumps, call frames, function symbols and trace markers
+static inline void aug_ir_optimize_relocate(aug_ir* ir, aug_container* rewritten, const int* addr_map, size_t bytecode_size)
+{
+    for(size_t i = 0; i < rewritten->length; ++i)
+    {
+        aug_ir_operation* operation = aug_container_ptr_type(aug_ir_operation, rewritten, i);
+        if(aug_ir_operation_is_addressed(operation))
+        {
+            const int addr = operation->operand.data.i;
+            if(addr >= 0 && (size_t)addr <= bytecode_size)
+                operation->operand.data.i = addr_map[addr];
+        }
+    }
+
+    if(ir->globals)
+        aug_hashtable_foreach(ir->globals, aug_ir_optimize_remap_func, (void*)addr_map);
+
+    for(size_t i = 0; i < ir->markers->length; ++i)
+    {
+        aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, ir->markers, i);
+        marker->bytecode_addr = addr_map[marker->bytecode_addr];
+    }
+
+    ir->operations = aug_container_decref(ir->operations);
+    ir->operations = rewritten;
+}
+
+// Single peephole pass. Returns true if any operations were replaced
+static inline bool aug_ir_optimize_pass(aug_ir* ir, int level)
+{
+    const size_t bytecode_size = ir->bytecode_offset;
+    aug_container* operations = ir->operations;
+    bool* targets = aug_ir_optimize_targets(ir);
+
+    // Rewrite the operations, map the old operation addresses to the new
+    int* addr_map = (int*)AUG_ALLOC(sizeof(int) * (bytecode_size + 1));
+    aug_container* optimized = aug_container_new_type(aug_ir_operation, operations->length);
+    ir->bytecode_offset = 0;
+
+    size_t i = 0;
+    while(i < operations->length)
+    {
+        aug_ir_operation fused;
+        size_t match = aug_ir_optimize_match(ir, targets, i, level, &fused);
+        if(match == 0)
+        {
+            aug_ir_operation operation = aug_container_at_type(aug_ir_operation, operations, i);
+            addr_map[operation.bytecode_offset] = ir->bytecode_offset;
+            operation.bytecode_offset = ir->bytecode_offset;
+            ir->bytecode_offset += aug_ir_operation_size(operation);
+            aug_container_push_type(aug_ir_operation, optimized, operation);
+            ++i;
+            continue;
+        }
+
+        // Addresses within the sequence map to the replacement
+        for(size_t j = i; j < i + match; ++j)
+        {
+            aug_ir_operation operation = aug_container_at_type(aug_ir_operation, operations, j);
+            addr_map[operation.bytecode_offset] = ir->bytecode_offset;
+
+            // Fused operations do not take ownership of allocated operands
+            aug_ir_operand_free(operation.operand);
+        }
+        i += match;
+
+        if(fused.opcode != (aug_opcode)AUG_OPCODE_INVALID)
+        {
+            fused.bytecode_offset = ir->bytecode_offset;
+            ir->bytecode_offset += aug_ir_operation_size(fused);
+            aug_container_push_type(aug_ir_operation, optimized, fused);
+        }
+    }
+    addr_map[bytecode_size] = ir->bytecode_offset;
+    aug_ir_optimize_relocate(ir, optimized, addr_map, bytecode_size);
+
+    AUG_FREE(addr_map);
+    AUG_FREE(targets);
+
+    return ir->bytecode_offset != bytecode_size;
+}
+
+// Peephole optimization. Removes redundant operations and fuses operation sequences into superinstructions.
+// All bytecode addresses are relocated, i.e. jumps, call frames, function symbols and trace markers
+void aug_optimize_ir(aug_ir* ir, int level)
+{
+    if(ir == NULL || !ir->valid || level <= 0)
+        return;
+
+    // Repeat until no more sequences are matched, replacements may form new sequences
+    while(aug_ir_optimize_pass(ir, level))
+        ;
+}
+
+static inline aug_opcode aug_ir_register_opcode(aug_opcode opcode)
+{
+    switch(opcode)
+    {
+        case AUG_OPCODE_ADD:           return AUG_OPCODE_ADD_REG;
+        case AUG_OPCODE_SUB:           return AUG_OPCODE_SUB_REG;
+        case AUG_OPCODE_MUL:           return AUG_OPCODE_MUL_REG;
+        case AUG_OPCODE_DIV:           return AUG_OPCODE_DIV_REG;
+        case AUG_OPCODE_LT:            return AUG_OPCODE_LT_REG;
+        case AUG_OPCODE_LTE:           return AUG_OPCODE_LTE_REG;
+        case AUG_OPCODE_GT:            return AUG_OPCODE_GT_REG;
+        case AUG_OPCODE_GTE:           return AUG_OPCODE_GTE_REG;
+        case AUG_OPCODE_EQ:            return AUG_OPCODE_EQ_REG;
+        case AUG_OPCODE_NEQ:           return AUG_OPCODE_NEQ_REG;
+        case AUG_OPCODE_LT_JUMP_ZERO:  return AUG_OPCODE_LT_JUMP_ZERO_REG;
+        case AUG_OPCODE_LTE_JUMP_ZERO: return AUG_OPCODE_LTE_JUMP_ZERO_REG;
+        case AUG_OPCODE_GT_JUMP_ZERO:  return AUG_OPCODE_GT_JUMP_ZERO_REG;
+        case AUG_OPCODE_GTE_JUMP_ZERO: return AUG_OPCODE_GTE_JUMP_ZERO_REG;
+        case AUG_OPCODE_EQ_JUMP_ZERO:  return AUG_OPCODE_EQ_JUMP_ZERO_REG;
+        case AUG_OPCODE_NEQ_JUMP_ZERO: return AUG_OPCODE_NEQ_JUMP_ZERO_REG;
+        default:
+            break;
+    }
+    return (aug_opcode)AUG_OPCODE_INVALID;
+}
+
+// Register of the variable or int constant operand, i.e. the source of a push or the destination of a load.
+// Returns false if the operation has no register, or the offset does not fit the encoding
+static inline bool aug_ir_operation_register(aug_ir* ir, const aug_ir_operation* operation, int* reg)
+{
+    aug_register_kind kind;
+    switch(operation->opcode)
+    {
+        case AUG_OPCODE_PUSH_LOCAL:
+        case AUG_OPCODE_LOAD_LOCAL:
+        case AUG_OPCODE_ADD_ASSIGN_LOCAL:
+            kind = AUG_REGISTER_LOCAL;
+            break;
+        case AUG_OPCODE_PUSH_GLOBAL:
+        case AUG_OPCODE_LOAD_GLOBAL:
+        case AUG_OPCODE_ADD_ASSIGN_GLOBAL:
+            kind = AUG_REGISTER_GLOBAL;
+            break;
+        case AUG_OPCODE_PUSH_INT:
+            kind = AUG_REGISTER_INT;
+            break;
+        default:
+            return false;
+    }
+
+    int index;
+    if(operation->operand.type == AUG_IR_OPERAND_INT)
+        index = operation->operand.data.i;
+    else if(operation->operand.type == AUG_IR_OPERAND_SYMBOL && ir->globals != NULL)
+    {
+        const aug_symbol* symbol = aug_hashtable_ptr_type(aug_symbol, ir->globals, operation->operand.data.str);
+        if(symbol == NULL)
+            return false;
+        index = symbol->offset;
+    }
+    else
+        return false;
+
+    if(index < AUG_REGISTER_INDEX_MIN || index > AUG_REGISTER_INDEX_MAX)
+        return false;
+
+    *reg = AUG_REGISTER(kind, index);
+    return true;
+}
+
+static inline void aug_ir_emit_operation(aug_ir* ir, aug_container* operations, aug_ir_operation operation)
+{
+    operation.bytecode_offset = ir->bytecode_offset;
+    ir->bytecode_offset += aug_ir_operation_size(operation);
+    aug_container_push_type(aug_ir_operation, operations, operation);
+}
+
+// Allocates registers for the register backend. Operands are assigned to the variable slots of the frame, at the 
+// offsets of the scope symbols, or to int constants. Pushes of these are deferred, and folded into the consuming 
+// arithmetic, comparison or move as three address instructions. Temporaries of nested expressions remain on the stack.
+// Deferred pushes are emitted in order before anything else executes, as declarations create their slot by pushing
+void aug_ir_allocate_registers(aug_ir* ir)
+{
+    if(ir == NULL || !ir->valid)
+        return;
+
+    const size_t bytecode_size = ir->bytecode_offset;
+    aug_container* operations = ir->operations;
+    const aug_ir_operation* ops = aug_container_ptr_type(aug_ir_operation, operations, 0);
+    bool* targets = aug_ir_optimize_targets(ir);
+
+    int* addr_map = (int*)AUG_ALLOC(sizeof(int) * (bytecode_size + 1));
+    size_t* pending = (size_t*)AUG_ALLOC(sizeof(size_t) * (operations->length + 1));
+    size_t pending_count = 0;
+    aug_container* allocated = aug_container_new_type(aug_ir_operation, operations->length);
+    ir->bytecode_offset = 0;
+
+    for(size_t i = 0; i < operations->length; ++i)
+    {
+        const aug_ir_operation* operation = &ops[i];
+        const aug_ir_operation* next = i + 1 < operations->length && !targets[ops[i + 1].bytecode_offset] ? &ops[i + 1] : NULL;
+
+        // Branches expect the stack of the stack backend
+        if(targets[operation->bytecode_offset])
+        {
+            for(size_t j = 0; j < pending_count; ++j)
+            {
+                addr_map[ops[pending[j]].bytecode_offset] = ir->bytecode_offset;
+                aug_ir_emit_operation(ir, allocated, ops[pending[j]]);
+            }
+            pending_count = 0;
+        }
+
+        int reg = 0, lhs = 0, rhs = 0, dst = 0;
+        if(operation->opcode != AUG_OPCODE_LOAD_LOCAL && operation->opcode != AUG_OPCODE_LOAD_GLOBAL
+            && operation->opcode != AUG_OPCODE_ADD_ASSIGN_LOCAL && operation->opcode != AUG_OPCODE_ADD_ASSIGN_GLOBAL
+            && aug_ir_operation_register(ir, operation, &reg))
+        {
+            pending[pending_count++] = i;
+            continue;
+        }
+
+        aug_ir_operation allocation;
+        allocation.opcode = (aug_opcode)AUG_OPCODE_INVALID;
+        allocation.operand.type = AUG_IR_OPERAND_NONE;
+        allocation.operand_ext.type = AUG_IR_OPERAND_NONE;
+        size_t consumed = 0;
+        size_t skipped = 0;
+
+        const aug_opcode opcode = aug_ir_register_opcode(operation->opcode);
+        if(pending_count >= 1)
+        {
+            aug_ir_operation_register(ir, &ops[pending[pending_count - 1]], &rhs);
+            if(pending_count >= 2)
+                aug_ir_operation_register(ir, &ops[pending[pending_count - 2]], &lhs);
+            else
+                lhs = AUG_REGISTER(AUG_REGISTER_STACK, 0);
+        }
+
+        // a OP b -> OP_REG dst a b. Destination is the following load, the following branch, or the stack
+        if(opcode != (aug_opcode)AUG_OPCODE_INVALID && pending_count >= 1)
+        {
+            const aug_opcode jump_opcode = aug_ir_register_opcode(aug_ir_compare_jump_opcode(operation->opcode));
+            consumed = pending_count >= 2 ? 2 : 1;
+            allocation.opcode = opcode;
+            allocation.operand_ext = aug_ir_operand_from_int(AUG_REGISTER_PAIR(lhs, rhs));
+            if(aug_ir_operation_is_addressed(operation))
+                allocation.operand = operation->operand;
+            else if(next && next->opcode == AUG_OPCODE_JUMP_ZERO && jump_opcode != (aug_opcode)AUG_OPCODE_INVALID)
+            {
+                allocation.opcode = jump_opcode;
+                allocation.operand = next->operand;
+                skipped = 1;
+            }
+            else if(next && (next->opcode == AUG_OPCODE_LOAD_LOCAL || next->opcode == AUG_OPCODE_LOAD_GLOBAL)
+                && aug_ir_operation_register(ir, next, &dst))
+            {
+                allocation.operand = aug_ir_operand_from_int(dst);
+                skipped = 1;
+            }
+            else
+                allocation.operand = aug_ir_operand_from_int(AUG_REGISTER(AUG_REGISTER_STACK, 0));
+        }
+        // a, b, ADD_ASSIGN a -> ADD_REG a a b
+        else if((operation->opcode == AUG_OPCODE_ADD_ASSIGN_LOCAL || operation->opcode == AUG_OPCODE_ADD_ASSIGN_GLOBAL) 
+            && pending_count >= 2 && aug_ir_operation_register(ir, operation, &dst) && dst == lhs)
+        {
+            consumed = 2;
+            allocation.opcode = AUG_OPCODE_ADD_REG;
+            allocation.operand = aug_ir_operand_from_int(dst);
+            allocation.operand_ext = aug_ir_operand_from_int(AUG_REGISTER_PAIR(lhs, rhs));
+        }
+        // b, LOAD a -> MOVE_REG a b
+        else if((operation->opcode == AUG_OPCODE_LOAD_LOCAL || operation->opcode == AUG_OPCODE_LOAD_GLOBAL) 
+            && pending_count >= 1 && aug_ir_operation_register(ir, operation, &dst))
+        {
+            consumed = 1;
+            allocation.opcode = AUG_OPCODE_MOVE_REG;
+            allocation.operand = aug_ir_operand_from_int(dst);
+            allocation.operand_ext = aug_ir_operand_from_int(AUG_REGISTER_PAIR(rhs, 0));
+        }
+
+        // Deferred pushes not consumed are emitted first
+        for(size_t j = 0; j < pending_count - consumed; ++j)
+        {
+            addr_map[ops[pending[j]].bytecode_offset] = ir->bytecode_offset;
+            aug_ir_emit_operation(ir, allocated, ops[pending[j]]);
+        }
+
+        if(allocation.opcode == (aug_opcode)AUG_OPCODE_INVALID)
+        {
+            pending_count = 0;
+            addr_map[operation->bytecode_offset] = ir->bytecode_offset;
+            aug_ir_emit_operation(ir, allocated, *operation);
+            continue;
+        }
+
+        // Addresses of the consumed operations map to the register instruction, as error markers match exactly
+        for(size_t j = pending_count - consumed; j < pending_count; ++j)
+        {
+            addr_map[ops[pending[j]].bytecode_offset] = ir->bytecode_offset;
+            aug_ir_operand_free(ops[pending[j]].operand);
+        }
+        for(size_t j = i; j <= i + skipped; ++j)
+        {
+            addr_map[ops[j].bytecode_offset] = ir->bytecode_offset;
+            aug_ir_operand_free(ops[j].operand);
+        }
+        pending_count = 0;
+        i += skipped;
+
+        aug_ir_emit_operation(ir, allocated, allocation);
+    }
+
+    for(size_t j = 0; j < pending_count; ++j)
+    {
+        addr_map[ops[pending[j]].bytecode_offset] = ir->bytecode_offset;
+        aug_ir_emit_operation(ir, allocated, ops[pending[j]]);
+    }
+    addr_map[bytecode_size] = ir->bytecode_offset;
+    aug_ir_optimize_relocate(ir, allocated, addr_map, bytecode_size);
+
+    AUG_FREE(pending);
+    AUG_FREE(addr_map);
+    AUG_FREE(targets);
+}
+
+aug_ir* aug_generate_ir(aug_vm* vm, aug_ast* root, aug_input* input)
+{
+    if(root == NULL || input == NULL)
+        return NULL;
+
+    // Generate IR
+    aug_ir* ir = aug_ir_new();
+    ir->optimize_level = vm != NULL ? vm->optimize_level : AUG_OPTIMIZE_LEVEL;
+    ir->backend = vm != NULL ? vm->backend : AUG_BACKEND;
+
+    aug_ir_push_frame(ir, 0);  // push global frame
+    aug_generate_ir_pass(root, ir, input);
+    
+    // Signal to VM to exit
+    aug_ir_add_operation(ir, AUG_OPCODE_EXIT);
+    aug_ir_pop_frame(ir); // pop global frame
+
+    aug_optimize_ir(ir, ir->optimize_level);
+    if(ir->backend == AUG_BACKEND_REGISTER)
+        aug_ir_allocate_registers(ir);
+    return ir;
+}
+
+static inline void aug_generate_bytecode_operand(aug_ir* ir, aug_ir_operand operand, char** instruction)
+{
+    switch (operand.type)
+    {
+    case AUG_IR_OPERAND_NONE:
+        break;
+    case AUG_IR_OPERAND_BOOL:
+    case AUG_IR_OPERAND_CHAR:
+    case AUG_IR_OPERAND_INT:
+    case AUG_IR_OPERAND_FLOAT:
+        for(size_t i = 0; i < aug_ir_operand_size(operand); ++i)
+            *((*instruction)++) = operand.data.bytes[i];
+        break;
+    case AUG_IR_OPERAND_BYTES:
+        for(size_t i = 0; operand.data.str[i] != '\0'; ++i)
+            *((*instruction)++) = operand.data.str[i];
+        *((*instruction)++) = 0; // null terminate
+        break;
+    case AUG_IR_OPERAND_SYMBOL:
+    {
+        aug_symbol* symbol = aug_hashtable_ptr_type(aug_symbol, ir->globals, operand.data.str);
+        assert(symbol);
+        operand.data.i = symbol->offset;
+        for(size_t i = 0; i < aug_ir_operand_size(operand); ++i)
+            *((*instruction)++) = operand.data.bytes[i];
+        break;
+    }
+    }
+}
+
+char* aug_generate_bytecode(aug_ir* ir)
+{  
+    assert(ir != NULL && ir->operations != NULL);
+
+    if (!ir->valid)
+        return NULL;
+
+    char* bytecode = (char*)AUG_ALLOC(sizeof(char)*ir->bytecode_offset);
+    char* instruction = bytecode;
+
+    for(size_t i = 0; i < ir->operations->length; ++i)
+    {
+        aug_ir_operation operation = aug_container_at_type(aug_ir_operation, ir->operations, i);
+
+        // push operation opcode
+        (*instruction++) = (aug_opcode)operation.opcode;
+
+        // push operation arguments
+        aug_generate_bytecode_operand(ir, operation.operand, &instruction);
+        aug_generate_bytecode_operand(ir, operation.operand_ext, &instruction);
+    }
+    assert((size_t) (instruction - bytecode) == ir->bytecode_offset);
+    return bytecode;
+}
+
+// STRING ================================================= STRING ============================================ STRING // 
+
+static inline aug_string* aug_string_alloc(size_t capacity)
+{
+	aug_heap* heap = aug_heap_current();
+	aug_string* string = (aug_string*)aug_heap_pool_alloc(heap, AUG_POOL_STRING);
+	string->heap = heap;
+	string->ref_count = 1;
+	string->length = 0;
+	string->hash = 0;
+	string->constant = false;
+	string->source = NULL;
+	string->epoch = heap->epoch;
+	if(capacity <= AUG_STRING_LOCAL_SIZE)
+	{
+		string->capacity = AUG_STRING_LOCAL_SIZE;
+		string->buffer = string->local;
+	}
+	else
+	{
+		string->capacity = capacity;
+		string->buffer = (char*)aug_heap_alloc(heap, sizeof(char)*string->capacity);
+	}
+	return string;
+}
+
+aug_string* aug_string_new(size_t size) 
+{
+	return aug_string_alloc(size);
+}
+
+aug_string* aug_string_create(const char* bytes) 
+{
+	const size_t length = strlen(bytes);
+	aug_string* string = aug_string_alloc(length + 1);
+	string->length = length;
+	memcpy(string->buffer, bytes, length + 1);
+    return string;
+}
+
+aug_string* aug_string_share(aug_string* constant)
+{
+	aug_heap* heap = aug_heap_current();
+	aug_string* string = (aug_string*)aug_heap_pool_alloc(heap, AUG_POOL_STRING);
+	string->heap = heap;
+	string->ref_count = 1;
+	string->length = constant->length;
+	string->capacity = constant->length + 1;
+	string->hash = aug_string_hash(constant); // cached by the constant, so that literal keys are hashed once
+	string->constant = true;
+	string->source = constant;
+	string->epoch = heap->epoch;
+	string->buffer = constant->buffer;
+	aug_string_incref(constant);
+	return string;
+}
+
+// Called before modifying the string, copies a shared buffer. Returns false if the string owns a constant buffer
+static bool aug_string_modify(aug_string* string)
+{
+	aug_string* source = string->source;
+	if(string->constant && source == NULL)
+		return false;
+	aug_heap_track(string->heap, AUG_STRING, string, &string->epoch);
+	if(!string->constant)
+		return true;
+
+	const size_t capacity = string->length + 1;
+	if(capacity <= AUG_STRING_LOCAL_SIZE)
+	{
+		string->capacity = AUG_STRING_LOCAL_SIZE;
+		string->buffer = string->local;
+	}
+	else
+	{
+		string->capacity = capacity;
+		string->buffer = (char*)aug_heap_alloc(string->heap, sizeof(char)*string->capacity);
+	}
+	memcpy(string->buffer, source->buffer, string->length + 1);
+	string->constant = false;
+	string->source = NULL;
+	aug_string_decref(source);
+	return true;
+}
+
+void aug_string_resize(aug_string* string, size_t size) 
+{
+	if(!aug_string_modify(string))
+		return;
+
+	if(string->buffer == string->local)
+	{
+		if(size <= AUG_STRING_LOCAL_SIZE)
+			return;
+
+		// Move out of the local storage
+		char* buffer = (char*)aug_heap_alloc(string->heap, sizeof(char)*size);
+		memcpy(buffer, string->local, string->length < size ? string->length + 1 : size);
+		string->buffer = buffer;
+		string->capacity = size;
+		return;
+	}
+
+    const size_t old_capacity = string->capacity;
+	string->capacity = size;
+    string->buffer = (char*)aug_heap_realloc(string->heap, string->buffer, sizeof(char)*old_capacity, sizeof(char)*string->capacity);
+}
+
+void aug_string_push(aug_string* string, char c) 
+{
+    if(!aug_string_modify(string))
+        return;
+    if(string->length + 1 >= string->capacity) 
+        aug_string_resize(string, 2 * string->capacity);
+    string->buffer[string->length++] = c;
+    string->buffer[string->length] = '\0';
+    string->hash = 0;
+}
+
+char aug_string_pop(aug_string* string) 
+{
+	if(string->length == 0 || !aug_string_modify(string))
+		return -1;
+	string->hash = 0;
+	return string->buffer[--string->length];
+}
+
+void aug_string_append(aug_string* a, const aug_string* b)
+{
+    if(a != NULL && b != NULL && b->buffer != NULL)
+        aug_string_append_bytes(a, b->buffer, b->length);
+}
+
+void aug_string_append_bytes(aug_string* string, const char* bytes, int len)
+{
+    if(!aug_string_modify(string))
+        return;
+    // Grow geometrically, so that appending in a loop is amortized linear
+    if(string->length + len >= string->capacity) 
+    {
+        const size_t required = string->length + len + 1;
+        aug_string_resize(string, string->capacity * 2 > required ? string->capacity * 2 : required);
+    }
+
+    memcpy(string->buffer + string->length, bytes, (size_t)len);
+    string->length += len;
+    string->buffer[string->length] = '\0'; 
+    string->hash = 0;
+}
+
+char aug_string_at(const aug_string* string, size_t index) 
+{
+	return index < string->length ? string->buffer[index] : -1;
+}
+
+bool aug_string_set(aug_string* string, size_t index, char c) 
+{
+	if(index < string->length && aug_string_modify(string))
+    {
+        string->buffer[index] = c;
+        string->hash = 0;
+        return true;
+    } 
+    return false;
+}
+
+char aug_string_back(const aug_string* string) 
+{
+	return string->length > 0 ? string->buffer[string->length-1] : -1;
+}
+
+bool aug_string_compare(const aug_string* a, const aug_string* b) 
+{
+    if(a == NULL || b == NULL || a->length != b->length)
+        return false; 
+    if(a->buffer == b->buffer) // shared with the same constant
+        return true;
+    if(a->hash != 0 && b->hash != 0 && a->hash != b->hash)
+        return false;
+    return strncmp(a->buffer, b->buffer, a->length) == 0;
+}
+
+size_t aug_string_hash(aug_string* string)
+{
+    if(string->hash == 0)
+    {
+        uint64_t hash = 5381; // DJB2 hash
+        for(size_t i = 0; i < string->length; ++i)
+            hash = ((hash << 5) + hash) + string->buffer[i];
+        hash = aug_hash_mix(hash);
+        string->hash = hash != 0 ? hash : 1; // 0 is reserved as not computed
+    }
+    return string->hash;
+}
+
+bool aug_string_compare_bytes(const aug_string* a, const char* bytes) 
+{
+    if(bytes == NULL)
+        return a->buffer == NULL;
+
+    size_t len = strlen(bytes);
+    if(len != a->length)
+        return false;
+
+    for(size_t i = 0; i < a->length; ++i)
+    {
+        if(a->buffer[i] != bytes[i])
+            return false;
+
+    }
+    return true;
+}
+
+void aug_string_incref(aug_string* string) 
+{
+    if(string != NULL)
+    {
+        string->ref_count++;
+        if(string->heap != NULL)
+            ++string->heap->incref_count;
+    }
+}
+
+aug_string* aug_string_decref(aug_string* string) 
+{
+    if(string == NULL)
+        return NULL;
+    // Arena strings are not owned by a heap
+    if(string->heap != NULL)
+        ++string->heap->decref_count;
+    if(--string->ref_count == 0)
+    {
+        if(string->source != NULL)
+            aug_string_decref(string->source);
+        else if(string->buffer != string->local)
+            aug_heap_free(string->heap, string->buffer, sizeof(char)*string->capacity);
+        aug_heap_pool_free(string->heap, AUG_POOL_STRING, string);
+        return NULL;
+    }
+    return string;
+}
+
+// ARRAY ================================================== ARRAY ============================================== ARRAY // 
+
+aug_array* aug_array_new(size_t size)
+{                
+	aug_heap* heap = aug_heap_current();
+	aug_array* array = (aug_array*)aug_heap_pool_alloc(heap, AUG_POOL_ARRAY);
+	array->heap = heap;
+	array->ref_count = 1;   
+	array->length = 0;      
+	array->capacity = size; 
+	array->buffer = (aug_value*)aug_heap_alloc(heap, sizeof(aug_value)*array->capacity);
+	array->epoch = heap->epoch;
+	array->gc.root = -1;
+	array->gc.color = AUG_GC_BLACK;
+	if(heap->deferred_count > 0)
+	    aug_heap_release_deferred(heap, AUG_DEFER_RELEASE_STEP);
+	return array;
+}
+
+void aug_array_incref(aug_array* array) 
+{
+    if(array != NULL)
+    {
+        array->ref_count++;
+        ++array->heap->incref_count;
+    }
+}
+ 
+static void aug_array_free(aug_array* array)
+{
+    aug_heap_free(array->heap, array->buffer, sizeof(aug_value)*array->capacity);
+    aug_heap_pool_free(array->heap, AUG_POOL_ARRAY, array);
+}
+
+// Releases an unreferenced array and its elements. Large arrays release their elements incrementally
+static void aug_array_release(aug_array* array)
+{
+#if AUG_CYCLE_COLLECT
+    if(array->gc.root >= 0)
+        aug_heap_remove_root(array->heap, &array->gc);
+#endif//AUG_CYCLE_COLLECT
+#if AUG_DEFER_RELEASE_SIZE > 0
+    if(array->length > AUG_DEFER_RELEASE_SIZE && array->heap->collect)
+    {
+        aug_value value;
+        aug_value_init_pointer(&value, AUG_ARRAY, array);
+        aug_heap_defer(array->heap, value, array->length);
+        return;
+    }
+#endif//AUG_DEFER_RELEASE_SIZE
+
+    // If will be dereferenced, ensure children are as well
+    for (size_t i = 0; i < array->length; ++i)
+        aug_decref(aug_array_at(array, i));
+    aug_array_free(array);
+}
+ 
+aug_array* aug_array_decref(aug_array* array)
+{
+    if(array == NULL)
+        return NULL;
+    ++array->heap->decref_count;
+    if(--array->ref_count == 0)
+    {            
+        aug_array_release(array);
+        return NULL;
+    }            
+#if AUG_CYCLE_COLLECT
+    if(array->gc.root < 0 && array->heap->collect)
+    {
+        aug_value value;
+        aug_value_init_pointer(&value, AUG_ARRAY, array);
+        aug_heap_buffer_root(array->heap, value, &array->gc);
+    }
+#endif//AUG_CYCLE_COLLECT
+    return array;
+}       
+
+void aug_array_reserve(aug_array* array, size_t size)    
+{
+    const size_t old_capacity = array->capacity;
+	array->capacity = size; 
+	array->buffer = (aug_value*)aug_heap_realloc(array->heap, array->buffer, sizeof(aug_value)*old_capacity, sizeof(aug_value)*array->capacity);
+}
+
+void aug_array_resize(aug_array* array, size_t size)    
+{
+    aug_heap_track(array->heap, AUG_ARRAY, array, &array->epoch);
+    aug_array_reserve(array, size);
+    array->length = array->capacity;
+    for(size_t i = 0; i < array->length; ++i)
+        array->buffer[i] = aug_none();
+}
+ 
+aug_value* aug_array_push(aug_array* array)  
+{
+    aug_heap_track(array->heap, AUG_ARRAY, array, &array->epoch);
+	if(array->length + 1 >= array->capacity)
+        aug_array_reserve(array, array->capacity * 2); 
+    return &array->buffer[array->length++];     
+}
+ 
+aug_value* aug_array_pop(aug_array* array)
+{
+	if(array->length == 0)
+		return NULL;
+	aug_heap_track(array->heap, AUG_ARRAY, array, &array->epoch);
+	return &array->buffer[--array->length]; 
+}
+ 
+aug_value* aug_array_at(const aug_array* array, size_t index) 
+{
+	return index < array->length ? &array->buffer[index] : NULL;       
+}
+
+bool aug_array_set(aug_array* array, size_t index, aug_value* value) 
+{
+	if(index < array->length)
+    {
+        aug_heap_track(array->heap, AUG_ARRAY, array, &array->epoch);
+        aug_assign(&array->buffer[index], value); 
+        return true;      
+    }   
+    return false;      
+}
+ 
+aug_value* aug_array_back(const aug_array* array)             
+{
+	return array->length > 0 ? &array->buffer[array->length-1] : NULL; 
+}
+
+bool aug_array_compare(const aug_array* a, const aug_array* b)             
+{
+    if(a->length != b->length)
+        return false;
+    for(size_t i = 0; i < a->length; ++i)
+    {
+        if(!aug_compare(&a->buffer[i], &b->buffer[i]))
+            return false;
+    }
+    return true;
+}
+
+void aug_array_append(aug_array* array, aug_value* value)  
+{
+    aug_value* new_value = aug_array_push(array);
+    if(new_value == NULL)
+        return;
+
+    *new_value = aug_none(); 
+    aug_array_set(array, array->length-1, value);
+}
+
+void aug_array_remove(aug_array* array, int index)  
+{
+    aug_value* value = aug_array_at(array, index); 
+
+    if(value == NULL)
+        return;
+
+    aug_heap_track(array->heap, AUG_ARRAY, array, &array->epoch);
+    aug_decref(value);
+    for(size_t i = index; i < array->length-1; ++i)
+        array->buffer[i] = array->buffer[i+1];
+    array->length--;
+}
+
+void aug_array_concat(aug_array* array, const aug_array* other)
+{
+    aug_heap_track(array->heap, AUG_ARRAY, array, &array->epoch);
+    const size_t length = other->length;
+    if(array->length + length >= array->capacity)
+    {
+        const size_t required = array->length + length + 1;
+        aug_array_reserve(array, array->capacity * 2 > required ? array->capacity * 2 : required);
+    }
+
+    // Read the other buffer after reserving, as the arrays can be the same
+    aug_value* elements = array->buffer + array->length;
+    memcpy(elements, other->buffer, sizeof(aug_value) * length);
+    for(size_t i = 0; i < length; ++i)
+        aug_incref(&elements[i]);
+    array->length += length;
+}
+
+aug_array* aug_array_copy(aug_array* array)
+{
+    aug_array* new_array = aug_array_new(array->length + 1);
+    aug_array_concat(new_array, array);
+    return new_array;
+}
+
+// TYPED ARRAY ======================================== TYPED ARRAY ====================================== TYPED ARRAY // 
+
+// Four float lanes. Integer loops are left to the compiler's vectorizer, as integer reductions can be reordered. 
+// Float reductions can not, so sums are accumulated per lane and the result may differ from a sequential sum by rounding
+#if AUG_SIMD_SSE
+#define AUG_FLOAT4 __m128
+#define AUG_FLOAT4_LOAD(ptr) _mm_loadu_ps(ptr)
+#define AUG_FLOAT4_STORE(ptr, v) _mm_storeu_ps(ptr, v)
+#define AUG_FLOAT4_SET(x) _mm_set1_ps(x)
+#define AUG_FLOAT4_ADD(a, b) _mm_add_ps(a, b)
+#define AUG_FLOAT4_MUL(a, b) _mm_mul_ps(a, b)
+#define AUG_FLOAT4_MIN(a, b) _mm_min_ps(a, b)
+#define AUG_FLOAT4_MAX(a, b) _mm_max_ps(a, b)
+#elif AUG_SIMD_NEON
+#define AUG_FLOAT4 float32x4_t
+#define AUG_FLOAT4_LOAD(ptr) vld1q_f32(ptr)
+#define AUG_FLOAT4_STORE(ptr, v) vst1q_f32(ptr, v)
+#define AUG_FLOAT4_SET(x) vdupq_n_f32(x)
+#define AUG_FLOAT4_ADD(a, b) vaddq_f32(a, b)
+#define AUG_FLOAT4_MUL(a, b) vmulq_f32(a, b)
+#define AUG_FLOAT4_MIN(a, b) vminq_f32(a, b)
+#define AUG_FLOAT4_MAX(a, b) vmaxq_f32(a, b)
+#endif
+
+static void aug_floats_add(float* a, const float* b, size_t n)
+{
+    size_t i = 0;
+#ifdef AUG_FLOAT4
+    for(; i + 4 <= n; i += 4)
+        AUG_FLOAT4_STORE(a + i, AUG_FLOAT4_ADD(AUG_FLOAT4_LOAD(a + i), AUG_FLOAT4_LOAD(b + i)));
+#endif
+    for(; i < n; ++i)
+        a[i] += b[i];
+}
+
+static void aug_floats_mul(float* a, const float* b, size_t n)
+{
+    size_t i = 0;
+#ifdef AUG_FLOAT4
+    for(; i + 4 <= n; i += 4)
+        AUG_FLOAT4_STORE(a + i, AUG_FLOAT4_MUL(AUG_FLOAT4_LOAD(a + i), AUG_FLOAT4_LOAD(b + i)));
+#endif
+    for(; i < n; ++i)
+        a[i] *= b[i];
+}
+
+static void aug_floats_scale(float* a, float factor, size_t n)
+{
+    size_t i = 0;
+#ifdef AUG_FLOAT4
+    const AUG_FLOAT4 factors = AUG_FLOAT4_SET(factor);
+    for(; i + 4 <= n; i += 4)
+        AUG_FLOAT4_STORE(a + i, AUG_FLOAT4_MUL(AUG_FLOAT4_LOAD(a + i), factors));
+#endif
+    for(; i < n; ++i)
+        a[i] *= factor;
+}
+
+static float aug_floats_sum(const float* a, size_t n)
+{
+    float total = 0.0f;
+    size_t i = 0;
+#ifdef AUG_FLOAT4
+    if(n >= 4)
+    {
+        AUG_FLOAT4 totals = AUG_FLOAT4_SET(0.0f);
+        for(; i + 4 <= n; i += 4)
+            totals = AUG_FLOAT4_ADD(totals, AUG_FLOAT4_LOAD(a + i));
+
+        float lanes[4];
+        AUG_FLOAT4_STORE(lanes, totals);
+        total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+#endif
+    for(; i < n; ++i)
+        total += a[i];
+    return total;
+}
+
+static float aug_floats_dot(const float* a, const float* b, size_t n)
+{
+    float total = 0.0f;
+    size_t i = 0;
+#ifdef AUG_FLOAT4
+    if(n >= 4)
+    {
+        AUG_FLOAT4 totals = AUG_FLOAT4_SET(0.0f);
+        for(; i + 4 <= n; i += 4)
+            totals = AUG_FLOAT4_ADD(totals, AUG_FLOAT4_MUL(AUG_FLOAT4_LOAD(a + i), AUG_FLOAT4_LOAD(b + i)));
+
+        float lanes[4];
+        AUG_FLOAT4_STORE(lanes, totals);
+        total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+#endif
+    for(; i < n; ++i)
+        total += a[i] * b[i];
+    return total;
+}
+
+// Expects n > 0
+static float aug_floats_min(const float* a, size_t n)
+{
+    float result = a[0];
+    size_t i = 0;
+#ifdef AUG_FLOAT4
+    if(n >= 4)
+    {
+        AUG_FLOAT4 results = AUG_FLOAT4_LOAD(a);
+        for(i = 4; i + 4 <= n; i += 4)
+            results = AUG_FLOAT4_MIN(results, AUG_FLOAT4_LOAD(a + i));
+
+        float lanes[4];
+        AUG_FLOAT4_STORE(lanes, results);
+        for(int j = 0; j < 4; ++j)
+            result = lanes[j] < result ? lanes[j] : result;
+    }
+#endif
+    for(; i < n; ++i)
+        result = a[i] < result ? a[i] : result;
+    return result;
+}
+
+// Expects n > 0
+static float aug_floats_max(const float* a, size_t n)
+{
+    float result = a[0];
+    size_t i = 0;
+#ifdef AUG_FLOAT4
+    if(n >= 4)
+    {
+        AUG_FLOAT4 results = AUG_FLOAT4_LOAD(a);
+        for(i = 4; i + 4 <= n; i += 4)
+            results = AUG_FLOAT4_MAX(results, AUG_FLOAT4_LOAD(a + i));
+
+        float lanes[4];
+        AUG_FLOAT4_STORE(lanes, results);
+        for(int j = 0; j < 4; ++j)
+            result = lanes[j] > result ? lanes[j] : result;
+    }
+#endif
+    for(; i < n; ++i)
+        result = a[i] > result ? a[i] : result;
+    return result;
+}
+
+static inline size_t aug_typed_array_element_size(const aug_typed_array* array)
+{
+    return array->element_type == AUG_INT ? sizeof(int) : sizeof(float);
+}
+
+static void aug_typed_array_reserve(aug_typed_array* array, size_t size)
+{
+    const size_t element_size = aug_typed_array_element_size(array);
+    array->buffer = aug_heap_realloc(array->heap, array->buffer, element_size * array->capacity, element_size * size);
+    array->capacity = size;
+}
+
+aug_typed_array* aug_typed_array_new(aug_type element_type, size_t length)
+{
+    if(element_type != AUG_INT && element_type != AUG_FLOAT)
+        return NULL;
+
+    aug_heap* heap = aug_heap_current();
+    aug_typed_array* array = (aug_typed_array*)aug_heap_pool_alloc(heap, AUG_POOL_TYPED_ARRAY);
+    array->heap = heap;
+    array->ref_count = 1;
+    array->element_type = element_type;
+    array->length = length;
+    array->capacity = length > 0 ? length : 1;
+    array->epoch = heap->epoch;
+
+    const size_t element_size = aug_typed_array_element_size(array);
+    array->buffer = aug_heap_alloc(heap, element_size * array->capacity);
+    memset(array->buffer, 0, element_size * length);
+    return array;
+}
+
+void aug_typed_array_incref(aug_typed_array* array)
+{
+    if(array != NULL)
+    {
+        ++array->ref_count;
+        ++array->heap->incref_count;
+    }
+}
+
+aug_typed_array* aug_typed_array_decref(aug_typed_array* array)
+{
+    if(array == NULL)
+        return NULL;
+    ++array->heap->decref_count;
+    if(--array->ref_count == 0)
+    {
+        aug_heap_free(array->heap, array->buffer, aug_typed_array_element_size(array) * array->capacity);
+        aug_heap_pool_free(array->heap, AUG_POOL_TYPED_ARRAY, array);
+        return NULL;
+    }
+    return array;
+}
+
+void aug_typed_array_resize(aug_typed_array* array, size_t length)
+{
+    aug_heap_track(array->heap, AUG_TYPED_ARRAY, array, &array->epoch);
+    if(length > array->capacity)
+        aug_typed_array_reserve(array, length);
+
+    if(length > array->length)
+    {
+        const size_t element_size = aug_typed_array_element_size(array);
+        memset((char*)array->buffer + element_size * array->length, 0, element_size * (length - array->length));
+    }
+    array->length = length;
+}
+
+bool aug_typed_array_push(aug_typed_array* array, const aug_value* value)
+{
+    if(value == NULL || (aug_value_type(value) != AUG_INT && aug_value_type(value) != AUG_FLOAT))
+        return false;
+
+    aug_heap_track(array->heap, AUG_TYPED_ARRAY, array, &array->epoch);
+    if(array->length == array->capacity)
+        aug_typed_array_reserve(array, array->capacity * 2);
+    ++array->length;
+    return aug_typed_array_set(array, array->length - 1, value);
+}
+
+bool aug_typed_array_get(const aug_typed_array* array, size_t index, aug_value* out_element)
+{
+    if(index >= array->length)
+        return false;
+
+    if(array->element_type == AUG_INT)
+        *out_element = aug_create_int(array->ints[index]);
+    else
+        *out_element = aug_create_float(array->floats[index]);
+    return true;
+}
+
+bool aug_typed_array_set(aug_typed_array* array, size_t index, const aug_value* value)
+{
+    if(index >= array->length || value == NULL || (aug_value_type(value) != AUG_INT && aug_value_type(value) != AUG_FLOAT))
+        return false;
+
+    aug_heap_track(array->heap, AUG_TYPED_ARRAY, array, &array->epoch);
+    if(array->element_type == AUG_INT)
+        array->ints[index] = aug_to_int(value);
+    else
+        array->floats[index] = aug_to_float(value);
+    return true;
+}
+
+bool aug_typed_array_compare(const aug_typed_array* a, const aug_typed_array* b)
+{
+    if(a->element_type != b->element_type || a->length != b->length)
+        return false;
+
+    if(a->element_type == AUG_INT)
+        return memcmp(a->ints, b->ints, sizeof(int) * a->length) == 0;
+
+    for(size_t i = 0; i < a->length; ++i)
+    {
+        if((float)fabs(a->floats[i] - b->floats[i]) >= AUG_APPROX_THRESHOLD)
+            return false;
+    }
+    return true;
+}
+
+aug_typed_array* aug_typed_array_copy(const aug_typed_array* array)
+{
+    aug_typed_array* new_array = aug_typed_array_new(array->element_type, array->length);
+    memcpy(new_array->buffer, array->buffer, aug_typed_array_element_size(array) * array->length);
+    return new_array;
+}
+
+static inline bool aug_typed_array_matches(const aug_typed_array* a, const aug_typed_array* b)
+{
+    return a != NULL && b != NULL && a->element_type == b->element_type && a->length == b->length;
+}
+
+bool aug_typed_array_add(aug_typed_array* array, const aug_typed_array* other)
+{
+    if(!aug_typed_array_matches(array, other))
+        return false;
+    aug_heap_track(array->heap, AUG_TYPED_ARRAY, array, &array->epoch);
+
+    if(array->element_type == AUG_FLOAT)
+    {
+        aug_floats_add(array->floats, other->floats, array->length);
+        return true;
+    }
+    for(size_t i = 0; i < array->length; ++i)
+        array->ints[i] += other->ints[i];
+    return true;
+}
+
+bool aug_typed_array_mul(aug_typed_array* array, const aug_typed_array* other)
+{
+    if(!aug_typed_array_matches(array, other))
+        return false;
+    aug_heap_track(array->heap, AUG_TYPED_ARRAY, array, &array->epoch);
+
+    if(array->element_type == AUG_FLOAT)
+    {
+        aug_floats_mul(array->floats, other->floats, array->length);
+        return true;
+    }
+    for(size_t i = 0; i < array->length; ++i)
+        array->ints[i] *= other->ints[i];
+    return true;
+}
+
+bool aug_typed_array_scale(aug_typed_array* array, const aug_value* factor)
+{
+    if(array == NULL || factor == NULL || (aug_value_type(factor) != AUG_INT && aug_value_type(factor) != AUG_FLOAT))
+        return false;
+    aug_heap_track(array->heap, AUG_TYPED_ARRAY, array, &array->epoch);
+
+    if(array->element_type == AUG_FLOAT)
+    {
+        aug_floats_scale(array->floats, aug_to_float(factor), array->length);
+        return true;
+    }
+
+    if(aug_value_type(factor) == AUG_INT)
+    {
+        const int scale = aug_value_int(factor);
+        for(size_t i = 0; i < array->length; ++i)
+            array->ints[i] *= scale;
+    }
+    else
+    {
+        const float scale = aug_value_float(factor);
+        for(size_t i = 0; i < array->length; ++i)
+            array->ints[i] = (int)(array->ints[i] * scale);
+    }
+    return true;
+}
+
+aug_value aug_typed_array_sum(const aug_typed_array* array)
+{
+    if(array == NULL || array->length == 0)
+        return aug_none();
+
+    if(array->element_type == AUG_FLOAT)
+        return aug_create_float(aug_floats_sum(array->floats, array->length));
+
+    // Accumulate unsigned, integer overflow wraps as it does for the script's add operator
+    unsigned int total = 0;
+    for(size_t i = 0; i < array->length; ++i)
+        total += (unsigned int)array->ints[i];
+    return aug_create_int((int)total);
+}
+
+aug_value aug_typed_array_min(const aug_typed_array* array)
+{
+    if(array == NULL || array->length == 0)
+        return aug_none();
+
+    if(array->element_type == AUG_FLOAT)
+        return aug_create_float(aug_floats_min(array->floats, array->length));
+
+    int result = array->ints[0];
+    for(size_t i = 1; i < array->length; ++i)
+        result = array->ints[i] < result ? array->ints[i] : result;
+    return aug_create_int(result);
+}
+
+aug_value aug_typed_array_max(const aug_typed_array* array)
+{
+    if(array == NULL || array->length == 0)
+        return aug_none();
+
+    if(array->element_type == AUG_FLOAT)
+        return aug_create_float(aug_floats_max(array->floats, array->length));
+
+    int result = array->ints[0];
+    for(size_t i = 1; i < array->length; ++i)
+        result = array->ints[i] > result ? array->ints[i] : result;
+    return aug_create_int(result);
+}
+
+aug_value aug_typed_array_dot(const aug_typed_array* a, const aug_typed_array* b)
+{
+    if(!aug_typed_array_matches(a, b) || a->length == 0)
+        return aug_none();
+
+    if(a->element_type == AUG_FLOAT)
+        return aug_create_float(aug_floats_dot(a->floats, b->floats, a->length));
+
+    unsigned int total = 0;
+    for(size_t i = 0; i < a->length; ++i)
+        total += (unsigned int)a->ints[i] * (unsigned int)b->ints[i];
+    return aug_create_int((int)total);
+}
+
+// BUFFER VIEW ======================================== BUFFER VIEW ====================================== BUFFER VIEW //
+
+size_t aug_view_type_size(aug_view_type element_type)
+{
+    switch(element_type)
+    {
+    case AUG_VIEW_INT8:
+    case AUG_VIEW_UINT8:
+        return sizeof(int8_t);
+    case AUG_VIEW_INT16:
+    case AUG_VIEW_UINT16:
+        return sizeof(int16_t);
+    case AUG_VIEW_INT32:
+    case AUG_VIEW_UINT32:
+        return sizeof(int32_t);
+    case AUG_VIEW_FLOAT:
+        return sizeof(float);
+    case AUG_VIEW_DOUBLE:
+        return sizeof(double);
+    }
+    return 0;
+}
+
+aug_buffer_view* aug_buffer_view_new(void* data, aug_view_type element_type, size_t length, size_t stride, 
+    aug_view_release_func* release, void* user)
+{
+    const size_t element_size = aug_view_type_size(element_type);
+    if(element_size == 0 || (data == NULL && length > 0) || (stride != 0 && stride < element_size))
+        return NULL;
+
+    aug_heap* heap = aug_heap_current();
+    aug_buffer_view* view = (aug_buffer_view*)aug_heap_pool_alloc(heap, AUG_POOL_BUFFER_VIEW);
+    view->heap = heap;
+    view->ref_count = 1;
+    view->data = (char*)data;
+    view->element_type = element_type;
+    view->length = length;
+    view->stride = stride != 0 ? stride : element_size;
+    view->release = release;
+    view->user = user;
+    return view;
+}
+
+void aug_buffer_view_incref(aug_buffer_view* view)
+{
+    if(view != NULL)
+    {
+        ++view->ref_count;
+        ++view->heap->incref_count;
+    }
+}
+
+aug_buffer_view* aug_buffer_view_decref(aug_buffer_view* view)
+{
+    if(view == NULL)
+        return NULL;
+    ++view->heap->decref_count;
+    if(--view->ref_count == 0)
+    {
+        if(view->release != NULL)
+            view->release(view->data, view->user);
+        aug_heap_pool_free(view->heap, AUG_POOL_BUFFER_VIEW, view);
+        return NULL;
+    }
+    return view;
+}
+
+// Elements are copied through memcpy, as host buffers such as packets do not guarantee the element alignment
+bool aug_buffer_view_get(const aug_buffer_view* view, size_t index, aug_value* out_element)
+{
+    if(index >= view->length)
+        return false;
+
+    const char* element = view->data + index * view->stride;
+    switch(view->element_type)
+    {
+    case AUG_VIEW_INT8:   { int8_t x;   memcpy(&x, element, sizeof(x)); *out_element = aug_create_int(x); break; }
+    case AUG_VIEW_UINT8:  { uint8_t x;  memcpy(&x, element, sizeof(x)); *out_element = aug_create_int(x); break; }
+    case AUG_VIEW_INT16:  { int16_t x;  memcpy(&x, element, sizeof(x)); *out_element = aug_create_int(x); break; }
+    case AUG_VIEW_UINT16: { uint16_t x; memcpy(&x, element, sizeof(x)); *out_element = aug_create_int(x); break; }
+    case AUG_VIEW_INT32:  { int32_t x;  memcpy(&x, element, sizeof(x)); *out_element = aug_create_int(x); break; }
+    case AUG_VIEW_UINT32: { uint32_t x; memcpy(&x, element, sizeof(x)); *out_element = aug_create_int((int)x); break; }
+    case AUG_VIEW_FLOAT:  { float x;    memcpy(&x, element, sizeof(x)); *out_element = aug_create_float(x); break; }
+    case AUG_VIEW_DOUBLE: { double x;   memcpy(&x, element, sizeof(x)); *out_element = aug_create_float((float)x); break; }
+    default:
+        return false;
+    }
+    return true;
+}
+
+bool aug_buffer_view_set(aug_buffer_view* view, size_t index, const aug_value* value)
+{
+    if(index >= view->length || value == NULL || (aug_value_type(value) != AUG_INT && aug_value_type(value) != AUG_FLOAT))
+        return false;
+
+    char* element = view->data + index * view->stride;
+    switch(view->element_type)
+    {
+    case AUG_VIEW_INT8:   { int8_t x = (int8_t)aug_to_int(value);     memcpy(element, &x, sizeof(x)); break; }
+    case AUG_VIEW_UINT8:  { uint8_t x = (uint8_t)aug_to_int(value);   memcpy(element, &x, sizeof(x)); break; }
+    case AUG_VIEW_INT16:  { int16_t x = (int16_t)aug_to_int(value);   memcpy(element, &x, sizeof(x)); break; }
+    case AUG_VIEW_UINT16: { uint16_t x = (uint16_t)aug_to_int(value); memcpy(element, &x, sizeof(x)); break; }
+    case AUG_VIEW_INT32:  { int32_t x = (int32_t)aug_to_int(value);   memcpy(element, &x, sizeof(x)); break; }
+    case AUG_VIEW_UINT32: { uint32_t x = (uint32_t)aug_to_int(value); memcpy(element, &x, sizeof(x)); break; }
+    case AUG_VIEW_FLOAT:  { float x = aug_to_float(value);            memcpy(element, &x, sizeof(x)); break; }
+    case AUG_VIEW_DOUBLE: { double x = aug_to_float(value);           memcpy(element, &x, sizeof(x)); break; }
+    default:
+        return false;
+    }
+    return true;
+}
+
+// Views are equal if their elements are equal, regardless of the memory layout
+bool aug_buffer_view_compare(const aug_buffer_view* a, const aug_buffer_view* b)
+{
+    if(a->length != b->length)
+        return false;
+    if(a->data == b->data && a->element_type == b->element_type && a->stride == b->stride)
+        return true;
+
+    for(size_t i = 0; i < a->length; ++i)
+    {
+        aug_value x, y;
+        if(!aug_buffer_view_get(a, i, &x) || !aug_buffer_view_get(b, i, &y) || !aug_compare(&x, &y))
+            return false;
+    }
+    return true;
+}
+
+// MAP ==================================================== MAP =================================================== MAP //
+
+// Open addressing hash map using robin hood probing. Slots store the key hash next to the key and value.
+// Capacity is a power of two, the table grows when the count exceeds the load factor. 
+// Removal shifts the following entries back, so no tombstones are required
+
+#ifndef AUG_MAP_SIZE_DEFAULT
+#define AUG_MAP_SIZE_DEFAULT 8 // must be a power of two
+#endif//AUG_MAP_SIZE_DEFAULT
+
+#ifndef AUG_MAP_LOAD_FACTOR
+#define AUG_MAP_LOAD_FACTOR 75 // percent of capacity
+#endif//AUG_MAP_LOAD_FACTOR
+
+typedef struct aug_map_slot
+{
+    aug_value key; // AUG_NONE if empty
+    aug_value value;
+    size_t hash;
+} aug_map_slot;
+
+bool aug_map_can_hash(const aug_value* value)
+{
+    switch(aug_value_type(value))
+    {
+        case AUG_STRING:
+        case AUG_INT:
+            return true;
+        default:
+            return false;
+    }
+    return false;
+}
+
+size_t aug_map_hash(const aug_value* value)
+{
+    uint64_t hash;
+    switch(aug_value_type(value))
+    {
+        case AUG_STRING:
+            return aug_string_hash(aug_value_string(value));
+        case AUG_INT:
+            hash = (uint64_t)aug_value_int(value);
+            break;
+        default:
+            return 0;
+    }
+
+    return aug_hash_mix(hash);
+}
+
+static inline size_t aug_map_probe_distance(const aug_map* map, size_t hash, size_t index)
+{
+    return (index - (hash & (map->capacity - 1))) & (map->capacity - 1);
+}
+
+static inline aug_map_slot* aug_map_find(const aug_map* map, const aug_value* key, size_t hash)
+{
+    if(map->capacity == 0)
+        return NULL;
+
+    const size_t mask = map->capacity - 1;
+    size_t index = hash & mask;
+    for(size_t dist = 0; ; ++dist, index = (index + 1) & mask)
+    {
+        aug_map_slot* slot = &map->slots[index];
+        // Robin hood invariant, the key would have been placed before any entry closer to its ideal slot
+        if(aug_value_type(&slot->key) == AUG_NONE || aug_map_probe_distance(map, slot->hash, index) < dist)
+            return NULL;
+        if(slot->hash == hash && aug_compare(&slot->key, (aug_value*)key))
+            return slot;
+    }
+    return NULL;
+}
+
+// Places the entry without checking for an existing key. Takes ownership of the key and value references
+static inline aug_map_slot* aug_map_place(aug_map* map, aug_value key, aug_value value, size_t hash)
+{
+    const size_t mask = map->capacity - 1;
+    size_t index = hash & mask;
+    aug_map_slot entry;
+    entry.key = key;
+    entry.value = value;
+    entry.hash = hash;
+
+    aug_map_slot* placed = NULL;
+    for(size_t dist = 0; ; ++dist, index = (index + 1) & mask)
+    {
+        aug_map_slot* slot = &map->slots[index];
+        if(aug_value_type(&slot->key) == AUG_NONE)
+        {
+            *slot = entry;
+            return placed != NULL ? placed : slot;
+        }
+
+        // Displace entries that are closer to their ideal slot, then continue placing the displaced entry
+        const size_t slot_dist = aug_map_probe_distance(map, slot->hash, index);
+        if(slot_dist < dist)
+        {
+            aug_map_slot displaced = *slot;
+            *slot = entry;
+            entry = displaced;
+            dist = slot_dist;
+            if(placed == NULL)
+                placed = slot;
+        }
+    }
+    return NULL;
+}
+
+void aug_map_reserve(aug_map* map, size_t size)
+{
+    size_t capacity = map->capacity > 0 ? map->capacity : AUG_MAP_SIZE_DEFAULT;
+    while(size * 100 > capacity * AUG_MAP_LOAD_FACTOR)
+        capacity *= 2;
+    if(capacity == map->capacity)
+        return;
+
+    aug_map_slot* old_slots = map->slots;
+    const size_t old_capacity = map->capacity;
+
+    map->capacity = capacity;
+    map->slots = (aug_map_slot*)aug_heap_alloc(map->heap, sizeof(aug_map_slot) * capacity);
+    for(size_t i = 0; i < capacity; ++i)
+        map->slots[i].key = aug_none();
+
+    // Move entries using the cached hashes, references are transferred
+    for(size_t i = 0; i < old_capacity; ++i)
+    {
+        aug_map_slot* slot = &old_slots[i];
+        if(aug_value_type(&slot->key) != AUG_NONE)
+            aug_map_place(map, slot->key, slot->value, slot->hash);
+    }
+
+    if(old_slots != NULL)
+        aug_heap_free(map->heap, old_slots, sizeof(aug_map_slot) * old_capacity);
+}
+
+aug_map* aug_map_new(size_t size)
+{
+    aug_heap* heap = aug_heap_current();
+    aug_map* map = (aug_map*)aug_heap_pool_alloc(heap, AUG_POOL_MAP);
+    map->heap = heap;
+    map->slots = NULL;
+    map->capacity = 0;
+    map->ref_count = 1;
+    map->count = 0;
+    map->epoch = heap->epoch;
+    map->gc.root = -1;
+    map->gc.color = AUG_GC_BLACK;
+    if(size > 0)
+        aug_map_reserve(map, size);
+    if(heap->deferred_count > 0)
+        aug_heap_release_deferred(heap, AUG_DEFER_RELEASE_STEP);
+    return map;
+}
+
+void aug_map_incref(aug_map* map)
+{
+    if (map)
+    {
+        ++map->ref_count;
+        ++map->heap->incref_count;
+    }
+}
+
+static void aug_map_free(aug_map* map)
+{
+    if(map->slots != NULL)
+        aug_heap_free(map->heap, map->slots, sizeof(aug_map_slot) * map->capacity);
+    aug_heap_pool_free(map->heap, AUG_POOL_MAP, map);
+}
+
+// Releases an unreferenced map and its entries. Large maps release their entries incrementally
+static void aug_map_release(aug_map* map)
+{
+#if AUG_CYCLE_COLLECT
+    if(map->gc.root >= 0)
+        aug_heap_remove_root(map->heap, &map->gc);
+#endif//AUG_CYCLE_COLLECT
+#if AUG_DEFER_RELEASE_SIZE > 0
+    if(map->count > AUG_DEFER_RELEASE_SIZE && map->heap->collect)
+    {
+        aug_value value;
+        aug_value_init_pointer(&value, AUG_MAP, map);
+        aug_heap_defer(map->heap, value, 0);
+        return;
+    }
+#endif//AUG_DEFER_RELEASE_SIZE
+
+    for (size_t i = 0; i < map->capacity; ++i)
+    {
+        aug_map_slot* slot = &map->slots[i];
+        if (aug_value_type(&slot->key) != AUG_NONE)
+        {
+            aug_decref(&slot->value);
+            aug_decref(&slot->key);
+        }
+    }
+    aug_map_free(map);
+}
+
+aug_map* aug_map_decref(aug_map* map)
+{
+    if (map == NULL)
+        return NULL;
+    ++map->heap->decref_count;
+    if (--map->ref_count == 0)
+    {
+        aug_map_release(map);
+        return NULL;
+    }
+#if AUG_CYCLE_COLLECT
+    if(map->gc.root < 0 && map->heap->collect)
+    {
+        aug_value value;
+        aug_value_init_pointer(&value, AUG_MAP, map);
+        aug_heap_buffer_root(map->heap, value, &map->gc);
+    }
+#endif//AUG_CYCLE_COLLECT
+    return map;
+}
+
+static inline aug_value* aug_map_insert_hash(aug_map* map, aug_value* key, size_t hash, aug_value* data)
+{
+    aug_heap_track(map->heap, AUG_MAP, map, &map->epoch);
+    aug_map_reserve(map, map->count + 1);
+
+    aug_map_slot* slot = aug_map_place(map, *key, *data, hash);
+    aug_incref(&slot->key);
+    aug_incref(&slot->value);
+    ++map->count;
+    return &slot->value;
+}
+
+bool aug_map_insert(aug_map* map, aug_value* key, aug_value* data)
+{
+    if(!aug_map_can_hash(key) || data == NULL)
+        return false;
+
+    const size_t hash = aug_map_hash(key);
+    if(aug_map_find(map, key, hash) != NULL)
+        return false;
+
+    aug_map_insert_hash(map, key, hash, data);
+    return true;
+}
+
+bool aug_map_remove(aug_map* map, aug_value* key)
+{   
+    if(!aug_map_can_hash(key))
+        return false;
+    
+    aug_map_slot* slot = aug_map_find(map, key, aug_map_hash(key));
+    if(slot == NULL)
+        return false;
+
+    aug_heap_track(map->heap, AUG_MAP, map, &map->epoch);
+    aug_decref(&slot->key);
+    aug_decref(&slot->value);
+    --map->count;
+
+    // Shift back the following entries until an empty slot or an entry at its ideal slot
+    const size_t mask = map->capacity - 1;
+    size_t index = slot - map->slots;
+    for(;;)
+    {
+        const size_t next_index = (index + 1) & mask;
+        aug_map_slot* next = &map->slots[next_index];
+        if(aug_value_type(&next->key) == AUG_NONE || aug_map_probe_distance(map, next->hash, next_index) == 0)
+            break;
+        map->slots[index] = *next;
+        index = next_index;
+    }
+    map->slots[index].key = aug_none();
+    return true;
+}
+
+aug_value* aug_map_get(aug_map* map, aug_value* key)
+{
+    if(!aug_map_can_hash(key))
+        return NULL;
+
+    aug_map_slot* slot = aug_map_find(map, key, aug_map_hash(key));
+    return slot != NULL ? &slot->value : NULL;
+}
+
+bool aug_map_insert_or_update(aug_map* map, aug_value* key, aug_value* data)
+{
+    if(!aug_map_can_hash(key) || data == NULL)
+        return false;
+
+    const size_t hash = aug_map_hash(key);
+    aug_map_slot* slot = aug_map_find(map, key, hash);
+    if(slot != NULL)
+    {
+        aug_heap_track(map->heap, AUG_MAP, map, &map->epoch);
+        aug_decref(&slot->value);
+        slot->value = *data;
+        aug_incref(&slot->value);
+        return true;
+    }
+
+    aug_map_insert_hash(map, key, hash, data);
+    return true;
+}
+
+void aug_map_foreach(aug_map* map, aug_map_iterator* iterator, void* user_data)
+{
+    if (map == NULL)
+        return;
+
+    for (size_t i = 0; i < map->capacity; ++i)
+    {
+        aug_map_slot* slot = &map->slots[i];
+        if (aug_value_type(&slot->key) != AUG_NONE)
+            iterator(&slot->key, &slot->value, user_data);
+    }
+}
+
+aug_iterator* aug_iterator_new(aug_value* iterable)
+{
+    switch(aug_value_type(iterable))
+    {
+        case AUG_INT:
+        case AUG_STRING:
+        case AUG_ARRAY:
+        case AUG_RANGE:
+        case AUG_TYPED_ARRAY:
+        case AUG_BUFFER_VIEW:
+            break;
+        default:
+            return NULL;
+    }
+
+    aug_heap* heap = aug_heap_current();
+    aug_iterator* iterator = (aug_iterator*)aug_heap_pool_alloc(heap, AUG_POOL_ITERATOR);
+    iterator->heap = heap;
+    iterator->ref_count = 1;
+    iterator->iterable = (aug_value*)aug_heap_pool_alloc(heap, AUG_POOL_VALUE);
+    *iterator->iterable = *iterable;
+    aug_incref(iterable);
+    iterator->index = NULL;
+    return iterator;
+}
+
+aug_iterator* aug_iterator_decref(aug_iterator* iterator)
+{
+    if(iterator == NULL)
+        return NULL;
+    ++iterator->heap->decref_count;
+    if(--iterator->ref_count == 0)
+    {
+        if(iterator->index != NULL)
+            aug_heap_pool_free(iterator->heap, AUG_POOL_VALUE, iterator->index);
+        
+        aug_decref(iterator->iterable);
+        aug_heap_pool_free(iterator->heap, AUG_POOL_VALUE, iterator->iterable);
+        aug_heap_pool_free(iterator->heap, AUG_POOL_ITERATOR, iterator);
+        return NULL;    
+    }
+    return iterator;
+}
+
+void aug_iterator_incref(aug_iterator* iterator)
+{
+    if(iterator != NULL)
+    {
+        ++iterator->ref_count;
+        ++iterator->heap->incref_count;
+    }
+}
+
+bool aug_iterator_next(aug_iterator* iterator)
+{
+    if(iterator == NULL || iterator->iterable == NULL)
+        return false;
+
+    int initial_index = 0;
+    aug_value* index = iterator->index;
+    aug_value* iterable = iterator->iterable;
+    switch(aug_value_type(iterable))
+    {
+        case AUG_INT:
+        case AUG_STRING:
+        case AUG_ARRAY:
+        case AUG_TYPED_ARRAY:
+        case AUG_BUFFER_VIEW:
+            initial_index = 0;
+            break;
+        case AUG_RANGE:
+            initial_index = aug_value_range(iterable)->from;
+            break;
+        default:
+            return false;
+    }
+
+    // grab initial index
+    if(iterator->index == NULL)
+    {
+        index = (aug_value*)aug_heap_pool_alloc(iterator->heap, AUG_POOL_VALUE);
+        *index = aug_create_int(initial_index);
+    }
+    else 
+    {
+        assert(aug_value_type(index) == AUG_INT);
+        aug_value_init_int(index, AUG_INT, aug_value_int(index) + 1);
+    }
+    
+    iterator->index = index;
+    return true;
+}
+
+bool aug_iterator_get(aug_iterator* iterator, aug_value* out_element)
+{
+    if(iterator == NULL || iterator->iterable == NULL)
+        return false;
+
+    aug_value* index = iterator->index;
+    aug_value* iterable = iterator->iterable;
+    assert(aug_value_type(index) == AUG_INT);
+
+    bool success = aug_get_element(iterable, index, out_element);
+    if(!success)
+    {
+        if(aug_value_type(iterable) == AUG_INT && aug_value_int(index) <= aug_value_int(iterable))
+        {
+            *out_element = *index;
+            return true;
+        }
+
+        aug_heap_pool_free(iterator->heap, AUG_POOL_VALUE, iterator->index);
+        iterator->index = NULL;
+        return false;
+    }
+    return true;
+}
+
+aug_range* aug_range_new(int from, int to)
+{
+    aug_heap* heap = aug_heap_current();
+    aug_range* range = (aug_range*)aug_heap_pool_alloc(heap, AUG_POOL_RANGE);
+    range->heap = heap;
+    range->ref_count = 1;
+    range->from = from;
+    range->to = to;
+    return range;
+}
+
+aug_range* aug_range_decref(aug_range* range)
+{
+    if(range == NULL)
+        return NULL;
+    ++range->heap->decref_count;
+    if(--range->ref_count == 0)
+    {
+        aug_heap_pool_free(range->heap, AUG_POOL_RANGE, range);
+        return NULL;    
+    }
+    return range;
+}
+
+void aug_range_incref(aug_range* range)
+{
+    if(range != NULL)
+    {
+        ++range->ref_count;
+        ++range->heap->incref_count;
+    }
+}
+
+// COLLECTOR ============================================ COLLECTOR ========================================= COLLECTOR //
+
+// Trial deletion cycle collector. Arrays and maps decremented to a non zero count are buffered as possible roots of 
+// a cycle, and removed once released. A collection step subtracts the references between the containers reachable 
+// from the buffered roots, marking them gray. Containers with references remaining are referenced from outside of the
+// marked containers, and are restored along with the containers they reach. The others are only referenced by each 
+// other, and are released. Steps run between executions, see aug_collect, so that every reference is counted
+
+// Returns the next container child of the value, or NULL once visited all. The cursor starts at 0
+static inline aug_value* aug_gc_child(const aug_value* value, size_t* cursor)
+{
+    aug_value* child = NULL;
+    switch(aug_value_type(value))
+    {
+    case AUG_ARRAY:
+    {
+        aug_array* array = aug_value_array(value);
+        for(; *cursor < array->length && child == NULL; ++*cursor)
+        {
+            if(aug_gc_node_of(&array->buffer[*cursor]) != NULL)
+                child = &array->buffer[*cursor];
+        }
+        break;
+    }
+    case AUG_MAP:
+    {
+        // Keys are strings or ints, and are not visited
+        aug_map* map = aug_value_map(value);
+        for(; *cursor < map->capacity && child == NULL; ++*cursor)
+        {
+            aug_map_slot* slot = &map->slots[*cursor];
+            if(aug_value_type(&slot->key) != AUG_NONE && aug_gc_node_of(&slot->value) != NULL)
+                child = &slot->value;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return child;
+}
+
+// Adds to the reference count of the container. Trial deletion changes counts without updating the heap statistics
+static inline size_t aug_gc_count(const aug_value* value, int delta)
+{
+    switch(aug_value_type(value))
+    {
+    case AUG_ARRAY:
+        return (size_t)(aug_value_array(value)->ref_count += delta);
+    case AUG_MAP:
+        return aug_value_map(value)->ref_count += delta;
+    default:
+        return 0;
+    }
+}
+
+#if AUG_CYCLE_COLLECT
+// Subtracts the references of the containers reachable from the root. Returns the number of containers visited
+static size_t aug_gc_mark_gray(aug_heap* heap, aug_value root)
+{
+    size_t visits = 0;
+    aug_gc_node_of(&root)->color = AUG_GC_GRAY;
+    aug_heap_values_push(heap, &heap->gc_stack, root);
+    while(heap->gc_stack.count > 0)
+    {
+        const aug_value node = aug_heap_values_pop(&heap->gc_stack);
+        aug_value* child;
+        for(size_t cursor = 0; (child = aug_gc_child(&node, &cursor)) != NULL;)
+        {
+            aug_gc_count(child, -1);
+            aug_gc_node* gc = aug_gc_node_of(child);
+            if(gc->color != AUG_GC_GRAY)
+            {
+                gc->color = AUG_GC_GRAY;
+                aug_heap_values_push(heap, &heap->gc_stack, *child);
+            }
+        }
+        ++visits;
+    }
+    return visits;
+}
+
+// Restores the references of the containers reachable from a referenced container
+static void aug_gc_scan_black(aug_heap* heap, aug_value node)
+{
+    const size_t base = heap->gc_stack.count;
+    aug_gc_node_of(&node)->color = AUG_GC_BLACK;
+    aug_heap_values_push(heap, &heap->gc_stack, node);
+    while(heap->gc_stack.count > base)
+    {
+        node = aug_heap_values_pop(&heap->gc_stack);
+        aug_value* child;
+        for(size_t cursor = 0; (child = aug_gc_child(&node, &cursor)) != NULL;)
+        {
+            aug_gc_count(child, 1);
+            aug_gc_node* gc = aug_gc_node_of(child);
+            if(gc->color != AUG_GC_BLACK)
+            {
+                gc->color = AUG_GC_BLACK;
+                aug_heap_values_push(heap, &heap->gc_stack, *child);
+            }
+        }
+    }
+}
+
+// Colors the marked containers without remaining references white, and restores the others
+static void aug_gc_scan(aug_heap* heap, aug_value root)
+{
+    aug_heap_values_push(heap, &heap->gc_stack, root);
+    while(heap->gc_stack.count > 0)
+    {
+        const aug_value node = aug_heap_values_pop(&heap->gc_stack);
+        aug_gc_node* gc = aug_gc_node_of(&node);
+        if(gc->color != AUG_GC_GRAY)
+            continue;
+
+        if(aug_gc_count(&node, 0) > 0)
+        {
+            aug_gc_scan_black(heap, node);
+            continue;
+        }
+
+        gc->color = AUG_GC_WHITE;
+        aug_value* child;
+        for(size_t cursor = 0; (child = aug_gc_child(&node, &cursor)) != NULL;)
+        {
+            if(aug_gc_node_of(child)->color == AUG_GC_GRAY)
+                aug_heap_values_push(heap, &heap->gc_stack, *child);
+        }
+    }
+}
+
+// Gathers the white containers reachable from the root to release
+static void aug_gc_gather(aug_heap* heap, aug_value root)
+{
+    aug_gc_node* gc = aug_gc_node_of(&root);
+    if(gc->color != AUG_GC_WHITE)
+        return;
+
+    gc->color = AUG_GC_GARBAGE;
+    aug_heap_values_push(heap, &heap->gc_stack, root);
+    while(heap->gc_stack.count > 0)
+    {
+        const aug_value node = aug_heap_values_pop(&heap->gc_stack);
+        gc = aug_gc_node_of(&node);
+        if(gc->root >= 0)
+            aug_heap_remove_root(heap, gc);
+        aug_heap_values_push(heap, &heap->gc_garbage, node);
+
+        aug_value* child;
+        for(size_t cursor = 0; (child = aug_gc_child(&node, &cursor)) != NULL;)
+        {
+            aug_gc_node* child_gc = aug_gc_node_of(child);
+            if(child_gc->color == AUG_GC_WHITE)
+            {
+                child_gc->color = AUG_GC_GARBAGE;
+                aug_heap_values_push(heap, &heap->gc_stack, *child);
+            }
+        }
+    }
+}
+
+// Releases the gathered containers. The references between them are removed first, so that releasing the elements
+// only decrements the containers still in use, whose references from the garbage are restored to be decremented
+static void aug_gc_release(aug_heap* heap)
+{
+    for(size_t i = 0; i < heap->gc_garbage.count; ++i)
+    {
+        const aug_value node = heap->gc_garbage.values[i];
+        aug_value* child;
+        for(size_t cursor = 0; (child = aug_gc_child(&node, &cursor)) != NULL;)
+        {
+            if(aug_gc_node_of(child)->color == AUG_GC_GARBAGE)
+                *child = aug_none();
+            else
+                aug_gc_count(child, 1);
+        }
+    }
+
+    for(size_t i = 0; i < heap->gc_garbage.count; ++i)
+    {
+        const aug_value node = heap->gc_garbage.values[i];
+        aug_gc_node_of(&node)->color = AUG_GC_BLACK;
+        switch(aug_value_type(&node))
+        {
+        case AUG_ARRAY:
+            aug_array_release(aug_value_array(&node));
+            break;
+        case AUG_MAP:
+            aug_map_release(aug_value_map(&node));
+            break;
+        default:
+            break;
+        }
+    }
+    heap->collected_count += heap->gc_garbage.count;
+    heap->gc_garbage.count = 0;
+}
+
+// Collects the cycles of the buffered roots, most recently buffered first. Stops taking roots once the budget of 
+// visited containers is spent, 0 to take all. The containers reachable from a root are always visited in full. 
+// Returns the number of containers released
+static size_t aug_heap_collect(aug_heap* heap, size_t budget)
+{
+    size_t visits = 0;
+    while(heap->roots.count > 0 && (budget == 0 || visits < budget))
+    {
+        const aug_value root = aug_heap_values_pop(&heap->roots);
+        aug_gc_node* gc = aug_gc_node_of(&root);
+        gc->root = -1;
+
+        // Already marked from another root of the step
+        if(gc->color == AUG_GC_GRAY)
+            continue;
+        visits += aug_gc_mark_gray(heap, root);
+        aug_heap_values_push(heap, &heap->gc_marked, root);
+    }
+
+    for(size_t i = 0; i < heap->gc_marked.count; ++i)
+        aug_gc_scan(heap, heap->gc_marked.values[i]);
+    for(size_t i = 0; i < heap->gc_marked.count; ++i)
+        aug_gc_gather(heap, heap->gc_marked.values[i]);
+    heap->gc_marked.count = 0;
+
+    const size_t collected = heap->gc_garbage.count;
+    aug_gc_release(heap);
+    return collected;
+}
+#endif//AUG_CYCLE_COLLECT
+
+// Continues the deferred releases, the most recently deferred first. Stops after releasing count elements
+static void aug_heap_release_deferred(aug_heap* heap, size_t count)
+{
+    while(heap->deferred_count > 0 && count > 0)
+    {
+        // Releasing an element can defer another release, and move the deferred releases
+        aug_heap_deferred* deferred = &heap->deferred[heap->deferred_count - 1];
+        switch(aug_value_type(&deferred->value))
+        {
+        case AUG_ARRAY:
+        {
+            aug_array* array = aug_value_array(&deferred->value);
+            if(deferred->cursor == 0)
+            {
+                --heap->deferred_count;
+                aug_array_free(array);
+                break;
+            }
+            --count;
+            aug_decref(aug_array_at(array, --deferred->cursor));
+            break;
+        }
+        case AUG_MAP:
+        {
+            aug_map* map = aug_value_map(&deferred->value);
+            if(deferred->cursor == map->capacity)
+            {
+                --heap->deferred_count;
+                aug_map_free(map);
+                break;
+            }
+            aug_map_slot* slot = &map->slots[deferred->cursor++];
+            if(aug_value_type(&slot->key) != AUG_NONE)
+            {
+                --count;
+                aug_decref(&slot->value);
+                aug_decref(&slot->key);
+            }
+            break;
+        }
+        default:
+            --heap->deferred_count;
+            break;
+        }
+    }
+}
+
+// Runs a collection step of the budget, 0 to complete all deferred releases and collect all buffered roots.
+// Returns the number of containers collected
+static size_t aug_heap_step(aug_heap* heap, size_t budget)
+{
+    size_t collected = 0;
+    do
+    {
+        // Releasing can buffer roots, and collecting can defer releases
+        if(heap->deferred_count > 0)
+            aug_heap_release_deferred(heap, budget == 0 ? (size_t)-1 : budget);
+#if AUG_CYCLE_COLLECT
+        if(heap->roots.count > 0)
+            collected += aug_heap_collect(heap, budget);
+#endif//AUG_CYCLE_COLLECT
+    } while(budget == 0 && (heap->deferred_count > 0 || heap->roots.count > 0));
+    return collected;
+}
+
+// Runs a collection step once returned from an execution, if releases are deferred or enough roots are buffered
+static inline void aug_heap_execute_step(aug_heap* heap)
+{
+    if(heap->deferred_count > 0 || heap->roots.count >= AUG_CYCLE_COLLECT_THRESHOLD)
+        aug_heap_step(heap, AUG_COLLECT_BUDGET);
+}
+
+// SCRIPT ================================================= SCRIPT ============================================= SCRIPT // 
+
+aug_script* aug_script_new(aug_hashtable* globals, char* bytecode, size_t bytecode_size, aug_container* markers, aug_container* extension_names, aug_container* constants)
+{
+    aug_script* script = (aug_script*)AUG_ALLOC(sizeof(aug_script));
+    script->stack_state = NULL;
+    script->bytecode = bytecode;
+    script->bytecode_size = bytecode_size;
+
+    script->globals = globals;
+    aug_hashtable_incref(script->globals);
+
+    script->markers = markers;
+    aug_container_incref(script->markers);
+
+    script->lib_extensions = aug_hashtable_new_type(aug_extension);
+
+    script->extension_names = extension_names;
+    aug_container_incref(script->extension_names);
+
+    // Slots are resolved on the first extension call 
+    const size_t extension_count = extension_names->length;
+    script->extension_slots = (aug_extension_func**)AUG_ALLOC(sizeof(aug_extension_func*) * (extension_count > 0 ? extension_count : 1));
+    for(size_t i = 0; i < extension_count; ++i)
+        script->extension_slots[i] = NULL;
+    script->extension_version = 0;
+
+    script->constants = constants;
+    aug_container_incref(script->constants);
+
+    script->backend = AUG_BACKEND_STACK;
+
+    script->compiled_data = NULL;
+    script->compiled_size = 0;
+    script->compiled_mapped = false;
+#if AUG_JIT
+    script->jit = aug_jit_new(bytecode, bytecode_size);
+#endif//AUG_JIT
+    return script;
+}
+
+void aug_script_delete(aug_script* script)
+{
+    if (script == NULL)
+        return;
+
+    if (script->stack_state != NULL)
+    {
+        for (size_t i = 0; i < script->stack_state->length; ++i)
+        {
+            aug_value* value = aug_array_at(script->stack_state, i);
+            aug_decref(value);
+        }
+    }
+    script->globals = aug_hashtable_decref(script->globals);
+    script->stack_state = aug_array_decref(script->stack_state);
+    script->lib_extensions = aug_hashtable_decref(script->lib_extensions);
+
+    if(script->markers->ref_count == 1)
+    {
+        for(size_t i = 0; i < script->markers->length; ++i)
+        {
+            aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, script->markers, i);
+            marker->symbol_name = aug_string_decref(marker->symbol_name);
+            marker->filename = aug_string_decref(marker->filename);
+        }
+    }
+    script->markers = aug_container_decref(script->markers);
+
+    if(script->extension_names->ref_count == 1)
+    {
+        for(size_t i = 0; i < script->extension_names->length; ++i)
+            aug_string_decref(aug_container_at_type(aug_string*, script->extension_names, i));
+    }
+    script->extension_names = aug_container_decref(script->extension_names);
+    AUG_FREE(script->extension_slots);
+
+    if(script->constants->ref_count == 1)
+    {
+        for(size_t i = 0; i < script->constants->length; ++i)
+            aug_string_decref(aug_container_at_type(aug_string*, script->constants, i));
+    }
+    script->constants = aug_container_decref(script->constants);
+#if AUG_JIT
+    aug_jit_delete(script->jit);
+#endif//AUG_JIT
+
+    if (script->compiled_data != NULL)
+        aug_file_close(script->compiled_data, script->compiled_size, script->compiled_mapped);
+    else if (script->bytecode != NULL)
+        AUG_FREE(script->bytecode);
+    AUG_FREE(script);
+}
+
+// Creates a script sharing the compiled globals, markers, extension names and constants. The bytecode is copied, 
+// as it is rewritten while executing 
+aug_script* aug_script_copy(const aug_script* script)
+{
+    char* bytecode = (char*)AUG_ALLOC(script->bytecode_size > 0 ? script->bytecode_size : 1);
+    memcpy(bytecode, script->bytecode, script->bytecode_size);
+    aug_script* copy = aug_script_new(script->globals, bytecode, script->bytecode_size, script->markers, script->extension_names, script->constants);
+    copy->backend = script->backend;
+    return copy;
+}
+
+// Compiled script kept by the VM. The script is never executed, compiles return a copy
+typedef struct aug_cached_script
+{
+    aug_script* script;
+    aug_container* imports; // type aug_string*, filenames of the scripts imported when compiled
+    uint64_t stamp;         // file stamp of the script and its imports when compiled
+    int optimize_level;     // vm optimize level when compiled
+    int backend;            // vm backend when compiled
+} aug_cached_script;
+
+// Combines the script's file stamp with the stamps of its imported scripts
+uint64_t aug_cached_script_stamp(uint64_t stamp, const aug_container* imports)
+{
+    for(size_t i = 0; i < imports->length; ++i)
+    {
+        const aug_string* import = aug_container_at_type(aug_string*, imports, i);
+        stamp = aug_hash_mix(stamp * 31 + aug_file_stamp(import->buffer));
+    }
+    return stamp;
+}
+
+void aug_cached_script_free(uint8_t* data)
+{
+    aug_cached_script* cached_script = (aug_cached_script*)data;
+    aug_script_delete(cached_script->script);
+
+    if(cached_script->imports->ref_count == 1)
+    {
+        for(size_t i = 0; i < cached_script->imports->length; ++i)
+            aug_string_decref(aug_container_at_type(aug_string*, cached_script->imports, i));
+    }
+    cached_script->imports = aug_container_decref(cached_script->imports);
+}
+
+// COMPILED ============================================= COMPILED ============================================ COMPILED // 
+
+// Precompiled script file layout. All values are stored in the host byte order
+//  header     - aug_compiled_header
+//  strings    - string_count entries of (u32 length, bytes, null terminator). Indexed by the globals, markers, extensions and constants
+//  globals    - global_count entries of aug_compiled_symbol
+//  markers    - marker_count entries of aug_compiled_marker
+//  extensions - extension_count entries of i32 string index. Extension names indexed by the CALL_EXT slot
+//  constants  - constant_count entries of i32 string index. String literals indexed by PUSH_STRING
+//  bytecode   - bytecode_size bytes
+
+#define AUG_COMPILED_MAGIC "AUGC"
+
+// Bump when the file layout, instruction set or instruction encoding changes
+#define AUG_COMPILED_VERSION 9
+
+typedef struct aug_compiled_header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t opcode_count;
+    uint32_t string_count;
+    uint32_t global_count;
+    uint32_t marker_count;
+    uint32_t extension_count;
+    uint32_t constant_count;
+    uint32_t bytecode_size;
+    uint32_t backend; // aug_backend of the bytecode
+} aug_compiled_header;
+
+typedef struct aug_compiled_symbol
+{
+    int32_t name; // string index
+    int32_t scope;
+    int32_t type;
+    int32_t offset;
+    int32_t argc;
+} aug_compiled_symbol;
+
+typedef struct aug_compiled_marker
+{
+    int32_t bytecode_addr;
+    int32_t symbol_name; // string index, -1 if not set
+    int32_t filename;    // string index, -1 if not set
+    uint32_t line;
+    uint32_t col;
+    uint32_t filepos;
+    uint32_t linepos;
+} aug_compiled_marker;
+
+typedef struct aug_compiled_writer
+{
+    aug_hashtable* string_indices; // string -> int 
+    aug_container* strings;        // type const char*, weak references
+    aug_container* symbols;        // type aug_symbol
+} aug_compiled_writer;
+
+static inline int aug_compiled_string_index(aug_compiled_writer* writer, const aug_string* str)
+{
+    if(str == NULL)
+        return -1;
+
+    int* index = aug_hashtable_ptr_type(int, writer->string_indices, str->buffer);
+    if(index != NULL)
+        return *index;
+
+    index = aug_hashtable_insert_type(int, writer->string_indices, str->buffer);
+    *index = (int)writer->strings->length;
+    aug_container_push_type(const char*, writer->strings, str->buffer);
+    return *index;
+}
+
+static void aug_compiled_gather_symbol(uint8_t* data, void* user_data)
+{
+    aug_compiled_writer* writer = (aug_compiled_writer*)user_data;
+    aug_symbol symbol = *(aug_symbol*)data;
+    aug_container_push_type(aug_symbol, writer->symbols, symbol);
+    aug_compiled_string_index(writer, symbol.name);
+}
+
+bool aug_script_write(const aug_script* script, FILE* file)
+{
+    aug_compiled_writer writer;
+    writer.string_indices = aug_hashtable_new_type(int);
+    writer.strings = aug_container_new_type(const char*, 1);
+    writer.symbols = aug_container_new_type(aug_symbol, 1);
+
+    // Gather all referenced strings 
+    if(script->globals != NULL)
+        aug_hashtable_foreach(script->globals, aug_compiled_gather_symbol, &writer);
+
+    for(size_t i = 0; i < script->markers->length; ++i)
+    {
+        const aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, script->markers, i);
+        aug_compiled_string_index(&writer, marker->symbol_name);
+        aug_compiled_string_index(&writer, marker->filename);
+    }
+
+    for(size_t i = 0; i < script->extension_names->length; ++i)
+        aug_compiled_string_index(&writer, aug_container_at_type(aug_string*, script->extension_names, i));
+
+    for(size_t i = 0; i < script->constants->length; ++i)
+        aug_compiled_string_index(&writer, aug_container_at_type(aug_string*, script->constants, i));
+
+    aug_compiled_header header;
+    memcpy(header.magic, AUG_COMPILED_MAGIC, sizeof(header.magic));
+    header.version = AUG_COMPILED_VERSION;
+    header.opcode_count = AUG_OPCODE_COUNT;
+    header.string_count = (uint32_t)writer.strings->length;
+    header.global_count = (uint32_t)writer.symbols->length;
+    header.marker_count = (uint32_t)script->markers->length;
+    header.extension_count = (uint32_t)script->extension_names->length;
+    header.constant_count = (uint32_t)script->constants->length;
+    header.bytecode_size = (uint32_t)script->bytecode_size;
+    header.backend = (uint32_t)script->backend;
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for(size_t i = 0; success && i < writer.strings->length; ++i)
+    {
+        const char* str = aug_container_at_type(const char*, writer.strings, i);
+        const uint32_t length = (uint32_t)strlen(str);
+        success = fwrite(&length, sizeof(length), 1, file) == 1 && fwrite(str, 1, length + 1, file) == length + 1;
+    }
+
+    for(size_t i = 0; success && i < writer.symbols->length; ++i)
+    {
+        const aug_symbol symbol = aug_container_at_type(aug_symbol, writer.symbols, i);
+        aug_compiled_symbol compiled_symbol;
+        compiled_symbol.name = aug_compiled_string_index(&writer, symbol.name);
+        compiled_symbol.scope = symbol.scope;
+        compiled_symbol.type = symbol.type;
+        compiled_symbol.offset = symbol.offset;
+        compiled_symbol.argc = symbol.argc;
+        success = fwrite(&compiled_symbol, sizeof(compiled_symbol), 1, file) == 1;
+    }
+
+    for(size_t i = 0; success && i < script->markers->length; ++i)
+    {
+        const aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, script->markers, i);
+        aug_compiled_marker compiled_marker;
+        memset(&compiled_marker, 0, sizeof(compiled_marker));
+        compiled_marker.bytecode_addr = marker->bytecode_addr;
+        compiled_marker.symbol_name = aug_compiled_string_index(&writer, marker->symbol_name);
+        compiled_marker.filename = aug_compiled_string_index(&writer, marker->filename);
+        if(marker->filename != NULL)
+        {
+            compiled_marker.line = (uint32_t)marker->pos.line;
+            compiled_marker.col = (uint32_t)marker->pos.col;
+            compiled_marker.filepos = (uint32_t)marker->pos.filepos;
+            compiled_marker.linepos = (uint32_t)marker->pos.linepos;
+        }
+        success = fwrite(&compiled_marker, sizeof(compiled_marker), 1, file) == 1;
+    }
+
+    for(size_t i = 0; success && i < script->extension_names->length; ++i)
+    {
+        const int32_t index = aug_compiled_string_index(&writer, aug_container_at_type(aug_string*, script->extension_names, i));
+        success = fwrite(&index, sizeof(index), 1, file) == 1;
+    }
+
+    for(size_t i = 0; success && i < script->constants->length; ++i)
+    {
+        const int32_t index = aug_compiled_string_index(&writer, aug_container_at_type(aug_string*, script->constants, i));
+        success = fwrite(&index, sizeof(index), 1, file) == 1;
+    }
+
+    if(success && script->bytecode_size > 0)
+        success = fwrite(script->bytecode, 1, script->bytecode_size, file) == script->bytecode_size;
 
-                // LHS must be an element of variable
-                if(var_node->type != AUG_AST_VARIABLE && var_node->type != AUG_AST_ELEMENT)
-                {
-                    ir->valid = false;
-                    aug_log_input_error_at(input, &token.pos, "Left hand of assignment must be a variable or element");
-                    break;
-                }
+    writer.string_indices = aug_hashtable_decref(writer.string_indices);
+    writer.strings = aug_container_decref(writer.strings);
+    writer.symbols = aug_container_decref(writer.symbols);
+    return success;
+}
 
-                if(var_node->type == AUG_AST_VARIABLE)
-                {
-                    aug_string* var_token_data = var_node->token.data;
-                    assert(var_token_data);
+typedef struct aug_compiled_reader
+{
+    const char* data;
+    size_t size;
+    size_t pos;
+} aug_compiled_reader;
 
-                    const aug_symbol symbol = aug_ir_get_symbol_relative(ir, var_token_data);
-                    if(symbol.type == AUG_SYM_NONE)
-                    {
-                        ir->valid = false;
-                        aug_log_input_error_at(input, &token.pos, "Variable %s not defined", var_token_data->buffer);
-                        break;
-                    }
-                    if(symbol.type == AUG_SYM_FUNC)
-                    {
-                        ir->valid = false;
-                        aug_log_input_error_at(input, &token.pos, "Can not assign function %s to a value", var_token_data->buffer);
-                        break;
-                    }
+static inline const char* aug_compiled_read(aug_compiled_reader* reader, size_t size)
+{
+    if(size > reader->size - reader->pos)
+        return NULL;
+    const char* data = reader->data + reader->pos;
+    reader->pos += size;
+    return data;
+}
 
-                    aug_ir_mark_symbol(ir, symbol);
+static inline aug_string* aug_compiled_string_at(aug_container* strings, int32_t index)
+{
+    if(index < 0 || (size_t)index >= strings->length)
+        return NULL;
+    return aug_container_at_type(aug_string*, strings, index);
+}
 
-                    const aug_ir_operand address_operand = aug_ir_operand_from_symbol(symbol);
-                    if(symbol.scope == AUG_SYM_SCOPE_GLOBAL)
-                        aug_ir_add_operation_arg(ir, AUG_OPCODE_LOAD_GLOBAL, address_operand);
-                    else // if local or param
-                        aug_ir_add_operation_arg(ir, AUG_OPCODE_LOAD_LOCAL, address_operand);
-                }
-                else if(var_node->type == AUG_AST_ELEMENT)
-                {
-                    assert(var_node->children_size == 2); // 0[1]
-                    aug_generate_ir_pass(var_node->children[0], ir, input); // push index expr
-                    aug_generate_ir_pass(var_node->children[1], ir, input); // push container                    
-                    
-                    aug_ir_mark_source(ir, input->filename, token.pos);
-                    aug_ir_add_operation(ir, AUG_OPCODE_LOAD_ELEMENT);
-                }
-            }
-            break;
-        }
-        case AUG_AST_ARRAY:
-        {
-            for(int i = children_size - 1; i >= 0; --i)
-                aug_generate_ir_pass(children[i], ir, input);
+// Creates a script from the compiled file contents. The script takes ownership of the data on success
+aug_script* aug_script_read(char* data, size_t size, bool mapped)
+{
+    aug_compiled_reader reader;
+    reader.data = data;
+    reader.size = size;
+    reader.pos = 0;
 
-            const aug_ir_operand count_operand = aug_ir_operand_from_int(children_size);
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_ARRAY, count_operand);
-            break;
-        }
-        case AUG_AST_MAP:
-        {
-            int i;
-            for (i = children_size - 1; i >= 0; --i)
-                aug_generate_ir_pass(children[i], ir, input);
+    aug_compiled_header header;
+    const char* header_data = aug_compiled_read(&reader, sizeof(header));
+    if(header_data == NULL)
+        return NULL;
+    memcpy(&header, header_data, sizeof(header));
+    if(memcmp(header.magic, AUG_COMPILED_MAGIC, sizeof(header.magic)) != 0 
+        || header.version != AUG_COMPILED_VERSION 
+        || header.opcode_count != AUG_OPCODE_COUNT
+        || header.backend > AUG_BACKEND_REGISTER)
+        return NULL;
 
-            const aug_ir_operand count_operand = aug_ir_operand_from_int(children_size);
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_MAP, count_operand);
-            break;
-        }
-        case AUG_AST_MAP_PAIR:
+    bool valid = true;
+    aug_container* strings = aug_container_new_type(aug_string*, header.string_count + 1);
+    for(uint32_t i = 0; valid && i < header.string_count; ++i)
+    {
+        uint32_t length;
+        const char* length_data = aug_compiled_read(&reader, sizeof(length));
+        if(length_data == NULL)
         {
-            assert(children_size == 2); // 0[1]
-            aug_generate_ir_pass(children[0], ir, input); // push key
-            aug_generate_ir_pass(children[1], ir, input); // push value
+            valid = false;
             break;
         }
-        case AUG_AST_ELEMENT:
-        {
-            assert(children_size == 2); // 0[1]
-            aug_generate_ir_pass(children[0], ir, input); // push index expr
-            aug_generate_ir_pass(children[1], ir, input); // push container
+        memcpy(&length, length_data, sizeof(length));
 
-            aug_ir_mark_source(ir, input->filename, token.pos);
-            aug_ir_add_operation(ir, AUG_OPCODE_PUSH_ELEMENT);
-            break;
-        }
-        case AUG_AST_RANGE:
-        {
-            assert(children_size == 2); // 0[1]
-            aug_generate_ir_pass(children[0], ir, input); // push from 
-            aug_generate_ir_pass(children[1], ir, input); // push to
+        const char* str = aug_compiled_read(&reader, (size_t)length + 1);
+        valid = str != NULL && str[length] == '\0';
+        if(valid)
+            aug_container_push_type(aug_string*, strings, aug_string_create(str));
+    }
 
-            aug_ir_mark_source(ir, input->filename, token.pos);
-            aug_ir_add_operation(ir, AUG_OPCODE_PUSH_RANGE);
-            break;
-        }
-        case AUG_AST_STMT_EXPR:
+    aug_hashtable* globals = aug_hashtable_new_type(aug_symbol);
+    globals->free_func = aug_ir_symtable_free;
+    for(uint32_t i = 0; valid && i < header.global_count; ++i)
+    {
+        aug_compiled_symbol compiled_symbol;
+        const char* symbol_data = aug_compiled_read(&reader, sizeof(compiled_symbol));
+        aug_string* name = NULL;
+        if(symbol_data != NULL)
         {
-            int i;
-            for( i = 0; i < children_size; ++i)
-                aug_generate_ir_pass(children[i], ir, input);
-            break;
+            memcpy(&compiled_symbol, symbol_data, sizeof(compiled_symbol));
+            name = aug_compiled_string_at(strings, compiled_symbol.name);
         }
-        case AUG_AST_DISCARD:
+
+        aug_symbol* symbol = name ? aug_hashtable_insert_type(aug_symbol, globals, name->buffer) : NULL;
+        valid = symbol != NULL;
+        if(valid)
         {
-            // if evaluating an input string, do not discard global return values. These may be returned to user
-            if(input->str != NULL)
-            {
-                bool global = aug_ir_current_scope_is_global(ir); 
-                if(!global)
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_POP, aug_ir_operand_from_int(1));
-            }
-            else //executing a file, discard all unused return values
-            {
-                aug_ir_add_operation_arg(ir, AUG_OPCODE_POP, aug_ir_operand_from_int(1));
-            }
-            break;
+            symbol->name = name;
+            symbol->scope = (aug_symbol_scope)compiled_symbol.scope;
+            symbol->type = (aug_symbol_type)compiled_symbol.type;
+            symbol->offset = compiled_symbol.offset;
+            symbol->argc = compiled_symbol.argc;
+            aug_string_incref(symbol->name);
+
+            if(symbol->type == AUG_SYM_FUNC && (symbol->offset < 0 || (uint32_t)symbol->offset >= header.bytecode_size))
+                valid = false;
         }
-        case AUG_AST_STMT_DEFINE_VAR:
-        {
-            assert(token_data != NULL);
+    }
 
-            if(children_size == 1) // token = [0]
-                aug_generate_ir_pass(children[0], ir, input);
-            else
-                aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE);
+    aug_container* markers = aug_container_new_type(aug_trace_marker, header.marker_count + 1);
+    for(uint32_t i = 0; valid && i < header.marker_count; ++i)
+    {
+        aug_compiled_marker compiled_marker;
+        const char* marker_data = aug_compiled_read(&reader, sizeof(compiled_marker));
+        valid = marker_data != NULL;
+        if(valid)
+        {
+            memcpy(&compiled_marker, marker_data, sizeof(compiled_marker));
+
+            aug_trace_marker marker;
+            marker.bytecode_addr = compiled_marker.bytecode_addr;
+            marker.symbol_name = aug_compiled_string_at(strings, compiled_marker.symbol_name);
+            marker.filename = aug_compiled_string_at(strings, compiled_marker.filename);
+            memset(&marker.pos, 0, sizeof(marker.pos));
+            marker.pos.line = compiled_marker.line;
+            marker.pos.col = compiled_marker.col;
+            marker.pos.filepos = compiled_marker.filepos;
+            marker.pos.linepos = compiled_marker.linepos;
+            aug_string_incref(marker.symbol_name);
+            aug_string_incref(marker.filename);
+            aug_container_push_type(aug_trace_marker, markers, marker);
+        }
+    }
 
-            // Get variable in the current block. If it exists, error out. If it does not exist, set in table
-            aug_symbol symbol = aug_ir_get_symbol_local(ir, token_data);
-            if(symbol.type != AUG_SYM_NONE)
-            {
-                ir->valid = false;
-                aug_log_input_error_at(input, &token.pos, "Variable %s already defined in block", token_data->buffer);
-                break;
-            }
+    aug_container* extension_names = aug_container_new_type(aug_string*, header.extension_count + 1);
+    for(uint32_t i = 0; valid && i < header.extension_count; ++i)
+    {
+        int32_t index;
+        const char* index_data = aug_compiled_read(&reader, sizeof(index));
+        aug_string* name = NULL;
+        if(index_data != NULL)
+        {
+            memcpy(&index, index_data, sizeof(index));
+            name = aug_compiled_string_at(strings, index);
+        }
 
-            aug_ir_set_var(ir, token_data);
-            break;
+        valid = name != NULL;
+        if(valid)
+        {
+            aug_string_incref(name);
+            aug_container_push_type(aug_string*, extension_names, name);
         }
-        case AUG_AST_STMT_IF:
+    }
+
+    aug_container* constants = aug_container_new_type(aug_string*, header.constant_count + 1);
+    for(uint32_t i = 0; valid && i < header.constant_count; ++i)
+    {
+        int32_t index;
+        const char* index_data = aug_compiled_read(&reader, sizeof(index));
+        aug_string* str = NULL;
+        if(index_data != NULL)
         {
-            assert(children_size == 2); //if([0]) {[1]}
+            memcpy(&index, index_data, sizeof(index));
+            str = aug_compiled_string_at(strings, index);
+        }
 
-            // Evaluate expression. 
-            aug_generate_ir_pass(children[0], ir, input);
+        valid = str != NULL;
+        if(valid)
+        {
+            // Constants are not shared with the symbol names 
+            aug_string* constant = aug_string_create(str->buffer);
+            constant->constant = true;
+            aug_container_push_type(aug_string*, constants, constant);
+        }
+    }
 
-            //Jump to end if false
-            const aug_ir_operand stub_operand = aug_ir_operand_from_int(0);
-            const size_t end_block_jmp = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP_ZERO, stub_operand);
+    // Bytecode is the remainder of the file
+    char* bytecode = (char*)aug_compiled_read(&reader, header.bytecode_size);
+    valid = valid && bytecode != NULL && header.bytecode_size > 0 && reader.pos == reader.size;
 
-            // True block
-            aug_ir_push_scope(ir);
-            aug_generate_ir_pass(children[1], ir, input);
-            aug_ir_pop_scope(ir);
+    aug_script* script = NULL;
+    if(valid)
+    {
+        script = aug_script_new(globals, bytecode, header.bytecode_size, markers, extension_names, constants);
+        script->backend = (int)header.backend;
+        script->compiled_data = data;
+        script->compiled_size = size;
+        script->compiled_mapped = mapped;
+    }
 
-            const size_t end_block_addr = ir->bytecode_offset;
+    for(size_t i = 0; i < strings->length; ++i)
+        aug_string_decref(aug_container_at_type(aug_string*, strings, i));
+    strings = aug_container_decref(strings);
 
-            // Fixup stubbed block offsets
-            aug_ir_get_operation(ir, end_block_jmp)->operand = aug_ir_operand_from_int(end_block_addr);
+    globals = aug_hashtable_decref(globals);
 
-            break;
-        }
-        case AUG_AST_STMT_IF_ELSE:
+    if(markers->ref_count == 1)
+    {
+        for(size_t i = 0; i < markers->length; ++i)
         {
-            assert(children_size == 3); //if([0]) {[1]} else {[2]}
-
-            // Evaluate expression. 
-            aug_generate_ir_pass(children[0], ir, input);
-
-            //Jump to else if false
-            const aug_ir_operand stub_operand = aug_ir_operand_from_int(0);
-            const size_t else_block_jmp = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP_ZERO, stub_operand);
-
-            // True block
-            aug_ir_push_scope(ir);
-            aug_generate_ir_pass(children[1], ir, input);
-            aug_ir_pop_scope(ir);
+            aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, markers, i);
+            marker->symbol_name = aug_string_decref(marker->symbol_name);
+            marker->filename = aug_string_decref(marker->filename);
+        }
+    }
+    markers = aug_container_decref(markers);
 
-            //Jump to end after true
-            const size_t end_block_jmp = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP, stub_operand);
-            const size_t else_block_addr = ir->bytecode_offset;
+    if(extension_names->ref_count == 1)
+    {
+        for(size_t i = 0; i < extension_names->length; ++i)
+            aug_string_decref(aug_container_at_type(aug_string*, extension_names, i));
+    }
+    extension_names = aug_container_decref(extension_names);
 
-            // Else block
-            aug_ir_push_scope(ir);
-            aug_generate_ir_pass(children[2], ir, input);
-            aug_ir_pop_scope(ir);
+    if(constants->ref_count == 1)
+    {
+        for(size_t i = 0; i < constants->length; ++i)
+            aug_string_decref(aug_container_at_type(aug_string*, constants, i));
+    }
+    constants = aug_container_decref(constants);
 
-            // Tag end address
-            const size_t end_block_addr = ir->bytecode_offset;
+    return script;
+}
 
-            // Fixup stubbed block offsets
-            aug_ir_get_operation(ir, else_block_jmp)->operand = aug_ir_operand_from_int(else_block_addr);
-            aug_ir_get_operation(ir, end_block_jmp)->operand = aug_ir_operand_from_int(end_block_addr);
+// Reads the compiled file contents. If supported, the file is mapped read-only. When quickening, the mapping is 
+// writable and private, so that only the pages of the quickened instructions are copied, and the file is not modified
+static inline char* aug_compiled_open(const char* filename, size_t* size_out, bool* mapped_out)
+{
+    char* data = aug_file_open(filename, AUG_QUICKEN, size_out, mapped_out);
+    if(data != NULL && *size_out == 0)
+    {
+        aug_file_close(data, *size_out, *mapped_out);
+        return NULL;
+    }
+    return data;
+}
 
-            break;
-        }
-        case AUG_AST_STMT_WHILE:
-        {
-            assert(children_size == 2); //while [0] {[1]}
+// SNAPSHOT ============================================= SNAPSHOT ============================================ SNAPSHOT // 
 
-            aug_ir_begin_loop(ir);
+// Contents of a container before its first change since saved. Snapshots saved since the same change share the image
+typedef struct aug_snapshot_image
+{
+    int ref_count;
+    aug_type type;
+    aug_type element_type; // AUG_TYPED_ARRAY element type
+    size_t length;         // array and typed array elements, map entries or string characters
+    aug_value* values;     // array elements, or map keys and values interleaved. Referenced by the image
+    char* bytes;           // string or typed array contents
+} aug_snapshot_image;
+
+typedef struct aug_snapshot_node
+{
+    aug_value value; // container changed since saved. Referenced by the snapshot, restored in place
+    aug_snapshot_image* image;
+} aug_snapshot_node;
+
+struct aug_snapshot
+{
+    aug_heap* heap; // owning allocator, the heap of the captured values
+    aug_heap* host_heap; // default heap of the saving thread, which tracks the containers created by the host
+    size_t epoch;        // heap epoch when saved. Containers changed in a later epoch have a node, see aug_heap_track
+    aug_value* globals;
+    size_t globals_count;
+    aug_snapshot_node* nodes;
+    size_t node_count;
+    size_t node_capacity;
+    size_t* slots; // node index + 1 by container address, 0 if empty
+    size_t slot_capacity;
+};
 
-            // Evaluate expression. 
-            aug_generate_ir_pass(children[0], ir, input);
-            aug_ir_check_loop(ir);
+// Constant strings that own their buffer are not modified, and are captured by reference. Shared literals are copied 
+// by their first modification
+static inline bool aug_snapshot_is_container(const aug_value* value)
+{
+    switch(aug_value_type(value))
+    {
+    case AUG_STRING:
+        return !aug_value_string(value)->constant || aug_value_string(value)->source != NULL;
+    case AUG_ARRAY:
+    case AUG_MAP:
+    case AUG_TYPED_ARRAY:
+        return true;
+    default:
+        return false;
+    }
+}
 
-            // Loop block
-            aug_ir_push_scope(ir);
-            aug_generate_ir_pass(children[1], ir, input);
-            aug_ir_pop_scope(ir);
+static inline size_t aug_snapshot_image_value_count(const aug_snapshot_image* image)
+{
+    switch(image->type)
+    {
+    case AUG_ARRAY: return image->length;
+    case AUG_MAP:   return image->length * 2;
+    default:        return 0;
+    }
+}
 
-            aug_ir_end_loop(ir);
-            break;
-        }
-        case AUG_AST_STMT_FOR:
-        {
-            assert(children_size == 3); //for [0] in [1] {[2]}
-            assert(children[0] && children[0]->type == AUG_AST_VARIABLE);
+static inline size_t aug_snapshot_image_byte_count(const aug_snapshot_image* image)
+{
+    switch(image->type)
+    {
+    case AUG_STRING:      return image->length;
+    case AUG_TYPED_ARRAY: return image->length * (image->element_type == AUG_INT ? sizeof(int) : sizeof(float));
+    default:              return 0;
+    }
+}
 
-            // Evaluate and initialize iterable expression. 
-            aug_ir_scope* scope = aug_ir_current_scope(ir);
-            int it_offset = scope->stack_offset++;
-            it_offset = aug_ir_current_frame_local_offset(ir, it_offset, 0);
-            aug_generate_ir_pass(children[1], ir, input);
+static aug_snapshot_node* aug_snapshot_find(const aug_snapshot* snapshot, const void* ptr)
+{
+    if(snapshot->slot_capacity == 0)
+        return NULL;
 
-            aug_ir_mark_source(ir, input->filename, token.pos);
-            aug_ir_add_operation(ir, AUG_OPCODE_PUSH_ITERATOR);
+    const size_t mask = snapshot->slot_capacity - 1;
+    for(size_t i = aug_hash_mix((uint64_t)(uintptr_t)ptr) & mask; snapshot->slots[i] != 0; i = (i + 1) & mask)
+    {
+        aug_snapshot_node* node = &snapshot->nodes[snapshot->slots[i] - 1];
+        if(aug_value_pointer(&node->value) == ptr)
+            return node;
+    }
+    return NULL;
+}
 
-            // Top of the loop.
-            aug_ir_begin_loop(ir);
+static void aug_snapshot_insert_slot(aug_snapshot* snapshot, size_t node_index)
+{
+    const size_t mask = snapshot->slot_capacity - 1;
+    size_t i = aug_hash_mix((uint64_t)(uintptr_t)aug_value_pointer(&snapshot->nodes[node_index].value)) & mask;
+    while(snapshot->slots[i] != 0)
+        i = (i + 1) & mask;
+    snapshot->slots[i] = node_index + 1;
+}
 
-            aug_ir_push_scope(ir);
+// Adds the container as a node. The snapshot takes the reference
+static void aug_snapshot_push_node(aug_snapshot* snapshot, aug_value value)
+{
+    aug_heap* heap = snapshot->heap;
+    if(snapshot->node_count == snapshot->node_capacity)
+    {
+        const size_t capacity = snapshot->node_capacity > 0 ? snapshot->node_capacity * 2 : 16;
+        snapshot->nodes = (aug_snapshot_node*)aug_heap_realloc(heap, snapshot->nodes, 
+            sizeof(aug_snapshot_node) * snapshot->node_capacity, sizeof(aug_snapshot_node) * capacity);
+        snapshot->node_capacity = capacity;
+    }
 
-            // initialize the variable
-            aug_string* var_token_data = children[0]->token.data; 
-            aug_ir_set_var(ir, var_token_data);
-            aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE); // initialize the slot for the var
+    // Keep the address table at most half full
+    if((snapshot->node_count + 1) * 2 > snapshot->slot_capacity)
+    {
+        aug_heap_free(heap, snapshot->slots, sizeof(size_t) * snapshot->slot_capacity);
+        snapshot->slot_capacity = snapshot->slot_capacity > 0 ? snapshot->slot_capacity * 2 : 32;
+        snapshot->slots = (size_t*)aug_heap_alloc(heap, sizeof(size_t) * snapshot->slot_capacity);
+        memset(snapshot->slots, 0, sizeof(size_t) * snapshot->slot_capacity);
+        for(size_t i = 0; i < snapshot->node_count; ++i)
+            aug_snapshot_insert_slot(snapshot, i);
+    }
 
-            aug_symbol var_symbol = aug_ir_get_symbol_relative(ir, var_token_data);
+    aug_snapshot_node* node = &snapshot->nodes[snapshot->node_count];
+    node->value = value;
+    node->image = NULL;
+    aug_snapshot_insert_slot(snapshot, snapshot->node_count++);
+}
 
-            //Move the iterator, and check the loop
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_ITERATE, aug_ir_operand_from_int(it_offset));
-            aug_ir_check_loop(ir);
+static inline void aug_snapshot_add(aug_snapshot* snapshot, const aug_value* value)
+{
+    if(!aug_snapshot_is_container(value) || aug_snapshot_find(snapshot, aug_value_pointer(value)) != NULL)
+        return;
+    aug_value node_value = *value;
+    aug_incref(&node_value);
+    aug_snapshot_push_node(snapshot, node_value);
+}
 
-            // If success, the iterator pushes the element value, load this into local
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_LOAD_LOCAL, aug_ir_operand_from_symbol(var_symbol));
+static aug_snapshot_image* aug_snapshot_image_new(aug_heap* heap, aug_type type, aug_type element_type, size_t length)
+{
+    aug_snapshot_image* image = (aug_snapshot_image*)aug_heap_alloc(heap, sizeof(aug_snapshot_image));
+    image->ref_count = 1;
+    image->type = type;
+    image->element_type = element_type;
+    image->length = length;
 
-            // Loop block
-            aug_generate_ir_pass(children[2], ir, input);
+    const size_t value_count = aug_snapshot_image_value_count(image);
+    image->values = value_count > 0 ? (aug_value*)aug_heap_alloc(heap, sizeof(aug_value) * value_count) : NULL;
+    for(size_t i = 0; i < value_count; ++i)
+        image->values[i] = aug_none();
 
-            aug_ir_pop_scope(ir);
+    const size_t byte_count = aug_snapshot_image_byte_count(image);
+    image->bytes = byte_count > 0 ? (char*)aug_heap_alloc(heap, byte_count) : NULL;
+    return image;
+}
 
-            aug_ir_end_loop(ir);
+static void aug_snapshot_image_decref(aug_heap* heap, aug_snapshot_image* image)
+{
+    if(image == NULL || --image->ref_count > 0)
+        return;
 
-            // pop the temporary iterator and iteration temp slot to restore stack (2)
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_POP, aug_ir_operand_from_int(2));
+    const size_t value_count = aug_snapshot_image_value_count(image);
+    for(size_t i = 0; i < value_count; ++i)
+        aug_decref(&image->values[i]);
+    if(image->values != NULL)
+        aug_heap_free(heap, image->values, sizeof(aug_value) * value_count);
+    if(image->bytes != NULL)
+        aug_heap_free(heap, image->bytes, aug_snapshot_image_byte_count(image));
+    aug_heap_free(heap, image, sizeof(aug_snapshot_image));
+}
 
-            scope = aug_ir_current_scope(ir);
-            scope->stack_offset--; // remove iterator from stack
-            break;
-        }
-        case AUG_AST_BREAK:
+static aug_snapshot_image* aug_snapshot_image_capture(aug_heap* heap, const aug_value* value)
+{
+    aug_snapshot_image* image = NULL;
+    switch(aug_value_type(value))
+    {
+    case AUG_STRING:
+    {
+        const aug_string* string = aug_value_string(value);
+        image = aug_snapshot_image_new(heap, AUG_STRING, AUG_NONE, string->length);
+        if(string->length > 0)
+            memcpy(image->bytes, string->buffer, string->length);
+        break;
+    }
+    case AUG_ARRAY:
+    {
+        const aug_array* array = aug_value_array(value);
+        image = aug_snapshot_image_new(heap, AUG_ARRAY, AUG_NONE, array->length);
+        for(size_t i = 0; i < array->length; ++i)
         {
-            if(!aug_ir_break_loop(ir))
-            {
-                ir->valid = false;
-                aug_log_input_error_at(input, &token.pos, "Break statement must be inside loop");
-            }
-            break;
+            image->values[i] = array->buffer[i];
+            aug_incref(&image->values[i]);
         }
-        case AUG_AST_CONTINUE:
+        break;
+    }
+    case AUG_MAP:
+    {
+        const aug_map* map = aug_value_map(value);
+        image = aug_snapshot_image_new(heap, AUG_MAP, AUG_NONE, map->count);
+        aug_value* entry = image->values;
+        for(size_t i = 0; i < map->capacity; ++i)
         {
-            if(!aug_ir_continue_loop(ir))
-            {
-                ir->valid = false;
-                aug_log_input_error_at(input, &token.pos, "Continue statement must be inside loop");
-            }
+            const aug_map_slot* slot = &map->slots[i];
+            if(aug_value_type(&slot->key) == AUG_NONE)
+                continue;
+            entry[0] = slot->key;
+            entry[1] = slot->value;
+            aug_incref(&entry[0]);
+            aug_incref(&entry[1]);
+            entry += 2;
+        }
+        break;
+    }
+    case AUG_TYPED_ARRAY:
+    {
+        const aug_typed_array* array = aug_value_typed_array(value);
+        image = aug_snapshot_image_new(heap, AUG_TYPED_ARRAY, array->element_type, array->length);
+        if(array->length > 0)
+            memcpy(image->bytes, array->buffer, aug_snapshot_image_byte_count(image));
+        break;
+    }
+    default:
+        break;
+    }
+    return image;
+}
+
+// Rewrites the container's contents from the image
+static void aug_snapshot_image_apply(const aug_snapshot_image* image, aug_value* value)
+{
+    if(image->type != aug_value_type(value))
+        return;
+
+    switch(image->type)
+    {
+    case AUG_STRING:
+    {
+        aug_string* string = aug_value_string(value);
+        if(!aug_string_modify(string))
             break;
+        if(image->length + 1 > string->capacity)
+            aug_string_resize(string, image->length + 1);
+        if(image->length > 0)
+            memcpy(string->buffer, image->bytes, image->length);
+        string->buffer[image->length] = '\0';
+        string->length = image->length;
+        string->hash = 0;
+        break;
+    }
+    case AUG_ARRAY:
+    {
+        aug_array* array = aug_value_array(value);
+        for(size_t i = 0; i < array->length; ++i)
+            aug_decref(&array->buffer[i]);
+        if(image->length > array->capacity)
+            aug_array_reserve(array, image->length);
+        for(size_t i = 0; i < image->length; ++i)
+        {
+            array->buffer[i] = image->values[i];
+            aug_incref(&array->buffer[i]);
         }
-        case AUG_AST_FUNC_CALL:
+        array->length = image->length;
+        break;
+    }
+    case AUG_MAP:
+    {
+        aug_map* map = aug_value_map(value);
+        for(size_t i = 0; i < map->capacity; ++i)
         {
-            assert(token_data != NULL); // func name is token data
-            const int arg_count = children_size;
+            aug_map_slot* slot = &map->slots[i];
+            if(aug_value_type(&slot->key) == AUG_NONE)
+                continue;
+            aug_decref(&slot->key);
+            aug_decref(&slot->value);
+            slot->key = aug_none();
+        }
+        map->count = 0;
+        for(size_t i = 0; i < image->length; ++i)
+            aug_map_insert(map, &image->values[i * 2], &image->values[i * 2 + 1]);
+        break;
+    }
+    case AUG_TYPED_ARRAY:
+    {
+        aug_typed_array* array = aug_value_typed_array(value);
+        if(array->element_type != image->element_type)
+            break;
+        aug_typed_array_resize(array, image->length);
+        if(image->length > 0)
+            memcpy(array->buffer, image->bytes, aug_snapshot_image_byte_count(image));
+        break;
+    }
+    default:
+        break;
+    }
+}
 
-            const aug_symbol symbol = aug_ir_get_symbol(ir, token_data);
-            if(symbol.type != AUG_SYM_NONE)
-            {
-                // If the symbol is a user defined function, check arg count.
-                if(symbol.type == AUG_SYM_FUNC && symbol.argc != arg_count)
-                {
-                    ir->valid = false;
-                    aug_log_input_error_at(input, &token.pos, "Function Call %s passed %d arguments, expected %d", 
-                        token_data->buffer, arg_count, symbol.argc);
-                }
-                else
-                {
-                    // offset to account for the pushed base
-                    size_t push_frame = aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL_FRAME, aug_ir_operand_from_int(0));
+static aug_snapshot* aug_snapshot_new(aug_heap* heap, size_t globals_count)
+{
+    aug_snapshot* snapshot = (aug_snapshot*)aug_heap_alloc(heap, sizeof(aug_snapshot));
+    snapshot->heap = heap;
+    snapshot->globals_count = globals_count;
+    snapshot->globals = globals_count > 0 ? (aug_value*)aug_heap_alloc(heap, sizeof(aug_value) * globals_count) : NULL;
+    for(size_t i = 0; i < globals_count; ++i)
+        snapshot->globals[i] = aug_none();
+    snapshot->host_heap = NULL;
+    snapshot->epoch = 0;
+    snapshot->nodes = NULL;
+    snapshot->node_count = 0;
+    snapshot->node_capacity = 0;
+    snapshot->slots = NULL;
+    snapshot->slot_capacity = 0;
+    return snapshot;
+}
 
-                    // Push arguments onto stack
-                    int i;
-                    for(i = 0; i < children_size; ++ i)
-                        aug_generate_ir_pass(children[i], ir, input);
+// Copies the container to the open snapshots saved since its last change, before it is changed again. Snapshots of 
+// the same VM share the image. Snapshots saved before the container was created do not reach it, and are skipped
+static void aug_snapshot_track(aug_heap* heap, aug_type type, void* container, size_t* epoch)
+{
+    aug_value value;
+    aug_value_init_pointer(&value, type, container);
 
-                    // TODO: Push arg count, and have the function body check that arg count matches in the vm runtime
-                    aug_ir_operand arg_count = aug_ir_operand_from_int(children_size);
-                    aug_ir_add_operation_arg(ir, AUG_OPCODE_ARG_COUNT, arg_count);
-                                        
-                    if(symbol.type == AUG_SYM_FUNC)  
-                    {
-                        aug_ir_mark_symbol(ir, symbol);
+    aug_snapshot_image* image = NULL;
+    aug_heap* image_heap = NULL;
+    for(size_t i = heap->snapshot_count; i > 0 && heap->snapshots[i - 1]->epoch >= *epoch; --i)
+    {
+        aug_snapshot* snapshot = heap->snapshots[i - 1];
+        if(aug_snapshot_find(snapshot, container) != NULL)
+            continue;
 
-                        aug_ir_operand address_operand = aug_ir_operand_from_symbol(symbol);
-                        aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL, address_operand);
-                    }
-                    if(symbol.type == AUG_SYM_VAR)
-                    {
-                        const aug_symbol var_symbol = aug_ir_get_symbol_relative(ir, token_data);
-                        aug_ir_mark_symbol(ir, var_symbol);
+        if(image == NULL || image_heap != snapshot->heap)
+        {
+            image = aug_snapshot_image_capture(snapshot->heap, &value);
+            image_heap = snapshot->heap;
+        }
+        else
+            ++image->ref_count;
 
-                        aug_ir_operand address_operand = aug_ir_operand_from_symbol(var_symbol);
-                        if(var_symbol.scope == AUG_SYM_SCOPE_GLOBAL)
-                            aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL_GLOBAL, address_operand);
-                        else // if local or param
-                            aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL_LOCAL, address_operand);
-                    }
-                    
-                    // fixup the return address to after the call
-                    aug_ir_get_operation(ir, push_frame)->operand = aug_ir_operand_from_int(ir->bytecode_offset);
-                }
-                break;
-            }
+        aug_value node_value = value;
+        aug_incref(&node_value);
+        aug_snapshot_push_node(snapshot, node_value);
+        snapshot->nodes[snapshot->node_count - 1].image = image;
+    }
+    *epoch = heap->epoch;
+}
 
-            for(int i = arg_count - 1; i >= 0; --i)
-                aug_generate_ir_pass(children[i], ir, input);
+// Tracks the container before it is restored. Returns false if it is unchanged since the epoch
+static bool aug_snapshot_track_value(const aug_value* value, size_t epoch)
+{
+    switch(aug_value_type(value))
+    {
+    case AUG_STRING:
+    {
+        aug_string* string = aug_value_string(value);
+        if(string->epoch <= epoch)
+            return false;
+        aug_heap_track(string->heap, AUG_STRING, string, &string->epoch);
+        return true;
+    }
+    case AUG_ARRAY:
+    {
+        aug_array* array = aug_value_array(value);
+        if(array->epoch <= epoch)
+            return false;
+        aug_heap_track(array->heap, AUG_ARRAY, array, &array->epoch);
+        return true;
+    }
+    case AUG_MAP:
+    {
+        aug_map* map = aug_value_map(value);
+        if(map->epoch <= epoch)
+            return false;
+        aug_heap_track(map->heap, AUG_MAP, map, &map->epoch);
+        return true;
+    }
+    case AUG_TYPED_ARRAY:
+    {
+        aug_typed_array* array = aug_value_typed_array(value);
+        if(array->epoch <= epoch)
+            return false;
+        aug_heap_track(array->heap, AUG_TYPED_ARRAY, array, &array->epoch);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
 
-            // push func name then call ext
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_PUSH_STRING, aug_ir_operand_from_str(token_data));
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL_EXT, aug_ir_operand_from_int(arg_count));
-            break;
-        }
-        case AUG_AST_FUNC_CALL_UNNAMED:
-        {
-            assert(children_size >= 1); 
-            const int arg_count = children_size - 1; // off by one since first child is the value to push onto the stack to be called
+static void aug_snapshot_list_push(aug_heap* heap, aug_snapshot* snapshot)
+{
+    if(heap->snapshot_count == heap->snapshot_capacity)
+    {
+        const size_t capacity = heap->snapshot_capacity > 0 ? heap->snapshot_capacity * 2 : 8;
+        heap->snapshots = (aug_snapshot**)aug_heap_realloc(heap, heap->snapshots, 
+            sizeof(aug_snapshot*) * heap->snapshot_capacity, sizeof(aug_snapshot*) * capacity);
+        heap->snapshot_capacity = capacity;
+    }
+    heap->snapshots[heap->snapshot_count++] = snapshot;
+}
 
-            // offset to account for the pushed base
-            size_t push_frame = aug_ir_add_operation_arg(ir, AUG_OPCODE_CALL_FRAME, aug_ir_operand_from_int(0));
+// Frees the list with the last snapshot, as the default heap is never deleted
+static void aug_snapshot_list_remove(aug_heap* heap, aug_snapshot* snapshot)
+{
+    for(size_t i = 0; i < heap->snapshot_count; ++i)
+    {
+        if(heap->snapshots[i] != snapshot)
+            continue;
+        memmove(heap->snapshots + i, heap->snapshots + i + 1, sizeof(aug_snapshot*) * (heap->snapshot_count - i - 1));
+        --heap->snapshot_count;
+        break;
+    }
+    if(heap->snapshot_count == 0 && heap->snapshots != NULL)
+    {
+        aug_heap_free(heap, heap->snapshots, sizeof(aug_snapshot*) * heap->snapshot_capacity);
+        heap->snapshots = NULL;
+        heap->snapshot_capacity = 0;
+    }
+}
 
-            // Push arguments onto stack
-            for(int i = 1; i < children_size; ++i)
-                aug_generate_ir_pass(children[i], ir, input);
+// Begins a new epoch, containers changed from then on are copied to the snapshot. The containers created by the host 
+// outside of calls, such as string arguments, belong to the default heap, which begins the same epoch
+static void aug_snapshot_open(aug_snapshot* snapshot)
+{
+    aug_heap* heap = snapshot->heap;
+    aug_heap* host_heap = &aug_heap_default;
+    const size_t epoch = heap->epoch > host_heap->epoch ? heap->epoch : host_heap->epoch;
+    snapshot->epoch = epoch;
+    heap->epoch = epoch + 1;
+    aug_snapshot_list_push(heap, snapshot);
+    if(host_heap != heap)
+    {
+        host_heap->epoch = epoch + 1;
+        snapshot->host_heap = host_heap;
+        aug_snapshot_list_push(host_heap, snapshot);
+    }
+}
 
-            // First arg is the value of the function to call 
-            aug_generate_ir_pass(children[0], ir, input);
+static void aug_snapshot_close(aug_snapshot* snapshot)
+{
+    aug_snapshot_list_remove(snapshot->heap, snapshot);
+    if(snapshot->host_heap != NULL)
+        aug_snapshot_list_remove(snapshot->host_heap, snapshot);
+}
 
-            // TODO: Push arg count, and have the function body check that arg count matches in the vm runtime
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_ARG_COUNT, aug_ir_operand_from_int(arg_count));
-            aug_ir_add_operation(ir, AUG_OPCODE_CALL_TOP);
+// Captures the globals and the containers reachable from them, to serialize the snapshot. Containers changed since 
+// share the snapshot's image, the others are copied. Nodes are visited in the order found, the node list is the work queue
+static aug_snapshot* aug_snapshot_expand(const aug_snapshot* snapshot)
+{
+    aug_heap* heap = snapshot->heap;
+    aug_snapshot* expanded = aug_snapshot_new(heap, snapshot->globals_count);
+    for(size_t i = 0; i < snapshot->globals_count; ++i)
+    {
+        expanded->globals[i] = snapshot->globals[i];
+        aug_incref(&expanded->globals[i]);
+        aug_snapshot_add(expanded, &snapshot->globals[i]);
+    }
 
-            // fixup the return address to after the call
-            aug_ir_get_operation(ir, push_frame)->operand = aug_ir_operand_from_int(ir->bytecode_offset);
+    for(size_t i = 0; i < expanded->node_count; ++i)
+    {
+        const aug_value* value = &expanded->nodes[i].value;
+        const aug_snapshot_node* changed = aug_snapshot_find(snapshot, aug_value_pointer(value));
 
-            break;
-        }
-        case AUG_AST_RETURN:
-        {
-            const aug_ir_operand offset = aug_ir_operand_from_int(aug_ir_calling_offset(ir));
-            if(children_size == 1) //return [0];
-            {
-                aug_generate_ir_pass(children[0], ir, input);
-                aug_ir_add_operation_arg(ir, AUG_OPCODE_RETURN_FUNC, offset);
-            }
-            else
-            {
-                aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE);
-                aug_ir_add_operation_arg(ir, AUG_OPCODE_RETURN_FUNC, offset);
-            }
-            break;
-        }
-        case AUG_AST_PARAM:
-        {
-            assert(token_data != NULL);
-            aug_ir_set_param(ir, token_data);
-            break;
-        }
-        case AUG_AST_PARAM_LIST:
-        {
-            for(int i = 0; i < children_size; ++ i)
-                aug_generate_ir_pass(children[i], ir, input);
-            break;
+        aug_snapshot_image* image;
+        if(changed != NULL)
+        {
+            image = changed->image;
+            ++image->ref_count;
         }
-        case AUG_AST_STMT_DEFINE_FUNC:
+        else
+            image = aug_snapshot_image_capture(heap, value);
+        expanded->nodes[i].image = image;
+
+        const size_t value_count = aug_snapshot_image_value_count(image);
+        for(size_t j = 0; j < value_count; ++j)
+            aug_snapshot_add(expanded, &image->values[j]);
+    }
+    return expanded;
+}
+
+// Restores the containers, then the globals. Maps are restored last, as string keys must be restored to be hashed. 
+// Restoring is a change, which the other open snapshots copy first
+static void aug_snapshot_apply(aug_snapshot* snapshot, aug_value* globals, bool changed_only)
+{
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(size_t i = 0; i < snapshot->node_count; ++i)
         {
-            assert(token_data != NULL && children_size == 2); //func token [0] {[1]};
+            aug_value* value = &snapshot->nodes[i].value;
+            if((aug_value_type(value) == AUG_MAP) != (pass == 1))
+                continue;
 
-            // Jump over the func def
-            const aug_ir_operand stub_operand = aug_ir_operand_from_int(0);
-            const size_t end_block_jmp = aug_ir_add_operation_arg(ir, AUG_OPCODE_JUMP, stub_operand);
+            if(!aug_snapshot_track_value(value, snapshot->epoch) && changed_only)
+                continue;
+            aug_snapshot_image_apply(snapshot->nodes[i].image, value);
+        }
+    }
 
-            aug_ast* params = children[0];
-            assert(params && params->type == AUG_AST_PARAM_LIST);
-            const int param_count = params->children_size;
+    for(size_t i = 0; globals != NULL && i < snapshot->globals_count; ++i)
+    {
+        aug_value prev = globals[i];
+        globals[i] = snapshot->globals[i];
+        aug_incref(&globals[i]);
+        aug_decref(&prev);
+    }
+}
 
-            // Gather global pass handles global symbol table. The offset however is incorrect, this pass will fixup the function offset  
-            bool update = aug_ir_current_scope_is_global(ir); 
+static void aug_snapshot_free(aug_snapshot* snapshot)
+{
+    aug_heap* heap = snapshot->heap;
+    for(size_t i = 0; i < snapshot->globals_count; ++i)
+        aug_decref(&snapshot->globals[i]);
+    for(size_t i = 0; i < snapshot->node_count; ++i)
+    {
+        aug_snapshot_image_decref(heap, snapshot->nodes[i].image);
+        aug_decref(&snapshot->nodes[i].value);
+    }
+    if(snapshot->globals != NULL)
+        aug_heap_free(heap, snapshot->globals, sizeof(aug_value) * snapshot->globals_count);
+    if(snapshot->nodes != NULL)
+        aug_heap_free(heap, snapshot->nodes, sizeof(aug_snapshot_node) * snapshot->node_capacity);
+    if(snapshot->slots != NULL)
+        aug_heap_free(heap, snapshot->slots, sizeof(size_t) * snapshot->slot_capacity);
+    aug_heap_free(heap, snapshot, sizeof(aug_snapshot));
+}
 
-            // Try to set function in symbol table. Func name is token
-            if(!aug_ir_set_func(ir, token_data, param_count, update))
-            {
-                ir->valid = false;
-                aug_log_input_error_at(input, &token.pos, "Function %s already defined", token_data->buffer);
-                break;
-            }
+// Serialized snapshot layout. All values are stored in the host byte order
+//  header  - aug_snapshot_header
+//  types   - node_count entries of (u8 type, u8 element type)
+//  globals - global_count values
+//  nodes   - node_count entries of (u32 length, contents). Arrays store length values, maps length key and value pairs,
+//            strings and typed arrays their bytes
+// Values are a u8 type, then i32 for bools, chars, ints and functions, f32 for floats, i32 from and to for ranges, 
+// and u32 node index for containers. Constant strings are stored inline, as AUG_SNAPSHOT_INLINE, u32 length and bytes
 
-            // Parameter frame
-            aug_ir_push_scope(ir);
-            aug_generate_ir_pass(children[0], ir, input);
+#define AUG_SNAPSHOT_MAGIC "AUGS"
+#define AUG_SNAPSHOT_VERSION 1
+#define AUG_SNAPSHOT_INLINE UINT32_MAX
 
-            aug_ir_mark_symbol(ir, aug_ir_get_symbol(ir, token_data));
+typedef struct aug_snapshot_header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t global_count;
+    uint32_t node_count;
+} aug_snapshot_header;
 
-            // TODO: Argument count check
-            aug_ir_operand param_count_arg = aug_ir_operand_from_int(param_count);
-            aug_ir_add_operation_arg(ir, AUG_OPCODE_ENTER_FUNC, param_count_arg);
+// Counts the bytes written, and copies them while they fit in the buffer
+typedef struct aug_snapshot_writer
+{
+    char* buffer;
+    size_t size;
+    size_t pos;
+} aug_snapshot_writer;
 
-            // Function block frame
-            aug_ir_push_frame(ir, param_count);
-            aug_generate_ir_pass(children[1], ir, input);
+static inline void aug_snapshot_write(aug_snapshot_writer* writer, const void* data, size_t size)
+{
+    if(writer->buffer != NULL && size > 0 && size <= writer->size && writer->pos <= writer->size - size)
+        memcpy(writer->buffer + writer->pos, data, size);
+    writer->pos += size;
+}
 
-            // Ensure there is a return
-            if(aug_ir_last_operation(ir)->opcode != AUG_OPCODE_RETURN_FUNC)
-            {
-                const aug_ir_operand offset = aug_ir_operand_from_int(aug_ir_calling_offset(ir));
-                aug_ir_add_operation(ir, AUG_OPCODE_PUSH_NONE);
-                aug_ir_add_operation_arg(ir, AUG_OPCODE_RETURN_FUNC, offset);
-            }
+static inline void aug_snapshot_write_u32(aug_snapshot_writer* writer, uint32_t data)
+{
+    aug_snapshot_write(writer, &data, sizeof(data));
+}
 
-            aug_ir_pop_frame(ir);
-            aug_ir_pop_scope(ir);
+static inline void aug_snapshot_write_i32(aug_snapshot_writer* writer, int32_t data)
+{
+    aug_snapshot_write(writer, &data, sizeof(data));
+}
 
-            // fixup jump operand
-            const size_t end_block_addr = ir->bytecode_offset;
-            aug_ir_get_operation(ir, end_block_jmp)->operand = aug_ir_operand_from_int(end_block_addr);
+static bool aug_snapshot_write_value(aug_snapshot_writer* writer, const aug_snapshot* snapshot, const aug_value* value)
+{
+    const uint8_t type = (uint8_t)aug_value_type(value);
+    aug_snapshot_write(writer, &type, sizeof(type));
 
-            break;
+    switch(aug_value_type(value))
+    {
+    case AUG_NONE:
+        return true;
+    case AUG_BOOL:
+        aug_snapshot_write_i32(writer, aug_value_bool(value) ? 1 : 0);
+        return true;
+    case AUG_CHAR:
+        aug_snapshot_write_i32(writer, aug_value_char(value));
+        return true;
+    case AUG_INT:
+    case AUG_FUNCTION:
+        aug_snapshot_write_i32(writer, aug_value_int(value));
+        return true;
+    case AUG_FLOAT:
+    {
+        const float data = aug_value_float(value);
+        aug_snapshot_write(writer, &data, sizeof(data));
+        return true;
+    }
+    case AUG_RANGE:
+        aug_snapshot_write_i32(writer, aug_value_range(value)->from);
+        aug_snapshot_write_i32(writer, aug_value_range(value)->to);
+        return true;
+    case AUG_STRING:
+    case AUG_ARRAY:
+    case AUG_MAP:
+    case AUG_TYPED_ARRAY:
+    {
+        if(!aug_snapshot_is_container(value))
+        {
+            const aug_string* string = aug_value_string(value);
+            aug_snapshot_write_u32(writer, AUG_SNAPSHOT_INLINE);
+            aug_snapshot_write_u32(writer, (uint32_t)string->length);
+            aug_snapshot_write(writer, string->buffer, string->length);
+            return true;
         }
-        default:
-            break;
+        const aug_snapshot_node* node = aug_snapshot_find(snapshot, aug_value_pointer(value));
+        if(node == NULL)
+            return false;
+        aug_snapshot_write_u32(writer, (uint32_t)(node - snapshot->nodes));
+        return true;
+    }
+    default:
+        return false;
     }
 }
 
-aug_ir* aug_generate_ir(aug_vm* vm, aug_ast* root, aug_input* input)
+static size_t aug_snapshot_write_all(const aug_snapshot* snapshot, aug_snapshot_writer* writer)
 {
-    if(root == NULL || input == NULL)
-        return NULL;
+    aug_snapshot_header header;
+    memcpy(header.magic, AUG_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = AUG_SNAPSHOT_VERSION;
+    header.global_count = (uint32_t)snapshot->globals_count;
+    header.node_count = (uint32_t)snapshot->node_count;
+    aug_snapshot_write(writer, &header, sizeof(header));
 
-    // Generate IR
-    aug_ir* ir = aug_ir_new();
+    for(size_t i = 0; i < snapshot->node_count; ++i)
+    {
+        const aug_snapshot_image* image = snapshot->nodes[i].image;
+        const uint8_t types[2] = {(uint8_t)image->type, (uint8_t)image->element_type};
+        aug_snapshot_write(writer, types, sizeof(types));
+    }
 
-    aug_ir_push_frame(ir, 0);  // push global frame
-    aug_generate_ir_pass(root, ir, input);
-    
-    // Signal to VM to exit
-    aug_ir_add_operation(ir, AUG_OPCODE_EXIT);
-    aug_ir_pop_frame(ir); // pop global frame
-    return ir;
+    for(size_t i = 0; i < snapshot->globals_count; ++i)
+    {
+        if(!aug_snapshot_write_value(writer, snapshot, &snapshot->globals[i]))
+            return 0;
+    }
+
+    for(size_t i = 0; i < snapshot->node_count; ++i)
+    {
+        const aug_snapshot_image* image = snapshot->nodes[i].image;
+        aug_snapshot_write_u32(writer, (uint32_t)image->length);
+        const size_t value_count = aug_snapshot_image_value_count(image);
+        for(size_t j = 0; j < value_count; ++j)
+        {
+            if(!aug_snapshot_write_value(writer, snapshot, &image->values[j]))
+                return 0;
+        }
+        aug_snapshot_write(writer, image->bytes, aug_snapshot_image_byte_count(image));
+    }
+    return writer->pos;
 }
 
-char* aug_generate_bytecode(aug_ir* ir)
-{  
-    assert(ir != NULL && ir->operations != NULL);
+static bool aug_snapshot_read_i32(aug_compiled_reader* reader, int32_t* out)
+{
+    const char* data = aug_compiled_read(reader, sizeof(int32_t));
+    if(data == NULL)
+        return false;
+    memcpy(out, data, sizeof(int32_t));
+    return true;
+}
 
-    if (!ir->valid)
+// Reads a value referencing the snapshot's nodes. The value is referenced by the caller
+static bool aug_snapshot_read_value(aug_compiled_reader* reader, const aug_snapshot* snapshot, aug_value* out)
+{
+    *out = aug_none();
+    const char* type_data = aug_compiled_read(reader, sizeof(uint8_t));
+    if(type_data == NULL)
+        return false;
+
+    int32_t data = 0;
+    const aug_type type = (aug_type)(uint8_t)*type_data;
+    switch(type)
+    {
+    case AUG_NONE:
+        return true;
+    case AUG_BOOL:
+        if(!aug_snapshot_read_i32(reader, &data))
+            return false;
+        aug_value_init_bool(out, data != 0);
+        return true;
+    case AUG_CHAR:
+        if(!aug_snapshot_read_i32(reader, &data))
+            return false;
+        aug_value_init_char(out, (char)data);
+        return true;
+    case AUG_INT:
+    case AUG_FUNCTION:
+        if(!aug_snapshot_read_i32(reader, &data))
+            return false;
+        aug_value_init_int(out, type, data);
+        return true;
+    case AUG_FLOAT:
+    {
+        const char* float_data = aug_compiled_read(reader, sizeof(float));
+        if(float_data == NULL)
+            return false;
+        float f;
+        memcpy(&f, float_data, sizeof(float));
+        aug_value_init_float(out, f);
+        return true;
+    }
+    case AUG_RANGE:
+    {
+        int32_t to = 0;
+        if(!aug_snapshot_read_i32(reader, &data) || !aug_snapshot_read_i32(reader, &to))
+            return false;
+        aug_value_init_pointer(out, AUG_RANGE, aug_range_new(data, to));
+        return true;
+    }
+    case AUG_STRING:
+    case AUG_ARRAY:
+    case AUG_MAP:
+    case AUG_TYPED_ARRAY:
+    {
+        uint32_t index;
+        if(!aug_snapshot_read_i32(reader, (int32_t*)&index))
+            return false;
+        if(index == AUG_SNAPSHOT_INLINE && type == AUG_STRING)
+        {
+            uint32_t length;
+            const char* bytes;
+            if(!aug_snapshot_read_i32(reader, (int32_t*)&length) || (bytes = aug_compiled_read(reader, length)) == NULL)
+                return false;
+            aug_string* string = aug_string_new(length + 1);
+            memcpy(string->buffer, bytes, length);
+            string->buffer[length] = '\0';
+            string->length = length;
+            aug_value_init_pointer(out, AUG_STRING, string);
+            return true;
+        }
+        if(index >= snapshot->node_count || aug_value_type(&snapshot->nodes[index].value) != type)
+            return false;
+        *out = snapshot->nodes[index].value;
+        aug_incref(out);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Creates the snapshot's containers empty, then reads their images and fills them. Returns NULL if the data is invalid
+static aug_snapshot* aug_snapshot_read(aug_heap* heap, const char* data, size_t size)
+{
+    aug_compiled_reader reader;
+    reader.data = data;
+    reader.size = size;
+    reader.pos = 0;
+
+    aug_snapshot_header header;
+    const char* header_data = aug_compiled_read(&reader, sizeof(header));
+    if(header_data == NULL)
+        return NULL;
+    memcpy(&header, header_data, sizeof(header));
+    if(memcmp(header.magic, AUG_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != AUG_SNAPSHOT_VERSION)
         return NULL;
 
-    char* bytecode = (char*)AUG_ALLOC(sizeof(char)*ir->bytecode_offset);
-    char* instruction = bytecode;
+    // Each entry takes at least a byte, bound the counts before allocating
+    if(header.global_count > size || header.node_count > size)
+        return NULL;
 
-    for(size_t i = 0; i < ir->operations->length; ++i)
+    aug_snapshot* snapshot = aug_snapshot_new(heap, header.global_count);
+    bool valid = true;
+    for(uint32_t i = 0; valid && i < header.node_count; ++i)
     {
-        aug_ir_operation operation = aug_container_at_type(aug_ir_operation, ir->operations, i);
-        aug_ir_operand operand = operation.operand;
-
-        // push operation opcode
-        (*instruction++) = (aug_opcode)operation.opcode;
+        const char* types = aug_compiled_read(&reader, 2);
+        if(types == NULL)
+        {
+            valid = false;
+            break;
+        }
 
-        // push operation arguments
-        switch (operand.type)
+        aug_value value;
+        switch((aug_type)(uint8_t)types[0])
         {
-        case AUG_IR_OPERAND_NONE:
+        case AUG_STRING:
+            aug_value_init_pointer(&value, AUG_STRING, aug_string_new(1));
             break;
-        case AUG_IR_OPERAND_BOOL:
-        case AUG_IR_OPERAND_CHAR:
-        case AUG_IR_OPERAND_INT:
-        case AUG_IR_OPERAND_FLOAT:
-            for(size_t i = 0; i < aug_ir_operand_size(operand); ++i)
-                *(instruction++) = operand.data.bytes[i];
+        case AUG_ARRAY:
+            aug_value_init_pointer(&value, AUG_ARRAY, aug_array_new(1));
             break;
-        case AUG_IR_OPERAND_BYTES:
-            for(size_t i = 0; operand.data.str[i] != '\0'; ++i)
-                *(instruction++) = operand.data.str[i];
-            *(instruction++) = 0; // null terminate
+        case AUG_MAP:
+            aug_value_init_pointer(&value, AUG_MAP, aug_map_new(1));
             break;
-        case AUG_IR_OPERAND_SYMBOL:
-            aug_symbol* symbol = aug_hashtable_ptr_type(aug_symbol, ir->globals, operand.data.str);
-            assert(symbol);
-            operand.data.i = symbol->offset;
-            for(size_t i = 0; i < aug_ir_operand_size(operand); ++i)
-                *(instruction++) = operand.data.bytes[i];
+        case AUG_TYPED_ARRAY:
+            value = aug_create_typed_array((aug_type)(uint8_t)types[1], 0);
+            valid = aug_value_type(&value) == AUG_TYPED_ARRAY;
+            break;
+        default:
+            valid = false;
             break;
         }
+        if(valid)
+            aug_snapshot_push_node(snapshot, value);
     }
-    assert((size_t) (instruction - bytecode) == ir->bytecode_offset);
-    return bytecode;
-}
 
-// STRING ================================================= STRING ============================================ STRING // 
+    for(uint32_t i = 0; valid && i < header.global_count; ++i)
+        valid = aug_snapshot_read_value(&reader, snapshot, &snapshot->globals[i]);
 
-aug_string* aug_string_new(size_t size) 
-{
-	aug_string* string = (aug_string*)AUG_ALLOC(sizeof(aug_string));
-	string->ref_count = 1;
-	string->length = 0;
-	string->capacity = size;
-	string->buffer = (char*)AUG_ALLOC(sizeof(char)*string->capacity);
-	return string;
-}
+    for(size_t i = 0; valid && i < snapshot->node_count; ++i)
+    {
+        aug_snapshot_node* node = &snapshot->nodes[i];
+        uint32_t length;
+        if(!aug_snapshot_read_i32(&reader, (int32_t*)&length) || length > size)
+        {
+            valid = false;
+            break;
+        }
 
-aug_string* aug_string_create(const char* bytes) 
-{
-	aug_string* string = (aug_string*)AUG_ALLOC(sizeof(aug_string));
-	string->ref_count = 1;
-	string->length = strlen(bytes);
-	string->capacity = string->length + 1;
-	string->buffer = (char*)AUG_ALLOC(sizeof(char)*string->capacity);
+        aug_type element_type = AUG_NONE;
+        if(aug_value_type(&node->value) == AUG_TYPED_ARRAY)
+            element_type = aug_value_typed_array(&node->value)->element_type;
+        node->image = aug_snapshot_image_new(heap, aug_value_type(&node->value), element_type, length);
 
-#ifdef AUG_SECURE
-    strcpy_s(string->buffer, string->length+1, bytes);
-#else
-    strcpy(string->buffer, bytes);
-#endif
-    return string;
-}
+        const size_t value_count = aug_snapshot_image_value_count(node->image);
+        for(size_t j = 0; valid && j < value_count; ++j)
+        {
+            valid = aug_snapshot_read_value(&reader, snapshot, &node->image->values[j]);
+            if(valid && node->image->type == AUG_MAP && j % 2 == 0)
+                valid = aug_map_can_hash(&node->image->values[j]);
+        }
 
-void aug_string_resize(aug_string* string, size_t size) 
-{
-	string->capacity = size;
-    string->buffer = (char*)AUG_REALLOC(string->buffer, sizeof(char)*string->capacity);
+        const size_t byte_count = aug_snapshot_image_byte_count(node->image);
+        const char* bytes = valid ? aug_compiled_read(&reader, byte_count) : NULL;
+        if(bytes == NULL)
+            valid = false;
+        else if(byte_count > 0)
+            memcpy(node->image->bytes, bytes, byte_count);
+    }
+
+    if(!valid)
+    {
+        aug_snapshot_free(snapshot);
+        return NULL;
+    }
+
+    aug_snapshot_apply(snapshot, NULL, false);
+    return snapshot;
 }
 
-void aug_string_push(aug_string* string, char c) 
+// API ================================================= API ====================================================== API // 
+
+#if AUG_LEAK_CHECK
+static int aug_heap_compare_elements(const void* a, const void* b)
 {
-	if(string->length + 1 >= string->capacity) 
-        aug_string_resize(string, 2 * string->capacity);
-    string->buffer[string->length++] = c;
-    string->buffer[string->length] = '\0';
+    const uintptr_t x = (uintptr_t)*(void* const*)a;
+    const uintptr_t y = (uintptr_t)*(void* const*)b;
+    return x < y ? -1 : x > y;
 }
 
-char aug_string_pop(aug_string* string) 
+static void aug_heap_report_element(aug_error_func* error_func, aug_pool_type type, const void* element)
 {
-	return string->length > 0 ? string->buffer[--string->length] : -1;
+    switch(type)
+    {
+    case AUG_POOL_STRING:
+    {
+        const aug_string* string = (const aug_string*)element;
+        aug_log_error(error_func, "Leaked string \"%.64s\" (%d references)", string->buffer, (int)string->ref_count);
+        break;
+    }
+    case AUG_POOL_ARRAY:
+    {
+        const aug_array* array = (const aug_array*)element;
+        aug_log_error(error_func, "Leaked array of length %d (%d references)", (int)array->length, (int)array->ref_count);
+        break;
+    }
+    case AUG_POOL_MAP:
+    {
+        const aug_map* map = (const aug_map*)element;
+        aug_log_error(error_func, "Leaked map of count %d (%d references)", (int)map->count, (int)map->ref_count);
+        break;
+    }
+    case AUG_POOL_ITERATOR:
+    {
+        const aug_iterator* iterator = (const aug_iterator*)element;
+        aug_log_error(error_func, "Leaked iterator over %s (%d references)", aug_type_label(iterator->iterable), (int)iterator->ref_count);
+        break;
+    }
+    case AUG_POOL_RANGE:
+    {
+        const aug_range* range = (const aug_range*)element;
+        aug_log_error(error_func, "Leaked range %d:%d (%d references)", range->from, range->to, (int)range->ref_count);
+        break;
+    }
+    case AUG_POOL_TYPED_ARRAY:
+    {
+        const aug_typed_array* array = (const aug_typed_array*)element;
+        aug_log_error(error_func, "Leaked %s typed array of length %d (%d references)", 
+            array->element_type == AUG_INT ? "int" : "float", (int)array->length, (int)array->ref_count);
+        break;
+    }
+    case AUG_POOL_BUFFER_VIEW:
+    {
+        const aug_buffer_view* view = (const aug_buffer_view*)element;
+        aug_log_error(error_func, "Leaked buffer view of length %d (%d references)", (int)view->length, (int)view->ref_count);
+        break;
+    }
+    default:
+        break;
+    }
 }
 
-void aug_string_append(aug_string* a, const aug_string* b)
+// Reports the values alive in the heap's pools. Elements of a slab that are not in the pool's free list are alive.
+// Iterator owned values are reported by the iterator
+static void aug_heap_check_leaks(aug_heap* heap, aug_error_func* error_func)
 {
-    if(a != NULL && b != NULL && b->buffer != NULL)
-        aug_string_append_bytes(a, b->buffer, b->length);
-}
+    for(int type = 0; type < AUG_POOL_VALUE; ++type)
+    {
+        const size_t live_count = heap->live_elements[type];
+        if(live_count == 0)
+            continue;
 
-void aug_string_append_bytes(aug_string* string, const char* bytes, int len)
-{
-    if(string->length + len >= string->capacity) 
-        aug_string_resize(string, string->capacity + len * 2);
+        aug_pool* pool = &heap->pools[type];
+        size_t free_count = 0;
+        for(void* element = pool->free_list; element != NULL; element = *(void**)element)
+            ++free_count;
 
-    for(int i = 0; i < len; ++i)
-        string->buffer[string->length++] = bytes[i];
-    string->buffer[string->length] = '\0'; 
-}
+        void** free_elements = (void**)AUG_ALLOC(sizeof(void*) * (free_count > 0 ? free_count : 1));
+        size_t i = 0;
+        for(void* element = pool->free_list; element != NULL; element = *(void**)element)
+            free_elements[i++] = element;
+        qsort(free_elements, free_count, sizeof(void*), aug_heap_compare_elements);
 
-char aug_string_at(const aug_string* string, size_t index) 
-{
-	return index < string->length ? string->buffer[index] : -1;
+        for(char* slab = (char*)pool->slabs; slab != NULL; slab = *(char**)slab)
+        {
+            char* element = slab + sizeof(void*);
+            for(int j = 0; j < AUG_POOL_SLAB_COUNT; ++j, element += pool->element_size)
+            {
+                if(bsearch(&element, free_elements, free_count, sizeof(void*), aug_heap_compare_elements) == NULL)
+                    aug_heap_report_element(error_func, (aug_pool_type)type, element);
+            }
+        }
+        AUG_FREE(free_elements);
+    }
 }
+#endif//AUG_LEAK_CHECK
 
-bool aug_string_set(const aug_string* string, size_t index, char c) 
+aug_vm* aug_startup(aug_error_func* error_func, const aug_allocator* allocator)
 {
-	if(index < string->length)
-    {
-        string->buffer[index] = c;
-        return true;
-    } 
-    return false;
-}
+    // If assert fails, Opcode count is too large. This will affect bytecode instruction set. If bumping aug_opcode type, ensure bytecode offsets are corrected
+    assert(AUG_OPCODE_COUNT < 255);
 
-char aug_string_back(const aug_string* string) 
-{
-	return string->length > 0 ? string->buffer[string->length-1] : -1;
-}
+    // If fails, Ensure enough bytes to contain both int and float data types when type punning
+    // Check in the aug_ir_operand's union byte array and the aug_vm_bytecode_value's union byte array
+    assert(sizeof(float) >= sizeof(int));
 
-bool aug_string_compare(const aug_string* a, const aug_string* b) 
-{
-    if(a == NULL || b == NULL || a->length != b->length)
-        return false; 
-    return strncmp(a->buffer, b->buffer, a->length) == 0;
+    aug_heap* heap = aug_heap_new(allocator);
+    aug_vm* vm = (aug_vm*)aug_heap_alloc(heap, sizeof(aug_vm));
+    vm->heap = heap;
+    vm->context = aug_vm_context_new(vm, heap, AUG_STACK_SIZE);
+
+    // Initialize global vm state, non script context sensitive
+    vm->extensions = aug_hashtable_new_type(aug_extension);
+    vm->libs = aug_hashtable_new_type(aug_lib);
+    vm->scripts = aug_hashtable_new(0, sizeof(aug_cached_script), aug_hashtable_hash_default, aug_cached_script_free);
+    vm->error_func = error_func;
+    vm->exec_filepath = NULL;
+    vm->optimize_level = AUG_OPTIMIZE_LEVEL;
+    vm->backend = AUG_BACKEND;
+    vm->extensions_version = 1;
+#if AUG_DEBUG
+    vm->debug_post_instruction = NULL;
+#endif// AUG_DEBUG
+    return vm;
 }
 
-bool aug_string_compare_bytes(const aug_string* a, const char* bytes) 
+void aug_shutdown(aug_vm* vm)
 {
-    if(bytes == NULL)
-        return a->buffer == NULL;
+    // Deinitialize global vm state, non script context sensitive
+    // Unregister all extensions and lib extensions
+    vm->scripts = aug_hashtable_decref(vm->scripts);
 
-    size_t len = strlen(bytes);
-    if(len != a->length)
-        return false;
+    aug_hashtable_foreach(vm->libs, aug_vm_lib_free, vm);
+    vm->libs = aug_hashtable_decref(vm->libs);
+    vm->extensions = aug_hashtable_decref(vm->extensions);
 
-    for(size_t i = 0; i < a->length; ++i)
-    {
-        if(a->buffer[i] != bytes[i])
-            return false;
+    aug_vm_shutdown(vm->context);
+    aug_vm_context_delete(vm->context);
 
-    }
-    return true;
-}
+    // Values created outside of a VM fall back to the default heap. Ensure they do not use the released pools
+    aug_heap* heap = vm->heap;
+    if(aug_heap_active == heap)
+        aug_heap_leave(NULL);
 
-void aug_string_incref(aug_string* string) 
-{
-    if(string != NULL)
-	    string->ref_count++;
+    // Release the cycles and deferred releases before reporting the values still alive
+    aug_heap_step(heap, 0);
+
+#if AUG_LEAK_CHECK
+    aug_heap_check_leaks(heap, vm->error_func);
+#endif//AUG_LEAK_CHECK
+
+    aug_heap_free(heap, vm, sizeof(aug_vm));
+    aug_heap_delete(heap);
 }
 
-aug_string* aug_string_decref(aug_string* string) 
+void aug_register(aug_vm* vm, const char* func_name, aug_extension_func* extension_func)
 {
-	if(string != NULL && --string->ref_count == 0)
+    if(vm->context->running && vm->context->lib_extensions != NULL)
     {
-        AUG_FREE(string->buffer);
-        AUG_FREE(string);
-        return NULL;
+        if(aug_hashtable_get(vm->context->lib_extensions, func_name) != 0)
+        {
+            aug_log_vm_warn(vm->context, "Failed to register library extension Function %s. Already registered!", func_name);
+            return;
+        }
+
+        aug_extension* extension = aug_hashtable_insert_type(aug_extension, vm->context->lib_extensions, func_name);
+        if(extension != NULL)
+            extension->func = extension_func;
+        ++vm->extensions_version;
+        return;
     }
-    return string;
-}
 
-// ARRAY ================================================== ARRAY ============================================== ARRAY // 
+    if(aug_hashtable_get(vm->extensions, func_name) != 0)
+    {
+        aug_log_vm_warn(vm->context, "Failed to register library extension Function %s. Already registered!", func_name);
+        return;
+    }
 
-aug_array* aug_array_new(size_t size)
-{                
-	aug_array* array = (aug_array*)AUG_ALLOC(sizeof(aug_array));
-	array->ref_count = 1;   
-	array->length = 0;      
-	array->capacity = size; 
-	array->buffer = (aug_value*)AUG_ALLOC(sizeof(aug_value)*array->capacity);
-	return array;
+    aug_extension* extension = aug_hashtable_insert_type(aug_extension, vm->extensions, func_name);
+    if(extension != NULL)
+        extension->func = extension_func;
+    ++vm->extensions_version;
 }
 
-void aug_array_incref(aug_array* array) 
-{
-    if(array != NULL)       
-	    array->ref_count++; 
-}
- 
-aug_array* aug_array_decref(aug_array* array)
+void aug_unregister(aug_vm* vm, const char* func_name)
 {
-	if(array != NULL && --array->ref_count == 0)
-    {            
-        // If will be dereferenced, ensure children are as well
-        for (size_t i = 0; i < array->length; ++i)
-            aug_decref(aug_array_at(array, i));
-        AUG_FREE(array->buffer);
-        AUG_FREE(array);
-        return NULL;
-    }            
-    return array;
-}       
+    if(vm->context->running && vm->context->lib_extensions != NULL)
+    {        
+        if(!aug_hashtable_remove(vm->context->lib_extensions, func_name))
+            aug_log_vm_warn(vm->context, "Failed to unregister library extension Function %s. Not registered!", func_name);
+        ++vm->extensions_version;
+        return;
+    }
 
-void aug_array_reserve(aug_array* array, size_t size)    
-{
-	array->capacity = size; 
-	array->buffer = (aug_value*)AUG_REALLOC(array->buffer, sizeof(aug_value)*array->capacity);
+    if(!aug_hashtable_remove(vm->extensions, func_name))
+        aug_log_vm_warn(vm->context, "Failed to unregister extension Function %s. Not registered!", func_name);
+    ++vm->extensions_version;
 }
 
-void aug_array_resize(aug_array* array, size_t size)    
-{
-    aug_array_reserve(array, size);
-    array->length = array->capacity;
-    for(size_t i = 0; i < array->length; ++i)
-        array->buffer[i] = aug_none();
-}
- 
-aug_value* aug_array_push(aug_array* array)  
-{
-	if(array->length + 1 >= array->capacity)
-        aug_array_reserve(array, array->capacity * 2); 
-    return &array->buffer[array->length++];     
-}
- 
-aug_value* aug_array_pop(aug_array* array)
-{
-	return array->length > 0 ? &array->buffer[--array->length] : NULL; 
-}
- 
-aug_value* aug_array_at(const aug_array* array, size_t index) 
+aug_script* aug_compile(aug_vm* vm, const char* filename)
 {
-	return index < array->length ? &array->buffer[index] : NULL;       
-}
+    if(vm == NULL || filename == NULL)
+        return NULL;
 
-bool aug_array_set(const aug_array* array, size_t index, aug_value* value) 
-{
-	if(index < array->length)
+#if AUG_SCRIPT_CACHE
+    // Stamped before reading, so that a modification while compiling is found by the next compile
+    const uint64_t stamp = aug_file_stamp(filename);
+    aug_cached_script* cached_script = aug_hashtable_ptr_type(aug_cached_script, vm->scripts, filename);
+    if(cached_script != NULL)
     {
-        aug_assign(&array->buffer[index], value); 
-        return true;      
-    }   
-    return false;      
-}
- 
-aug_value* aug_array_back(const aug_array* array)             
-{
-	return array->length > 0 ? &array->buffer[array->length-1] : NULL; 
-}
+        if(cached_script->optimize_level == vm->optimize_level && cached_script->backend == vm->backend
+            && cached_script->stamp == aug_cached_script_stamp(stamp, cached_script->imports))
+            return aug_script_copy(cached_script->script);
+        aug_hashtable_remove(vm->scripts, filename);
+    }
+#endif//AUG_SCRIPT_CACHE
 
-bool aug_array_compare(const aug_array* a, const aug_array* b)             
-{
-    if(a->length != b->length)
-        return false;
-    for(size_t i = 0; i < a->length; ++i)
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
+
+    aug_input* input = aug_input_open(filename, vm->error_func);
+    aug_ast* root = aug_parse(input);
+    if (root == NULL)
     {
-        if(!aug_compare(&a->buffer[i], &b->buffer[i]))
-            return false;
+        aug_input_close(input);
+        aug_heap_leave(prev_heap);
+        return NULL;
     }
-    return true;
-}
-
-void aug_array_append(aug_array* array, aug_value* value)  
-{
-    aug_value* new_value = aug_array_push(array);
-    if(new_value == NULL)
-        return;
 
-    *new_value = aug_none(); 
-    aug_array_set(array, array->length-1, value);
-}
+    aug_ir* ir = aug_generate_ir(vm, root, input);
+    char* bytecode = aug_generate_bytecode(ir);
+    if(bytecode == NULL)
+    {
+        aug_ir_delete(ir);
+        aug_input_close(input);
+        aug_heap_leave(prev_heap);
+        return NULL;
+    }
 
-void aug_array_remove(aug_array* array, int index)  
-{
-    aug_value* value = aug_array_at(array, index); 
+    aug_script* script = aug_script_new(ir->globals, bytecode, ir->bytecode_offset, ir->markers, ir->extension_names, ir->constants);
+    script->backend = ir->backend;
 
-    if(value == NULL)
-        return;
+#if AUG_SCRIPT_CACHE
+    // The cache keeps the compiled script, and returns a copy to execute
+    if(ir->valid && stamp != 0)
+    {
+        cached_script = aug_hashtable_insert_type(aug_cached_script, vm->scripts, filename);
+        cached_script->script = script;
+        cached_script->imports = ir->imports;
+        aug_container_incref(cached_script->imports);
+        cached_script->stamp = aug_cached_script_stamp(stamp, ir->imports);
+        cached_script->optimize_level = vm->optimize_level;
+        cached_script->backend = vm->backend;
+        script = aug_script_copy(script);
+    }
+#endif//AUG_SCRIPT_CACHE
+    
+    aug_ir_delete(ir);
+    aug_input_close(input);
 
-    aug_decref(value);
-    for(size_t i = index; i < array->length-1; ++i)
-        array->buffer[i] = array->buffer[i+1];
-    array->length--;
+    aug_heap_leave(prev_heap);
+    return script;
 }
 
-aug_array* aug_array_copy(aug_array* array)
+void aug_clear_cache(aug_vm* vm)
 {
-    aug_array* new_array = aug_array_new(array->length);
-    for(size_t i = 0; i < array->length; ++i)
-        aug_array_append(new_array, aug_array_at(array, i));
-    return new_array;
+    if(vm == NULL)
+        return;
+    vm->scripts = aug_hashtable_decref(vm->scripts);
+    vm->scripts = aug_hashtable_new(0, sizeof(aug_cached_script), aug_hashtable_hash_default, aug_cached_script_free);
 }
 
-// MAP ==================================================== MAP =================================================== MAP //
-
-#ifndef AUG_MAP_SIZE_DEFAULT
-#define AUG_MAP_SIZE_DEFAULT 1
-#endif//AUG_MAP_SIZE_DEFAULT
-
-#ifndef AUG_MAP_BUCKET_SIZE_DEFAULT
-#define AUG_MAP_BUCKET_SIZE_DEFAULT 1
-#endif//AUG_MAP_BUCKET_SIZE_DEFAULT
+aug_value aug_eval(aug_vm* vm, const char* code)
+{    
+    if(vm == NULL || code == NULL)
+        return aug_none();
 
-typedef struct aug_map_bucket
-{
-    aug_value* keys;
-    aug_value* values;
-    size_t capacity;
-} aug_map_bucket;
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
 
-bool aug_map_can_hash(const aug_value* value)
-{
-    switch(value->type)
+    aug_input* input = aug_input_open_code(code, vm->error_func);
+    aug_ast* root = aug_parse(input);
+    if (root == NULL)
     {
-        case AUG_STRING:
-        case AUG_INT:
-            return true;
-        default:
-            return false;
+        aug_input_close(input);
+        aug_heap_leave(prev_heap);
+        return aug_none();
     }
-    return false;
-}
 
-size_t aug_map_hash(const aug_value* value)
-{
-    switch(value->type)
+    aug_ir* ir = aug_generate_ir(vm, root, input);
+    char* bytecode = aug_generate_bytecode(ir);
+    if(bytecode == NULL)
     {
-        case AUG_STRING:
-        {
-            const char* bytes = value->str->buffer;
-            size_t hash = 5381; // DJB2 hash
-            while (*bytes)
-                hash = ((hash << 5) + hash) + *bytes++;
-            return hash;
-        }
-        case AUG_INT:
-            return value->i;
-        default:
-            return 0;
+        aug_ir_delete(ir);
+        aug_input_close(input);
+        aug_heap_leave(prev_heap);
+        return aug_none();
     }
-    return 0;
+
+    aug_script* script = aug_script_new(ir->globals, bytecode, ir->bytecode_offset, ir->markers, ir->extension_names, ir->constants);
+    script->backend = ir->backend;
+    
+    aug_ir_delete(ir);
+    aug_input_close(input);
+
+    aug_vm_startup(vm->context);
+    aug_vm_load_script(vm->context, script);
+    aug_vm_execute(vm->context);
+
+    aug_value* ret = aug_vm_pop(vm->context);
+
+    aug_vm_shutdown(vm->context);
+    aug_script_delete(script);
+    aug_heap_execute_step(vm->heap);
+    aug_heap_leave(prev_heap);
+    return *ret;
+}
+
+void aug_execute(aug_vm* vm, const char* filename)
+{
+    aug_script* script = aug_compile(vm, filename);
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
+
+    aug_vm_startup(vm->context);
+    aug_vm_load_script(vm->context, script);
+    aug_vm_execute(vm->context);
+    aug_vm_shutdown(vm->context);
+
+    aug_script_delete(script);
+    aug_heap_execute_step(vm->heap);
+    aug_heap_leave(prev_heap);
 }
 
-void aug_map_bucket_init(aug_map* map, int size)
+aug_script* aug_load(aug_vm* vm, const char* filename)
 {
-    for (size_t i = 0; i < map->capacity; ++i)
-    {
-        aug_map_bucket* bucket = &map->buckets[i];
-        bucket->capacity = size;
-        bucket->keys = (aug_value*)AUG_ALLOC(sizeof(aug_value) * size);
-        bucket->values = (aug_value*)AUG_ALLOC(sizeof(aug_value) * size);
-        for(size_t j = 0; j < bucket->capacity; ++j)
-            bucket->keys[j] = aug_none();
-    }
+    aug_script* script = aug_compile(vm, filename);
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
+
+    aug_vm_load_script(vm->context, script);
+    aug_vm_execute(vm->context);
+    aug_vm_save_script(vm->context, script);
+
+    aug_heap_execute_step(vm->heap);
+    aug_heap_leave(prev_heap);
+    return script;
 }
 
-aug_value* aug_map_bucket_insert(aug_map* map, aug_map_bucket* bucket, aug_value* key)
+bool aug_save_compiled(aug_vm* vm, const aug_script* script, const char* filename)
 {
-    size_t i;
-    for (i = 0; i < bucket->capacity; ++i)
-    {
-        if (bucket->keys[i].type == AUG_NONE)
-            break;
+    if(vm == NULL || script == NULL || script->bytecode == NULL || filename == NULL)
+        return false;
 
-        if (aug_compare(&bucket->keys[i], key))
-            return NULL;
-    }
+#ifdef AUG_SECURE
+    FILE* file;
+    fopen_s(&file, filename, "wb");
+#else
+    FILE* file = fopen(filename, "wb");
+#endif //AUG_SECURE
 
-    if (i >= bucket->capacity)
+    if(file == NULL)
     {
-        size_t new_size = 2 * bucket->capacity;
-        bucket->keys = (aug_value*)AUG_REALLOC(bucket->keys, sizeof(aug_value) * new_size);
-        bucket->values = (aug_value*)AUG_REALLOC(bucket->values, sizeof(aug_value) * new_size);
-
-        size_t j; // init new entries to null 
-        for (j = bucket->capacity; j < new_size; ++j)
-            bucket->keys[j] = aug_none();
-        bucket->capacity = new_size;
+        aug_log_error(vm->error_func, "Compiled file %s failed to open for writing", filename);
+        return false;
     }
 
-    ++map->count;
-
-    bucket->keys[i] = *key;
-    aug_incref(&bucket->keys[i]);
+    const bool success = aug_script_write(script, file);
+    fclose(file);
 
-    return &bucket->values[i];
+    if(!success)
+        aug_log_error(vm->error_func, "Compiled file %s failed to write", filename);
+    return success;
 }
 
-aug_value* aug_map_bucket_insert_or_update(aug_map* map, aug_map_bucket* bucket, aug_value* key, aug_value* value)
+aug_script* aug_load_compiled(aug_vm* vm, const char* filename)
 {
-    size_t i;
-    for (i = 0; i < bucket->capacity; ++i)
-    {
-        if (bucket->keys[i].type == AUG_NONE)
-            break;
+    if(vm == NULL || filename == NULL)
+        return NULL;
 
-        if (aug_compare(&bucket->keys[i], key))
-        {
-            aug_move(&bucket->values[i], value);
-            return &bucket->values[i];
-        }
+    size_t size = 0;
+    bool mapped = false;
+    char* data = aug_compiled_open(filename, &size, &mapped);
+    if(data == NULL)
+    {
+        aug_log_error(vm->error_func, "Compiled file %s failed to open", filename);
         return NULL;
     }
 
-    if (i >= bucket->capacity)
-    {
-        size_t new_size = 2 * bucket->capacity;
-        bucket->keys = (aug_value*)AUG_REALLOC(bucket->keys, sizeof(aug_value) * new_size);
-        bucket->values = (aug_value*)AUG_REALLOC(bucket->values, sizeof(aug_value) * new_size);
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
 
-        size_t j; // init new entries to null 
-        for (j = bucket->capacity; j < new_size; ++j)
-            bucket->keys[j] = aug_none();
-        bucket->capacity = new_size;
+    aug_script* script = aug_script_read(data, size, mapped);
+    if(script == NULL)
+    {
+        aug_log_error(vm->error_func, "Compiled file %s is invalid or was compiled by an incompatible version", filename);
+        aug_file_close(data, size, mapped);
+        aug_heap_leave(prev_heap);
+        return NULL;
     }
 
-    ++map->count;
-
-    bucket->keys[i] = *key;
-    aug_incref(&bucket->keys[i]);
+    aug_vm_load_script(vm->context, script);
+    aug_vm_execute(vm->context);
+    aug_vm_save_script(vm->context, script);
 
-    return &bucket->values[i];
+    aug_heap_execute_step(vm->heap);
+    aug_heap_leave(prev_heap);
+    return script;
 }
 
-aug_map* aug_map_new(size_t size)
+void aug_unload(aug_vm* vm, aug_script* script)
 {
-    aug_map* map = (aug_map*)AUG_ALLOC(sizeof(aug_map));
-    map->capacity = size;
-    map->ref_count = 1;
-    map->count = 0;
-    map->buckets = (aug_map_bucket*)AUG_ALLOC(sizeof(aug_map_bucket) * size);
-    aug_map_bucket_init(map, AUG_MAP_BUCKET_SIZE_DEFAULT);
-    return map;
+    aug_vm_unload_script(vm->context, script);
+    aug_script_delete(script);
 }
 
-void aug_map_resize(aug_map* map, size_t size)
+aug_function aug_get_function(aug_vm* vm, aug_script* script, const char* func_name)
 {
-    size_t old_size = map->capacity;
-    aug_map_bucket* old_buckets = map->buckets;
+    aug_function function;
+    function.script = script;
+    function.addr = -1;
+    function.argc = 0;
+    if (vm == NULL || script == NULL || script->bytecode == NULL)
+        return function;
 
-    map->capacity = size;
-    map->buckets = (aug_map_bucket*)AUG_ALLOC(sizeof(aug_map_bucket) * map->capacity);
-    aug_map_bucket_init(map, AUG_MAP_BUCKET_SIZE_DEFAULT);
-
-    // reindex all values, copy over raw data 
-    for (size_t i = 0; i < old_size; ++i)
+    aug_symbol* symbol_ptr = aug_hashtable_ptr_type(aug_symbol, script->globals, func_name);
+    if (symbol_ptr == NULL || symbol_ptr->type == AUG_SYM_NONE)
     {
-        aug_map_bucket* old_bucket = &old_buckets[i];
-        for (size_t j = 0; j < old_bucket->capacity; ++j)
-        {
-            aug_value* key = &old_bucket->keys[j];
-            if (old_bucket->keys[j].type != AUG_NONE)
-            {
-                aug_value* value = &old_bucket->values[j];
-                size_t hash = aug_map_hash(key);
-
-                aug_map_bucket* new_bucket = &map->buckets[hash % map->capacity];
-                aug_value* new_value = aug_map_bucket_insert(map, new_bucket, key);
-                assert(value != NULL);
-                *new_value = *value;
-
-                aug_decref(key);
-            }
-        }
+        aug_log_error(vm->error_func, "Function %s not defined", func_name);
+        return function;
+    }
 
-        AUG_FREE(old_bucket->values);
-        AUG_FREE(old_bucket->keys);
+    aug_symbol symbol = *symbol_ptr; 
+    switch (symbol.type)
+    {
+    case AUG_SYM_FUNC:
+        break;
+    case AUG_SYM_VAR:
+        aug_log_error(vm->error_func, "Can not call variable %s a function", func_name);
+        return function;
+    default:
+        aug_log_error(vm->error_func, "Symbol %s not defined as a function", func_name);
+        return function;
     }
 
-    AUG_FREE(old_buckets);
+    function.addr = symbol.offset;
+    function.argc = symbol.argc;
+    return function;
 }
 
-void aug_map_incref(aug_map* map)
+static inline bool aug_call_handle_valid(aug_vm* vm, aug_function function, int argc)
 {
-    if (map)
-        ++map->ref_count;
-}
+    if (function.script == NULL || function.script->bytecode == NULL || function.addr < 0)
+        return false;
 
-aug_map* aug_map_decref(aug_map* map)
-{
-    if (map && --map->ref_count == 0)
+    if (function.argc != argc)
     {
-        for (size_t i = 0; i < map->capacity; ++i)
-        {
-            aug_map_bucket* bucket = &map->buckets[i];
-            for (size_t j = 0; j < bucket->capacity; ++j)
-            {
-                if (bucket->keys[j].type != AUG_NONE)
-                {
-                    aug_decref(&bucket->values[j]);
-                    aug_decref(&bucket->keys[j]);
-                    bucket->keys[j] = aug_none();
-                }
-            }
-            AUG_FREE(bucket->values);
-            AUG_FREE(bucket->keys);
-        }
-        AUG_FREE(map->buckets);
-        AUG_FREE(map);
-        return NULL;
+        aug_log_error(vm->error_func, "Function passed %d arguments, expected %d", argc, function.argc);
+        return false;
     }
-    return map;
+    return true;
 }
 
-bool aug_map_insert(aug_map* map, aug_value* key, aug_value* data)
+aug_value aug_call_handle(aug_vm* vm, aug_function function, int argc, aug_value* args)
 {
-    if(!aug_map_can_hash(key) || data == NULL)
-        return false;
+    if (vm == NULL || !aug_call_handle_valid(vm, function, argc))
+        return aug_none();
 
-    size_t hash = aug_map_hash(key);
-    aug_map_bucket* bucket = &map->buckets[hash % map->capacity];
-    // If a bucket is larger than the map capacity, reindex all entries
-    if (bucket->capacity > map->capacity)
-    {
-        aug_map_resize(map, map->capacity * 2);
-        bucket = &map->buckets[hash % map->capacity];
-    }
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
 
-    aug_value* entry = aug_map_bucket_insert(map, bucket, key);
-    if (entry == NULL)
-        return false;
+    // The script globals are used in place, only the call frame is pushed onto the stack
+    aug_script* script = function.script;
+    aug_vm_startup(vm->context);
+    aug_vm_load_script(vm->context, script);
 
-    ++map->count;
-    *entry = *data;
-    aug_incref(entry);
-    return true;
-}
+    aug_value ret_value = aug_vm_execute_from_frame(vm->context, function.addr, argc, args);
 
-bool aug_map_remove(aug_map* map, aug_value* key)
-{   
-    if(!aug_map_can_hash(key))
-        return false;
-    
-    size_t hash = aug_map_hash(key);
-    aug_map_bucket* bucket = &map->buckets[hash % map->capacity];
-    for (size_t i = 0; i < bucket->capacity; ++i)
-    {
-        if (aug_compare(&bucket->keys[i], key))
-        {
-            aug_decref(&bucket->keys[i]);
-            aug_decref(&bucket->values[i]);
-            bucket->keys[i] = aug_none();
-            return true;
-        }
-    }
-    return false;
+    // Keep the resolved slots if still valid
+    script->extension_version = vm->context->extension_version;
+    aug_vm_shutdown(vm->context);
+
+    aug_heap_execute_step(vm->heap);
+    aug_heap_leave(prev_heap);
+    return ret_value;
 }
 
-aug_value* aug_map_get(aug_map* map, aug_value* key)
+int aug_call_batch(aug_vm* vm, aug_function function, int count, int argc, aug_value* args, aug_value* results)
 {
-    if(!aug_map_can_hash(key))
-        return NULL;
+    if (vm == NULL || count <= 0 || !aug_call_handle_valid(vm, function, argc))
+        return 0;
 
-    size_t hash = aug_map_hash(key);
-    aug_map_bucket* bucket = &map->buckets[hash % map->capacity];
-    for (size_t i = 0; i < bucket->capacity; ++i)
-    {
-        if (aug_compare(&bucket->keys[i], key))
-        {
-            return &bucket->values[i];
-        }
-    }
-    return NULL;
-}
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
 
-bool aug_map_insert_or_update(aug_map* map, aug_value* key, aug_value* data)
-{
-    // TODO: better solution, avoid duplicate traversal from initial lookup
-    aug_value* entry = aug_map_get(map, key);
-    if(entry != NULL)
-    {
-        aug_decref(entry);
-        *entry = *data;
-        aug_incref(entry);
-        return true;
-    }
+    aug_script* script = function.script;
+    aug_vm_startup(vm->context);
+    aug_vm_load_script(vm->context, script);
+
+    const int returned = aug_vm_execute_batch(vm->context, function.addr, count, argc, args, results);
+
+    script->extension_version = vm->context->extension_version;
+    aug_vm_shutdown(vm->context);
 
-    return aug_map_insert(map, key, data);
+    aug_heap_execute_step(vm->heap);
+    aug_heap_leave(prev_heap);
+    return returned;
 }
 
-void aug_map_foreach(aug_map* map, aug_map_iterator* iterator, void* user_data)
+aug_value aug_call_args(aug_vm* vm, aug_script* script, const char* func_name, int argc, aug_value* args)
 {
-    if (map == NULL)
-        return;
+    if (vm == NULL || script == NULL || script->bytecode == NULL)
+        return aug_none();
 
-    for (size_t i = 0; i < map->capacity; ++i)
+    aug_function function = aug_get_function(vm, script, func_name);
+    if (function.addr >= 0 && function.argc != argc)
     {
-        aug_map_bucket* bucket = &map->buckets[i];
-        for (size_t j = 0; j < bucket->capacity; ++j)
-        {
-            if (bucket->keys[j].type != AUG_NONE)
-                iterator(&bucket->keys[j], &bucket->values[j], user_data);
-        }
+        aug_log_error(vm->error_func, "Function %s passed %d arguments, expected %d", func_name, argc, function.argc);
+        return aug_none();
     }
+    return aug_call_handle(vm, function, argc, args);
 }
 
-aug_iterator* aug_iterator_new(aug_value* iterable)
+aug_value aug_call(aug_vm* vm, aug_script* script, const char* func_name)
 {
-    switch(iterable->type)
-    {
-        case AUG_INT:
-        case AUG_STRING:
-        case AUG_ARRAY:
-        case AUG_RANGE:
-            break;
-        default:
-            return NULL;
-    }
+    return aug_call_args(vm, script, func_name, 0, NULL);
+}
 
-    aug_iterator* iterator = (aug_iterator*)AUG_ALLOC(sizeof(aug_iterator));
-    iterator->ref_count = 1;
-    iterator->iterable = (aug_value*)AUG_ALLOC(sizeof(aug_value));
-    *iterator->iterable = *iterable;
-    aug_incref(iterable);
-    iterator->index = NULL;
-    return iterator;
+// Saves the execution state if the coroutine suspended, then resets the VM for other calls
+static inline void aug_coroutine_save(aug_vm* vm, aug_coroutine* coroutine)
+{
+    coroutine->suspended = vm->context->suspended;
+    if(coroutine->suspended)
+        aug_save_state(vm, &coroutine->state);
+    aug_vm_shutdown(vm->context);
 }
 
-aug_iterator* aug_iterator_decref(aug_iterator* iterator)
+aug_value aug_coroutine_start(aug_vm* vm, aug_coroutine* coroutine, aug_function function, int argc, aug_value* args)
 {
-    if(iterator != NULL && --iterator->ref_count == 0)
-    {
-        if(iterator->index != NULL)
-            AUG_FREE(iterator->index);
-        
-        aug_decref(iterator->iterable);
-        AUG_FREE(iterator->iterable);
-        AUG_FREE(iterator);
-        return NULL;    
-    }
-    return iterator;
+    if (vm == NULL || coroutine == NULL)
+        return aug_none();
+
+    coroutine->suspended = false;
+    coroutine->state.stack_state = NULL;
+    if (!aug_call_handle_valid(vm, function, argc))
+        return aug_none();
+
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
+
+    aug_vm_startup(vm->context);
+    aug_vm_load_script(vm->context, function.script);
+    vm->context->coroutine = true;
+    vm->context->budget = coroutine->budget;
+
+    aug_value ret_value = aug_vm_execute_from_frame(vm->context, function.addr, argc, args);
+    aug_coroutine_save(vm, coroutine);
+
+    aug_heap_execute_step(vm->heap);
+    aug_heap_leave(prev_heap);
+    return ret_value;
 }
 
-void aug_iterator_incref(aug_iterator* iterator)
+aug_value aug_resume(aug_vm* vm, aug_coroutine* coroutine)
 {
-    if(iterator != NULL)
-        ++iterator->ref_count;
+    if (vm == NULL || coroutine == NULL || !coroutine->suspended)
+        return aug_none();
+
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
+
+    aug_vm_startup(vm->context);
+    aug_load_state(vm, &coroutine->state);
+    vm->context->valid = (vm->context->bytecode != NULL);
+    vm->context->budget = coroutine->budget;
+    aug_vm_execute(vm->context);
+
+    aug_value ret_value = aug_none();
+    if(!vm->context->suspended && vm->context->stack_index >= 1)
+        ret_value = *aug_vm_pop(vm->context);
+    aug_coroutine_save(vm, coroutine);
+
+    aug_heap_execute_step(vm->heap);
+    aug_heap_leave(prev_heap);
+    return ret_value;
 }
 
-bool aug_iterator_next(aug_iterator* iterator)
+void aug_coroutine_release(aug_coroutine* coroutine)
 {
-    if(iterator == NULL || iterator->iterable == NULL)
-        return false;
+    if (coroutine == NULL || !coroutine->suspended)
+        return;
 
-    int initial_index = 0;
-    aug_value* index = iterator->index;
-    aug_value* iterable = iterator->iterable;
-    switch(iterable->type)
+    // aug_save_state retains the saved values in addition to the stack's references, which are released when not resumed
+    aug_array* stack_state = coroutine->state.stack_state;
+    if (stack_state != NULL)
     {
-        case AUG_INT:
-        case AUG_STRING:
-        case AUG_ARRAY:
-            initial_index = 0;
-            break;
-        case AUG_RANGE:
-            initial_index = iterable->range->from;
-            break;
-        default:
-            return false;
+        for (size_t i = 0; i < stack_state->length; ++i)
+        {
+            aug_value value = *aug_array_at(stack_state, i);
+            aug_decref(&value);
+        }
     }
+    coroutine->state.stack_state = aug_array_decref(stack_state);
+    coroutine->suspended = false;
+}
 
-    // grab initial index
-    if(iterator->index == NULL)
+// Deep copies the value into the active heap, so that the copy does not share reference counts with the original 
+static aug_value aug_context_clone_value(const aug_value* value)
+{
+    aug_value clone = *value;
+    switch (aug_value_type(value))
     {
-        index = (aug_value*)AUG_ALLOC(sizeof(aug_value));
-        *index = aug_create_int(initial_index);
+    case AUG_STRING:
+    {
+        aug_value_init_pointer(&clone, AUG_STRING, aug_string_create(aug_value_string(value)->buffer));
+        break;
     }
-    else 
+    case AUG_ARRAY:
     {
-        assert(index->type == AUG_INT);
-        index->i += 1;
+        aug_value_init_pointer(&clone, AUG_ARRAY, aug_array_new(aug_value_array(value)->length));
+        for(size_t i = 0; i < aug_value_array(value)->length; ++i)
+        {
+            aug_value element = aug_context_clone_value(aug_array_at(aug_value_array(value), i));
+            aug_array_append(aug_value_array(&clone), &element);
+            aug_decref(&element);
+        }
+        break;
     }
-    
-    iterator->index = index;
-    return true;
-}
-
-bool aug_iterator_get(aug_iterator* iterator, aug_value* out_element)
-{
-    if(iterator == NULL || iterator->iterable == NULL)
-        return false;
-
-    aug_value* index = iterator->index;
-    aug_value* iterable = iterator->iterable;
-    assert(index->type == AUG_INT);
-
-    bool success = aug_get_element(iterable, index, out_element);
-    if(!success)
+    case AUG_MAP:
     {
-        if(iterable->type == AUG_INT && index->i <= iterable->i)
+        aug_value_init_pointer(&clone, AUG_MAP, aug_map_new(aug_value_map(value)->count));
+        for(size_t i = 0; i < aug_value_map(value)->capacity; ++i)
         {
-            *out_element = *index;
-            return true;
+            aug_map_slot* slot = &aug_value_map(value)->slots[i];
+            if(aug_value_type(&slot->key) == AUG_NONE)
+                continue;
+            aug_value key = aug_context_clone_value(&slot->key);
+            aug_value element = aug_context_clone_value(&slot->value);
+            aug_map_insert(aug_value_map(&clone), &key, &element);
+            aug_decref(&key);
+            aug_decref(&element);
         }
-
-        AUG_FREE(iterator->index);
-        iterator->index = NULL;
-        return false;
+        break;
     }
-    return true;
+    case AUG_RANGE:
+        aug_value_init_pointer(&clone, AUG_RANGE, aug_range_new(aug_value_range(value)->from, aug_value_range(value)->to));
+        break;
+    case AUG_TYPED_ARRAY:
+        aug_value_init_pointer(&clone, AUG_TYPED_ARRAY, aug_typed_array_copy(aug_value_typed_array(value)));
+        break;
+    case AUG_BUFFER_VIEW:
+    {
+        // The clone views the same memory. The release function is kept by the original
+        const aug_buffer_view* view = aug_value_buffer_view(value);
+        aug_value_init_pointer(&clone, AUG_BUFFER_VIEW, aug_buffer_view_new(view->data, view->element_type, view->length, view->stride, NULL, NULL));
+        break;
+    }
+    default:
+        aug_incref(&clone);
+        break;
+    }
+    return clone;
 }
 
-aug_range* aug_range_new(int from, int to)
+aug_context* aug_context_new(aug_vm* vm, aug_script* script, int stack_size)
 {
-    aug_range* range = (aug_range*)AUG_ALLOC(sizeof(aug_range));
-    range->ref_count = 1;
-    range->from = from;
-    range->to = to;
-    return range;
-}
+    if(vm == NULL || script == NULL || script->bytecode == NULL)
+        return NULL;
 
-aug_range* aug_range_decref(aug_range* range)
-{
-    if(range != NULL && --range->ref_count == 0)
+    // Each context allocates values from its own pools, so that contexts on separate threads do not contend
+    aug_heap* heap = aug_heap_new(&vm->heap->allocator);
+    aug_heap* prev_heap = aug_heap_enter(heap);
+
+    aug_context* context = aug_vm_context_new(vm, heap, stack_size);
+    context->script = script;
+#if AUG_QUICKEN
+    // The script bytecode is shared with other threads, the context quickens its own copy
+    char* bytecode = (char*)AUG_ALLOC(script->bytecode_size);
+    memcpy(bytecode, script->bytecode, script->bytecode_size);
+    context->bytecode = bytecode;
+#else
+    context->bytecode = script->bytecode;
+#endif//AUG_QUICKEN
+    context->registers = script->backend == AUG_BACKEND_REGISTER;
+#if AUG_JIT
+    context->jit = aug_jit_new(context->bytecode, script->bytecode_size);
+#endif//AUG_JIT
+    context->instruction = NULL;
+    context->valid = true;
+    context->markers = script->markers;
+    context->lib_extensions = script->lib_extensions;
+    context->extension_names = script->extension_names;
+
+    // Slots are resolved on the first extension call 
+    const size_t extension_count = script->extension_names->length;
+    context->extension_slots = (aug_extension_func**)AUG_ALLOC(sizeof(aug_extension_func*) * (extension_count > 0 ? extension_count : 1));
+    for(size_t i = 0; i < extension_count; ++i)
+        context->extension_slots[i] = NULL;
+    context->extension_version = 0;
+
+    // String constants are reference counted when pushed, the context requires its own copies
+    context->constants = aug_container_new_type(aug_string*, script->constants->length + 1);
+    for(size_t i = 0; i < script->constants->length; ++i)
+    {
+        const aug_string* str = aug_container_at_type(aug_string*, script->constants, i);
+        aug_string* constant = aug_string_create(str->buffer);
+        constant->constant = true;
+        aug_container_push_type(aug_string*, context->constants, constant);
+    }
+
+    // Globals remain on the stack, and persist between calls within this context
+    if(script->stack_state != NULL)
     {
-        AUG_FREE(range);
-        return NULL;    
+        for(size_t i = 0; i < script->stack_state->length; ++i)
+        {
+            aug_value* top = aug_vm_push(context);
+            if(top)
+                *top = aug_context_clone_value(aug_array_at(script->stack_state, i));
+        }
     }
-    return range;
+
+    aug_heap_leave(prev_heap);
+    return context;
 }
 
-void aug_range_incref(aug_range* range)
+void aug_context_delete(aug_context* context)
 {
-    if(range != NULL)
-        ++range->ref_count;
-}
+    if(context == NULL || context->script == NULL)
+        return;
 
-// SCRIPT ================================================= SCRIPT ============================================= SCRIPT // 
+    aug_heap* heap = context->heap;
+    aug_heap* prev_heap = aug_heap_enter(heap);
 
-aug_script* aug_script_new(aug_hashtable* globals, char* bytecode, aug_container* markers)
-{
-    aug_script* script = (aug_script*)AUG_ALLOC(sizeof(aug_script));
-    script->stack_state = NULL;
-    script->bytecode = bytecode;
+    aug_vm_shutdown(context);
 
-    script->globals = globals;
-    aug_hashtable_incref(script->globals);
+    for(size_t i = 0; i < context->constants->length; ++i)
+        aug_string_decref(aug_container_at_type(aug_string*, context->constants, i));
+    context->constants = aug_container_decref(context->constants);
+    AUG_FREE(context->extension_slots);
+#if AUG_QUICKEN
+    AUG_FREE((char*)context->bytecode);
+#endif//AUG_QUICKEN
+#if AUG_JIT
+    aug_jit_delete(context->jit);
+#endif//AUG_JIT
 
-    script->markers = markers;
-    aug_container_incref(script->markers);
+#if AUG_LEAK_CHECK
+    aug_error_func* error_func = context->vm->error_func;
+#endif//AUG_LEAK_CHECK
 
-    script->lib_extensions = aug_hashtable_new_type(aug_extension);
+    aug_vm_context_delete(context);
 
-    return script;
+    // Release the cycles and deferred releases before reporting the values still alive
+    aug_heap_step(heap, 0);
+    aug_heap_leave(prev_heap);
+#if AUG_LEAK_CHECK
+    aug_heap_check_leaks(heap, error_func);
+#endif//AUG_LEAK_CHECK
+    aug_heap_delete(heap);
 }
 
-void aug_script_delete(aug_script* script)
+aug_value aug_context_call_handle(aug_context* context, aug_function function, int argc, aug_value* args)
 {
-    if (script == NULL)
-        return;
+    if (context == NULL || context->script == NULL || !context->valid || function.script != context->script)
+        return aug_none();
 
-    if (script->stack_state != NULL)
-    {
-        for (size_t i = 0; i < script->stack_state->length; ++i)
-        {
-            aug_value* value = aug_array_at(script->stack_state, i);
-            aug_decref(value);
-        }
-    }
-    script->globals = aug_hashtable_decref(script->globals);
-    script->stack_state = aug_array_decref(script->stack_state);
-    script->lib_extensions = aug_hashtable_decref(script->lib_extensions);
+    if (!aug_call_handle_valid(context->vm, function, argc))
+        return aug_none();
 
-    if(script->markers->ref_count == 1)
-    {
-        for(size_t i = 0; i < script->markers->length; ++i)
-        {
-            aug_trace_marker* marker = aug_container_ptr_type(aug_trace_marker, script->markers, i);
-            marker->symbol_name = aug_string_decref(marker->symbol_name);
-            marker->filename = aug_string_decref(marker->filename);
-        }
-    }
-    script->markers = aug_container_decref(script->markers);
+    aug_heap* prev_heap = aug_heap_enter(context->heap);
 
-    if (script->bytecode != NULL)
-        AUG_FREE(script->bytecode);
-    AUG_FREE(script);
-}
+    const int globals_index = context->stack_index;
+    aug_value ret_value = aug_vm_execute_from_frame(context, function.addr, argc, args);
 
-// API ================================================= API ====================================================== API // 
+    // Discard any values left by a failed call, keeping the globals
+    while(context->stack_index > globals_index)
+        aug_decref(aug_vm_pop(context));
+
+    aug_heap_execute_step(context->heap);
+    aug_heap_leave(prev_heap);
+    return ret_value;
+}
 
-aug_vm* aug_startup(aug_error_func* error_func)
+int aug_context_call_batch(aug_context* context, aug_function function, int count, int argc, aug_value* args, aug_value* results)
 {
-    // If assert fails, Opcode count is too large. This will affect bytecode instruction set. If bumping aug_opcode type, ensure bytecode offsets are corrected
-    assert(AUG_OPCODE_COUNT < 255);
+    if (context == NULL || context->script == NULL || !context->valid || function.script != context->script || count <= 0)
+        return 0;
 
-    // If fails, Ensure enough bytes to contain both int and float data types when type punning
-    // Check in the aug_ir_operand's union byte array and the aug_vm_bytecode_value's union byte array
-    assert(sizeof(float) >= sizeof(int));
+    if (!aug_call_handle_valid(context->vm, function, argc))
+        return 0;
 
-    aug_vm* vm = (aug_vm*)AUG_ALLOC(sizeof(aug_vm));
+    aug_heap* prev_heap = aug_heap_enter(context->heap);
+    const int returned = aug_vm_execute_batch(context, function.addr, count, argc, args, results);
+    aug_heap_execute_step(context->heap);
+    aug_heap_leave(prev_heap);
+    return returned;
+}
 
-    for (size_t i = 0; i < AUG_STACK_SIZE; ++i)
-        vm->stack[i] = aug_none();
+aug_value aug_context_call_args(aug_context* context, const char* func_name, int argc, aug_value* args)
+{
+    if (context == NULL || context->script == NULL)
+        return aug_none();
 
-    aug_vm_startup(vm);
+    return aug_context_call_handle(context, aug_get_function(context->vm, context->script, func_name), argc, args);
+}
 
-    // Initialize global vm state, non script context sensitive
-    vm->extensions = aug_hashtable_new_type(aug_extension);
-    vm->libs = aug_container_new_type(aug_lib_handle, 1);
-    vm->error_func = error_func;
-    vm->exec_filepath = NULL;
-#if AUG_DEBUG
-    vm->debug_post_instruction = NULL;
-#endif// AUG_DEBUG
-    return vm;
+aug_value aug_context_call(aug_context* context, const char* func_name)
+{
+    return aug_context_call_args(context, func_name, 0, NULL);
 }
 
-void aug_shutdown(aug_vm* vm)
+aug_profiler* aug_profiler_new()
 {
-    // Deinitialize global vm state, non script context sensitive
-    // Unregister all extensions and lib extensions
-    for (size_t i = 0; i < vm->libs->length; ++i)
-    {
-        aug_lib_handle handle = aug_container_at_type(aug_lib_handle, vm->libs, i);
-        aug_vm_lib_unload(vm, handle);
-    }
+    aug_profiler* profiler = (aug_profiler*)AUG_ALLOC(sizeof(aug_profiler));
+    profiler->root.name = NULL;
+    profiler->root.parent = NULL;
+    profiler->root.child = NULL;
+    profiler->root.sibling = NULL;
+    profiler->lines = aug_hashtable_new(0, sizeof(aug_profile_line), aug_hashtable_hash_default, aug_profile_line_free);
+    profiler->opcode = AUG_OPCODE_COUNT;
+    aug_profiler_reset(profiler);
+    return profiler;
+}
 
-    vm->libs = aug_container_decref(vm->libs);
-    vm->extensions = aug_hashtable_decref(vm->extensions);
+void aug_profiler_delete(aug_profiler* profiler)
+{
+    if(profiler == NULL)
+        return;
 
-    aug_vm_shutdown(vm);
-    AUG_FREE(vm);
+    aug_profile_node_delete(&profiler->root);
+    aug_hashtable_decref(profiler->lines);
+    AUG_FREE(profiler);
 }
 
-void aug_register(aug_vm* vm, const char* func_name, aug_extension_func* extension_func)
+void aug_profiler_reset(aug_profiler* profiler)
 {
-    if(vm->running && vm->lib_extensions != NULL)
-    {
-        if(aug_hashtable_get(vm->lib_extensions, func_name) != 0)
-        {
-            aug_log_vm_warn(vm, "Failed to register library extension Function %s. Already registered!", func_name);
-            return;
-        }
-
-        aug_extension* extension = aug_hashtable_insert_type(aug_extension, vm->lib_extensions, func_name);
-        if(extension != NULL)
-            extension->func = extension_func;
+    if(profiler == NULL)
         return;
-    }
 
-    if(aug_hashtable_get(vm->extensions, func_name) != 0)
+    for(int i = 0; i < AUG_OPCODE_COUNT; ++i)
     {
-        aug_log_vm_warn(vm, "Failed to register library extension Function %s. Already registered!", func_name);
-        return;
+        profiler->opcode_counts[i] = 0;
+        profiler->opcode_ticks[i] = 0;
     }
+    aug_profile_node_reset(&profiler->root);
 
-    aug_extension* extension = aug_hashtable_insert_type(aug_extension, vm->extensions, func_name);
-    if(extension != NULL)
-        extension->func = extension_func;
+    aug_hashtable_decref(profiler->lines);
+    profiler->lines = aug_hashtable_new(0, sizeof(aug_profile_line), aug_hashtable_hash_default, aug_profile_line_free);
 }
 
-void aug_unregister(aug_vm* vm, const char* func_name)
+void aug_context_profile(aug_context* context, aug_profiler* profiler)
 {
-    if(vm->running && vm->lib_extensions != NULL)
-    {        
-        if(!aug_hashtable_remove(vm->lib_extensions, func_name))
-            aug_log_vm_warn(vm, "Failed to unregister library extension Function %s. Not registered!", func_name);
+    if(context == NULL)
         return;
-    }
 
-    if(!aug_hashtable_remove(vm->extensions, func_name))
-        aug_log_vm_warn(vm, "Failed to unregister extension Function %s. Not registered!", func_name);
+    context->profiler = profiler;
+    context->profile_node = NULL;
 }
 
-aug_script* aug_compile(aug_vm* vm, const char* filename)
+void aug_profile(aug_vm* vm, aug_profiler* profiler)
 {
-    if(vm == NULL || filename == NULL)
-        return NULL;
+    if(vm != NULL)
+        aug_context_profile(vm->context, profiler);
+}
 
-    aug_input* input = aug_input_open(filename, vm->error_func);
-    aug_ast* root = aug_parse(input);
-    if (root == NULL)
-    {
-        aug_input_close(input);
-        return NULL;
-    }
+aug_vm_stats aug_context_get_stats(aug_context* context)
+{
+    aug_vm_stats stats;
+    memset(&stats, 0, sizeof(aug_vm_stats));
+    if(context == NULL)
+        return stats;
 
-    aug_ir* ir = aug_generate_ir(vm, root, input);
-    char* bytecode = aug_generate_bytecode(ir);
-    if(bytecode == NULL)
-    {
-        aug_ir_delete(ir);
-        aug_ast_delete(root);
-        aug_input_close(input);
-        return NULL;
-    }
+    const aug_heap* heap = context->heap;
+    stats.live_bytes = heap->live_bytes;
+    stats.peak_bytes = heap->peak_bytes;
+    stats.alloc_count = heap->alloc_count;
+    stats.free_count = heap->free_count;
+    stats.live_strings = heap->live_elements[AUG_POOL_STRING];
+    stats.live_arrays = heap->live_elements[AUG_POOL_ARRAY];
+    stats.live_maps = heap->live_elements[AUG_POOL_MAP];
+    stats.live_iterators = heap->live_elements[AUG_POOL_ITERATOR];
+    stats.live_ranges = heap->live_elements[AUG_POOL_RANGE];
+    stats.live_typed_arrays = heap->live_elements[AUG_POOL_TYPED_ARRAY];
+    stats.live_buffer_views = heap->live_elements[AUG_POOL_BUFFER_VIEW];
+    stats.incref_count = heap->incref_count;
+    stats.decref_count = heap->decref_count;
+    stats.collected_count = heap->collected_count;
+    return stats;
+}
 
-    aug_script* script = aug_script_new(ir->globals, bytecode, ir->markers);
-    
-    aug_ir_delete(ir);
-    aug_ast_delete(root);
-    aug_input_close(input);
+aug_vm_stats aug_get_stats(aug_vm* vm)
+{
+    return aug_context_get_stats(vm != NULL ? vm->context : NULL);
+}
 
-    return script;
+size_t aug_context_collect(aug_context* context, size_t budget)
+{
+    if(context == NULL)
+        return 0;
+    return aug_heap_step(context->heap, budget);
 }
 
-aug_value aug_eval(aug_vm* vm, const char* code)
-{    
-    if(vm == NULL || code == NULL)
-        return aug_none();
+size_t aug_collect(aug_vm* vm, size_t budget)
+{
+    return aug_context_collect(vm != NULL ? vm->context : NULL, budget);
+}
 
-    aug_input* input = aug_input_open_code(code, vm->error_func);
-    aug_ast* root = aug_parse(input);
-    if (root == NULL)
+static void aug_profiler_write_string(FILE* file, const char* str)
+{
+    fputc('"', file);
+    for(; *str; ++str)
     {
-        aug_input_close(input);
-        return aug_none();
+        if(*str == '"' || *str == '\\')
+            fprintf(file, "\\%c", *str);
+        else if((unsigned char)*str < 0x20)
+            fprintf(file, "\\u%04x", (unsigned char)*str);
+        else
+            fputc(*str, file);
     }
+    fputc('"', file);
+}
 
-    aug_ir* ir = aug_generate_ir(vm, root, input);
-    char* bytecode = aug_generate_bytecode(ir);
-    if(bytecode == NULL)
+// Writes the function names from the root to the node, separated by semicolons
+static void aug_profiler_write_stack(FILE* file, const aug_profile_node* node)
+{
+    if(node->parent == NULL)
     {
-        aug_ir_delete(ir);
-        aug_ast_delete(root);
-        aug_input_close(input);
-        return aug_none();
+        fputs("(global)", file);
+        return;
     }
+    if(node->parent->parent != NULL)
+    {
+        aug_profiler_write_stack(file, node->parent);
+        fputc(';', file);
+    }
+    fputs(node->name, file);
+}
 
-    aug_script* script = aug_script_new(ir->globals, bytecode, ir->markers);
-    
-    aug_ir_delete(ir);
-    aug_ast_delete(root);
-    aug_input_close(input);
-
-    aug_vm_startup(vm);
-    aug_vm_load_script(vm, script);
-    aug_vm_execute(vm);
+static void aug_profiler_write_collapsed(FILE* file, const aug_profile_node* node)
+{
+    if(node->ticks > 0)
+    {
+        aug_profiler_write_stack(file, node);
+        fprintf(file, " %llu\n", (unsigned long long)node->ticks);
+    }
+    for(const aug_profile_node* child = node->child; child != NULL; child = child->sibling)
+        aug_profiler_write_collapsed(file, child);
+}
 
-    aug_value* ret = aug_vm_pop(vm);
+typedef struct aug_profile_function
+{
+    const char* name;
+    uint64_t calls;
+    uint64_t ticks;       // self ticks
+    uint64_t total_ticks; // ticks including the called functions
+} aug_profile_function;
 
-    aug_vm_shutdown(vm);
-    aug_script_delete(script);
-    return *ret;
-}
+typedef struct aug_profiler_writer
+{
+    FILE* file;
+    bool first; // the next element is the first of its list
+} aug_profiler_writer;
 
-void aug_execute(aug_vm* vm, const char* filename)
+// Returns the ticks of the node including its children. Recursive calls are only added to the outermost call's total
+static uint64_t aug_profiler_gather_functions(aug_hashtable* functions, const aug_profile_node* node)
 {
-    aug_script* script = aug_compile(vm, filename);
+    uint64_t total_ticks = node->ticks;
+    for(const aug_profile_node* child = node->child; child != NULL; child = child->sibling)
+        total_ticks += aug_profiler_gather_functions(functions, child);
 
-    aug_vm_startup(vm);
-    aug_vm_load_script(vm, script);
-    aug_vm_execute(vm);
-    aug_vm_shutdown(vm);
+    if(node->name == NULL)
+        return total_ticks;
 
-    aug_script_delete(script);
-}
+    aug_profile_function* function = aug_hashtable_ptr_type(aug_profile_function, functions, node->name);
+    if(function == NULL)
+    {
+        function = aug_hashtable_insert_type(aug_profile_function, functions, node->name);
+        function->name = node->name;
+        function->calls = 0;
+        function->ticks = 0;
+        function->total_ticks = 0;
+    }
+    function->calls += node->calls;
+    function->ticks += node->ticks;
 
-aug_script* aug_load(aug_vm* vm, const char* filename)
-{
-    // TODO: check file ext. If is a script, compile, else load bytecode
-    aug_script* script = aug_compile(vm, filename);
-    aug_vm_load_script(vm, script);
-    aug_vm_execute(vm);
-    aug_vm_save_script(vm, script);
-    return script;
+    bool recursive = false;
+    for(const aug_profile_node* parent = node->parent; parent != NULL && !recursive; parent = parent->parent)
+        recursive = parent->name != NULL && strcmp(parent->name, node->name) == 0;
+    if(!recursive)
+        function->total_ticks += total_ticks;
+
+    return total_ticks;
 }
 
-void aug_unload(aug_vm* vm, aug_script* script)
+static void aug_profiler_write_function(uint8_t* data, void* user_data)
 {
-    aug_vm_unload_script(vm, script);
-    aug_script_delete(script);
+    const aug_profile_function* function = (const aug_profile_function*)data;
+    aug_profiler_writer* writer = (aug_profiler_writer*)user_data;
+
+    fprintf(writer->file, "%s\n    {\"name\": ", writer->first ? "" : ",");
+    aug_profiler_write_string(writer->file, function->name);
+    fprintf(writer->file, ", \"calls\": %llu, \"ticks\": %llu, \"total_ticks\": %llu}", 
+        (unsigned long long)function->calls, (unsigned long long)function->ticks, (unsigned long long)function->total_ticks);
+    writer->first = false;
 }
 
-aug_value aug_call_args(aug_vm* vm, aug_script* script, const char* func_name, int argc, aug_value* args)
+static void aug_profiler_write_line(uint8_t* data, void* user_data)
 {
-    if (vm == NULL || script == NULL)
-        return aug_none();
+    const aug_profile_line* line = (const aug_profile_line*)data;
+    aug_profiler_writer* writer = (aug_profiler_writer*)user_data;
 
-    aug_value ret_value = aug_none();
-    if (script->bytecode == NULL)
-        return ret_value;
+    fprintf(writer->file, "%s\n    {\"file\": ", writer->first ? "" : ",");
+    aug_profiler_write_string(writer->file, line->filename);
+    fprintf(writer->file, ", \"line\": %zu, \"samples\": %llu, \"ticks\": %llu}", 
+        line->line, (unsigned long long)line->samples, (unsigned long long)line->ticks);
+    writer->first = false;
+}
 
-    aug_symbol* symbol_ptr = aug_hashtable_ptr_type(aug_symbol, script->globals, func_name);
-    if (symbol_ptr == NULL || symbol_ptr->type == AUG_SYM_NONE)
+static void aug_profiler_write_stacks(aug_profiler_writer* writer, const aug_profile_node* node)
+{
+    if(node->ticks > 0 || node->calls > 0)
     {
-        aug_log_error(vm->error_func, "Function %s not defined", func_name);
-        return ret_value;
+        fprintf(writer->file, "%s\n    {\"stack\": \"", writer->first ? "" : ",");
+        aug_profiler_write_stack(writer->file, node);
+        fprintf(writer->file, "\", \"calls\": %llu, \"ticks\": %llu}", 
+            (unsigned long long)node->calls, (unsigned long long)node->ticks);
+        writer->first = false;
     }
+    for(const aug_profile_node* child = node->child; child != NULL; child = child->sibling)
+        aug_profiler_write_stacks(writer, child);
+}
 
-    aug_symbol symbol = *symbol_ptr; 
-    switch (symbol.type)
-    {
-    case AUG_SYM_FUNC:
-        break;
-    case AUG_SYM_VAR:
-        aug_log_error(vm->error_func, "Can not call variable %s a function", func_name);
-        return ret_value;
-    default:
-        aug_log_error(vm->error_func, "Symbol %s not defined as a function", func_name);
-        return ret_value;
-    }
+static void aug_profiler_write_json(FILE* file, const aug_profiler* profiler)
+{
+    aug_profiler_writer writer;
+    writer.file = file;
 
-    if (symbol.argc != argc)
+    fprintf(file, "{\n  \"opcodes\": [");
+    writer.first = true;
+    for(int i = 0; i < AUG_OPCODE_COUNT; ++i)
     {
-        aug_log_error(vm->error_func, "Function %s passed %d arguments, expected %d", func_name, argc, symbol.argc);
-        return ret_value;
+        if(profiler->opcode_counts[i] == 0)
+            continue;
+        fprintf(file, "%s\n    {\"opcode\": \"%s\", \"count\": %llu, \"ticks\": %llu}", writer.first ? "" : ",",
+            aug_opcode_label((uint8_t)i), (unsigned long long)profiler->opcode_counts[i], (unsigned long long)profiler->opcode_ticks[i]);
+        writer.first = false;
     }
 
-    aug_vm_startup(vm);
-    aug_vm_load_script(vm, script);
+    fprintf(file, "\n  ],\n  \"functions\": [");
+    aug_hashtable* functions = aug_hashtable_new_type(aug_profile_function);
+    aug_profiler_gather_functions(functions, &profiler->root);
+    writer.first = true;
+    aug_hashtable_foreach(functions, aug_profiler_write_function, &writer);
+    aug_hashtable_decref(functions);
 
-    // Setup base index to be current stack index
-    const int func_addr = symbol.offset;
-    ret_value = aug_vm_execute_from_frame(vm, func_addr, argc, args);
+    fprintf(file, "\n  ],\n  \"lines\": [");
+    writer.first = true;
+    aug_hashtable_foreach(profiler->lines, aug_profiler_write_line, &writer);
 
-    aug_vm_save_script(vm, script);
-    aug_vm_shutdown(vm);
-
-    return ret_value;
+    // Function names are written unescaped within the stack string, as script identifiers do not contain special characters
+    fprintf(file, "\n  ],\n  \"stacks\": [");
+    writer.first = true;
+    aug_profiler_write_stacks(&writer, &profiler->root);
+    fprintf(file, "\n  ]\n}\n");
 }
 
-aug_value aug_call(aug_vm* vm, aug_script* script, const char* func_name)
+bool aug_profiler_save(const aug_profiler* profiler, const char* filename, aug_profile_format format)
 {
-    return aug_call_args(vm, script, func_name, 0, NULL);
+    if(profiler == NULL || filename == NULL)
+        return false;
+
+#ifdef AUG_SECURE
+    FILE* file;
+    fopen_s(&file, filename, "w");
+#else
+    FILE* file = fopen(filename, "w");
+#endif //AUG_SECURE
+
+    if(file == NULL)
+        return false;
+
+    switch(format)
+    {
+    case AUG_PROFILE_COLLAPSED:
+        aug_profiler_write_collapsed(file, &profiler->root);
+        break;
+    case AUG_PROFILE_JSON:
+        aug_profiler_write_json(file, profiler);
+        break;
+    }
+
+    const bool success = ferror(file) == 0;
+    fclose(file);
+    return success;
 }
 
 void aug_save_state(aug_vm* vm, aug_vm_exec_state* exec_state)
@@ -7031,23 +14505,37 @@ void aug_save_state(aug_vm* vm, aug_vm_exec_state* exec_state)
     if (vm == NULL || exec_state == NULL)
         return;
 
-    exec_state->bytecode = vm->bytecode;
-    exec_state->base_index = vm->base_index;
-    exec_state->instruction = vm->instruction;
-    exec_state->last_instruction = vm->last_instruction;
-    exec_state->markers = vm->markers; 
-    exec_state->lib_extensions = vm->lib_extensions;
+    exec_state->bytecode = vm->context->bytecode;
+    exec_state->registers = vm->context->registers;
+    exec_state->base_index = vm->context->base_index;
+    exec_state->instruction = vm->context->instruction;
+    exec_state->last_instruction = vm->context->last_instruction;
+    exec_state->markers = vm->context->markers; 
+    exec_state->lib_extensions = vm->context->lib_extensions;
+    exec_state->extension_names = vm->context->extension_names;
+    exec_state->extension_slots = vm->context->extension_slots;
+    exec_state->extension_version = vm->context->extension_version;
+    exec_state->constants = vm->context->constants;
+    exec_state->globals = vm->context->globals;
+    exec_state->globals_size = vm->context->globals_size;
+    exec_state->arg_count = vm->context->arg_count;
+    exec_state->coroutine = vm->context->coroutine;
+    exec_state->budget = vm->context->budget;
+    exec_state->profile_node = vm->context->profile_node;
+#if AUG_JIT
+    exec_state->jit = vm->context->jit;
+#endif//AUG_JIT
 
     // reset script stack state to match vm
-    if (vm->stack_index > 0)
+    if (vm->context->stack_index > 0)
     {
-        exec_state->stack_state = aug_array_new(vm->stack_index);
-        exec_state->stack_state->length = vm->stack_index;
+        exec_state->stack_state = aug_array_new(vm->context->stack_index);
+        exec_state->stack_state->length = vm->context->stack_index;
 
-        while (vm->stack_index > 0)
+        while (vm->context->stack_index > 0)
         {
-            aug_value* top = aug_vm_pop(vm);
-            aug_value* element = aug_array_at(exec_state->stack_state, vm->stack_index);
+            aug_value* top = aug_vm_pop(vm->context);
+            aug_value* element = aug_array_at(exec_state->stack_state, vm->context->stack_index);
             aug_incref(top);
             *element = *top;
         }
@@ -7061,26 +14549,115 @@ void aug_load_state(aug_vm* vm, aug_vm_exec_state* exec_state)
     if (vm == NULL || exec_state == NULL)
         return;
 
-    vm->bytecode = exec_state->bytecode;
-    vm->base_index = exec_state->base_index;
-    vm->instruction = exec_state->instruction;
-    vm->last_instruction = exec_state->last_instruction;
-    vm->markers = exec_state->markers;
-    vm->lib_extensions = exec_state->lib_extensions;
+    vm->context->bytecode = exec_state->bytecode;
+    vm->context->registers = exec_state->registers;
+    vm->context->base_index = exec_state->base_index;
+    vm->context->instruction = exec_state->instruction;
+    vm->context->last_instruction = exec_state->last_instruction;
+    vm->context->markers = exec_state->markers;
+    vm->context->lib_extensions = exec_state->lib_extensions;
+    vm->context->extension_names = exec_state->extension_names;
+    vm->context->extension_slots = exec_state->extension_slots;
+    vm->context->extension_version = exec_state->extension_version;
+    vm->context->constants = exec_state->constants;
+    vm->context->globals = exec_state->globals;
+    vm->context->globals_size = exec_state->globals_size;
+    vm->context->arg_count = exec_state->arg_count;
+    vm->context->coroutine = exec_state->coroutine;
+    vm->context->budget = exec_state->budget;
+    vm->context->profile_node = exec_state->profile_node;
+#if AUG_JIT
+    vm->context->jit = exec_state->jit;
+#endif//AUG_JIT
 
     if (exec_state->stack_state != NULL)
     {
         for (size_t i = 0; i < exec_state->stack_state->length; ++i)
         {
-            aug_value* top = aug_vm_push(vm);
+            aug_value* top = aug_vm_push(vm->context);
             aug_value* element = aug_array_at(exec_state->stack_state, i);
-            aug_decref(top);
             *top = *element;
         }
     }
     exec_state->stack_state = aug_array_decref(exec_state->stack_state);
 }
 
+aug_snapshot* aug_snapshot_save(aug_vm* vm, aug_script* script)
+{
+    if(vm == NULL || script == NULL)
+        return NULL;
+
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
+    aug_array* globals = script->stack_state;
+    const size_t globals_count = globals ? globals->length : 0;
+    aug_snapshot* snapshot = aug_snapshot_new(vm->heap, globals_count);
+    for(size_t i = 0; i < globals_count; ++i)
+    {
+        snapshot->globals[i] = globals->buffer[i];
+        aug_incref(&snapshot->globals[i]);
+    }
+    aug_snapshot_open(snapshot);
+    aug_heap_leave(prev_heap);
+    return snapshot;
+}
+
+bool aug_snapshot_restore(aug_vm* vm, aug_script* script, aug_snapshot* snapshot)
+{
+    if(vm == NULL || script == NULL || snapshot == NULL || snapshot->heap != vm->heap)
+        return false;
+
+    aug_array* globals = script->stack_state;
+    if((globals ? globals->length : 0) != snapshot->globals_count)
+        return false;
+
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
+    aug_snapshot_apply(snapshot, globals ? globals->buffer : NULL, true);
+    aug_heap_execute_step(vm->heap);
+    aug_heap_leave(prev_heap);
+    return true;
+}
+
+void aug_snapshot_delete(aug_snapshot* snapshot)
+{
+    if(snapshot == NULL)
+        return;
+
+    aug_heap* prev_heap = aug_heap_enter(snapshot->heap);
+    aug_snapshot_close(snapshot);
+    aug_snapshot_free(snapshot);
+    aug_heap_leave(prev_heap);
+}
+
+size_t aug_snapshot_serialize(const aug_snapshot* snapshot, char* buffer, size_t size)
+{
+    if(snapshot == NULL)
+        return 0;
+
+    aug_heap* prev_heap = aug_heap_enter(snapshot->heap);
+    aug_snapshot* expanded = aug_snapshot_expand(snapshot);
+    aug_snapshot_writer writer;
+    writer.buffer = buffer;
+    writer.size = buffer != NULL ? size : 0;
+    writer.pos = 0;
+    const size_t written = aug_snapshot_write_all(expanded, &writer);
+    aug_snapshot_free(expanded);
+    aug_heap_leave(prev_heap);
+    return written;
+}
+
+aug_snapshot* aug_snapshot_deserialize(aug_vm* vm, const char* data, size_t size)
+{
+    if(vm == NULL || data == NULL)
+        return NULL;
+
+    aug_heap* prev_heap = aug_heap_enter(vm->heap);
+    aug_snapshot* snapshot = aug_snapshot_read(vm->heap, data, size);
+    if(snapshot != NULL)
+        aug_snapshot_open(snapshot);
+    aug_heap_leave(prev_heap);
+    return snapshot;
+}
+
 aug_value aug_create_bool(bool data)
 {
     aug_value value;
@@ -7119,8 +14696,7 @@ aug_value aug_create_string(const char* data)
 aug_value aug_create_user_data(void* userdata)
 {
     aug_value value;
-    value.type = AUG_USERDATA;
-    value.userdata = userdata;
+    aug_value_init_pointer(&value, AUG_USERDATA, userdata);
     return value;
 }
 
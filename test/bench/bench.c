@@ -0,0 +1,326 @@
+// Benchmark harness. Each benchmark script defines a bench function that runs the workload once, and returns the
+// number of operations performed. The harness loads the script, calls bench for the warmup iterations, then times the
+// measured iterations. Results are reported per operation, and optionally written to a JSON file
+//
+// usage: aug_bench [--warmup N] [--iterations N] [--backend N] [--output file.json] [--no-eval] bench_scripts...
+//  --backend compiles the scripts for the aug_backend, to compare the stack and register backends
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Count the engine's allocations. All VM and container allocations use these when the VM has no allocator
+static uint64_t s_bench_alloc_count = 0;
+
+static void* bench_alloc(size_t size)
+{
+    ++s_bench_alloc_count;
+    return malloc(size);
+}
+
+static void* bench_realloc(void* ptr, size_t size)
+{
+    if(ptr == NULL)
+        ++s_bench_alloc_count;
+    return realloc(ptr, size);
+}
+
+#define AUG_ALLOC(size) bench_alloc(size)
+#define AUG_REALLOC(ptr, size) bench_realloc(ptr, size)
+#define AUG_FREE(ptr) free(ptr)
+
+#define AUG_IMPLEMENTATION
+#include <aug.h>
+
+#include <string.h>
+#if _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#define BENCH_WARMUP_DEFAULT 2
+#define BENCH_ITERATIONS_DEFAULT 10
+#define BENCH_ITERATIONS_MAX 1000
+#define BENCH_EVAL_COUNT 1000 // aug_eval calls per iteration of the eval benchmark
+
+static const char* s_bench_eval_code =
+    "func square(x) { return x * x; } "
+    "var total = 0; "
+    "for i in 0:10 { total += square(i); } "
+    "total";
+
+typedef struct bench_result
+{
+    const char* name;
+    bool valid;
+    uint64_t ops;          // operations per iteration
+    uint64_t instructions; // vm instructions per iteration
+    uint64_t allocations;  // allocations per iteration
+    uint64_t min_ns;
+    uint64_t median_ns;
+} bench_result;
+
+typedef struct bench_config
+{
+    int warmup;
+    int iterations;
+    int backend;
+} bench_config;
+
+static int s_bench_errors = 0;
+
+static uint64_t bench_time_ns()
+{
+#if _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+#endif
+}
+
+static void bench_on_error(const char* msg)
+{
+    ++s_bench_errors;
+    fprintf(stderr, "aug_bench: %s\n", msg);
+}
+
+static aug_value bench_expect(int argc, aug_value* args)
+{
+    if (argc > 0 && !aug_to_bool(&args[0]))
+    {
+        ++s_bench_errors;
+        fprintf(stderr, "aug_bench: expect failed");
+        for (int i = 1; i < argc; ++i)
+        {
+            if (aug_value_type(&args[i]) == AUG_STRING)
+                fprintf(stderr, "%s", aug_value_string(&args[i])->buffer);
+            else if (aug_value_type(&args[i]) == AUG_INT)
+                fprintf(stderr, "%d", aug_value_int(&args[i]));
+        }
+        fprintf(stderr, "\n");
+    }
+    return aug_none();
+}
+
+static int bench_compare_ns(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a;
+    const uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t bench_profiled_instructions(const aug_profiler* profiler)
+{
+    uint64_t instructions = 0;
+    for (int i = 0; i < AUG_OPCODE_COUNT; ++i)
+        instructions += profiler->opcode_counts[i];
+    return instructions;
+}
+
+// Runs a single iteration of the benchmark, returns the operation count
+typedef uint64_t(bench_func)(aug_vm* vm, void* user);
+
+static uint64_t bench_script_iteration(aug_vm* vm, void* user)
+{
+    aug_value ret = aug_call_handle(vm, *(aug_function*)user, 0, NULL);
+    const uint64_t ops = aug_value_type(&ret) == AUG_INT && aug_value_int(&ret) > 0 ? (uint64_t)aug_value_int(&ret) : 1;
+    aug_decref(&ret);
+    return ops;
+}
+
+static uint64_t bench_eval_iteration(aug_vm* vm, void* user)
+{
+    for (int i = 0; i < BENCH_EVAL_COUNT; ++i)
+    {
+        aug_value ret = aug_eval(vm, s_bench_eval_code);
+        if (aug_value_type(&ret) != AUG_INT || aug_value_int(&ret) != 285)
+            ++s_bench_errors;
+        aug_decref(&ret);
+    }
+    return BENCH_EVAL_COUNT;
+}
+
+static void bench_measure(aug_vm* vm, const bench_config* config, bench_func* func, void* user, bench_result* result)
+{
+    const int errors = s_bench_errors;
+
+    for (int i = 0; i < config->warmup; ++i)
+        func(vm, user);
+
+    // Count the instructions of an iteration separately, as profiling slows down execution
+    aug_profiler* profiler = aug_profiler_new();
+    aug_profile(vm, profiler);
+    func(vm, user);
+    aug_profile(vm, NULL);
+    result->instructions = bench_profiled_instructions(profiler);
+    aug_profiler_delete(profiler);
+
+    uint64_t times[BENCH_ITERATIONS_MAX];
+    const uint64_t alloc_count = s_bench_alloc_count;
+    for (int i = 0; i < config->iterations; ++i)
+    {
+        const uint64_t start = bench_time_ns();
+        result->ops = func(vm, user);
+        times[i] = bench_time_ns() - start;
+    }
+    result->allocations = (s_bench_alloc_count - alloc_count) / config->iterations;
+
+    qsort(times, config->iterations, sizeof(uint64_t), bench_compare_ns);
+    result->min_ns = times[0];
+    result->median_ns = times[config->iterations / 2];
+    result->valid = s_bench_errors == errors;
+}
+
+static void bench_script(aug_vm* vm, const bench_config* config, const char* filename, bench_result* result)
+{
+    result->valid = false;
+    result->ops = 0;
+
+    aug_script* script = aug_load(vm, filename);
+    if (script == NULL)
+        return;
+
+    aug_function function = aug_get_function(vm, script, "bench");
+    if (function.addr >= 0)
+        bench_measure(vm, config, bench_script_iteration, &function, result);
+    aug_unload(vm, script);
+}
+
+static const char* bench_name(const char* filename)
+{
+    const char* name = filename;
+    for (const char* c = filename; *c; ++c)
+    {
+        if (*c == '/' || *c == '\\')
+            name = c + 1;
+    }
+    return name;
+}
+
+static void bench_print(const bench_result* result)
+{
+    if (!result->valid)
+    {
+        printf("%-20s FAILED\n", result->name);
+        return;
+    }
+
+    const double ns_per_op = (double)result->median_ns / (double)result->ops;
+    const double instructions_per_sec = (double)result->instructions * 1e9 / (double)result->median_ns;
+    printf("%-20s %10.2f ns/op %10.3f ms (min %.3f) %12.0f instr/s %10llu allocs/run\n", result->name, ns_per_op,
+        result->median_ns / 1e6, result->min_ns / 1e6, instructions_per_sec, (unsigned long long)result->allocations);
+}
+
+static bool bench_write_json(const char* filename, const bench_config* config, const bench_result* results, int count)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL)
+        return false;
+
+    fprintf(file, "{\n  \"warmup\": %d,\n  \"iterations\": %d,\n  \"backend\": %d,\n  \"benchmarks\": [", 
+        config->warmup, config->iterations, config->backend);
+    for (int i = 0; i < count; ++i)
+    {
+        const bench_result* result = &results[i];
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"valid\": %s", i == 0 ? "" : ",", result->name, result->valid ? "true" : "false");
+        if (result->valid)
+        {
+            fprintf(file, ", \"ops\": %llu, \"ns_per_op\": %.3f, \"median_ns\": %llu, \"min_ns\": %llu, "
+                "\"instructions\": %llu, \"instructions_per_sec\": %.0f, \"allocations\": %llu",
+                (unsigned long long)result->ops, (double)result->median_ns / (double)result->ops,
+                (unsigned long long)result->median_ns, (unsigned long long)result->min_ns,
+                (unsigned long long)result->instructions, (double)result->instructions * 1e9 / (double)result->median_ns,
+                (unsigned long long)result->allocations);
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    const bool success = ferror(file) == 0;
+    fclose(file);
+    return success;
+}
+
+int main(int argc, char** argv)
+{
+    bench_config config;
+    config.warmup = BENCH_WARMUP_DEFAULT;
+    config.iterations = BENCH_ITERATIONS_DEFAULT;
+    config.backend = AUG_BACKEND;
+    const char* output = NULL;
+    bool eval = true;
+
+    int first_script = argc;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            config.warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            config.iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc)
+            config.backend = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else if (strcmp(argv[i], "--no-eval") == 0)
+            eval = false;
+        else
+        {
+            first_script = i;
+            break;
+        }
+    }
+
+    if (config.warmup < 0)
+        config.warmup = 0;
+    if (config.iterations < 1)
+        config.iterations = 1;
+    if (config.iterations > BENCH_ITERATIONS_MAX)
+        config.iterations = BENCH_ITERATIONS_MAX;
+
+    const int count = (argc - first_script) + (eval ? 1 : 0);
+    bench_result* results = (bench_result*)malloc(sizeof(bench_result) * (count > 0 ? count : 1));
+
+    aug_vm* vm = aug_startup(bench_on_error, NULL);
+    vm->backend = config.backend;
+    aug_register(vm, "expect", bench_expect);
+
+    int index = 0;
+    for (int i = first_script; i < argc; ++i, ++index)
+    {
+        results[index].name = bench_name(argv[i]);
+        bench_script(vm, &config, argv[i], &results[index]);
+        bench_print(&results[index]);
+    }
+
+    if (eval)
+    {
+        results[index].name = "eval";
+        bench_measure(vm, &config, bench_eval_iteration, NULL, &results[index]);
+        bench_print(&results[index]);
+        ++index;
+    }
+
+    aug_shutdown(vm);
+
+    bool success = true;
+    for (int i = 0; i < count; ++i)
+        success &= results[i].valid;
+
+    if (output != NULL && !bench_write_json(output, &config, results, count))
+    {
+        fprintf(stderr, "aug_bench: failed to write %s\n", output);
+        success = false;
+    }
+
+    free(results);
+    return success ? 0 : 1;
+}
@@ -75,6 +75,37 @@ void dump_ast(aug_ast* root)
     aug_string_decref(prefix);
 }
 
+void dump_ir_operand(aug_ir* ir, aug_ir_operand operand)
+{
+    switch (operand.type)
+    {
+    case AUG_IR_OPERAND_BOOL:
+        printf(" %s", operand.data.b ? "true" : "false");
+        break;
+    case AUG_IR_OPERAND_CHAR:
+        printf(" %c", operand.data.c);
+        break;
+    case AUG_IR_OPERAND_INT:
+        printf(" %d", operand.data.i);
+        break;
+    case AUG_IR_OPERAND_FLOAT:
+        printf(" %f", operand.data.f);
+        break;
+    case AUG_IR_OPERAND_BYTES:
+        printf(" %s", operand.data.str);
+        break;
+    case AUG_IR_OPERAND_SYMBOL:
+    {
+        aug_symbol* symbol = aug_hashtable_ptr_type(aug_symbol, ir->globals, operand.data.str);
+        assert(symbol);
+        printf(" %d:%s", symbol->offset, operand.data.str);
+        break;
+    }
+    case AUG_IR_OPERAND_NONE:
+        break;
+    }
+}
+
 void dump_ir(aug_ir* ir)
 {
     assert(ir && ir->operations);
@@ -86,33 +117,12 @@ void dump_ir(aug_ir* ir)
         aug_ir_operation operation = aug_container_at_type(aug_ir_operation, ir->operations, i);
 
         printf("%d\t\t%s", (int)operation.bytecode_offset, aug_opcode_label(operation.opcode));
-        aug_ir_operand operand = operation.operand;
-        switch (operand.type)
+        dump_ir_operand(ir, operation.operand);
+        dump_ir_operand(ir, operation.operand_ext);
+        if (operation.opcode == AUG_OPCODE_PUSH_STRING)
         {
-        case AUG_IR_OPERAND_BOOL:
-            printf(" %s", operand.data.b ? "true" : "false");
-            break;
-        case AUG_IR_OPERAND_CHAR:
-            printf(" %c", operand.data.c);
-            break;
-        case AUG_IR_OPERAND_INT:
-            printf(" %d", operand.data.i);
-            break;
-        case AUG_IR_OPERAND_FLOAT:
-            printf(" %f", operand.data.f);
-            break;
-        case AUG_IR_OPERAND_BYTES:
-            printf(" %s", operand.data.str);
-            break;
-        case AUG_IR_OPERAND_SYMBOL:
-        {
-            aug_symbol* symbol = aug_hashtable_ptr_type(aug_symbol, ir->globals, operand.data.str);
-            assert(symbol);
-            printf(" %d:%s", symbol->offset, operand.data.str);
-            break;
-        }
-        case AUG_IR_OPERAND_NONE:
-            break;
+            const aug_string* constant = aug_container_at_type(aug_string*, ir->constants, operation.operand.data.i);
+            printf(" \"%s\"", constant->buffer);
         }
 
         int addr = (int)operation.bytecode_offset;
@@ -152,7 +162,6 @@ void aug_dump_file(aug_vm* vm, const char* filename)
     aug_ir* ir = aug_generate_ir(vm, root, input);
     dump_ir(ir);
 
-    aug_ast_delete(root);
     aug_ir_delete(ir);
     aug_input_close(input);
 }
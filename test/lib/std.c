@@ -38,41 +38,41 @@ void aug_std_print_map_pair(const aug_value* key, aug_value* value, void* user_d
 
 void aug_std_print_value(const aug_value value)
 {
-	switch (value.type)
+	switch (aug_value_type(&value))
 	{
 	case AUG_NONE:
 		printf("none");
 		break;
 	case AUG_BOOL:
-		printf("%s", value.b ? "true" : "false");
+		printf("%s", aug_value_bool(&value) ? "true" : "false");
 		break;
 	case AUG_CHAR:
-		printf("%c", value.c);
+		printf("%c", aug_value_char(&value));
 		break;
 	case AUG_INT:
-		printf("%d", value.i);
+		printf("%d", aug_value_int(&value));
 		break;
 	case AUG_FLOAT:
-		printf("%0.3f", value.f);
+		printf("%0.3f", aug_value_float(&value));
 		break;
 	case AUG_STRING:
-		printf("%s", value.str->buffer);
+		printf("%s", aug_value_string(&value)->buffer);
 		break;
 	case AUG_OBJECT:
 		printf("object");
 		break;
 	case AUG_FUNCTION:
-		printf("function %d", value.i);
+		printf("function %d", aug_value_int(&value));
 		break;
 	case AUG_ARRAY:
 	{
 		printf("[");
-		for( size_t i = 0; i < value.array->length; ++i)
+		for( size_t i = 0; i < aug_value_array(&value)->length; ++i)
 		{
 			printf(" ");
-			const aug_value* entry = aug_array_at(value.array, i);
+			const aug_value* entry = aug_array_at(aug_value_array(&value), i);
 			aug_std_print_value(*entry);
-			if(entry->type == AUG_ARRAY) printf("\n");		
+			if(aug_value_type(entry) == AUG_ARRAY) printf("\n");		
 		}
 		printf(" ]");
 		break;
@@ -80,11 +80,37 @@ void aug_std_print_value(const aug_value value)
 	case AUG_MAP:
 	{		
 		printf("{");
-		aug_map_foreach(value.map, aug_std_print_map_pair, NULL);
+		aug_map_foreach(aug_value_map(&value), aug_std_print_map_pair, NULL);
 		printf("\n}");
 
 		break;
 	}
+	case AUG_TYPED_ARRAY:
+	{
+		printf("[");
+		for( size_t i = 0; i < aug_value_typed_array(&value)->length; ++i)
+		{
+			printf(" ");
+			aug_value entry;
+			aug_typed_array_get(aug_value_typed_array(&value), i, &entry);
+			aug_std_print_value(entry);
+		}
+		printf(" ]");
+		break;
+	}
+	case AUG_BUFFER_VIEW:
+	{
+		printf("[");
+		for( size_t i = 0; i < aug_value_buffer_view(&value)->length; ++i)
+		{
+			printf(" ");
+			aug_value entry;
+			aug_buffer_view_get(aug_value_buffer_view(&value), i, &entry);
+			aug_std_print_value(entry);
+		}
+		printf(" ]");
+		break;
+	}
 	default: break;
 	}
 }
@@ -104,24 +130,24 @@ aug_value aug_std_to_string(int argc, aug_value* args)
 
 	aug_value value = args[0];
    	char out[1024];
-    switch (value.type)
+    switch (aug_value_type(&value))
     {
     case AUG_NONE:
     	return aug_none();
     case AUG_BOOL:
-        snprintf(out, sizeof(out), "%s", value.b ? "true" : "false");
+        snprintf(out, sizeof(out), "%s", aug_value_bool(&value) ? "true" : "false");
         break;
 	case AUG_CHAR:
-        snprintf(out, sizeof(out), "%c", value.c);
+        snprintf(out, sizeof(out), "%c", aug_value_char(&value));
         break;
     case AUG_INT:
-        snprintf(out, sizeof(out), "%d", value.i);
+        snprintf(out, sizeof(out), "%d", aug_value_int(&value));
         break;
     case AUG_FLOAT:
-        snprintf(out, sizeof(out), "%0.3f", value.f);
+        snprintf(out, sizeof(out), "%0.3f", aug_value_float(&value));
         break;
     case AUG_STRING:
-        snprintf(out, sizeof(out), "%s", value.str->buffer);
+        snprintf(out, sizeof(out), "%s", aug_value_string(&value)->buffer);
         break;
     default:
     	return aug_none();
@@ -132,9 +158,9 @@ aug_value aug_std_to_string(int argc, aug_value* args)
 aug_value aug_std_get(int argc, aug_value* args)
 {
 	assert(argc == 2);
-	assert(args[0].type == AUG_MAP);
+	assert(aug_value_type(&args[0]) == AUG_MAP);
 
-	aug_value* elem = aug_map_get(args[0].map, args + 1);
+	aug_value* elem = aug_map_get(aug_value_map(&args[0]), args + 1);
 	if(elem == NULL)
 		return aug_none();
 	aug_incref(elem);
@@ -144,9 +170,9 @@ aug_value aug_std_get(int argc, aug_value* args)
 aug_value aug_std_exists(int argc, aug_value* args)
 {
 	assert(argc == 2);
-	assert(args[0].type == AUG_MAP);
+	assert(aug_value_type(&args[0]) == AUG_MAP);
 
-	aug_value* elem = aug_map_get(args[0].map, args + 1);
+	aug_value* elem = aug_map_get(aug_value_map(&args[0]), args + 1);
 	return aug_create_bool(elem != NULL);
 }
 
@@ -158,13 +184,13 @@ aug_value aug_std_concat(int argc, aug_value* args)
 	for (int i = 0; i < argc; ++i)
 	{
 		aug_value* arg = args + i;
-		switch(arg->type)
+		switch(aug_value_type(arg))
 		{
 			case AUG_CHAR:
-				aug_string_push(value.str, arg->c);
+				aug_string_push(aug_value_string(&value), aug_value_char(arg));
 				break;
 			case AUG_STRING:
-				aug_string_append(value.str, arg->str);
+				aug_string_append(aug_value_string(&value), aug_value_string(arg));
 				break;
 			default: break;
 		}
@@ -175,11 +201,11 @@ aug_value aug_std_concat(int argc, aug_value* args)
 aug_value aug_std_split(int argc, aug_value* args)
 {
 	assert(argc == 2);
-	assert(args[0].type == AUG_STRING && args[1].type == AUG_STRING);
+	assert(aug_value_type(&args[0]) == AUG_STRING && aug_value_type(&args[1]) == AUG_STRING);
 
 	aug_value value = aug_create_array();
-	aug_string* str = args[0].str;
-	aug_string* delim = args[1].str;
+	aug_string* str = aug_value_string(&args[0]);
+	aug_string* delim = aug_value_string(&args[1]);
 	aug_value line = aug_create_string("");
 	for (size_t i = 0; i < str->length; ++i)
 	{
@@ -196,18 +222,18 @@ aug_value aug_std_split(int argc, aug_value* args)
 
 			if(j == delim->length)
 			{				
-				aug_array_append(value.array, &line);
+				aug_array_append(aug_value_array(&value), &line);
 				line = aug_create_string("");
 				i += (j - 1); // -1 to account for the ++i in the for loop 
 			}
 		}
 		else
 		{
-			aug_string_push(line.str, c);
+			aug_string_push(aug_value_string(&line), c);
 		}
 	}
 	
-	aug_array_append(value.array, &line);
+	aug_array_append(aug_value_array(&value), &line);
 	return value;
 }
 
@@ -220,20 +246,23 @@ aug_value aug_std_append(int argc, aug_value* args)
 	{
 		aug_value* arg = args + i;
 
-		switch(value.type)
+		switch(aug_value_type(&value))
 		{
 		case AUG_ARRAY:
-			aug_array_append(value.array, arg);
+			aug_array_append(aug_value_array(&value), arg);
+			break;
+		case AUG_TYPED_ARRAY:
+			aug_typed_array_push(aug_value_typed_array(&value), arg);
 			break;
 		case AUG_STRING:
 		{
-			switch(arg->type)
+			switch(aug_value_type(arg))
 			{
 				case AUG_CHAR:
-					aug_string_push(value.str, arg->c);
+					aug_string_push(aug_value_string(&value), aug_value_char(arg));
 					break;
 				case AUG_STRING:
-					aug_string_append(value.str, arg->str);
+					aug_string_append(aug_value_string(&value), aug_value_string(arg));
 					break;
 				default: break;
 			}
@@ -248,21 +277,24 @@ aug_value aug_std_append(int argc, aug_value* args)
 aug_value aug_std_remove(int argc, aug_value* args)
 {
 	assert(argc == 2);
-	assert(args[0].type == AUG_ARRAY);
+	assert(aug_value_type(&args[0]) == AUG_ARRAY || aug_value_type(&args[0]) == AUG_MAP);
 
 	aug_value value = args[0];
 	aug_value index = args[1];
-	aug_array_remove(value.array, aug_to_int(&index));
+	if(aug_value_type(&value) == AUG_MAP)
+		aug_map_remove(aug_value_map(&value), &index);
+	else
+		aug_array_remove(aug_value_array(&value), aug_to_int(&index));
 	return aug_none();
 }
 
 aug_value aug_std_front(int argc, aug_value* args)
 {
 	assert(argc == 1);
-	assert(args[0].type == AUG_ARRAY);
+	assert(aug_value_type(&args[0]) == AUG_ARRAY);
 
 	aug_value value = args[0];
-	aug_value* element = aug_array_at(value.array, 0);
+	aug_value* element = aug_array_at(aug_value_array(&value), 0);
 	aug_incref(element);
 	if(element != NULL)
 		return *element;
@@ -272,10 +304,10 @@ aug_value aug_std_front(int argc, aug_value* args)
 aug_value aug_std_back(int argc, aug_value* args)
 {
 	assert(argc == 1);
-	assert(args[0].type == AUG_ARRAY);
+	assert(aug_value_type(&args[0]) == AUG_ARRAY);
 
 	aug_value value = args[0];
-	aug_value* element = aug_array_at(value.array, value.array->length - 1);
+	aug_value* element = aug_array_at(aug_value_array(&value), aug_value_array(&value)->length - 1);
 	aug_incref(element);
 	if(element != NULL)
 		return *element;
@@ -287,14 +319,18 @@ aug_value aug_std_length(int argc, aug_value* args)
 	assert(argc == 1);
 
 	aug_value value = args[0];
-	switch (value.type)
+	switch (aug_value_type(&value))
 	{
 	case AUG_STRING:
-		return aug_create_int(value.str->length);
+		return aug_create_int(aug_value_string(&value)->length);
 	case AUG_ARRAY:
-		return aug_create_int(value.array->length);
+		return aug_create_int(aug_value_array(&value)->length);
 	case AUG_MAP:
-		return aug_create_int(value.map->count);
+		return aug_create_int(aug_value_map(&value)->count);
+	case AUG_TYPED_ARRAY:
+		return aug_create_int(aug_value_typed_array(&value)->length);
+	case AUG_BUFFER_VIEW:
+		return aug_create_int(aug_value_buffer_view(&value)->length);
 	default: break;
 	}
 	return aug_none();
@@ -302,30 +338,111 @@ aug_value aug_std_length(int argc, aug_value* args)
 
 aug_value aug_std_contains(int argc, aug_value* args)
 {
-	assert(!((argc != 2 || argc != 4) && args[0].type != AUG_ARRAY));
+	assert(!((argc != 2 || argc != 4) && aug_value_type(&args[0]) != AUG_ARRAY));
 
 	aug_value value = args[0];
 	aug_value arg = args[1];
 
 	size_t start = 0;
-	size_t end = value.array->length;
+	size_t end = aug_value_array(&value)->length;
 
 	if(argc == 4)
 	{		
-		if(args[2].type != AUG_INT || args[3].type != AUG_INT)
+		if(aug_value_type(&args[2]) != AUG_INT || aug_value_type(&args[3]) != AUG_INT)
 			return aug_none();
 		start = aug_to_int(args + 2);
 		end = aug_to_int(args + 3);
 	}
 
 	for (size_t i = start; i < end; ++i){
-		aug_value* element = aug_array_at(value.array, i);
+		aug_value* element = aug_array_at(aug_value_array(&value), i);
 		if(aug_compare(&arg, element))
 			return aug_create_bool(true);
 	}
 	return aug_create_bool(false);
 }
 
+// Creates a typed array of the given length, or from the elements of an array
+aug_value aug_std_typed_array(aug_type element_type, int argc, aug_value* args)
+{
+	assert(argc == 1);
+
+	if(aug_value_type(&args[0]) != AUG_ARRAY)
+		return aug_create_typed_array(element_type, aug_to_int(args + 0));
+
+	aug_array* array = aug_value_array(&args[0]);
+	aug_value value = aug_create_typed_array(element_type, array->length);
+	for (size_t i = 0; i < array->length; ++i)
+		aug_typed_array_set(aug_value_typed_array(&value), i, aug_array_at(array, i));
+	return value;
+}
+
+aug_value aug_std_int_array(int argc, aug_value* args)
+{
+	return aug_std_typed_array(AUG_INT, argc, args);
+}
+
+aug_value aug_std_float_array(int argc, aug_value* args)
+{
+	return aug_std_typed_array(AUG_FLOAT, argc, args);
+}
+
+aug_value aug_std_array_add(int argc, aug_value* args)
+{
+	assert(argc == 2);
+	assert(aug_value_type(&args[0]) == AUG_TYPED_ARRAY && aug_value_type(&args[1]) == AUG_TYPED_ARRAY);
+
+	return aug_create_bool(aug_typed_array_add(aug_value_typed_array(&args[0]), aug_value_typed_array(&args[1])));
+}
+
+aug_value aug_std_array_mul(int argc, aug_value* args)
+{
+	assert(argc == 2);
+	assert(aug_value_type(&args[0]) == AUG_TYPED_ARRAY && aug_value_type(&args[1]) == AUG_TYPED_ARRAY);
+
+	return aug_create_bool(aug_typed_array_mul(aug_value_typed_array(&args[0]), aug_value_typed_array(&args[1])));
+}
+
+aug_value aug_std_array_scale(int argc, aug_value* args)
+{
+	assert(argc == 2);
+	assert(aug_value_type(&args[0]) == AUG_TYPED_ARRAY);
+
+	return aug_create_bool(aug_typed_array_scale(aug_value_typed_array(&args[0]), args + 1));
+}
+
+aug_value aug_std_array_sum(int argc, aug_value* args)
+{
+	assert(argc == 1);
+	assert(aug_value_type(&args[0]) == AUG_TYPED_ARRAY);
+
+	return aug_typed_array_sum(aug_value_typed_array(&args[0]));
+}
+
+aug_value aug_std_array_min(int argc, aug_value* args)
+{
+	assert(argc == 1);
+	assert(aug_value_type(&args[0]) == AUG_TYPED_ARRAY);
+
+	return aug_typed_array_min(aug_value_typed_array(&args[0]));
+}
+
+aug_value aug_std_array_max(int argc, aug_value* args)
+{
+	assert(argc == 1);
+	assert(aug_value_type(&args[0]) == AUG_TYPED_ARRAY);
+
+	return aug_typed_array_max(aug_value_typed_array(&args[0]));
+}
+
+aug_value aug_std_array_dot(int argc, aug_value* args)
+{
+	assert(argc == 2);
+	assert(aug_value_type(&args[0]) == AUG_TYPED_ARRAY && aug_value_type(&args[1]) == AUG_TYPED_ARRAY);
+
+	return aug_typed_array_dot(aug_value_typed_array(&args[0]), aug_value_typed_array(&args[1]));
+}
+
 aug_value aug_std_snap(int argc, aug_value* args)
 {
 	assert(argc == 2);
@@ -385,11 +502,11 @@ void core_makepath(char* path, const char* base, const char* file)
 aug_value aug_std_exec(int argc, aug_value* args)
 {
 	assert(argc == 1);
-	assert(args[0].type == AUG_STRING);
+	assert(aug_value_type(&args[0]) == AUG_STRING);
 
 	char syspath[1024] = {0};
 	core_basedir(syspath, s_std_vm->exec_filepath);
-	core_makepath(syspath, syspath, args[0].str->buffer);
+	core_makepath(syspath, syspath, aug_value_string(&args[0])->buffer);
 
 	aug_vm_exec_state exec_state;
 	aug_save_state(s_std_vm, &exec_state);
@@ -418,6 +535,15 @@ AUG_LIB aug_register_lib(aug_vm* vm)
 	aug_register(vm, "length",    aug_std_length    ) ;
 	aug_register(vm, "contains",  aug_std_contains  );
 	aug_register(vm, "split",     aug_std_split     );
+	aug_register(vm, "int_array",   aug_std_int_array   );
+	aug_register(vm, "float_array", aug_std_float_array );
+	aug_register(vm, "array_add",   aug_std_array_add   );
+	aug_register(vm, "array_mul",   aug_std_array_mul   );
+	aug_register(vm, "array_scale", aug_std_array_scale );
+	aug_register(vm, "array_sum",   aug_std_array_sum   );
+	aug_register(vm, "array_min",   aug_std_array_min   );
+	aug_register(vm, "array_max",   aug_std_array_max   );
+	aug_register(vm, "array_dot",   aug_std_array_dot   );
 }
 
 #ifdef __cplusplus
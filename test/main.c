@@ -4,6 +4,9 @@
 #include "dump.inl"
 
 #include <string.h>
+#if __linux
+#include <pthread.h>
+#endif
 
 struct aug_tester;
 typedef void(aug_tester_func)(aug_vm*);
@@ -61,7 +64,7 @@ void test_run(const char* filename, aug_vm* vm, aug_tester_func* func)
     else
         aug_execute(vm, s_tester.filename);
     
-    if(!vm->valid)
+    if(!vm->context->valid)
         s_tester.passed = 0;
 
     // End test
@@ -112,27 +115,27 @@ void to_string_map_pair(const aug_value* key, aug_value* value, void* user_data)
 aug_string* to_string(const aug_value* value)
 {
     char out[1024];
-    switch (value->type)
+    switch (aug_value_type(value))
     {
     case AUG_NONE:
         return aug_string_create("none");
     case AUG_BOOL:
-        snprintf(out, sizeof(out), "%s", value->b ? "true" : "false");
+        snprintf(out, sizeof(out), "%s", aug_value_bool(value) ? "true" : "false");
         break;
     case AUG_CHAR:
-        snprintf(out, sizeof(out), "%c", value->c);
+        snprintf(out, sizeof(out), "%c", aug_value_char(value));
         break;
     case AUG_INT:
-        snprintf(out, sizeof(out), "%d", value->i);
+        snprintf(out, sizeof(out), "%d", aug_value_int(value));
         break;
     case AUG_FLOAT:
-        snprintf(out, sizeof(out), "%f", value->f);
+        snprintf(out, sizeof(out), "%f", aug_value_float(value));
         break;
     case AUG_STRING:
-        snprintf(out, sizeof(out), "%s", value->str->buffer);
+        snprintf(out, sizeof(out), "%s", aug_value_string(value)->buffer);
         break;
     case AUG_FUNCTION:
-        snprintf(out, sizeof(out), "function %d", value->i);
+        snprintf(out, sizeof(out), "function %d", aug_value_int(value));
         break;
     case AUG_OBJECT:
         return aug_string_create("object");
@@ -141,15 +144,15 @@ aug_string* to_string(const aug_value* value)
     case AUG_ARRAY:
     {
         aug_string* str = aug_string_create("[");
-        if(value->array)
+        if(aug_value_array(value))
         {
-            for( size_t i = 0; i < value->array->length; ++i)
+            for( size_t i = 0; i < aug_value_array(value)->length; ++i)
             {
-                const aug_value* element = aug_array_at(value->array, i);
+                const aug_value* element = aug_array_at(aug_value_array(value), i);
                 aug_string* element_str = to_string(element);
                 aug_string_append(str, element_str);
                 aug_string_decref(element_str);
-                if( i != value->array->length - 1)
+                if( i != aug_value_array(value)->length - 1)
                     aug_string_append_bytes(str, ",", 1);
             }
         }
@@ -159,7 +162,7 @@ aug_string* to_string(const aug_value* value)
     case AUG_MAP:
     {
         aug_string* str = aug_string_create("{");
-        aug_map_foreach(value->map, to_string_map_pair, &str);
+        aug_map_foreach(aug_value_map(value), to_string_map_pair, str);
         aug_string_append_bytes(str, "\n}", 2);
         return str;
     }
@@ -170,7 +173,7 @@ aug_string* to_string(const aug_value* value)
 
 float sum_value(const aug_value* value, aug_type* type)
 {
-    switch (value->type)
+    switch (aug_value_type(value))
     {
     case AUG_NONE:
     case AUG_BOOL:
@@ -179,20 +182,20 @@ float sum_value(const aug_value* value, aug_type* type)
     case AUG_FUNCTION:
         return 0.0f;
     case AUG_INT:
-        return (float)value->i;
+        return (float)aug_value_int(value);
     case AUG_CHAR:
-        return (float)value->c;
+        return (float)aug_value_char(value);
     case AUG_FLOAT:
         *type = AUG_FLOAT;
-        return value->f;
+        return aug_value_float(value);
     case AUG_ARRAY:
     {
         float total = 0;
-        if(value->array)
+        if(aug_value_array(value))
         {
-            for( size_t i = 0; i < value->array->length; ++i)
+            for( size_t i = 0; i < aug_value_array(value)->length; ++i)
             {
-                const aug_value* entry = aug_array_at(value->array, i);
+                const aug_value* entry = aug_array_at(aug_value_array(value), i);
                 total += sum_value(entry, type);
             }
         }
@@ -218,6 +221,14 @@ aug_value sum(int argc, aug_value* args)
     return aug_none();
 }
 
+aug_value product(int argc, aug_value* args)
+{
+    int total = 1;
+    for( int i = 0; i < argc; ++i)
+        total *= aug_to_int(args+i);
+    return aug_create_int(total);
+}
+
 aug_value map_insert(int argc, aug_value* args)
 {
     if (argc != 3)
@@ -225,9 +236,9 @@ aug_value map_insert(int argc, aug_value* args)
     aug_value map = args[0];
     aug_value key = args[1];
     aug_value value = args[2];
-    if(map.type != AUG_MAP)
+    if(aug_value_type(&map) != AUG_MAP)
         return aug_none();
-    aug_map_insert(map.map, &key, &value);
+    aug_map_insert(aug_value_map(&map), &key, &value);
 
     return aug_none();
 }
@@ -263,7 +274,7 @@ void aug_test_native(aug_vm* vm)
 
         aug_value value = aug_call_args(vm, script, "fibonacci", 1, &args[0]);
 
-        bool success = value.i == 5;
+        bool success = aug_value_int(&value) == 5;
         //bool success = value.i == 832040;
         aug_string* message = aug_string_create("fibonacci = ");
         aug_string* value_str = to_string(&value);
@@ -280,7 +291,7 @@ void aug_test_native(aug_vm* vm)
 
         aug_value value = aug_call_args(vm, script, "count", 1, &args[0]);
         
-        bool success = value.i == n;
+        bool success = aug_value_int(&value) == n;
         aug_string* message = aug_string_create("count = ");
         aug_string* value_str = to_string(&value);
         aug_string_append(message, value_str);
@@ -290,6 +301,118 @@ void aug_test_native(aug_vm* vm)
         aug_string_decref(message);
     }
 
+    {
+        // re-registering must invalidate the script's resolved extensions
+        aug_value args[3];
+        args[0] = aug_create_int(2);
+        args[1] = aug_create_int(3);
+        args[2] = aug_create_int(4);
+
+        aug_value sum_value = aug_call_args(vm, script, "total", 3, &args[0]);
+        aug_unregister(vm, "sum");
+        aug_register(vm, "sum", product);
+        aug_value product_value = aug_call_args(vm, script, "total", 3, &args[0]);
+        aug_unregister(vm, "sum");
+        aug_register(vm, "sum", sum);
+
+        bool success = aug_value_int(&sum_value) == 9 && aug_value_int(&product_value) == 24;
+        aug_string* message = aug_string_create("total = ");
+        aug_string* value_str = to_string(&product_value);
+        aug_string_append(message, value_str);
+        test_verify(success, message);
+
+        aug_string_decref(value_str);
+        aug_string_decref(message);
+    }
+
+    {
+        // handles are resolved once, globals modified by each call remain in the script
+        aug_function update = aug_get_function(vm, script, "update");
+        aug_value value = aug_none();
+        for(int i = 0; i < 10; ++i)
+        {
+            aug_value args[1];
+            args[0] = aug_create_int(i);
+            aug_decref(&value);
+            value = aug_call_handle(vm, update, 1, &args[0]);
+        }
+
+        aug_value frames = aug_call(vm, script, "frame_count");
+        bool success = update.addr >= 0 && aug_value_int(&value) == 45 && aug_value_int(&frames) == 10;
+        aug_string* message = aug_string_create("update = ");
+        aug_string* value_str = to_string(&value);
+        aug_string_append(message, value_str);
+        test_verify(success, message);
+
+        aug_decref(&value);
+        aug_string_decref(value_str);
+        aug_string_decref(message);
+    }
+
+    {
+        // coroutines suspend at each yield, and are resumed while other calls are made
+        aug_function steps = aug_get_function(vm, script, "steps");
+        aug_coroutine coroutine;
+        coroutine.budget = 0;
+        aug_coroutine discarded;
+        discarded.budget = 0;
+
+        aug_value args[1];
+        args[0] = aug_create_int(4);
+        aug_value value = aug_coroutine_start(vm, &coroutine, steps, 1, &args[0]);
+        args[0] = aug_create_int(4);
+        aug_coroutine_start(vm, &discarded, steps, 1, &args[0]);
+
+        int resumes = 0;
+        while(coroutine.suspended)
+        {
+            aug_value frames = aug_call(vm, script, "frame_count");
+            aug_decref(&frames);
+            value = aug_resume(vm, &coroutine);
+            ++resumes;
+        }
+        aug_coroutine_release(&discarded);
+
+        // yields are ignored outside of coroutines
+        args[0] = aug_create_int(4);
+        aug_value call_value = aug_call_handle(vm, steps, 1, &args[0]);
+
+        bool success = aug_value_int(&value) == 6 && resumes == 4 && aug_value_int(&call_value) == 6 && !discarded.suspended;
+        aug_string* message = aug_string_create("steps = ");
+        aug_string* value_str = to_string(&value);
+        aug_string_append(message, value_str);
+        test_verify(success, message);
+
+        aug_string_decref(value_str);
+        aug_string_decref(message);
+    }
+    {
+        // the instruction budget suspends long running calls
+        aug_function spin = aug_get_function(vm, script, "spin");
+        aug_coroutine coroutine;
+        coroutine.budget = 100;
+
+        aug_value args[1];
+        args[0] = aug_create_int(1000);
+        aug_value value = aug_coroutine_start(vm, &coroutine, spin, 1, &args[0]);
+
+        int resumes = 0;
+        while(coroutine.suspended)
+        {
+            value = aug_resume(vm, &coroutine);
+            ++resumes;
+        }
+
+        bool success = aug_value_int(&value) == 1000 && resumes > 10;
+        aug_string* message = aug_string_create("spin = ");
+        aug_string* value_str = to_string(&value);
+        aug_string_append(message, value_str);
+        test_verify(success, message);
+
+        aug_string_decref(value_str);
+        aug_string_decref(message);
+    }
+
     // unload the script state and restore vm
     aug_unload(vm, script);
 }
@@ -307,11 +430,196 @@ void aug_test_gameloop(aug_vm* vm)
     aug_unload(vm, script);
 }
 
+#define AUG_TEST_CONTEXT_COUNT 4
+#define AUG_TEST_CONTEXT_CALLS 100
+
+typedef struct aug_test_context_job
+{
+    aug_context* context;
+    int total;
+    int calls;
+} aug_test_context_job;
+
+static void* aug_test_context_run(void* user)
+{
+    aug_test_context_job* job = (aug_test_context_job*)user;
+    job->total = 0;
+    aug_function work = aug_get_function(job->context->vm, job->context->script, "work");
+    for(int i = 0; i < AUG_TEST_CONTEXT_CALLS; ++i)
+    {
+        aug_value args[1];
+        args[0] = aug_create_int(100);
+        aug_value value = aug_context_call_handle(job->context, work, 1, &args[0]);
+        job->total += aug_value_int(&value);
+        aug_decref(&value);
+    }
+
+    aug_value calls = aug_context_call(job->context, "call_count");
+    job->calls = aug_value_int(&calls);
+    return NULL;
+}
+
+void aug_test_context(aug_vm* vm)
+{
+    // call the same script from separate contexts, each on its own thread
+    aug_script* script = aug_load(vm, s_tester.filename);
+
+    aug_test_context_job jobs[AUG_TEST_CONTEXT_COUNT];
+    for(int i = 0; i < AUG_TEST_CONTEXT_COUNT; ++i)
+        jobs[i].context = aug_context_new(vm, script, 256);
+
+#if __linux
+    pthread_t threads[AUG_TEST_CONTEXT_COUNT];
+    for(int i = 0; i < AUG_TEST_CONTEXT_COUNT; ++i)
+        pthread_create(&threads[i], NULL, aug_test_context_run, &jobs[i]);
+    for(int i = 0; i < AUG_TEST_CONTEXT_COUNT; ++i)
+        pthread_join(threads[i], NULL);
+#else
+    for(int i = 0; i < AUG_TEST_CONTEXT_COUNT; ++i)
+        aug_test_context_run(&jobs[i]);
+#endif
+
+    // work(100) sums 3 * i over 0:100, then adds 1 per name
+    const int expected = AUG_TEST_CONTEXT_CALLS * (3 * 4950 + 3);
+    for(int i = 0; i < AUG_TEST_CONTEXT_COUNT; ++i)
+    {
+        aug_value total = aug_create_int(jobs[i].total);
+        aug_string* message = aug_string_create("context total = ");
+        aug_string* value_str = to_string(&total);
+        aug_string_append(message, value_str);
+        test_verify(jobs[i].total == expected && jobs[i].calls == AUG_TEST_CONTEXT_CALLS, message);
+        aug_string_decref(value_str);
+        aug_string_decref(message);
+
+        aug_context_delete(jobs[i].context);
+    }
+
+    // contexts modify their own copies of the globals
+    aug_value calls = aug_call(vm, script, "call_count");
+    aug_string* message = aug_string_create("script calls unchanged");
+    test_verify(aug_value_int(&calls) == 0, message);
+    aug_string_decref(message);
+
+    aug_unload(vm, script);
+}
+
+static char* aug_test_read_file(const char* filename)
+{
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* buffer = (char*)malloc(size + 1);
+    buffer[fread(buffer, 1, size, file)] = '\0';
+    fclose(file);
+    return buffer;
+}
+
+static void aug_test_profile_expect(const char* output, const char* expected)
+{
+    aug_string* message = aug_string_create("profile contains ");
+    aug_string_append_bytes(message, expected, strlen(expected));
+    test_verify(output != NULL && strstr(output, expected) != NULL, message);
+    aug_string_decref(message);
+}
+
+void aug_test_profile(aug_vm* vm)
+{
+    const char* collapsed_filename = "aug_test_profile.folded";
+    const char* json_filename = "aug_test_profile.json";
+
+    aug_profiler* profiler = aug_profiler_new();
+    aug_profile(vm, profiler);
+
+    aug_script* script = aug_load(vm, s_tester.filename);
+    aug_function branch = aug_get_function(vm, script, "branch");
+    aug_function fib = aug_get_function(vm, script, "fib");
+    aug_function steps = aug_get_function(vm, script, "steps");
+
+    aug_value args[1];
+    args[0] = aug_create_int(100);
+    for(int i = 0; i < 5; ++i)
+        aug_call_handle(vm, branch, 1, args);
+
+    // fib(10) is called 177 times in total
+    args[0] = aug_create_int(10);
+    aug_call_handle(vm, fib, 1, args);
+
+    // resumed coroutines remain within their function
+    aug_coroutine coroutine;
+    coroutine.budget = 0;
+    args[0] = aug_create_int(3);
+    aug_coroutine_start(vm, &coroutine, steps, 1, args);
+    while(coroutine.suspended)
+        aug_resume(vm, &coroutine);
+
+    aug_profile(vm, NULL);
+    aug_profiler_save(profiler, collapsed_filename, AUG_PROFILE_COLLAPSED);
+    aug_profiler_save(profiler, json_filename, AUG_PROFILE_JSON);
+
+    char* collapsed = aug_test_read_file(collapsed_filename);
+    aug_test_profile_expect(collapsed, "(global) ");
+    aug_test_profile_expect(collapsed, "\nbranch;leaf ");
+    aug_test_profile_expect(collapsed, "\nfib;fib;fib ");
+    aug_test_profile_expect(collapsed, "\nsteps ");
+
+    // the script's top level calls branch(10) once before the handle calls
+    char* json = aug_test_read_file(json_filename);
+    aug_test_profile_expect(json, "{\"opcode\": \"ENTER_FUNC\", \"count\": ");
+    aug_test_profile_expect(json, "{\"name\": \"branch\", \"calls\": 6, ");
+    aug_test_profile_expect(json, "{\"name\": \"leaf\", \"calls\": 12, ");
+    aug_test_profile_expect(json, "{\"name\": \"fib\", \"calls\": 177, ");
+    aug_test_profile_expect(json, "{\"name\": \"steps\", \"calls\": 1, ");
+    aug_test_profile_expect(json, "{\"stack\": \"branch;leaf\", \"calls\": 12, ");
+    aug_test_profile_expect(json, "test_profile\", \"line\": ");
+
+    // detached profilers do not record
+    args[0] = aug_create_int(100);
+    aug_call_handle(vm, branch, 1, args);
+    aug_profiler_save(profiler, json_filename, AUG_PROFILE_JSON);
+    char* json_detached = aug_test_read_file(json_filename);
+    aug_string* message = aug_string_create("profile unchanged once detached");
+    test_verify(json != NULL && json_detached != NULL && strcmp(json, json_detached) == 0, message);
+    aug_string_decref(message);
+
+    free(json_detached);
+    free(json);
+    free(collapsed);
+    remove(collapsed_filename);
+    remove(json_filename);
+
+    aug_unload(vm, script);
+    aug_profiler_delete(profiler);
+}
+
+void aug_test_compiled(aug_vm* vm)
+{
+    // compile to file, then run the test from the precompiled file
+    const char* compiled_filename = "aug_test.augc";
+
+    aug_script* script = aug_compile(vm, s_tester.filename);
+    bool success = aug_save_compiled(vm, script, compiled_filename);
+    aug_unload(vm, script);
+    if(!success)
+    {
+        aug_string* message = aug_string_create("failed to save compiled script");
+        test_verify(false, message);
+        aug_string_decref(message);
+        return;
+    }
+
+    script = aug_load_compiled(vm, compiled_filename);
+    aug_unload(vm, script);
+    remove(compiled_filename);
+}
+
 void aug_test_eval(aug_vm* vm)
 {
     const char* code = "func count(a){ if a <= 0 return 0; return count(a-1) + 1;} count(5)";
     aug_value value = aug_eval(vm, code);
-    bool success = value.i == 5;
+    bool success = aug_value_int(&value) == 5;
     aug_string* message = aug_string_create("count = ");
     aug_string* value_str = to_string(&value);
     aug_string_append(message, value_str);
@@ -321,6 +629,687 @@ void aug_test_eval(aug_vm* vm)
     aug_decref(&value);
     aug_string_decref(value_str);
     aug_string_decref(message);
+
+    // names at the end of the code
+    value = aug_eval(vm, "var total = 0; for i in 0:10 { total += i; } total");
+    message = aug_string_create("total = ");
+    value_str = to_string(&value);
+    aug_string_append(message, value_str);
+    test_verify(aug_value_type(&value) == AUG_INT && aug_value_int(&value) == 45, message);
+
+    aug_decref(&value);
+    aug_string_decref(value_str);
+    aug_string_decref(message);
+}
+
+static void aug_test_write_file(const char* filename, const char* contents)
+{
+    FILE* file = fopen(filename, "wb");
+    if(file == NULL)
+        return;
+    fputs(contents, file);
+    fclose(file);
+}
+
+static void aug_test_cache_expect(aug_vm* vm, aug_script* script, int expected, const char* message_str)
+{
+    aug_value value = aug_call(vm, script, "value");
+    aug_string* message = aug_string_create(message_str);
+    test_verify(aug_value_type(&value) == AUG_INT && aug_value_int(&value) == expected, message);
+    aug_decref(&value);
+    aug_string_decref(message);
+}
+
+static void aug_test_cache_verify(bool success, const char* message_str)
+{
+    aug_string* message = aug_string_create(message_str);
+    test_verify(success, message);
+    aug_string_decref(message);
+}
+
+void aug_test_cache(aug_vm* vm)
+{
+    // compiles of an unmodified script share the cached compile, modifying the script or its import recompiles it
+    const char* filename = "./aug_test_cache";
+    const char* import_filename = "./aug_test_cache_import";
+    aug_test_write_file(filename, "import std; import \"aug_test_cache_import\"; func value() { return floor(base() + 0.5); }");
+    aug_test_write_file(import_filename, "func base() { return 1; }");
+
+    aug_script* script = aug_load(vm, filename);
+    aug_script* reused = aug_load(vm, filename);
+    aug_test_cache_expect(vm, script, 1, "cached value = 1");
+    aug_test_cache_expect(vm, reused, 1, "reused value = 1");
+    aug_test_cache_verify(script != NULL && reused != NULL && script->globals == reused->globals, "compile reused");
+    aug_test_cache_verify(script != NULL && reused != NULL && script->bytecode != reused->bytecode, "bytecode copied");
+    aug_unload(vm, reused);
+
+    // the lib is loaded once, later imports reuse its extensions
+    const size_t lib_count = vm->libs->count;
+    aug_execute(vm, filename);
+    aug_test_cache_verify(aug_hashtable_get(vm->libs, "std") != NULL && vm->libs->count == lib_count, "lib reused");
+
+    aug_test_write_file(import_filename, "func base() { return 10; }");
+    reused = aug_load(vm, filename);
+    aug_test_cache_expect(vm, reused, 10, "modified import value = 10");
+    aug_test_cache_verify(reused != NULL && script->globals != reused->globals, "import modified");
+    aug_unload(vm, reused);
+
+    aug_test_write_file(filename, "import std; import \"aug_test_cache_import\"; func value() { return floor(base() * 2.0); }");
+    reused = aug_load(vm, filename);
+    aug_test_cache_expect(vm, reused, 20, "modified script value = 20");
+    aug_unload(vm, reused);
+
+    // scripts loaded from the cache remain valid once cleared
+    aug_clear_cache(vm);
+    aug_test_cache_verify(vm->scripts->count == 0, "cache cleared");
+    aug_test_cache_expect(vm, script, 1, "cleared value = 1");
+    aug_unload(vm, script);
+
+    remove(filename);
+    remove(import_filename);
+}
+
+// Errors raised while testing the jit, concatenated
+static char s_aug_test_jit_errors[1024];
+
+static void aug_test_jit_on_error(const char* msg)
+{
+    const size_t length = strlen(s_aug_test_jit_errors);
+    snprintf(s_aug_test_jit_errors + length, sizeof(s_aug_test_jit_errors) - length, "%s\n", msg);
+}
+
+void aug_test_jit(aug_vm* vm)
+{
+    // hot functions give the same results once compiled, and report errors at the failing source line
+    const char* filename = "./aug_test_jit";
+    aug_test_write_file(filename,
+        "import std;\n"
+        "func square(x) { return x * x; }\n"
+        "func hot(n) {\n"
+        "    var total = 0;\n"
+        "    for i in 0:n { if i % 2 == 0 { total += square(i); } else { total -= 1; } }\n"
+        "    var values = [1, 2, 3];\n"
+        "    var entries = { \"a\": 1 };\n"
+        "    var i = 0;\n"
+        "    while i < length(values) { total += values[i] + entries[\"a\"]; i += 1; }\n"
+        "    return total;\n"
+        "}\n"
+        "func fail(x) {\n"
+        "    return x + [1];\n"
+        "}\n"
+        "func mix(a, b) { if a < b { return a + b; } return a * b; }\n"
+        "func loops(n) {\n"
+        "    var total = 0;\n"
+        "    var x = 0;\n"
+        "    while x < n {\n"
+        "        if x == n / 2 { x = x + 0.5; }\n"
+        "        x = x + 1;\n"
+        "        total += 1;\n"
+        "    }\n"
+        "    var text = \"\";\n"
+        "    for i in 0:n {\n"
+        "        for j in 0:3 { if j == 2 { break; } total += j; }\n"
+        "        if i > n - 3 { text += \"a\"; }\n"
+        "        var value = i;\n"
+        "        if i == n - 1 { value = text; }\n"
+        "        if i * 2.0 >= n * 2 - 2.5 { return [total, x, value]; }\n"
+        "    }\n"
+        "    return none;\n"
+        "}\n");
+
+    aug_script* script = aug_load(vm, filename);
+    aug_function hot = aug_get_function(vm, script, "hot");
+    aug_function fail = aug_get_function(vm, script, "fail");
+    aug_test_cache_verify(hot.addr >= 0 && fail.addr >= 0, "functions found");
+
+    bool valid = true;
+    for(int i = 0; i < AUG_JIT_THRESHOLD * 2 && hot.addr >= 0; ++i)
+    {
+        aug_value arg = aug_create_int(i % 10);
+        aug_value ret = aug_call_handle(vm, hot, 1, &arg);
+        int expected = 9;
+        for(int j = 0; j < i % 10; ++j)
+            expected += j % 2 == 0 ? j * j : -1;
+        valid &= aug_value_type(&ret) == AUG_INT && aug_value_int(&ret) == expected;
+        aug_decref(&ret);
+    }
+    aug_test_cache_verify(valid, "hot results");
+#if AUG_JIT && !AUG_DEBUG
+    // debug builds interpret every instruction to call the post instruction hook
+    aug_test_cache_verify(script != NULL && script->jit != NULL && script->jit->code->length > 0, "hot compiled");
+#endif//AUG_JIT
+
+    // quickened instructions specialize and revert once compiled, as the operand types change
+    aug_function mix = aug_get_function(vm, script, "mix");
+    for(int i = 0; i < AUG_JIT_THRESHOLD * 6 && mix.addr >= 0; ++i)
+    {
+        const int phase = i / (AUG_JIT_THRESHOLD * 2);
+        aug_value args[2];
+        args[0] = phase == 1 ? aug_create_float(1.5f) : aug_create_int(i % 4);
+        args[1] = phase == 1 ? aug_create_float(2.0f) : aug_create_int(2);
+        aug_value ret = aug_call_handle(vm, mix, 2, args);
+        if(phase == 1)
+            valid &= aug_value_type(&ret) == AUG_FLOAT && aug_value_float(&ret) == 3.5f;
+        else
+            valid &= aug_value_type(&ret) == AUG_INT && aug_value_int(&ret) == (i % 4 < 2 ? i % 4 + 2 : i % 4 * 2);
+        aug_decref(&ret);
+    }
+    aug_test_cache_verify(valid, "quickened results");
+
+    // loops are compiled once iterated, and continue in native code as the types change
+    aug_function loops = aug_get_function(vm, script, "loops");
+    for(int i = 0; i < 2 && loops.addr >= 0; ++i)
+    {
+        aug_value arg = aug_create_int(AUG_JIT_THRESHOLD * 4);
+        aug_value ret = aug_call_handle(vm, loops, 1, &arg);
+        aug_value expected = aug_create_array();
+        aug_value element = aug_create_int(AUG_JIT_THRESHOLD * 4 * 2);
+        aug_array_append(aug_value_array(&expected), &element);
+        element = aug_create_float(AUG_JIT_THRESHOLD * 4 + 0.5f);
+        aug_array_append(aug_value_array(&expected), &element);
+        element = aug_create_string("aa");
+        aug_array_append(aug_value_array(&expected), &element);
+        aug_decref(&element);
+        valid &= aug_compare(&ret, &expected);
+        aug_decref(&expected);
+        aug_decref(&ret);
+    }
+    aug_test_cache_verify(valid, "loop results");
+
+    aug_error_func* error_func = vm->error_func;
+    vm->error_func = aug_test_jit_on_error;
+    for(int i = 0; i < AUG_JIT_THRESHOLD * 2 && fail.addr >= 0; ++i)
+    {
+        s_aug_test_jit_errors[0] = '\0';
+        aug_value arg = aug_create_int(i);
+        aug_value ret = aug_call_handle(vm, fail, 1, &arg);
+        aug_decref(&ret);
+        valid &= strstr(s_aug_test_jit_errors, "return x + [1];") != NULL;
+        valid &= strstr(s_aug_test_jit_errors, "int + array not defined") != NULL;
+    }
+    vm->error_func = error_func;
+    aug_test_cache_verify(valid, "errors reported at the source line");
+
+    aug_unload(vm, script);
+    remove(filename);
+}
+
+// Runs sum with the backend, returns the instructions executed
+static uint64_t aug_test_registers_run(aug_vm* vm, const char* filename, int backend, int n, bool* valid)
+{
+    vm->backend = backend;
+    aug_script* script = aug_load(vm, filename);
+    aug_function sum = aug_get_function(vm, script, "sum");
+    aug_test_cache_verify(script != NULL && script->backend == backend && sum.addr >= 0, "compiled for the backend");
+
+    aug_profiler* profiler = aug_profiler_new();
+    aug_profile(vm, profiler);
+    aug_value arg = aug_create_int(n);
+    aug_value ret = aug_call_handle(vm, sum, 1, &arg);
+    aug_profile(vm, NULL);
+    *valid &= aug_value_type(&ret) == AUG_INT && aug_value_int(&ret) == 3 * n * (n - 1) / 2 - n;
+    aug_decref(&ret);
+
+    uint64_t instructions = 0;
+    for(int i = 0; i < AUG_OPCODE_COUNT; ++i)
+        instructions += profiler->opcode_counts[i];
+    if(backend == AUG_BACKEND_REGISTER)
+        *valid &= profiler->opcode_counts[AUG_OPCODE_ADD_REG] > 0 && profiler->opcode_counts[AUG_OPCODE_LT_JUMP_ZERO_REG] > 0;
+    else
+        *valid &= profiler->opcode_counts[AUG_OPCODE_ADD_REG] == 0;
+
+    aug_profiler_delete(profiler);
+    aug_unload(vm, script);
+    return instructions;
+}
+
+void aug_test_registers(aug_vm* vm)
+{
+    // scripts give the same results with either backend, the register backend executing fewer instructions
+    const char* filename = "./aug_test_registers";
+    aug_test_write_file(filename,
+        "var scale = 3;\n"
+        "func sum(n) {\n"
+        "    var total = 0;\n"
+        "    var i = 0;\n"
+        "    while i < n { var x = i * scale; total = total + x - 1; i += 1; }\n"
+        "    return total;\n"
+        "}\n"
+        "func fail(x) {\n"
+        "    var y = [1];\n"
+        "    return x + y;\n"
+        "}\n");
+
+    const int backend = vm->backend;
+    bool valid = true;
+    const uint64_t stack_instructions = aug_test_registers_run(vm, filename, AUG_BACKEND_STACK, 100, &valid);
+    const uint64_t register_instructions = aug_test_registers_run(vm, filename, AUG_BACKEND_REGISTER, 100, &valid);
+    aug_test_cache_verify(valid, "same results");
+    aug_test_cache_verify(register_instructions < stack_instructions, "fewer instructions");
+
+    // errors are reported at the failing source line
+    aug_script* script = aug_load(vm, filename);
+    aug_function fail = aug_get_function(vm, script, "fail");
+    aug_error_func* error_func = vm->error_func;
+    vm->error_func = aug_test_jit_on_error;
+    s_aug_test_jit_errors[0] = '\0';
+    aug_value arg = aug_create_int(1);
+    aug_value ret = aug_call_handle(vm, fail, 1, &arg);
+    aug_decref(&ret);
+    vm->error_func = error_func;
+    aug_test_cache_verify(strstr(s_aug_test_jit_errors, "return x + y;") != NULL, "error source line");
+    aug_test_cache_verify(strstr(s_aug_test_jit_errors, "int + array not defined") != NULL, "error message");
+
+    aug_unload(vm, script);
+    vm->backend = backend;
+    remove(filename);
+}
+
+#define AUG_TEST_BATCH_COUNT 1000
+
+void aug_test_batch(aug_vm* vm)
+{
+    // batched calls match the calls made one at a time, and failed calls do not stop the batch
+    const char* filename = "./aug_test_batch";
+    aug_test_write_file(filename,
+        "var calls = 0;\n"
+        "func scale(x, y) { calls += 1; return x * y; }\n"
+        "func make(x) { return [x, \"a string longer than the local storage\"]; }\n"
+        "func half(x) { if x % 2 == 0 { return x / 2; } return x + [1]; }\n"
+        "func call_count() { return calls; }\n");
+
+    aug_script* script = aug_load(vm, filename);
+    aug_function scale = aug_get_function(vm, script, "scale");
+    aug_function make = aug_get_function(vm, script, "make");
+    aug_function half = aug_get_function(vm, script, "half");
+    aug_test_cache_verify(scale.addr >= 0 && make.addr >= 0 && half.addr >= 0, "functions found");
+
+    static aug_value args[AUG_TEST_BATCH_COUNT * 2];
+    static aug_value results[AUG_TEST_BATCH_COUNT];
+    for(int i = 0; i < AUG_TEST_BATCH_COUNT; ++i)
+    {
+        args[i * 2] = aug_create_int(i);
+        args[i * 2 + 1] = aug_create_int(3);
+    }
+    int returned = aug_call_batch(vm, scale, AUG_TEST_BATCH_COUNT, 2, args, results);
+    bool valid = returned == AUG_TEST_BATCH_COUNT;
+    for(int i = 0; i < AUG_TEST_BATCH_COUNT; ++i)
+        valid &= aug_value_type(&results[i]) == AUG_INT && aug_value_int(&results[i]) == i * 3;
+    aug_value calls = aug_call(vm, script, "call_count");
+    valid &= aug_value_int(&calls) == AUG_TEST_BATCH_COUNT;
+    aug_test_cache_verify(valid, "batch results");
+
+    // discarded results are released
+    const aug_vm_stats stats = aug_get_stats(vm);
+    for(int i = 0; i < AUG_TEST_BATCH_COUNT; ++i)
+        args[i] = aug_create_int(i);
+    returned = aug_call_batch(vm, make, AUG_TEST_BATCH_COUNT, 1, args, NULL);
+    const aug_vm_stats batch_stats = aug_get_stats(vm);
+    aug_test_cache_verify(returned == AUG_TEST_BATCH_COUNT && batch_stats.live_arrays == stats.live_arrays 
+        && batch_stats.live_strings == stats.live_strings, "batch results released");
+
+    aug_error_func* error_func = vm->error_func;
+    vm->error_func = aug_test_jit_on_error;
+    for(int i = 0; i < AUG_TEST_BATCH_COUNT; ++i)
+        args[i] = aug_create_int(i);
+    returned = aug_call_batch(vm, half, AUG_TEST_BATCH_COUNT, 1, args, results);
+    vm->error_func = error_func;
+    valid = returned == AUG_TEST_BATCH_COUNT / 2;
+    for(int i = 0; i < AUG_TEST_BATCH_COUNT; ++i)
+        valid &= i % 2 == 0 ? aug_to_int(&results[i]) == i / 2 : aug_value_type(&results[i]) == AUG_NONE;
+    aug_test_cache_verify(valid, "failed calls continue");
+
+    // contexts run batches with their own globals
+    aug_context* context = aug_context_new(vm, script, 256);
+    for(int i = 0; i < AUG_TEST_BATCH_COUNT; ++i)
+    {
+        args[i * 2] = aug_create_int(i);
+        args[i * 2 + 1] = aug_create_int(-1);
+    }
+    returned = aug_context_call_batch(context, scale, AUG_TEST_BATCH_COUNT, 2, args, results);
+    valid = returned == AUG_TEST_BATCH_COUNT;
+    for(int i = 0; i < AUG_TEST_BATCH_COUNT; ++i)
+        valid &= aug_value_int(&results[i]) == -i;
+    aug_value context_calls = aug_context_call(context, "call_count");
+    valid &= aug_value_int(&context_calls) == AUG_TEST_BATCH_COUNT * 2;
+    aug_test_cache_verify(valid, "context batch results");
+    aug_context_delete(context);
+
+    aug_unload(vm, script);
+    remove(filename);
+}
+
+typedef struct aug_test_view_point
+{
+    float x;
+    float y;
+    int8_t tag;
+} aug_test_view_point;
+
+void aug_test_view_release(void* data, void* user)
+{
+    assert(data != NULL);
+    ++*(int*)user;
+}
+
+void aug_test_view(aug_vm* vm)
+{
+    // scripts read and write host memory in place through views
+    const char* filename = "./aug_test_view";
+    aug_test_write_file(filename,
+        "func sum(view) { var total = 0; for x in view { total += x; } return total; }\n"
+        "func fill(view, n, x) { for i in 0:n { view[i] = x + i; } }\n"
+        "func get(view, i) { return view[i]; }\n"
+        "func same(a, b) { return a == b; }\n");
+
+    aug_script* script = aug_load(vm, filename);
+    aug_function sum = aug_get_function(vm, script, "sum");
+    aug_function fill = aug_get_function(vm, script, "fill");
+    aug_function get = aug_get_function(vm, script, "get");
+    aug_function same = aug_get_function(vm, script, "same");
+    aug_test_cache_verify(sum.addr >= 0 && fill.addr >= 0 && get.addr >= 0 && same.addr >= 0, "functions found");
+
+    int releases = 0;
+    int16_t samples[8] = {1, 2, 3, 4, -5, 6, 7, 8};
+    aug_value view = aug_create_buffer_view(samples, AUG_VIEW_INT16, 8, 0, aug_test_view_release, &releases);
+    aug_test_cache_verify(aug_value_type(&view) == AUG_BUFFER_VIEW, "view created");
+
+    aug_incref(&view);
+    aug_value total = aug_call_handle(vm, sum, 1, &view);
+    aug_test_cache_verify(aug_value_type(&total) == AUG_INT && aug_value_int(&total) == 26, "view iterated");
+
+    aug_value args[3];
+    aug_incref(&view);
+    args[0] = view;
+    args[1] = aug_create_int(8);
+    args[2] = aug_create_int(32766);
+    aug_value ret = aug_call_handle(vm, fill, 3, args);
+    aug_decref(&ret);
+    aug_test_cache_verify(samples[0] == 32766 && samples[1] == 32767 && samples[2] == -32768, "view written, narrowing wraps");
+    aug_test_cache_verify(releases == 0, "view unreleased while referenced");
+
+    // strided views over a field of an array of structs
+    aug_test_view_point points[4];
+    for(int i = 0; i < 4; ++i)
+    {
+        points[i].x = (float)i;
+        points[i].y = 0.5f * (float)i;
+        points[i].tag = (int8_t)i;
+    }
+    aug_value ys = aug_create_buffer_view(&points[0].y, AUG_VIEW_FLOAT, 4, sizeof(aug_test_view_point), NULL, NULL);
+    aug_incref(&ys);
+    total = aug_call_handle(vm, sum, 1, &ys);
+    aug_test_cache_verify(aug_value_type(&total) == AUG_FLOAT && aug_value_float(&total) == 3.0f, "strided view iterated");
+
+    aug_incref(&ys);
+    args[0] = ys;
+    args[1] = aug_create_int(4);
+    args[2] = aug_create_float(0.25f);
+    ret = aug_call_handle(vm, fill, 3, args);
+    aug_decref(&ret);
+    bool valid = true;
+    for(int i = 0; i < 4; ++i)
+        valid &= points[i].x == (float)i && points[i].y == 0.25f + (float)i && points[i].tag == (int8_t)i;
+    aug_test_cache_verify(valid, "strided view written");
+
+    // out of bounds reads are errors, equal elements compare equal across layouts
+    float floats[4] = {0.25f, 1.25f, 2.25f, 3.25f};
+    aug_value packed = aug_create_buffer_view(floats, AUG_VIEW_FLOAT, 4, 0, NULL, NULL);
+    aug_incref(&ys);
+    args[0] = ys;
+    args[1] = packed;
+    ret = aug_call_handle(vm, same, 2, args);
+    aug_test_cache_verify(aug_value_type(&ret) == AUG_BOOL && aug_value_bool(&ret), "views compared");
+
+    aug_error_func* error_func = vm->error_func;
+    vm->error_func = aug_test_jit_on_error;
+    aug_incref(&ys);
+    args[0] = ys;
+    args[1] = aug_create_int(4);
+    ret = aug_call_handle(vm, get, 2, args);
+    vm->error_func = error_func;
+    aug_test_cache_verify(aug_value_type(&ret) == AUG_NONE, "out of bounds read");
+
+    aug_decref(&ys);
+    aug_decref(&view);
+    aug_test_cache_verify(releases == 1, "view released once");
+
+    aug_unload(vm, script);
+    remove(filename);
+}
+
+void aug_test_snapshot(aug_vm* vm)
+{
+    // snapshots restore the reachable values in place, and copy the containers on their first change since saved
+    const char* filename = "./aug_test_snapshot";
+    aug_test_write_file(filename,
+        "var frame = 0;\n"
+        "var pos = [0, 0];\n"
+        "var players = { \"a\": pos, \"b\": [5, 5] };\n"
+        "var shared = [pos, pos];\n"
+        "var name = none;\n"
+        "var cycle = [0, 1.5]; cycle[0] = cycle;\n"
+        "func step() { frame += 1; pos[0] += 1; players[\"b\"][1] -= 1; name[frame - 1] = 'z'; }\n"
+        "func position() { return pos; }\n"
+        "func rename(n) { name = n; }\n"
+        "func state() { return [frame, pos[0], shared[1][0], players[\"b\"][1], name, cycle[0][1]]; }\n"
+        "func aliased() { pos[1] = 7; return shared[0][1] == 7 and players[\"a\"][1] == 7; }\n");
+
+    aug_script* script = aug_load(vm, filename);
+    aug_value position = aug_call(vm, script, "position");
+    aug_value name = aug_create_string("abc");
+    aug_value ret = aug_call_args(vm, script, "rename", 1, &name);
+    aug_decref(&ret);
+    aug_snapshot* initial = aug_snapshot_save(vm, script);
+    aug_test_cache_verify(initial != NULL && initial->node_count == 0, "snapshot saved");
+
+    for(int i = 0; i < 3; ++i)
+    {
+        ret = aug_call(vm, script, "step");
+        aug_decref(&ret);
+    }
+    aug_snapshot* stepped = aug_snapshot_save(vm, script);
+    aug_test_cache_verify(stepped != NULL && stepped->node_count == 0, "snapshot saved unchanged");
+
+    // the changed arrays and string are copied, the players map and the other arrays are unchanged
+    bool map_copied = false;
+    for(size_t i = 0; i < initial->node_count; ++i)
+        map_copied = map_copied || aug_value_type(&initial->nodes[i].value) == AUG_MAP;
+    aug_test_cache_verify(initial->node_count == 3 && !map_copied, "unchanged containers not copied");
+    const aug_snapshot_node* pos_node = aug_snapshot_find(initial, aug_value_pointer(&position));
+    aug_test_cache_verify(pos_node != NULL && aug_value_int(&pos_node->image->values[0]) == 0, "changed array copied");
+
+    aug_value state = aug_call(vm, script, "state");
+    aug_value expected = aug_eval(vm, "[3, 3, 3, 2, \"zzz\", 1.5]");
+    aug_test_cache_verify(aug_compare(&state, &expected), "stepped state");
+    aug_decref(&state);
+    aug_decref(&expected);
+
+    aug_test_cache_verify(aug_snapshot_restore(vm, script, initial), "snapshot restored");
+    state = aug_call(vm, script, "state");
+    expected = aug_eval(vm, "[0, 0, 0, 5, \"abc\", 1.5]");
+    aug_test_cache_verify(aug_compare(&state, &expected), "initial state");
+    aug_test_cache_verify(aug_value_int(aug_array_at(aug_value_array(&position), 0)) == 0, "restored in place");
+    aug_test_cache_verify(stepped->node_count == 3 && aug_snapshot_find(stepped, aug_value_pointer(&position)) != NULL, "restore copied to later snapshots");
+    aug_decref(&state);
+    aug_decref(&expected);
+
+    // serialized snapshots restore the same graph, aliases included
+    const size_t size = aug_snapshot_serialize(stepped, NULL, 0);
+    char* buffer = (char*)malloc(size);
+    aug_test_cache_verify(size > 0 && aug_snapshot_serialize(stepped, buffer, size) == size, "snapshot serialized");
+    aug_test_cache_verify(aug_snapshot_deserialize(vm, buffer, size - 1) == NULL, "truncated snapshot rejected");
+    aug_snapshot* received = aug_snapshot_deserialize(vm, buffer, size);
+    free(buffer);
+    aug_test_cache_verify(received != NULL && aug_snapshot_restore(vm, script, received), "deserialized snapshot restored");
+
+    state = aug_call(vm, script, "state");
+    expected = aug_eval(vm, "[3, 3, 3, 2, \"zzz\", 1.5]");
+    aug_test_cache_verify(aug_compare(&state, &expected), "deserialized state");
+    aug_decref(&state);
+    aug_decref(&expected);
+    aug_value aliased = aug_call(vm, script, "aliased");
+    aug_test_cache_verify(aug_value_type(&aliased) == AUG_BOOL && aug_value_bool(&aliased), "aliases restored");
+
+    // restoring the later snapshot undoes the restore of the initial one
+    aug_test_cache_verify(aug_snapshot_restore(vm, script, stepped), "later snapshot restored");
+    state = aug_call(vm, script, "state");
+    expected = aug_eval(vm, "[3, 3, 3, 2, \"zzz\", 1.5]");
+    aug_test_cache_verify(aug_compare(&state, &expected) && aug_value_int(aug_array_at(aug_value_array(&position), 0)) == 3, "later state");
+    aug_decref(&state);
+    aug_decref(&expected);
+
+    aug_snapshot_delete(received);
+    aug_snapshot_delete(stepped);
+    aug_snapshot_delete(initial);
+    aug_decref(&position);
+    aug_unload(vm, script);
+    remove(filename);
+}
+
+typedef struct aug_test_allocator_stats
+{
+    int alloc_count;
+    int free_count;
+} aug_test_allocator_stats;
+
+void* aug_test_alloc(void* user, size_t size)
+{
+    ++((aug_test_allocator_stats*)user)->alloc_count;
+    return malloc(size);
+}
+
+void* aug_test_realloc(void* user, void* ptr, size_t size)
+{
+    if(ptr == NULL)
+        ++((aug_test_allocator_stats*)user)->alloc_count;
+    return realloc(ptr, size);
+}
+
+void aug_test_free(void* user, void* ptr)
+{
+    if(ptr != NULL)
+        ++((aug_test_allocator_stats*)user)->free_count;
+    free(ptr);
+}
+
+void aug_test_allocator(aug_vm* vm)
+{
+    // run in a separate vm with its own allocator. iterators and ranges created per iteration should come from the slab pools
+    aug_test_allocator_stats stats = {0, 0};
+    aug_allocator allocator = { aug_test_alloc, aug_test_realloc, aug_test_free, &stats };
+
+    aug_vm* alloc_vm = aug_startup(vm->error_func, &allocator);
+    const char* code = "func count(){ var total = 0; for i in 0:10000 { for j in 0:2 { total += j; } for c in \"ab\" { total += 1; } } return total; } count()";
+    aug_value value = aug_eval(alloc_vm, code);
+
+    aug_string* message = aug_string_create("total = ");
+    aug_string* value_str = to_string(&value);
+    aug_string_append(message, value_str);
+    test_verify(aug_value_type(&value) == AUG_INT && aug_value_int(&value) == 30000, message);
+    aug_decref(&value);
+    aug_string_decref(value_str);
+    aug_string_decref(message);
+
+    const int pooled_alloc_count = stats.alloc_count;
+    message = aug_string_create("pooled allocations");
+    test_verify(pooled_alloc_count > 0 && pooled_alloc_count < 100, message);
+    aug_string_decref(message);
+
+    // the vm counts the same allocations, excluding its heap
+    aug_vm_stats vm_stats = aug_get_stats(alloc_vm);
+    message = aug_string_create("vm stats allocations");
+    test_verify((int)vm_stats.alloc_count + 1 == stats.alloc_count && vm_stats.alloc_count - vm_stats.free_count > 0, message);
+    aug_string_decref(message);
+
+    message = aug_string_create("vm stats values released");
+    test_verify(vm_stats.live_strings == 0 && vm_stats.live_arrays == 0 && vm_stats.live_maps == 0 
+        && vm_stats.live_iterators == 0 && vm_stats.live_ranges == 0, message);
+    aug_string_decref(message);
+
+    message = aug_string_create("vm stats references");
+    test_verify(vm_stats.incref_count > 0 && vm_stats.decref_count > 0 && vm_stats.peak_bytes >= vm_stats.live_bytes, message);
+    aug_string_decref(message);
+
+    // values returned to the host remain alive until released
+    const size_t live_bytes = vm_stats.live_bytes;
+    value = aug_eval(alloc_vm, "[\"a string longer than the local storage\", {1:2}]");
+    vm_stats = aug_get_stats(alloc_vm);
+    message = aug_string_create("vm stats live values");
+    // the string shares the buffer of its literal, and keeps it alive
+    test_verify(vm_stats.live_arrays == 1 && vm_stats.live_maps == 1 && vm_stats.live_strings == 2 
+        && vm_stats.live_bytes > live_bytes, message);
+    aug_string_decref(message);
+
+    aug_decref(&value);
+    vm_stats = aug_get_stats(alloc_vm);
+    message = aug_string_create("vm stats live values released");
+    test_verify(vm_stats.live_arrays == 0 && vm_stats.live_maps == 0 && vm_stats.live_strings == 0, message);
+    aug_string_decref(message);
+
+    aug_shutdown(alloc_vm);
+    message = aug_string_create("all allocations freed");
+    test_verify(stats.alloc_count == stats.free_count, message);
+    aug_string_decref(message);
+}
+
+void aug_test_collect(aug_vm* vm)
+{
+    // run in a separate vm, so that the statistics only count the collected values
+    aug_vm* collect_vm = aug_startup(vm->error_func, NULL);
+    const char* code = 
+        "func cycles(n) {\n"
+        "    for i in 0:n {\n"
+        "        var a = [0, 1]; a[0] = a;\n"
+        "        var m = { \"self\": 0 }; m[\"self\"] = m;\n"
+        "        var x = { \"y\": 0 }; var y = { \"x\": x }; x[\"y\"] = [y, \"a string longer than the local storage\"];\n"
+        "    }\n"
+        "    var keep = [1, 2, 3];\n"
+        "    var c = [keep, 0]; c[1] = c;\n"
+        "    return keep;\n"
+        "}\n"
+        "cycles(100)";
+    aug_value value = aug_eval(collect_vm, code);
+
+    // steps of a budget collect part of the cycles
+    size_t partial = 0;
+    for(int i = 0; i < 10; ++i)
+        partial += aug_collect(collect_vm, 1);
+    const size_t collected = partial + aug_collect(collect_vm, 0);
+    aug_vm_stats vm_stats = aug_get_stats(collect_vm);
+
+#if AUG_CYCLE_COLLECT
+    aug_test_cache_verify(partial > 0 && partial < 501, "collected incrementally");
+    aug_test_cache_verify(collected == 501 && vm_stats.collected_count == 501, "cycles collected");
+    aug_test_cache_verify(vm_stats.live_arrays == 1 && vm_stats.live_maps == 0 && vm_stats.live_strings == 0, "cycles released");
+#else
+    aug_test_cache_verify(collected == 0 && vm_stats.collected_count == 0, "cycles not collected");
+#endif//AUG_CYCLE_COLLECT
+
+    // containers referenced from a collected cycle remain alive
+    aug_string* message = aug_string_create("kept = ");
+    aug_string* value_str = to_string(&value);
+    aug_string_append(message, value_str);
+    test_verify(aug_value_type(&value) == AUG_ARRAY && aug_value_array(&value)->length == 3 
+        && aug_value_int(aug_array_at(aug_value_array(&value), 2)) == 3, message);
+    aug_string_decref(value_str);
+    aug_string_decref(message);
+    aug_decref(&value);
+
+    // large maps release their entries over the next steps
+    value = aug_eval(collect_vm, "func large() { var m = {}; for i in 0:10000 { m[i] = [i]; } return 0; } large()");
+    vm_stats = aug_get_stats(collect_vm);
+#if AUG_CYCLE_COLLECT && AUG_DEFER_RELEASE_SIZE > 0 && AUG_DEFER_RELEASE_SIZE < 10000 && AUG_COLLECT_BUDGET < 10000
+    aug_test_cache_verify(vm_stats.live_maps == 1 && vm_stats.live_arrays > 1 && vm_stats.live_arrays < 10001, "release deferred");
+#endif//AUG_DEFER_RELEASE_SIZE
+
+    aug_collect(collect_vm, 0);
+#if AUG_CYCLE_COLLECT
+    vm_stats = aug_get_stats(collect_vm);
+    aug_test_cache_verify(vm_stats.live_arrays == 0 && vm_stats.live_maps == 0, "release completed");
+#endif//AUG_CYCLE_COLLECT
+
+    aug_shutdown(collect_vm);
 }
 
 void on_aug_error(const char* msg)
@@ -329,21 +1318,21 @@ void on_aug_error(const char* msg)
 }
 
 #if AUG_DEBUG
-void on_aug_post_instruction_debug(aug_vm* vm, int opcode)
+void on_aug_post_instruction_debug(aug_context* context, int opcode)
 {
-    printf("%ld:   %s\n", vm->instruction - vm->bytecode, aug_opcode_label(opcode));
+    printf("%ld:   %s\n", context->instruction - context->bytecode, aug_opcode_label(opcode));
     int i;
     for(i = 0; i < 10; ++i)
     {
-        aug_value val = vm->stack[i];
-        printf("%s %d: %s ", (vm->stack_index-1) == i ? ">" : " ", i, aug_type_label(&val));
-        switch(val.type)
+        aug_value val = context->stack[i];
+        printf("%s %d: %s ", (context->stack_index-1) == i ? ">" : " ", i, aug_type_label(&val));
+        switch(aug_value_type(&val))
         {
-            case AUG_INT:      printf("%d", val.i); break;
-            case AUG_FLOAT:    printf("%f", val.f); break;
-            case AUG_STRING:   printf("%s", val.str->buffer); break;
-            case AUG_BOOL:     printf("%s", val.b ? "true" : "false"); break;
-            case AUG_CHAR:     printf("%c", val.c); break;
+            case AUG_INT:      printf("%d", aug_value_int(&val)); break;
+            case AUG_FLOAT:    printf("%f", aug_value_float(&val)); break;
+            case AUG_STRING:   printf("%s", aug_value_string(&val)->buffer); break;
+            case AUG_BOOL:     printf("%s", aug_value_bool(&val) ? "true" : "false"); break;
+            case AUG_CHAR:     printf("%c", aug_value_char(&val)); break;
             default: break;
         }
         printf("\n");
@@ -354,7 +1343,7 @@ void on_aug_post_instruction_debug(aug_vm* vm, int opcode)
 
 int main(int argc, char**argv)
 {
-    aug_vm* vm = aug_startup(on_aug_error);
+    aug_vm* vm = aug_startup(on_aug_error, NULL);
     vm->exec_filepath = *argv;
 
 #if AUG_DEBUG
@@ -365,6 +1354,9 @@ int main(int argc, char**argv)
     aug_register(vm, "sum", sum);
     test_startup();
 
+    // used to run script tests, overriden to run from the precompiled script
+    aug_tester_func* script_func = NULL;
+
     for(int i = 1; i < argc; ++i)
     {
         if (argv[i] && strcmp(argv[i], "--verbose") == 0)
@@ -375,6 +1367,41 @@ int main(int argc, char**argv)
         {
             s_tester.dump = true;
         }
+        else if (argv[i] && strcmp(argv[i], "--optimize") == 0)
+        {
+            if (++i >= argc)
+            {
+                printf("aug_test: --optimize parameter expected level!");
+                break;
+            }
+            vm->optimize_level = atoi(argv[i]);
+        }
+        else if (argv[i] && strcmp(argv[i], "--backend") == 0)
+        {
+            if (++i >= argc)
+            {
+                printf("aug_test: --backend parameter expected backend!");
+                break;
+            }
+            vm->backend = atoi(argv[i]);
+        }
+        else if (argv[i] && strcmp(argv[i], "--compiled") == 0)
+        {
+            script_func = aug_test_compiled;
+        }
+        else if (argv[i] && strcmp(argv[i], "--compile") == 0)
+        {
+            if (i + 2 >= argc)
+            {
+                printf("aug_test: --compile parameter expected script and output filename!");
+                break;
+            }
+            aug_script* script = aug_compile(vm, argv[i + 1]);
+            if (!aug_save_compiled(vm, script, argv[i + 2]))
+                printf("aug_test: --compile failed to compile %s\n", argv[i + 1]);
+            aug_unload(vm, script);
+            i += 2;
+        }
         else if (argv[i] && strcmp(argv[i], "--test") == 0)
         {
             if (++i >= argc)
@@ -382,7 +1409,7 @@ int main(int argc, char**argv)
                 printf("aug_test: --exec parameter expected filename!");
                 break;
             }
-            test_run(argv[i], vm, NULL);
+            test_run(argv[i], vm, script_func);
         }
         else if (argv[i] && strcmp(argv[i], "--test_native") == 0)
         {
@@ -414,13 +1441,63 @@ int main(int argc, char**argv)
 
             while ( i < argc && strncmp(argv[i], "--", 2) != 0)
             {
-                test_run(argv[i++], vm, NULL);
+                test_run(argv[i++], vm, script_func);
             }
         }
         else if (argv[i] && strcmp(argv[i], "--test_eval") == 0)
         {
             test_run(argv[i], vm, aug_test_eval);
         }
+        else if (argv[i] && strcmp(argv[i], "--test_cache") == 0)
+        {
+            test_run(argv[i], vm, aug_test_cache);
+        }
+        else if (argv[i] && strcmp(argv[i], "--test_jit") == 0)
+        {
+            test_run(argv[i], vm, aug_test_jit);
+        }
+        else if (argv[i] && strcmp(argv[i], "--test_registers") == 0)
+        {
+            test_run(argv[i], vm, aug_test_registers);
+        }
+        else if (argv[i] && strcmp(argv[i], "--test_batch") == 0)
+        {
+            test_run(argv[i], vm, aug_test_batch);
+        }
+        else if (argv[i] && strcmp(argv[i], "--test_view") == 0)
+        {
+            test_run(argv[i], vm, aug_test_view);
+        }
+        else if (argv[i] && strcmp(argv[i], "--test_snapshot") == 0)
+        {
+            test_run(argv[i], vm, aug_test_snapshot);
+        }
+        else if (argv[i] && strcmp(argv[i], "--test_collect") == 0)
+        {
+            test_run(argv[i], vm, aug_test_collect);
+        }
+        else if (argv[i] && strcmp(argv[i], "--test_allocator") == 0)
+        {
+            test_run(argv[i], vm, aug_test_allocator);
+        }
+        else if (argv[i] && strcmp(argv[i], "--test_context") == 0)
+        {
+            if (++i >= argc)
+            {
+                printf("aug_test: --test_context parameter expected filename!");
+                break;
+            }
+            test_run(argv[i], vm, aug_test_context);
+        }
+        else if (argv[i] && strcmp(argv[i], "--test_profile") == 0)
+        {
+            if (++i >= argc)
+            {
+                printf("aug_test: --test_profile parameter expected filename!");
+                break;
+            }
+            test_run(argv[i], vm, aug_test_profile);
+        }
     }
 
     test_shutdown();